@@ -0,0 +1,131 @@
+#include "active_note_tracker.h"
+#include "ump_utils.h"
+#include <bit>
+
+namespace {
+size_t noteIndex(uint8_t group, uint8_t channel, uint8_t note) {
+    return (static_cast<size_t>(group & 0xF) << 11) | (static_cast<size_t>(channel & 0xF) << 7) | (note & 0x7F);
+}
+}
+
+ActiveNoteTracker::ActiveNoteTracker()
+    : onTimeMs_(new std::atomic<uint32_t>[16 * 16 * 128]),
+      epoch_(std::chrono::steady_clock::now()) {
+    clear();
+    for (size_t i = 0; i < 16 * 16 * 128; i++) {
+        onTimeMs_[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+uint32_t ActiveNoteTracker::nowMs() const {
+    return static_cast<uint32_t>(
+        std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - epoch_).count());
+}
+
+void ActiveNoteTracker::observe(const uint32_t* words) {
+    const uint8_t type = umpMessageType(words[0]);
+    if (type != 0x2 && type != 0x4) return;
+
+    const uint8_t group = umpGroup(words[0]);
+    const uint8_t opcode = (words[0] >> 20) & 0xF;
+    const uint8_t channel = (words[0] >> 16) & 0xF;
+    const uint8_t index = (words[0] >> 8) & 0x7F;
+
+    switch (opcode) {
+        case 0x9:
+            // In MIDI 1.0 velocity 0 means Note Off; in MIDI 2.0 it is a real (silent) Note On
+            if (type == 0x2 && (words[0] & 0x7F) == 0) {
+                noteOff(group, channel, index);
+            } else {
+                noteOn(group, channel, index);
+            }
+            break;
+        case 0x8:
+            noteOff(group, channel, index);
+            break;
+        case 0xB:
+            if (index == 120 || index == 123) {  // All Sound Off, All Notes Off
+                clearChannel(group, channel);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void ActiveNoteTracker::noteOn(uint8_t group, uint8_t channel, uint8_t note) {
+    onTimeMs_[noteIndex(group, channel, note)].store(nowMs(), std::memory_order_relaxed);
+    bits_[group & 0xF][channel & 0xF][(note >> 6) & 1].fetch_or(1ULL << (note & 63), std::memory_order_release);
+}
+
+void ActiveNoteTracker::noteOff(uint8_t group, uint8_t channel, uint8_t note) {
+    bits_[group & 0xF][channel & 0xF][(note >> 6) & 1].fetch_and(~(1ULL << (note & 63)), std::memory_order_release);
+}
+
+void ActiveNoteTracker::clearChannel(uint8_t group, uint8_t channel) {
+    bits_[group & 0xF][channel & 0xF][0].store(0, std::memory_order_release);
+    bits_[group & 0xF][channel & 0xF][1].store(0, std::memory_order_release);
+}
+
+void ActiveNoteTracker::clear() {
+    for (uint8_t group = 0; group < 16; group++) {
+        for (uint8_t channel = 0; channel < 16; channel++) {
+            clearChannel(group, channel);
+        }
+    }
+}
+
+bool ActiveNoteTracker::isActive(uint8_t group, uint8_t channel, uint8_t note) const {
+    return (bits_[group & 0xF][channel & 0xF][(note >> 6) & 1].load(std::memory_order_acquire) >> (note & 63)) & 1;
+}
+
+template <typename Visitor>
+void ActiveNoteTracker::forEachActive(Visitor&& visit) const {
+    for (uint8_t group = 0; group < 16; group++) {
+        for (uint8_t channel = 0; channel < 16; channel++) {
+            for (uint8_t half = 0; half < 2; half++) {
+                uint64_t bits = bits_[group][channel][half].load(std::memory_order_acquire);
+                while (bits != 0) {
+                    int bit = std::countr_zero(bits);
+                    bits &= bits - 1;
+                    visit(group, channel, static_cast<uint8_t>(half * 64 + bit));
+                }
+            }
+        }
+    }
+}
+
+size_t ActiveNoteTracker::activeCount() const {
+    size_t count = 0;
+    for (const auto& group : bits_) {
+        for (const auto& channel : group) {
+            count += std::popcount(channel[0].load(std::memory_order_relaxed)) +
+                     std::popcount(channel[1].load(std::memory_order_relaxed));
+        }
+    }
+    return count;
+}
+
+void ActiveNoteTracker::appendNoteOffs(std::vector<uint32_t>& words) const {
+    forEachActive([&words](uint8_t group, uint8_t channel, uint8_t note) {
+        words.push_back((0x4u << 28) | (static_cast<uint32_t>(group) << 24) | (0x8u << 20) |
+                        (static_cast<uint32_t>(channel) << 16) | (static_cast<uint32_t>(note) << 8));
+        words.push_back(0);
+    });
+}
+
+std::vector<ActiveNote> ActiveNoteTracker::activeNotes() const {
+    return stuckNotes(std::chrono::milliseconds(0));
+}
+
+std::vector<ActiveNote> ActiveNoteTracker::stuckNotes(std::chrono::milliseconds threshold) const {
+    std::vector<ActiveNote> notes;
+    const uint32_t now = nowMs();
+    forEachActive([&](uint8_t group, uint8_t channel, uint8_t note) {
+        uint32_t heldFor = now - onTimeMs_[noteIndex(group, channel, note)].load(std::memory_order_relaxed);
+        if (static_cast<int64_t>(heldFor) >= threshold.count()) {
+            notes.push_back(ActiveNote{group, channel, note, std::chrono::milliseconds(heldFor)});
+        }
+    });
+    return notes;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+struct ActiveNote {
+    uint8_t group = 0;
+    uint8_t channel = 0;
+    uint8_t note = 0;
+    std::chrono::milliseconds heldFor{0};
+};
+
+// Which notes are sounding on the output, as one 128-bit set per (group, channel).
+//
+// Fed from every UMP that actually leaves the controller, so notes from the keyboard, the file
+// player and anything else are covered alike. Updates are single atomic bit operations and may
+// come from any sending thread; releasing everything walks 512 words and emits only set bits.
+class ActiveNoteTracker {
+public:
+    ActiveNoteTracker();
+
+    // Inspects one outgoing UMP (Note On/Off, All Sound Off / All Notes Off, MIDI 1.0 or 2.0 CV)
+    void observe(const uint32_t* words);
+
+    void noteOn(uint8_t group, uint8_t channel, uint8_t note);
+    void noteOff(uint8_t group, uint8_t channel, uint8_t note);
+    void clearChannel(uint8_t group, uint8_t channel);
+    void clear();
+
+    bool isActive(uint8_t group, uint8_t channel, uint8_t note) const;
+    size_t activeCount() const;
+
+    // Appends a MIDI 2.0 Note Off for every sounding note. The bits are cleared when the
+    // packets are observed on their way out, not here, so a muted output keeps its state.
+    void appendNoteOffs(std::vector<uint32_t>& words) const;
+
+    std::vector<ActiveNote> activeNotes() const;
+    // Notes held for at least `threshold`: candidates for a lost Note Off
+    std::vector<ActiveNote> stuckNotes(std::chrono::milliseconds threshold) const;
+
+private:
+    uint32_t nowMs() const;
+    template <typename Visitor> void forEachActive(Visitor&& visit) const;
+
+    std::atomic<uint64_t> bits_[16][16][2];
+    // Note On time per [group][channel][note], milliseconds since epoch_
+    std::unique_ptr<std::atomic<uint32_t>[]> onTimeMs_;
+    std::chrono::steady_clock::time_point epoch_;
+};
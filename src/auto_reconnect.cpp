@@ -0,0 +1,51 @@
+#include "auto_reconnect.h"
+
+void AutoReconnect::select(PortDirection direction, const std::string& id, bool open) {
+    auto& s = side(direction);
+    s.id = open ? id : "";
+    s.open = open && !id.empty();
+    // A new choice ends any outage we were waiting on for the old one
+    if ((input_.id.empty() || input_.open) && (output_.id.empty() || output_.open)) {
+        lostAtNs_ = 0;
+        returnedAtNs_ = 0;
+    }
+}
+
+bool AutoReconnect::portRemoved(PortDirection direction, const std::string& id, int64_t nowNs) {
+    auto& s = side(direction);
+    if (s.id.empty() || s.id != id || !s.open) {
+        return false;
+    }
+    s.open = false;
+    if (lostAtNs_ == 0) {
+        lostAtNs_ = nowNs;
+    }
+    return true;
+}
+
+bool AutoReconnect::portAdded(PortDirection direction, const std::string& id, int64_t nowNs) {
+    auto& s = side(direction);
+    if (!enabled_ || s.id.empty() || s.id != id || s.open) {
+        return false;
+    }
+    returnedAtNs_ = nowNs;
+    return true;
+}
+
+std::optional<ReconnectReport> AutoReconnect::portReopened(PortDirection direction, int64_t nowNs) {
+    side(direction).open = true;
+    if (lostAtNs_ == 0) {
+        return std::nullopt;
+    }
+    for (const auto* s : {&input_, &output_}) {
+        if (!s->id.empty() && !s->open) {
+            return std::nullopt;
+        }
+    }
+    ReconnectReport report;
+    report.downNs = nowNs - lostAtNs_;
+    report.recoveryNs = nowNs - returnedAtNs_;
+    lostAtNs_ = 0;
+    returnedAtNs_ = 0;
+    return report;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include "port_registry.h"
+
+// Timing of one outage of the selected port pair, measured when the pair was open again
+struct ReconnectReport {
+    int64_t downNs = 0;      // first selected port removed -> pair reopened
+    int64_t recoveryNs = 0;  // last selected port plugged back -> pair reopened
+};
+
+// Decides when the selected input/output ports must be closed and reopened as they disappear and
+// come back, based on the registry's stable port IDs.
+//
+// The user's selection survives a port being removed; only an explicit selection (including
+// "none") changes it. When a selected port reappears under the same ID it is reopened, and once
+// every selected direction is open again the outage is over and portReopened() returns its timing
+// so the caller can re-establish MIDI-CI and restore state exactly once.
+//
+// Not thread-safe; KeyboardController serializes calls under its connection mutex.
+class AutoReconnect {
+public:
+    void setEnabled(bool enabled) { enabled_ = enabled; }
+    bool isEnabled() const { return enabled_; }
+
+    // The user picked a port ("" for none); `open` says whether opening it succeeded
+    void select(PortDirection direction, const std::string& id, bool open);
+    const std::string& selection(PortDirection direction) const { return side(direction).id; }
+
+    // True when the removed port was selected and open, i.e. it must be closed now
+    bool portRemoved(PortDirection direction, const std::string& id, int64_t nowNs);
+    // True when the added port is a selected one waiting to be reopened
+    bool portAdded(PortDirection direction, const std::string& id, int64_t nowNs);
+    // Call after reopening succeeded; returns the report when this completed the pair
+    std::optional<ReconnectReport> portReopened(PortDirection direction, int64_t nowNs);
+
+    // Some selected port went away and has not been reopened yet
+    bool isWaiting() const { return lostAtNs_ != 0; }
+
+private:
+    struct Side {
+        std::string id;
+        bool open = false;
+    };
+
+    Side& side(PortDirection direction) { return direction == PortDirection::Input ? input_ : output_; }
+    const Side& side(PortDirection direction) const { return direction == PortDirection::Input ? input_ : output_; }
+
+    bool enabled_ = true;
+    Side input_;
+    Side output_;
+    int64_t lostAtNs_ = 0;
+    int64_t returnedAtNs_ = 0;
+};
@@ -0,0 +1,121 @@
+#include "control_snapshot.h"
+#include "keyboard_controller.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+std::optional<ControlKind> controlKindFromCtrlType(const std::string& ctrlType) {
+    if (ctrlType == "cc") return ControlKind::ControlChange;
+    if (ctrlType == "rpn") return ControlKind::RPN;
+    if (ctrlType == "nrpn") return ControlKind::NRPN;
+    return std::nullopt;
+}
+
+void encodeControlValue(uint8_t group, const ControlValue& control, uint32_t out[2]) {
+    uint32_t opcode = 0xB;
+    uint32_t data = static_cast<uint32_t>(control.index & 0x7F) << 8;
+    switch (control.kind) {
+        case ControlKind::ControlChange:
+            break;
+        case ControlKind::RPN:
+        case ControlKind::NRPN:
+            opcode = control.kind == ControlKind::RPN ? 0x2 : 0x3;
+            data |= control.subIndex & 0x7F;
+            break;
+    }
+    out[0] = (0x4u << 28) | (static_cast<uint32_t>(group & 0xF) << 24) | (opcode << 20) |
+             (static_cast<uint32_t>(control.channel & 0xF) << 16) | data;
+    out[1] = control.value;
+}
+
+ControlSnapshotSender::ControlSnapshotSender(KeyboardController& controller)
+    : sink_([&controller](const uint32_t* words, size_t wordCount) {
+          return controller.sendUmpBatch(words, wordCount, UmpLane::Bulk);
+      }) {
+}
+
+ControlSnapshotSender::ControlSnapshotSender(BatchSink sink)
+    : sink_(std::move(sink)) {
+}
+
+ControlSnapshotSender::~ControlSnapshotSender() {
+    cancel();
+}
+
+bool ControlSnapshotSender::send(const ControlSnapshot& snapshot, uint8_t group, const ControlSnapshotOptions& options) {
+    cancel();
+    if (options.messagesPerBatch == 0) {
+        std::cerr << "[SNAPSHOT] messagesPerBatch must be positive" << std::endl;
+        return false;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    words_.resize(snapshot.size() * 2);
+    for (size_t i = 0; i < snapshot.size(); i++) {
+        encodeControlValue(group, snapshot[i], &words_[i * 2]);
+    }
+
+    cancelRequested_.store(false);
+    sending_.store(true);
+    worker_ = std::thread(&ControlSnapshotSender::sendLoop, this, options, start, snapshot.size());
+    return true;
+}
+
+void ControlSnapshotSender::cancel() {
+    cancelRequested_.store(true);
+    wait();
+}
+
+void ControlSnapshotSender::wait() {
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+}
+
+bool ControlSnapshotSender::isSending() const {
+    return sending_.load();
+}
+
+void ControlSnapshotSender::setFinishedCallback(std::function<void(const ControlSnapshotReport&)> callback) {
+    finishedCallback_ = callback;
+}
+
+void ControlSnapshotSender::sendLoop(ControlSnapshotOptions options, std::chrono::steady_clock::time_point start,
+                                     uint64_t controls) {
+    ControlSnapshotReport report;
+    report.controls = controls;
+
+    const size_t batchWords = static_cast<size_t>(options.messagesPerBatch) * 2;
+    // Batch n is due at n * batchPeriod; sleeping to an absolute time keeps a late batch from delaying the rest
+    const auto batchPeriod = options.messagesPerSecond == 0
+        ? std::chrono::nanoseconds(0)
+        : std::chrono::nanoseconds(1000000000ULL * options.messagesPerBatch / options.messagesPerSecond);
+
+    for (size_t pos = 0; pos < words_.size(); pos += batchWords) {
+        if (cancelRequested_.load(std::memory_order_relaxed)) {
+            report.cancelled = true;
+            break;
+        }
+        if (report.batches > 0 && batchPeriod.count() > 0) {
+            std::this_thread::sleep_until(start + batchPeriod * report.batches);
+        }
+        size_t count = std::min(batchWords, words_.size() - pos);
+        report.packets += sink_(words_.data() + pos, count);
+        report.batches++;
+    }
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printReport(report);
+    sending_.store(false);
+    if (finishedCallback_) {
+        finishedCallback_(report);
+    }
+}
+
+void ControlSnapshotSender::printReport(const ControlSnapshotReport& report) {
+    std::ostringstream ms;
+    ms << std::fixed << std::setprecision(1) << report.seconds * 1000.0;
+    std::cout << "[SNAPSHOT] " << (report.cancelled ? "Cancelled after " : "Sent ") << report.packets << " of "
+              << report.controls << " controls in " << report.batches << " batches, " << ms.str() << " ms" << std::endl;
+}
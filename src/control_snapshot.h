@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+class KeyboardController;
+
+// Kinds of controls in a MIDI-CI ChCtrlList ("ctrlType") that carry channel state
+enum class ControlKind : uint8_t {
+    ControlChange,
+    RPN,
+    NRPN,
+};
+
+// One control's current value, independent of the widgets that display it
+struct ControlValue {
+    ControlKind kind = ControlKind::ControlChange;
+    uint8_t channel = 0;
+    uint8_t index = 0;     // CC number, or the RPN/NRPN bank (MSB)
+    uint8_t subIndex = 0;  // RPN/NRPN index (LSB)
+    uint32_t value = 0;
+};
+
+using ControlSnapshot = std::vector<ControlValue>;
+
+// Maps a ChCtrlList ctrlType to a snapshot kind. Per-note controls ("pnrc", "pnac") only affect
+// notes that are sounding, so they are not part of the restorable state and map to nullopt.
+std::optional<ControlKind> controlKindFromCtrlType(const std::string& ctrlType);
+
+// Writes the MIDI 2.0 Channel Voice message for a control value (two words)
+void encodeControlValue(uint8_t group, const ControlValue& control, uint32_t out[2]);
+
+struct ControlSnapshotOptions {
+    uint32_t messagesPerSecond = 10000;  // 0 = no pacing
+    uint32_t messagesPerBatch = 32;
+};
+
+struct ControlSnapshotReport {
+    uint64_t controls = 0;
+    uint64_t packets = 0;      // packets the output accepted
+    uint64_t batches = 0;
+    double seconds = 0.0;      // from send() to the last batch
+    bool cancelled = false;
+};
+
+// Sends a whole control snapshot (e.g. to restore a synth after a power cycle) as one burst.
+//
+// The snapshot is encoded up front into a single word buffer; a worker thread then hands it to
+// KeyboardController::sendUmpBatch() in fixed-size batches, each due at a fixed offset from the
+// start, so the burst stays at messagesPerSecond on average without drifting when one batch is
+// late. The UI thread only pays for encoding. Batches go on the bulk lane: with output pacing,
+// the burst is charged to the bulk budget and notes played meanwhile go ahead of it.
+class ControlSnapshotSender {
+public:
+    using BatchSink = std::function<size_t(const uint32_t* words, size_t wordCount)>;
+
+    explicit ControlSnapshotSender(KeyboardController& controller);
+    // For tests and offline use: batches go to `sink` instead of a controller
+    explicit ControlSnapshotSender(BatchSink sink);
+    ~ControlSnapshotSender();
+
+    ControlSnapshotSender(const ControlSnapshotSender&) = delete;
+    ControlSnapshotSender& operator=(const ControlSnapshotSender&) = delete;
+
+    // Cancels a burst that is still running before starting the new one
+    bool send(const ControlSnapshot& snapshot, uint8_t group, const ControlSnapshotOptions& options = {});
+    void cancel();
+    bool isSending() const;
+    // Blocks until the current burst has finished or was cancelled
+    void wait();
+
+    // Invoked from the worker thread when a burst ends (also after cancel()).
+    // The callback must not call send() or cancel(); post to another thread instead.
+    void setFinishedCallback(std::function<void(const ControlSnapshotReport&)> callback);
+
+    static void printReport(const ControlSnapshotReport& report);
+
+private:
+    void sendLoop(ControlSnapshotOptions options, std::chrono::steady_clock::time_point start, uint64_t controls);
+
+    BatchSink sink_;
+    std::vector<uint32_t> words_;
+    std::thread worker_;
+    std::atomic<bool> cancelRequested_{false};
+    std::atomic<bool> sending_{false};
+    std::function<void(const ControlSnapshotReport&)> finishedCallback_;
+};
@@ -0,0 +1,312 @@
+#include "device_state_mirror.h"
+#include <algorithm>
+#include <bit>
+#include "midi_value_scaling.h"
+#include "ump_utils.h"
+
+namespace {
+constexpr size_t CHANNELS = 256;
+constexpr size_t NOTES = CHANNELS * 128;
+constexpr uint32_t NOTE_ON_BIT = 1u << 16;
+constexpr uint32_t PROGRAM_SET_BIT = 1u << 31;
+constexpr uint32_t PROGRAM_BANK_BIT = 1u << 30;
+
+// Calls visit(bit) for every bit that was set in the bitmap and clears it
+template <typename Visitor>
+void drainBitmap(std::atomic<uint64_t>* bitmap, size_t words, Visitor&& visit) {
+    for (size_t w = 0; w < words; w++) {
+        if (bitmap[w].load(std::memory_order_relaxed) == 0) continue;
+        uint64_t bits = bitmap[w].exchange(0, std::memory_order_acquire);
+        while (bits != 0) {
+            int bit = std::countr_zero(bits);
+            bits &= bits - 1;
+            visit(w * 64 + static_cast<size_t>(bit));
+        }
+    }
+}
+}
+
+void DeviceStateChanges::clear() {
+    controls.clear();
+    notes.clear();
+    channels.clear();
+    droppedParameters = 0;
+}
+
+DeviceStateMirror::DeviceStateMirror()
+    : controllers_(new std::atomic<uint32_t>[NOTES]),
+      notes_(new std::atomic<uint32_t>[NOTES]),
+      notePressure_(new std::atomic<uint32_t>[NOTES]),
+      notePitchBend_(new std::atomic<uint32_t>[NOTES]),
+      parameterKeys_(new std::atomic<uint32_t>[PARAMETER_SLOTS]),
+      parameterValues_(new std::atomic<uint32_t>[PARAMETER_SLOTS]) {
+    clear();
+}
+
+void DeviceStateMirror::clear() {
+    for (size_t i = 0; i < NOTES; i++) {
+        controllers_[i].store(0, std::memory_order_relaxed);
+        notes_[i].store(0, std::memory_order_relaxed);
+        notePressure_[i].store(0, std::memory_order_relaxed);
+        notePitchBend_[i].store(PITCH_BEND_CENTER, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < CHANNELS; i++) {
+        pitchBend_[i].store(PITCH_BEND_CENTER, std::memory_order_relaxed);
+        channelPressure_[i].store(0, std::memory_order_relaxed);
+        program_[i].store(0, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < PARAMETER_SLOTS; i++) {
+        parameterKeys_[i].store(0, std::memory_order_relaxed);
+        parameterValues_[i].store(0, std::memory_order_relaxed);
+    }
+    for (auto& word : controllerDirty_) word.store(0, std::memory_order_relaxed);
+    for (auto& word : noteDirty_) word.store(0, std::memory_order_relaxed);
+    for (auto& word : channelDirty_) word.store(0, std::memory_order_relaxed);
+    for (auto& word : parameterDirty_) word.store(0, std::memory_order_relaxed);
+    droppedParameters_.store(0, std::memory_order_relaxed);
+}
+
+void DeviceStateMirror::observe(const uint32_t* words) {
+    switch (umpMessageType(words[0])) {
+        case 0x2: observeMidi1(words); break;
+        case 0x4: observeMidi2(words); break;
+        default: break;
+    }
+}
+
+void DeviceStateMirror::observeMidi1(const uint32_t* words) {
+    const uint8_t group = umpGroup(words[0]);
+    const uint8_t status = (words[0] >> 20) & 0xF;
+    const uint8_t channel = (words[0] >> 16) & 0xF;
+    const uint8_t data1 = (words[0] >> 8) & 0x7F;
+    const uint8_t data2 = words[0] & 0x7F;
+
+    switch (status) {
+        case 0x8: setNote(group, channel, data1, false, 0); break;
+        case 0x9: setNote(group, channel, data1, data2 != 0, data2 != 0 ? midi7To16(data2) : 0); break;
+        case 0xA: setNotePressure(group, channel, data1, midi7To32(data2)); break;
+        case 0xB:
+            // RPN/NRPN sequences stay plain controllers here; MIDI 2.0 devices send them as single messages
+            setController(group, channel, data1, midi7To32(data2));
+            if (data1 == 120 || data1 == 123) {
+                releaseChannelNotes(group, channel);
+            }
+            break;
+        case 0xC:
+            program_[channelIndex(group, channel)].store(PROGRAM_SET_BIT | data1, std::memory_order_relaxed);
+            markChannel(group, channel);
+            break;
+        case 0xD:
+            channelPressure_[channelIndex(group, channel)].store(midi7To32(data1), std::memory_order_relaxed);
+            markChannel(group, channel);
+            break;
+        case 0xE:
+            pitchBend_[channelIndex(group, channel)].store(midi14To32(static_cast<uint16_t>(data2 << 7 | data1)),
+                                                          std::memory_order_relaxed);
+            markChannel(group, channel);
+            break;
+        default:
+            break;
+    }
+}
+
+void DeviceStateMirror::observeMidi2(const uint32_t* words) {
+    const uint8_t group = umpGroup(words[0]);
+    const uint8_t opcode = (words[0] >> 20) & 0xF;
+    const uint8_t channel = (words[0] >> 16) & 0xF;
+    const uint8_t byte3 = (words[0] >> 8) & 0x7F;
+    const uint8_t byte4 = words[0] & 0xFF;
+    const uint32_t data = words[1];
+
+    switch (opcode) {
+        case 0x2: setParameter(ControlKind::RPN, group, channel, byte3, byte4 & 0x7F, data, false); break;
+        case 0x3: setParameter(ControlKind::NRPN, group, channel, byte3, byte4 & 0x7F, data, false); break;
+        case 0x4: setParameter(ControlKind::RPN, group, channel, byte3, byte4 & 0x7F, data, true); break;
+        case 0x5: setParameter(ControlKind::NRPN, group, channel, byte3, byte4 & 0x7F, data, true); break;
+        case 0x6: setNotePitchBend(group, channel, byte3, data); break;
+        case 0x8: setNote(group, channel, byte3, false, 0); break;
+        case 0x9: setNote(group, channel, byte3, true, static_cast<uint16_t>(data >> 16)); break;
+        case 0xA: setNotePressure(group, channel, byte3, data); break;
+        case 0xB:
+            setController(group, channel, byte3, data);
+            if (byte3 == 120 || byte3 == 123) {
+                releaseChannelNotes(group, channel);
+            }
+            break;
+        case 0xC: {
+            uint32_t program = PROGRAM_SET_BIT | (data >> 24);
+            if (byte4 & 0x1) {
+                program |= PROGRAM_BANK_BIT | ((((data >> 8) & 0x7F) << 7 | (data & 0x7F)) << 8);
+            }
+            program_[channelIndex(group, channel)].store(program, std::memory_order_relaxed);
+            markChannel(group, channel);
+            break;
+        }
+        case 0xD:
+            channelPressure_[channelIndex(group, channel)].store(data, std::memory_order_relaxed);
+            markChannel(group, channel);
+            break;
+        case 0xE:
+            pitchBend_[channelIndex(group, channel)].store(data, std::memory_order_relaxed);
+            markChannel(group, channel);
+            break;
+        default:
+            break;  // per-note controllers and management carry no state we mirror
+    }
+}
+
+void DeviceStateMirror::setController(uint8_t group, uint8_t channel, uint8_t index, uint32_t value) {
+    size_t slot = noteIndex(group, channel, index);
+    controllers_[slot].store(value, std::memory_order_relaxed);
+    markBit(controllerDirty_, slot);
+}
+
+uint32_t DeviceStateMirror::parameterKey(ControlKind kind, uint8_t group, uint8_t channel, uint8_t bank, uint8_t index) {
+    return 1u | (kind == ControlKind::NRPN ? 2u : 0u) | (static_cast<uint32_t>(channelIndex(group, channel)) << 2) |
+           (static_cast<uint32_t>(bank & 0x7F) << 10) | (static_cast<uint32_t>(index & 0x7F) << 17);
+}
+
+std::optional<size_t> DeviceStateMirror::findParameterSlot(uint32_t key, bool insert) const {
+    size_t slot = (key * 2654435761u) >> (32 - std::countr_zero(PARAMETER_SLOTS));
+    for (size_t probe = 0; probe < PARAMETER_SLOTS; probe++, slot = (slot + 1) % PARAMETER_SLOTS) {
+        uint32_t current = parameterKeys_[slot].load(std::memory_order_acquire);
+        if (current == key) return slot;
+        if (current != 0) continue;
+        if (!insert) return std::nullopt;
+        if (parameterKeys_[slot].compare_exchange_strong(current, key, std::memory_order_acq_rel) || current == key) {
+            return slot;
+        }
+    }
+    return std::nullopt;
+}
+
+void DeviceStateMirror::setParameter(ControlKind kind, uint8_t group, uint8_t channel, uint8_t bank, uint8_t index,
+                                     uint32_t value, bool relative) {
+    auto slot = findParameterSlot(parameterKey(kind, group, channel, bank, index), true);
+    if (!slot) {
+        droppedParameters_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    if (relative) {
+        // Relative messages carry a signed two's complement delta; the result saturates
+        int64_t current = parameterValues_[*slot].load(std::memory_order_relaxed);
+        int64_t next = std::clamp<int64_t>(current + static_cast<int32_t>(value), 0, UINT32_MAX);
+        value = static_cast<uint32_t>(next);
+    }
+    parameterValues_[*slot].store(value, std::memory_order_relaxed);
+    markBit(parameterDirty_, *slot);
+}
+
+void DeviceStateMirror::setNote(uint8_t group, uint8_t channel, uint8_t note, bool on, uint16_t velocity) {
+    size_t slot = noteIndex(group, channel, note);
+    uint32_t previous = notes_[slot].load(std::memory_order_relaxed);
+    // Note Off keeps the velocity of the Note On it ends
+    uint32_t next = on ? (NOTE_ON_BIT | velocity) : (previous & 0xFFFF);
+    notes_[slot].store(next, std::memory_order_relaxed);
+    markBit(noteDirty_, slot);
+}
+
+void DeviceStateMirror::setNotePressure(uint8_t group, uint8_t channel, uint8_t note, uint32_t pressure) {
+    size_t slot = noteIndex(group, channel, note);
+    notePressure_[slot].store(pressure, std::memory_order_relaxed);
+    markBit(noteDirty_, slot);
+}
+
+void DeviceStateMirror::setNotePitchBend(uint8_t group, uint8_t channel, uint8_t note, uint32_t bend) {
+    size_t slot = noteIndex(group, channel, note);
+    notePitchBend_[slot].store(bend, std::memory_order_relaxed);
+    markBit(noteDirty_, slot);
+}
+
+void DeviceStateMirror::releaseChannelNotes(uint8_t group, uint8_t channel) {
+    for (uint8_t note = 0; note < 128; note++) {
+        if (notes_[noteIndex(group, channel, note)].load(std::memory_order_relaxed) & NOTE_ON_BIT) {
+            setNote(group, channel, note, false, 0);
+        }
+    }
+}
+
+void DeviceStateMirror::markChannel(uint8_t group, uint8_t channel) {
+    markBit(channelDirty_, channelIndex(group, channel));
+}
+
+uint32_t DeviceStateMirror::controller(uint8_t group, uint8_t channel, uint8_t index) const {
+    return controllers_[noteIndex(group, channel, index)].load(std::memory_order_relaxed);
+}
+
+std::optional<uint32_t> DeviceStateMirror::parameter(ControlKind kind, uint8_t group, uint8_t channel, uint8_t bank,
+                                                     uint8_t index) const {
+    auto slot = findParameterSlot(parameterKey(kind, group, channel, bank, index), false);
+    if (!slot) return std::nullopt;
+    return parameterValues_[*slot].load(std::memory_order_relaxed);
+}
+
+bool DeviceStateMirror::isNoteOn(uint8_t group, uint8_t channel, uint8_t note) const {
+    return notes_[noteIndex(group, channel, note)].load(std::memory_order_relaxed) & NOTE_ON_BIT;
+}
+
+uint16_t DeviceStateMirror::noteVelocity(uint8_t group, uint8_t channel, uint8_t note) const {
+    return static_cast<uint16_t>(notes_[noteIndex(group, channel, note)].load(std::memory_order_relaxed) & 0xFFFF);
+}
+
+uint32_t DeviceStateMirror::channelPitchBend(uint8_t group, uint8_t channel) const {
+    return pitchBend_[channelIndex(group, channel)].load(std::memory_order_relaxed);
+}
+
+bool DeviceStateMirror::takeChanges(DeviceStateChanges& changes) {
+    const size_t before = changes.controls.size() + changes.notes.size() + changes.channels.size();
+
+    drainBitmap(controllerDirty_, std::size(controllerDirty_), [&](size_t slot) {
+        ControlValue control;
+        control.kind = ControlKind::ControlChange;
+        control.channel = static_cast<uint8_t>((slot / 128) % 16);
+        control.index = static_cast<uint8_t>(slot % 128);
+        control.value = controllers_[slot].load(std::memory_order_relaxed);
+        changes.controls.emplace_back(static_cast<uint8_t>(slot / 128 / 16), control);
+    });
+
+    drainBitmap(parameterDirty_, std::size(parameterDirty_), [&](size_t slot) {
+        uint32_t key = parameterKeys_[slot].load(std::memory_order_acquire);
+        ControlValue control;
+        control.kind = (key & 2u) ? ControlKind::NRPN : ControlKind::RPN;
+        size_t channel = (key >> 2) & 0xFF;
+        control.channel = static_cast<uint8_t>(channel % 16);
+        control.index = static_cast<uint8_t>((key >> 10) & 0x7F);
+        control.subIndex = static_cast<uint8_t>((key >> 17) & 0x7F);
+        control.value = parameterValues_[slot].load(std::memory_order_relaxed);
+        changes.controls.emplace_back(static_cast<uint8_t>(channel / 16), control);
+    });
+
+    drainBitmap(noteDirty_, std::size(noteDirty_), [&](size_t slot) {
+        uint32_t state = notes_[slot].load(std::memory_order_relaxed);
+        MirroredNote note;
+        note.group = static_cast<uint8_t>(slot / 128 / 16);
+        note.channel = static_cast<uint8_t>((slot / 128) % 16);
+        note.note = static_cast<uint8_t>(slot % 128);
+        note.on = (state & NOTE_ON_BIT) != 0;
+        note.velocity = static_cast<uint16_t>(state & 0xFFFF);
+        note.pressure = notePressure_[slot].load(std::memory_order_relaxed);
+        note.pitchBend = notePitchBend_[slot].load(std::memory_order_relaxed);
+        changes.notes.push_back(note);
+    });
+
+    drainBitmap(channelDirty_, std::size(channelDirty_), [&](size_t slot) {
+        MirroredChannel channel;
+        channel.group = static_cast<uint8_t>(slot / 16);
+        channel.channel = static_cast<uint8_t>(slot % 16);
+        channel.pitchBend = pitchBend_[slot].load(std::memory_order_relaxed);
+        channel.pressure = channelPressure_[slot].load(std::memory_order_relaxed);
+        uint32_t program = program_[slot].load(std::memory_order_relaxed);
+        if (program & PROGRAM_SET_BIT) {
+            channel.program = static_cast<uint8_t>(program & 0x7F);
+            if (program & PROGRAM_BANK_BIT) {
+                channel.bank = static_cast<uint16_t>((program >> 8) & 0x3FFF);
+            }
+        }
+        changes.channels.push_back(channel);
+    });
+
+    changes.droppedParameters += droppedParameters_.exchange(0, std::memory_order_relaxed);
+    return changes.controls.size() + changes.notes.size() + changes.channels.size() > before;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+#include "control_snapshot.h"
+
+// A note whose state changed on the device side
+struct MirroredNote {
+    uint8_t group = 0;
+    uint8_t channel = 0;
+    uint8_t note = 0;
+    bool on = false;
+    uint16_t velocity = 0;     // of the last Note On
+    uint32_t pressure = 0;     // polyphonic key pressure
+    uint32_t pitchBend = 0;    // per-note pitch bend, 0x80000000 = center
+};
+
+// Channel-wide state that changed on the device side
+struct MirroredChannel {
+    uint8_t group = 0;
+    uint8_t channel = 0;
+    uint32_t pitchBend = 0;
+    uint32_t pressure = 0;
+    std::optional<uint8_t> program;
+    std::optional<uint16_t> bank;  // MSB << 7 | LSB
+};
+
+// Everything that changed since the previous takeChanges()
+struct DeviceStateChanges {
+    std::vector<std::pair<uint8_t, ControlValue>> controls;  // (group, value) for CC, RPN and NRPN
+    std::vector<MirroredNote> notes;
+    std::vector<MirroredChannel> channels;
+    uint64_t droppedParameters = 0;  // RPN/NRPN updates lost because the parameter table was full
+
+    bool empty() const { return controls.empty() && notes.empty() && channels.empty(); }
+    void clear();
+};
+
+// The last known state of the device, decoded from incoming MIDI 1.0 and 2.0 Channel Voice UMPs.
+//
+// observe() runs on the MIDI input thread and only does relaxed atomic stores plus one atomic OR
+// into a dirty bitmap per message; it never locks or allocates. The UI polls takeChanges() at
+// display rate, which swaps each dirty word with zero and reads back only the flagged entries, so
+// a burst of thousands of messages costs the UI one pass over a few hundred words.
+//
+// Values are stored at MIDI 2.0 resolution: CC and per-note values as 32 bit, velocity as 16 bit.
+// RPN/NRPN values live in a fixed open-addressing table because the full 16K x 256 channel space
+// would be far larger than what devices actually use.
+class DeviceStateMirror {
+public:
+    static constexpr size_t PARAMETER_SLOTS = 4096;
+    static constexpr uint32_t PITCH_BEND_CENTER = 0x80000000;
+
+    DeviceStateMirror();
+
+    // Inspects one incoming UMP; anything that is not Channel Voice is ignored
+    void observe(const uint32_t* words);
+    void clear();
+
+    uint32_t controller(uint8_t group, uint8_t channel, uint8_t index) const;
+    std::optional<uint32_t> parameter(ControlKind kind, uint8_t group, uint8_t channel, uint8_t bank, uint8_t index) const;
+    bool isNoteOn(uint8_t group, uint8_t channel, uint8_t note) const;
+    uint16_t noteVelocity(uint8_t group, uint8_t channel, uint8_t note) const;
+    uint32_t channelPitchBend(uint8_t group, uint8_t channel) const;
+
+    // Appends every change since the last call and clears the dirty bits; returns false if nothing changed
+    bool takeChanges(DeviceStateChanges& changes);
+
+private:
+    static size_t channelIndex(uint8_t group, uint8_t channel) { return (group & 0xF) * 16u + (channel & 0xF); }
+    static size_t noteIndex(uint8_t group, uint8_t channel, uint8_t note) { return channelIndex(group, channel) * 128 + (note & 0x7F); }
+
+    void observeMidi1(const uint32_t* words);
+    void observeMidi2(const uint32_t* words);
+
+    void setController(uint8_t group, uint8_t channel, uint8_t index, uint32_t value);
+    void setParameter(ControlKind kind, uint8_t group, uint8_t channel, uint8_t bank, uint8_t index, uint32_t value, bool relative);
+    void setNote(uint8_t group, uint8_t channel, uint8_t note, bool on, uint16_t velocity);
+    void setNotePressure(uint8_t group, uint8_t channel, uint8_t note, uint32_t pressure);
+    void setNotePitchBend(uint8_t group, uint8_t channel, uint8_t note, uint32_t bend);
+    void releaseChannelNotes(uint8_t group, uint8_t channel);  // All Sound Off / All Notes Off
+    void markChannel(uint8_t group, uint8_t channel);
+    static uint32_t parameterKey(ControlKind kind, uint8_t group, uint8_t channel, uint8_t bank, uint8_t index);
+    // Only the input thread inserts; lookups from other threads never modify the table
+    std::optional<size_t> findParameterSlot(uint32_t key, bool insert) const;
+
+    static void markBit(std::atomic<uint64_t>* bitmap, size_t bit) {
+        bitmap[bit / 64].fetch_or(1ULL << (bit % 64), std::memory_order_release);
+    }
+
+    // [group * 16 + channel] * 128 + index
+    std::unique_ptr<std::atomic<uint32_t>[]> controllers_;
+    std::unique_ptr<std::atomic<uint32_t>[]> notes_;          // bit 16 = on, low 16 bits = velocity
+    std::unique_ptr<std::atomic<uint32_t>[]> notePressure_;
+    std::unique_ptr<std::atomic<uint32_t>[]> notePitchBend_;
+    std::atomic<uint32_t> pitchBend_[256];
+    std::atomic<uint32_t> channelPressure_[256];
+    std::atomic<uint32_t> program_[256];                       // bit 31 = set, bit 30 = bank valid, bank << 8 | program
+
+    // Keys are 1 | kind << 1 | channelIndex << 2 | bank << 10 | index << 17; 0 = free slot
+    std::unique_ptr<std::atomic<uint32_t>[]> parameterKeys_;
+    std::unique_ptr<std::atomic<uint32_t>[]> parameterValues_;
+    std::atomic<uint64_t> droppedParameters_{0};
+
+    std::atomic<uint64_t> controllerDirty_[256 * 128 / 64];
+    std::atomic<uint64_t> noteDirty_[256 * 128 / 64];
+    std::atomic<uint64_t> channelDirty_[256 / 64];
+    std::atomic<uint64_t> parameterDirty_[PARAMETER_SLOTS / 64];
+};
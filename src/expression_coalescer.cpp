@@ -0,0 +1,74 @@
+#include "expression_coalescer.h"
+
+ExpressionCoalescer::ExpressionCoalescer(std::chrono::microseconds interval, uint32_t deadband)
+    : interval_(interval), deadband_(deadband) {
+    for (int key = 0; key < 128; key++) {
+        slot(key, NoteExpression::PitchBend).sent = PITCH_BEND_CENTER;
+        slot(key, NoteExpression::PitchBend).target = PITCH_BEND_CENTER;
+    }
+}
+
+void ExpressionCoalescer::set(int key, NoteExpression parameter, uint32_t value) {
+    if (key < 0 || key > 127) return;
+    updatesReceived_++;
+
+    Slot& s = slot(key, parameter);
+    s.target = value;
+
+    uint32_t distance = value > s.sent ? value - s.sent : s.sent - value;
+    // Always let the exact resting values through so a gesture never ends slightly off
+    bool resting = value == 0 || (parameter == NoteExpression::PitchBend && value == PITCH_BEND_CENTER);
+    bool wanted = distance >= deadband_ || (resting && distance != 0);
+
+    if (wanted && !s.pending) {
+        s.pending = true;
+        pendingCount_++;
+    } else if (!wanted && s.pending) {
+        s.pending = false;
+        pendingCount_--;
+    }
+}
+
+void ExpressionCoalescer::forget(int key) {
+    if (key < 0 || key > 127) return;
+    for (int p = 0; p < static_cast<int>(NoteExpression::Count); p++) {
+        Slot& s = slot(key, static_cast<NoteExpression>(p));
+        if (s.pending) {
+            s.pending = false;
+            pendingCount_--;
+        }
+    }
+}
+
+bool ExpressionCoalescer::flush(Clock::time_point now, const Sender& send) {
+    if (pendingCount_ == 0) return false;
+
+    for (int key = 0; key < 128; key++) {
+        for (int p = 0; p < static_cast<int>(NoteExpression::Count); p++) {
+            Slot& s = slot(key, static_cast<NoteExpression>(p));
+            if (!s.pending || now - s.sentAt < interval_) continue;
+
+            s.pending = false;
+            pendingCount_--;
+            s.sent = s.target;
+            s.sentAt = now;
+            updatesSent_++;
+            send(key, static_cast<NoteExpression>(p), s.target);
+        }
+    }
+    return pendingCount_ > 0;
+}
+
+uint32_t ExpressionCoalescer::lastSent(int key, NoteExpression parameter) const {
+    return slot(key, parameter).sent;
+}
+
+void ExpressionCoalescer::resetLastSent(int key, NoteExpression parameter, uint32_t value) {
+    Slot& s = slot(key, parameter);
+    s.sent = value;
+    s.target = value;
+    if (s.pending) {
+        s.pending = false;
+        pendingCount_--;
+    }
+}
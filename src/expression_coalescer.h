@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+enum class NoteExpression : uint8_t {
+    PitchBend,   // per-note pitch bend, 0x80000000 = center
+    Pressure,    // per-note (polyphonic) aftertouch
+    Count
+};
+
+// Turns a stream of per-key expression updates (one per pointer event, possibly hundreds per
+// second per finger) into a bounded UMP stream: each (key, parameter) pair is sent at most once
+// per interval, always with its latest value, and changes below the deadband are dropped.
+// Single-threaded; owned and flushed by the thread that handles input.
+class ExpressionCoalescer {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Sender = std::function<void(int key, NoteExpression parameter, uint32_t value)>;
+
+    static constexpr uint32_t PITCH_BEND_CENTER = 0x80000000u;
+
+    explicit ExpressionCoalescer(std::chrono::microseconds interval = std::chrono::milliseconds(5),
+                                 uint32_t deadband = 1u << 20);
+
+    void set(int key, NoteExpression parameter, uint32_t value);
+    // Drops pending updates for a released key; the last sent values are kept (see lastSent)
+    void forget(int key);
+
+    // Sends everything that is due; returns true while updates are still waiting for their slot
+    bool flush(Clock::time_point now, const Sender& send);
+    bool hasPending() const { return pendingCount_ > 0; }
+
+    uint32_t lastSent(int key, NoteExpression parameter) const;
+    void resetLastSent(int key, NoteExpression parameter, uint32_t value);
+
+    uint64_t updatesReceived() const { return updatesReceived_; }
+    uint64_t updatesSent() const { return updatesSent_; }
+
+private:
+    struct Slot {
+        uint32_t target = 0;
+        uint32_t sent = 0;
+        Clock::time_point sentAt{};
+        bool pending = false;
+    };
+
+    Slot& slot(int key, NoteExpression parameter) {
+        return slots_[(key & 0x7F) * static_cast<int>(NoteExpression::Count) + static_cast<int>(parameter)];
+    }
+    const Slot& slot(int key, NoteExpression parameter) const {
+        return slots_[(key & 0x7F) * static_cast<int>(NoteExpression::Count) + static_cast<int>(parameter)];
+    }
+
+    std::chrono::microseconds interval_;
+    uint32_t deadband_;
+    std::array<Slot, 128 * static_cast<int>(NoteExpression::Count)> slots_;
+    int pendingCount_ = 0;
+    uint64_t updatesReceived_ = 0;
+    uint64_t updatesSent_ = 0;
+};
@@ -1,29 +1,69 @@
 #include "keyboard_controller.h"
 #include <iostream>
 #include <algorithm>
+#include <bit>
+#include <cmath>
 #include <libremidi/ump.hpp>
 #include <cmidi2.h>
+#include "ump_utils.h"
+#include "midi_value_scaling.h"
+#include "trace_recorder.h"
+#include "startup_profiler.h"
+#include "realtime_config.h"
 
-KeyboardController::KeyboardController() {
-    resetMidiConnections();
+struct KeyboardController::LoopbackTestState {
+    static constexpr int MAX_PINGS = 65536;  // the JR Timestamp payload is 16 bits
+    
+    std::unique_ptr<std::atomic<int64_t>[]> sentAt{new std::atomic<int64_t>[MAX_PINGS]};
+    std::atomic<uint32_t> received{0};
+    std::atomic<bool> cancelled{false};
+    LatencyHistogram roundTrip;
+};
+
+KeyboardController::KeyboardController(MidiStartup startup)
+    : outputQueue([this](const uint32_t* words, size_t wordCount) { writeOutputBatch(words, wordCount); }) {
+    outputQueue.start();
+    if (startup == MidiStartup::Immediate) {
+        resetMidiConnections();
+    }
 }
 
 KeyboardController::~KeyboardController() {
+    if (startupThread.joinable()) {
+        startupThread.join();
+    }
+    if (loopbackState) {
+        loopbackState->cancelled = true;
+    }
+    if (loopbackThread.joinable()) {
+        loopbackThread.join();
+    }
+    
     if (initialized) {
+        // MIDI-CI first: its unsubscribes go through the queue and the output port, so both must
+        // still be there
+        if (midiCIManager) {
+            midiCIManager->shutdown();
+        }
         allNotesOff();
+    }
+    // Everything already submitted (the unsubscribes and note offs above included) goes out before
+    // the ports close; this final flush is paced, never dropped
+    outputQueue.stop(UmpOutputQueue::StopMode::Drain);
+    if (initialized) {
         if (midiIn && midiIn->is_port_open()) {
             midiIn->close_port();
         }
         if (midiOut && midiOut->is_port_open()) {
             midiOut->close_port();
         }
-        if (midiCIManager) {
-            midiCIManager->shutdown();
-        }
     }
+    stopCapture();
 }
 
 bool KeyboardController::resetMidiConnections() {
+    // Entry points return early from here on, instead of reaching members being replaced
+    initialized.store(false, std::memory_order_release);
     try {
         // Shutdown existing MIDI-CI manager if it exists
         if (midiCIManager) {
@@ -42,42 +82,74 @@ bool KeyboardController::resetMidiConnections() {
         obsConf.track_any = true;        // Track any other types of devices
         obsConf.notify_in_constructor = true;  // Get existing ports immediately
         
-        // Add callbacks for device hotplug detection
+        // Hotplug events maintain the port registry; the UI gets the resulting deltas
         obsConf.input_added = [this](const libremidi::input_port& port) {
             std::cout << "MIDI Input device connected: " << port.port_name << std::endl;
+            auto delta = portRegistry.add(PortDirection::Input, port);
+            notifyPortDelta(delta);
+            if (delta) {
+                handlePortAdded(PortDirection::Input, delta->id);
+            }
         };
         obsConf.input_removed = [this](const libremidi::input_port& port) {
             std::cout << "MIDI Input device disconnected: " << port.port_name << std::endl;
+            auto delta = portRegistry.remove(PortDirection::Input, port);
+            notifyPortDelta(delta);
+            if (delta) {
+                handlePortRemoved(PortDirection::Input, delta->id);
+            }
         };
         obsConf.output_added = [this](const libremidi::output_port& port) {
             std::cout << "MIDI Output device connected: " << port.port_name << std::endl;
+            auto delta = portRegistry.add(PortDirection::Output, port);
+            notifyPortDelta(delta);
+            if (delta) {
+                handlePortAdded(PortDirection::Output, delta->id);
+            }
         };
         obsConf.output_removed = [this](const libremidi::output_port& port) {
             std::cout << "MIDI Output device disconnected: " << port.port_name << std::endl;
+            auto delta = portRegistry.remove(PortDirection::Output, port);
+            notifyPortDelta(delta);
+            if (delta) {
+                handlePortRemoved(PortDirection::Output, delta->id);
+            }
         };
         
         // Use MIDI 2.0/UMP observer configuration
         observer = std::make_unique<libremidi::observer>(obsConf, libremidi::midi2::observer_default_configuration());
+        // Drop ports a previous observer knew about that are gone now
+        syncPorts();
         
         // Create MIDI input with UMP callback configuration
         libremidi::ump_input_configuration inConf {
             .on_message = [this](libremidi::ump&& packet) {
-                onMidiInput(std::move(packet));
+                RealtimeSetup::instance().enterIoThread("midi in");
+                liveInputUsers.fetch_add(1);
+                if (!liveInputSuspended.load()) {
+                    onMidiInput(std::move(packet));
+                }
+                liveInputUsers.fetch_sub(1);
             },
             .ignore_sysex = false
         };
 
-        midiIn = std::make_unique<libremidi::midi_in>(inConf, libremidi::midi2::in_default_configuration());
+        auto in = std::make_unique<libremidi::midi_in>(inConf, libremidi::midi2::in_default_configuration());
         
         // Create MIDI output with UMP configuration
         libremidi::output_configuration outConf;
-        midiOut = std::make_unique<libremidi::midi_out>(outConf, libremidi::midi2::out_default_configuration());
-        
+        auto out = std::make_unique<libremidi::midi_out>(outConf, libremidi::midi2::out_default_configuration());
+        {
+            std::lock_guard<std::mutex> lock(connectionMutex);  // the output thread may be sending
+            midiIn = std::move(in);
+            midiOut = std::move(out);
+        }
         
         // Initialize MIDI-CI
         initializeMidiCI();
         
-        initialized = true;
+        // Publishes midiIn, midiOut and midiCIManager: isReady() pairs with this store
+        initialized.store(true, std::memory_order_release);
         return true;
     } catch (const std::exception& e) {
         std::cerr << "MIDI initialization failed: " << e.what() << std::endl;
@@ -85,181 +157,711 @@ bool KeyboardController::resetMidiConnections() {
     }
 }
 
-std::vector<std::pair<std::string, std::string>> KeyboardController::getInputDevices() {
-    std::vector<std::pair<std::string, std::string>> devices;
-    
-    try {
-        if (!observer) {
-            std::cerr << "Observer not initialized" << std::endl;
-            return devices;
+bool KeyboardController::startAsync(std::function<void(bool)> onReady) {
+    if (isReady() || startupThread.joinable()) {
+        std::cerr << "MIDI startup already ran" << std::endl;
+        return false;
+    }
+    startupThread = std::thread([this, onReady]() {
+        bool ok;
+        {
+            TraceSpan trace("MIDI startup", "startup");
+            ok = resetMidiConnections();
         }
-        
-        auto ports = observer->get_input_ports();
-        for (size_t i = 0; i < ports.size(); i++) {
-            std::string id = std::to_string(i);
-            std::string name = ports[i].port_name;
-            // Device now supports UMP/MIDI 2.0 by default with the UMP backend
-            devices.emplace_back(id, name);
+        if (ok && isMidiCIInitialized()) {
+            StartupProfiler::instance().mark("MIDI-CI ready");
         }
-        
-        std::cout << "Found " << devices.size() << " input devices" << std::endl;
-        for (const auto& device : devices) {
-            std::cout << "  ID: " << device.first << " - " << device.second << std::endl;
+        if (onReady) {
+            onReady(ok);
         }
-    } catch (const std::exception& e) {
-        std::cerr << "Error getting input devices: " << e.what() << std::endl;
-    }
+    });
+    return true;
+}
+
+std::vector<std::pair<std::string, std::string>> KeyboardController::getInputDevices() {
+    auto devices = portRegistry.list(PortDirection::Input);
     
+    std::cout << "Found " << devices.size() << " input devices" << std::endl;
+    for (const auto& device : devices) {
+        std::cout << "  ID: " << device.first << " - " << device.second << std::endl;
+    }
     return devices;
 }
 
 std::vector<std::pair<std::string, std::string>> KeyboardController::getOutputDevices() {
-    std::vector<std::pair<std::string, std::string>> devices;
+    auto devices = portRegistry.list(PortDirection::Output);
+    
+    std::cout << "Found " << devices.size() << " output devices" << std::endl;
+    for (const auto& device : devices) {
+        std::cout << "  ID: " << device.first << " - " << device.second << std::endl;
+    }
+    return devices;
+}
+
+bool KeyboardController::selectInputDevice(const std::string& deviceId) {
+    ConnectionEvents events;
+    bool ok = false;
+    {
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        ok = reconfigurePortsLocked(deviceId, currentOutputDeviceId, events);
+    }
+    dispatchConnectionEvents(events);
+    return ok;
+}
+
+bool KeyboardController::selectOutputDevice(const std::string& deviceId) {
+    ConnectionEvents events;
+    bool ok = false;
+    {
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        ok = reconfigurePortsLocked(currentInputDeviceId, deviceId, events);
+    }
+    dispatchConnectionEvents(events);
+    return ok;
+}
+
+bool KeyboardController::reconfigurePorts(const std::string& inputDeviceId, const std::string& outputDeviceId) {
+    ConnectionEvents events;
+    bool ok = false;
+    {
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        ok = reconfigurePortsLocked(inputDeviceId, outputDeviceId, events);
+    }
+    dispatchConnectionEvents(events);
+    return ok;
+}
+
+bool KeyboardController::reconfigurePortsLocked(const std::string& inputDeviceId, const std::string& outputDeviceId,
+                                                ConnectionEvents& events) {
+    if (!isReady() || !midiIn || !midiOut) {
+        return false;
+    }
+    // A side whose selection did not change stays as it is (open, or waiting to be reconnected)
+    bool inputChanged = inputDeviceId != currentInputDeviceId;
+    bool outputChanged = outputDeviceId != currentOutputDeviceId;
+    if (!inputChanged && !outputChanged) {
+        return true;
+    }
     
+    bool ok = true;
     try {
-        if (!observer) {
-            std::cerr << "Observer not initialized" << std::endl;
-            return devices;
+        if (inputChanged && midiIn->is_port_open()) {
+            midiIn->close_port();
         }
-        
-        auto ports = observer->get_output_ports();
-        for (size_t i = 0; i < ports.size(); i++) {
-            std::string id = std::to_string(i);
-            std::string name = ports[i].port_name;
-            // Device now supports UMP/MIDI 2.0 by default with the UMP backend
-            devices.emplace_back(id, name);
+        if (outputChanged && midiOut->is_port_open()) {
+            midiOut->close_port();
         }
+        // Report the break once, so the new pair is announced (and discovered) once below
+        updateUIConnectionState(events);
         
-        std::cout << "Found " << devices.size() << " output devices" << std::endl;
-        for (const auto& device : devices) {
-            std::cout << "  ID: " << device.first << " - " << device.second << std::endl;
+        if (inputChanged) {
+            // The mirror describes the device on the old port; nothing writes to it while no port is open
+            deviceState.clear();
+            bool opened = inputDeviceId.empty() || openPort(PortDirection::Input, inputDeviceId);
+            autoReconnect.select(PortDirection::Input, inputDeviceId, opened);
+            currentInputDeviceId = opened ? inputDeviceId : "";
+            ok = ok && opened;
+        }
+        if (outputChanged) {
+            bool opened = outputDeviceId.empty() || openPort(PortDirection::Output, outputDeviceId);
+            autoReconnect.select(PortDirection::Output, outputDeviceId, opened);
+            currentOutputDeviceId = opened ? outputDeviceId : "";
+            ok = ok && opened;
         }
     } catch (const std::exception& e) {
-        std::cerr << "Error getting output devices: " << e.what() << std::endl;
+        std::cerr << "Error switching MIDI ports: " << e.what() << std::endl;
+        ok = false;
+    }
+    if (!autoReconnect.isWaiting()) {
+        std::lock_guard<std::mutex> restoreLock(restoreMutex);
+        propertiesToRestore.clear();  // chosen by hand, not the device coming back
     }
     
-    return devices;
+    if (hasValidMidiPair()) {
+        bindMidiCIToPortPair(false);
+    }
+    updateUIConnectionState(events);
+    return ok;
 }
 
-bool KeyboardController::selectInputDevice(const std::string& deviceId) {
+void KeyboardController::bindMidiCIToPortPair(bool remoteRestarted) {
+    std::pair<std::string, std::string> pair{currentInputDeviceId, currentOutputDeviceId};
+    if (!midiCIManager || !midiCIManager->isInitialized()) {
+        initializeMidiCI();
+    } else if (remoteRestarted || (pair != midiCIPortPair && !midiCIPortPair.first.empty())) {
+        // Only the transport changed: keep our MUID and the midicci device, and drop what we learned
+        // about the devices behind the previous ports. The connection callback sends discovery.
+        std::cout << "[MIDI-CI] Port pair changed; keeping MUID 0x" << std::hex << midiCIManager->getMuid() << std::dec
+                  << std::endl;
+        midiCIManager->clearDiscoveredDevices();
+    }
+    midiCIPortPair = pair;
+}
+
+bool KeyboardController::openPort(PortDirection direction, const std::string& id) {
+    auto port = portRegistry.find(direction, id);
+    const char* kind = direction == PortDirection::Input ? "Input" : "Output";
+    if (!port) {
+        std::cerr << "MIDI " << kind << " device " << id << " is no longer available" << std::endl;
+        return false;
+    }
     try {
-        if (midiIn && midiIn->is_port_open()) {
-            midiIn->close_port();
-            updateUIConnectionState();
+        bool midi1 = isMidi1PortLocked(*port);
+        if (midi1) {
+            std::cout << "[MIDI1] " << kind << " " << PortRegistry::displayName(*port)
+                      << " speaks MIDI 1.0 protocol; translating channel voice messages" << std::endl;
         }
-        
-        if (deviceId.empty()) {
-            currentInputDeviceId = "";
-            updateUIConnectionState();
-            return true;
+        if (direction == PortDirection::Input) {
+            midiIn->open_port(libremidi::input_port{*port});
+            inputUpscaler.reset();  // safe: no callbacks before the port is open
+            inputIsMidi1 = midi1;
+        } else {
+            midiOut->open_port(libremidi::output_port{*port});
+            outputDownscaler.reset();  // the output thread is locked out by connectionMutex
+            outputIsMidi1 = midi1;
+            applyOutputPacingLocked(*port);
         }
-        
-        auto ports = observer->get_input_ports();
-        size_t portIndex = std::stoul(deviceId);
-        
-        if (portIndex < ports.size()) {
-            midiIn->open_port(ports[portIndex]);
-            currentInputDeviceId = deviceId;
+        return true;
+    } catch (const std::exception& e) {
+        std::cerr << "Opening MIDI " << kind << " device " << port->port_name << " failed: " << e.what() << std::endl;
+        return false;
+    }
+}
 
-            // Reinitialize MIDI-CI when we have a valid MIDI pair
-            if (hasValidMidiPair()) {
-                initializeMidiCI();
-            }
+void KeyboardController::setOutputPacing(const std::string& portName, const OutputPacingConfig& config) {
+    std::lock_guard<std::mutex> lock(connectionMutex);
+    outputPacingRules.emplace_back(portName, config);
+    if (auto port = portRegistry.find(PortDirection::Output, currentOutputDeviceId)) {
+        applyOutputPacingLocked(*port);
+    }
+}
+
+void KeyboardController::setMidi1Port(const std::string& portName) {
+    std::lock_guard<std::mutex> lock(connectionMutex);
+    midi1PortNames.push_back(portName);
+    if (auto port = portRegistry.find(PortDirection::Input, currentInputDeviceId)) {
+        inputIsMidi1 = isMidi1PortLocked(*port);
+    }
+    if (auto port = portRegistry.find(PortDirection::Output, currentOutputDeviceId)) {
+        outputIsMidi1 = isMidi1PortLocked(*port);
+    }
+}
+
+bool KeyboardController::isMidi1PortLocked(const libremidi::port_information& port) const {
+    std::string name = PortRegistry::displayName(port);
+    return std::any_of(midi1PortNames.begin(), midi1PortNames.end(),
+                       [&](const std::string& match) { return match == "*" || name.find(match) != std::string::npos; });
+}
+
+void KeyboardController::applyOutputPacingLocked(const libremidi::port_information& port) {
+    std::string name = PortRegistry::displayName(port);
+    OutputPacingConfig config;
+    for (const auto& [match, rule] : outputPacingRules) {
+        if (match == "*" || name.find(match) != std::string::npos) {
+            config = rule;
+        }
+    }
+    if (config.isEnabled() || outputQueue.pacing().isEnabled()) {
+        std::cout << "[PACING] " << name << ": voice " << config.voice.bytesPerSecond << " B/s, bulk "
+                  << config.bulk.bytesPerSecond << " B/s (0 = unlimited)" << std::endl;
+    }
+    outputQueue.setPacing(config);
+}
+
+void KeyboardController::setUmpStreamPreferences(const UmpStreamPreferences& preferences) {
+    std::lock_guard<std::mutex> lock(umpEndpointMutex);
+    umpEndpoint.setPreferences(preferences);
+}
 
-            updateUIConnectionState();
+std::optional<UmpEndpointInfo> KeyboardController::getUmpEndpoint() const {
+    std::lock_guard<std::mutex> lock(umpEndpointMutex);
+    if (!umpEndpoint.isEndpointKnown()) {
+        return std::nullopt;
+    }
+    return umpEndpoint.endpoint();
+}
 
-            return true;
+void KeyboardController::startEndpointDiscovery(const std::string& outputDeviceId) {
+    std::vector<uint32_t> requests;
+    {
+        std::lock_guard<std::mutex> lock(umpEndpointMutex);
+        umpEndpointPortId = outputDeviceId;
+        auto cached = umpEndpointCache.find(umpEndpointPortId);
+        if (cached != umpEndpointCache.end()) {
+            std::cout << "[UMP ENDPOINT] Using cached function blocks of \"" << cached->second.name
+                      << "\" until the endpoint answers" << std::endl;
+            umpEndpoint.start(cached->second, requests);
         } else {
-            return false;
+            umpEndpoint.start(requests);
         }
-    } catch (const std::exception& e) {
-        return false;
+        applyEndpointStateLocked();
     }
+    // A port that does not implement UMP Stream messages never answers, and everything stays as it was
+    submitOutput(UmpLane::Bulk, std::move(requests));
 }
 
-bool KeyboardController::selectOutputDevice(const std::string& deviceId) {
+void KeyboardController::onUmpStreamMessage(const uint32_t* words) {
+    std::vector<uint32_t> requests;
+    bool rediscoverMidiCI = false;
+    {
+        std::lock_guard<std::mutex> lock(umpEndpointMutex);
+        if (!umpEndpoint.handle(words, requests)) {
+            return;
+        }
+        uint16_t previousCIGroups = midiCIGroups.load(std::memory_order_relaxed);
+        applyEndpointStateLocked();
+        // MIDI-CI discovery goes out on group 0 unless that was known to be the wrong group; send it
+        // again if it went to a group without MIDI-CI (or was not sent at all)
+        uint16_t ciGroups = midiCIGroups.load(std::memory_order_relaxed);
+        int sentTo = previousCIGroups == 0 ? -1 : (previousCIGroups & 1) ? 0 : std::countr_zero(previousCIGroups);
+        rediscoverMidiCI = ciGroups != 0 && ciGroups != UmpEndpointDiscovery::ALL_GROUPS &&
+                           (sentTo < 0 || !(ciGroups & (1u << sentTo)));
+        if (umpEndpoint.isEndpointKnown() && !umpEndpointPortId.empty()) {
+            umpEndpointCache[umpEndpointPortId] = umpEndpoint.endpoint();
+        }
+        std::cout << "[UMP ENDPOINT] " << umpEndpoint.describe() << std::endl;
+    }
+    if (!requests.empty()) {
+        submitOutput(UmpLane::Bulk, std::move(requests));
+    }
+    if (rediscoverMidiCI) {
+        std::cout << "[UMP ENDPOINT] MIDI-CI groups changed; sending discovery again" << std::endl;
+        sendMidiCIDiscovery();
+    }
+}
+
+void KeyboardController::applyEndpointStateLocked() {
+    activeGroups = umpEndpoint.receivingGroups();
+    midiCIGroups = umpEndpoint.midiCIGroups();
+    droppedGroupsReported = 0;
+    bool midi1 = umpEndpoint.isEndpointKnown() && umpEndpoint.endpoint().protocol == UmpProtocol::Midi1;
+    if (midi1 != endpointIsMidi1.exchange(midi1)) {
+        std::cout << "[UMP ENDPOINT] Endpoint protocol is " << (midi1 ? "MIDI 1.0; translating channel voice messages" : "MIDI 2.0")
+                  << std::endl;
+    }
+}
+
+bool KeyboardController::dropInactiveGroups(std::vector<uint32_t>& words, uint16_t groups) {
+    size_t kept = 0;
+    for (size_t pos = 0; pos < words.size();) {
+        size_t count = std::min<size_t>(umpWordCount(words[pos]), words.size() - pos);
+        uint8_t type = umpMessageType(words[pos]);
+        // Utility and UMP Stream messages have no group
+        bool grouped = type != 0x0 && type != 0xF;
+        uint16_t bit = static_cast<uint16_t>(1u << umpGroup(words[pos]));
+        if (!grouped || (groups & bit)) {
+            std::copy_n(words.begin() + pos, count, words.begin() + kept);
+            kept += count;
+        } else if (!(droppedGroupsReported.fetch_or(bit, std::memory_order_relaxed) & bit)) {
+            std::cout << "[UMP ENDPOINT] Group " << umpGroup(words[pos]) + 1
+                      << " has no active function block; not sending to it" << std::endl;
+        }
+        pos += count;
+    }
+    words.resize(kept);
+    return kept > 0;
+}
+
+void KeyboardController::refreshDevices() {
+    if (!isReady()) return;  // the observer is still being created
+    std::cout << "Refreshing MIDI devices..." << std::endl;
+    // Hotplug keeps the registry current; this only catches events a backend failed to report
+    syncPorts();
+}
+
+void KeyboardController::setPortsChangedCallback(std::function<void(const PortDelta&)> callback) {
+    portsChangedCallback = callback;
+}
+
+void KeyboardController::notifyPortDelta(const std::optional<PortDelta>& delta) {
+    // Ports found while starting up are listed in one go once the controller is ready
+    if (delta && portsChangedCallback && isReady()) {
+        portsChangedCallback(*delta);
+    }
+}
+
+void KeyboardController::setAutoReconnect(bool enabled) {
+    std::lock_guard<std::mutex> lock(connectionMutex);
+    autoReconnect.setEnabled(enabled);
+}
+
+bool KeyboardController::isAutoReconnectEnabled() const {
+    std::lock_guard<std::mutex> lock(connectionMutex);
+    return autoReconnect.isEnabled();
+}
+
+void KeyboardController::setPortPairLostCallback(std::function<void()> callback) {
+    portPairLostCallback = callback;
+}
+
+void KeyboardController::setPortPairRestoredCallback(std::function<void(const ReconnectReport&)> callback) {
+    portPairRestoredCallback = callback;
+}
+
+void KeyboardController::handlePortRemoved(PortDirection direction, const std::string& id) {
+    ConnectionEvents events;
+    {
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        handlePortRemovedLocked(direction, id, events);
+    }
+    dispatchConnectionEvents(events);
+}
+
+void KeyboardController::handlePortRemovedLocked(PortDirection direction, const std::string& id,
+                                                 ConnectionEvents& events) {
+    bool firstLoss = !autoReconnect.isWaiting();
+    if (!autoReconnect.portRemoved(direction, id, LatencyTracker::now())) {
+        return;
+    }
+    if (firstLoss) {
+        saveMidiCIPropertiesForRestore();
+    }
+    
     try {
-        if (midiOut && midiOut->is_port_open()) {
+        if (direction == PortDirection::Input) {
+            if (midiIn && midiIn->is_port_open()) {
+                midiIn->close_port();
+            }
+            deviceState.clear();
+        } else if (midiOut && midiOut->is_port_open()) {
             midiOut->close_port();
-            updateUIConnectionState();
         }
-        
-        if (deviceId.empty()) {
-            currentOutputDeviceId = "";
-            updateUIConnectionState();
-            return true;
+    } catch (const std::exception& e) {
+        std::cerr << "[RECONNECT] Error closing removed port: " << e.what() << std::endl;
+    }
+    std::cout << "[RECONNECT] Selected MIDI " << (direction == PortDirection::Input ? "input" : "output")
+              << " went away; " << (autoReconnect.isEnabled() ? "waiting for it to return" : "auto-reconnect is off")
+              << std::endl;
+    updateUIConnectionState(events);
+    events.pairLost = firstLoss;
+}
+
+void KeyboardController::handlePortAdded(PortDirection direction, const std::string& id) {
+    ConnectionEvents events;
+    {
+        std::lock_guard<std::mutex> lock(connectionMutex);
+        handlePortAddedLocked(direction, id, events);
+    }
+    dispatchConnectionEvents(events);
+}
+
+void KeyboardController::handlePortAddedLocked(PortDirection direction, const std::string& id,
+                                               ConnectionEvents& events) {
+    if (!midiIn || !midiOut || !autoReconnect.portAdded(direction, id, LatencyTracker::now())) {
+        return;
+    }
+    
+    TraceSpan trace("reconnect port", "midi");
+    if (!openPort(direction, id)) {
+        return;  // stays selected; the next hotplug event for it tries again
+    }
+    int64_t reopenedNs = LatencyTracker::now();
+    auto report = autoReconnect.portReopened(direction, reopenedNs);
+    if (!report) {
+        std::cout << "[RECONNECT] Reopened MIDI " << (direction == PortDirection::Input ? "input" : "output")
+                  << "; waiting for the other port" << std::endl;
+        return;
+    }
+    
+    // Same MUID as before the outage; the device restarted, so forget it. The connection callback
+    // below sends discovery for the restored pair and the devices callback restores the lists.
+    if (hasValidMidiPair()) {
+        bindMidiCIToPortPair(true);
+    }
+    int64_t setupNs = LatencyTracker::now() - reopenedNs;
+    report->downNs += setupNs;
+    report->recoveryNs += setupNs;
+    
+    std::cout << "[RECONNECT] Port pair restored " << report->recoveryNs / 1e6 << " ms after replug (down for "
+              << report->downNs / 1e6 << " ms)" << std::endl;
+    updateUIConnectionState(events);
+    events.pairRestored = report;
+}
+
+namespace {
+
+std::string midiCIDeviceKey(const MidiCIDeviceInfo& device) {
+    return device.manufacturer + "/" + device.model;
+}
+
+}  // namespace
+
+void KeyboardController::saveMidiCIPropertiesForRestore() {
+    if (!midiCIManager || !midiCIManager->isInitialized()) {
+        return;
+    }
+    std::map<std::string, std::map<std::string, std::vector<uint8_t>>> saved;
+    for (const auto& device : midiCIManager->getDiscoveredDeviceDetails()) {
+        auto bodies = midiCIManager->getCachedProperties(device.muid);
+        if (!bodies.empty()) {
+            saved[midiCIDeviceKey(device)] = std::move(bodies);
         }
-        
-        auto ports = observer->get_output_ports();
-        size_t portIndex = std::stoul(deviceId);
-        
-        if (portIndex < ports.size()) {
-            midiOut->open_port(ports[portIndex]);
-            currentOutputDeviceId = deviceId;
-            updateUIConnectionState();
-            
-            // Reinitialize MIDI-CI when we have a valid MIDI pair
-            if (hasValidMidiPair()) {
-                initializeMidiCI();
+    }
+    std::lock_guard<std::mutex> lock(restoreMutex);
+    propertiesToRestore = std::move(saved);
+}
+
+void KeyboardController::onMidiCIDevicesChanged() {
+    std::map<std::string, std::map<std::string, std::vector<uint8_t>>> pending;
+    {
+        std::lock_guard<std::mutex> lock(restoreMutex);
+        pending = propertiesToRestore;
+    }
+    if (!pending.empty() && midiCIManager) {
+        for (const auto& device : midiCIManager->getDiscoveredDeviceDetails()) {
+            auto saved = pending.find(midiCIDeviceKey(device));
+            if (saved == pending.end()) {
+                continue;
+            }
+            size_t restored = midiCIManager->restoreProperties(device.muid, saved->second);
+            {
+                std::lock_guard<std::mutex> lock(restoreMutex);
+                propertiesToRestore.erase(saved->first);
+            }
+            if (restored > 0 && midiCIPropertiesChangedCallback) {
+                midiCIPropertiesChangedCallback(device.muid);
             }
-            
-            return true;
-        } else {
-            return false;
         }
-    } catch (const std::exception& e) {
-        return false;
+    }
+    if (midiCIDevicesChangedCallback) {
+        midiCIDevicesChangedCallback();
     }
 }
 
-void KeyboardController::refreshDevices() {
-    std::cout << "Refreshing MIDI devices..." << std::endl;
-    // The observer automatically refreshes device lists
-    // We just need to call the getter functions to update
-    getInputDevices();
-    getOutputDevices();
+void KeyboardController::syncPorts() {
+    if (!observer) {
+        return;
+    }
+    try {
+        auto inputs = observer->get_input_ports();
+        auto outputs = observer->get_output_ports();
+        std::vector<PortDelta> deltas = portRegistry.sync(
+            PortDirection::Input, std::vector<libremidi::port_information>(inputs.begin(), inputs.end()));
+        auto outputDeltas = portRegistry.sync(
+            PortDirection::Output, std::vector<libremidi::port_information>(outputs.begin(), outputs.end()));
+        deltas.insert(deltas.end(), outputDeltas.begin(), outputDeltas.end());
+        for (const auto& delta : deltas) {
+            notifyPortDelta(delta);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error listing MIDI devices: " << e.what() << std::endl;
+    }
 }
 
 void KeyboardController::noteOn(int note, int velocity) {
-    if (!midiOut || !initialized) return;
+    noteOnHighResolution(note, midi7To16(static_cast<uint8_t>(std::clamp(velocity, 0, 127))));
+}
+
+void KeyboardController::noteOnHighResolution(int note, uint16_t velocity) {
+    if (!isReady() || !midiOut) return;
     
     try {
+        auto probe = LatencyTracker::instance().begin();
+        
+        NoteRoute route = noteRouter.route(note);
+        if (!route.valid) return;  // key is outside every zone
+        
+        // A key that is still held (e.g. re-pressed during a glissando) is released where it was sent
+        if (auto previous = noteRouter.noteOn(note, route)) {
+            sendUmp(createUmpNoteOff(previous->group, previous->channel, previous->note));
+        }
+        
+        // Per-note pitch bend outlives the note it was sent for; start every note centered
+        if (noteExpression.lastSent(note, NoteExpression::PitchBend) != ExpressionCoalescer::PITCH_BEND_CENTER) {
+            uint32_t word0 = (0x4u << 28) | (route.group << 24) | (0x6u << 20) | (route.channel << 16) | (route.note << 8);
+            sendUmp(libremidi::ump(word0, ExpressionCoalescer::PITCH_BEND_CENTER, 0, 0));
+        }
+        noteExpression.resetLastSent(note, NoteExpression::PitchBend, ExpressionCoalescer::PITCH_BEND_CENTER);
+        noteExpression.resetLastSent(note, NoteExpression::Pressure, 0);
+        
         // Send MIDI 2.0 UMP note on message
-        libremidi::ump noteOnPacket = createUmpNoteOn(0, note, velocity);
-        midiOut->send_ump(noteOnPacket);
+        libremidi::ump noteOnPacket = createUmpNoteOn(route.group, route.channel, route.note, velocity);
+        probe.stamp(LatencyStage::Encode);
+        sendUmp(noteOnPacket);
+        probe.stamp(LatencyStage::Queue);
+        
+        LatencyTracker::instance().commit(probe);
     } catch (const std::exception& e) {
         std::cerr << "Error sending note on: " << e.what() << std::endl;
     }
 }
 
 void KeyboardController::noteOff(int note) {
-    if (!midiOut || !initialized) return;
+    if (!isReady() || !midiOut) return;
     
     try {
+        auto probe = LatencyTracker::instance().begin();
+        
+        auto route = noteRouter.noteOff(note);
+        if (!route) return;  // never sent, or already released
+        noteExpression.forget(note);
+        
         // Send MIDI 2.0 UMP note off message
-        libremidi::ump noteOffPacket = createUmpNoteOff(0, note);
-        midiOut->send_ump(noteOffPacket);
+        libremidi::ump noteOffPacket = createUmpNoteOff(route->group, route->channel, route->note);
+        probe.stamp(LatencyStage::Encode);
+        sendUmp(noteOffPacket);
+        probe.stamp(LatencyStage::Queue);
+        
+        LatencyTracker::instance().commit(probe);
     } catch (const std::exception& e) {
         std::cerr << "Error sending note off: " << e.what() << std::endl;
     }
 }
 
 void KeyboardController::allNotesOff() {
-    if (!midiOut || !initialized) return;
+    if (!isReady() || !midiOut) return;
     
     try {
-        // Send all notes off message
-        for (int note = 0; note < 128; note++) {
-            noteOff(note);
+        // Held keys are forgotten; the tracker knows everything that is sounding, on every destination
+        noteRouter.releaseAll();
+        
+        std::vector<uint32_t> words;
+        activeNotes.appendNoteOffs(words);
+        if (!words.empty()) {
+            sendUmpBatch(words.data(), words.size());
         }
     } catch (const std::exception& e) {
         std::cerr << "Error sending all notes off: " << e.what() << std::endl;
     }
 }
 
+void KeyboardController::panic() {
+    if (!isReady() || !midiOut) return;
+    
+    try {
+        noteRouter.releaseAll();
+        
+        std::vector<uint32_t> words;
+        activeNotes.appendNoteOffs(words);
+        size_t trackedNotes = words.size() / 2;
+        
+        // Also silence anything we did not send ourselves (e.g. notes from before a reconnect)
+        for (int group = 0; group < 16; group++) {
+            for (int channel = 0; channel < 16; channel++) {
+                for (uint8_t controller : {120, 123}) {  // All Sound Off, All Notes Off
+                    auto cc = cmidi2_ump_midi2_cc(group, channel, controller, 0);
+                    words.push_back(static_cast<uint32_t>(cc >> 32));
+                    words.push_back(static_cast<uint32_t>(cc & 0xFFFFFFFF));
+                }
+            }
+        }
+        sendUmpBatch(words.data(), words.size());
+        activeNotes.clear();
+        
+        std::cout << "[PANIC] Released " << trackedNotes << " tracked notes and reset all groups/channels" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error sending panic: " << e.what() << std::endl;
+    }
+}
+
+std::vector<ActiveNote> KeyboardController::getActiveNotes() const {
+    return activeNotes.activeNotes();
+}
+
+std::vector<ActiveNote> KeyboardController::getStuckNotes(std::chrono::milliseconds threshold) const {
+    return activeNotes.stuckNotes(threshold);
+}
+
+void KeyboardController::setNoteBend(int note, float semitones) {
+    double normalized = std::clamp(static_cast<double>(semitones / perNotePitchBendRange), -1.0, 1.0);
+    auto value = static_cast<uint32_t>(static_cast<int64_t>(ExpressionCoalescer::PITCH_BEND_CENTER) +
+                                       std::llround(normalized * 0x7FFFFFFF));
+    noteExpression.set(note, NoteExpression::PitchBend, value);
+}
+
+void KeyboardController::setNotePressure(int note, float pressure) {
+    auto value = static_cast<uint32_t>(std::clamp(static_cast<double>(pressure), 0.0, 1.0) * 4294967295.0);
+    noteExpression.set(note, NoteExpression::Pressure, value);
+}
+
+bool KeyboardController::flushNoteExpression() {
+    return noteExpression.flush(ExpressionCoalescer::Clock::now(), [this](int note, NoteExpression parameter, uint32_t value) {
+        auto route = noteRouter.sounding(note);
+        if (!isReady() || !route || !midiOut) return;
+        
+        // Per-Note Pitch Bend (opcode 0x6) or Poly Pressure (opcode 0xA)
+        uint32_t opcode = parameter == NoteExpression::PitchBend ? 0x6u : 0xAu;
+        uint32_t word0 = (0x4u << 28) | (route->group << 24) | (opcode << 20) | (route->channel << 16) | (route->note << 8);
+        try {
+            sendUmp(libremidi::ump(word0, value, 0, 0));
+        } catch (const std::exception& e) {
+            std::cerr << "Error sending per-note expression: " << e.what() << std::endl;
+        }
+    });
+}
+
+void KeyboardController::setPerNotePitchBendRange(float semitones) {
+    if (semitones > 0.0f) {
+        perNotePitchBendRange = semitones;
+    }
+}
+
+void KeyboardController::setKeyboardZones(const std::vector<KeyboardZone>& zones) {
+    // Held notes keep their old destination until released
+    noteRouter.setZones(zones);
+    for (const auto& zone : zones) {
+        std::cout << "[ROUTER] Keys " << zone.lowKey << "-" << zone.highKey << " -> group " << (zone.group + 1)
+                  << " channel " << (zone.channel + 1);
+        if (zone.transpose != 0) {
+            std::cout << " transpose " << zone.transpose;
+        }
+        std::cout << std::endl;
+    }
+}
+
+std::vector<KeyboardZone> KeyboardController::getKeyboardZones() const {
+    return noteRouter.zones();
+}
+
+void KeyboardController::setControlGroup(int group) {
+    noteRouter.setControlGroup(static_cast<uint8_t>(group));
+}
+
+int KeyboardController::getControlGroup() const {
+    return noteRouter.controlGroup();
+}
+
+bool KeyboardController::takeDeviceStateChanges(DeviceStateChanges& changes) {
+    return deviceState.takeChanges(changes);
+}
+
 void KeyboardController::onMidiInput(libremidi::ump&& packet) {
+    TraceSpan trace("onMidiInput", "midi");
+    captureUmp(UmpCaptureDirection::Incoming, packet);
+    
     // Check if this is a System Exclusive message (UMP Type 3 - SysEx7)
     uint8_t message_type = (packet.data[0] >> 28) & 0xF;
+    
+    // JR Timestamp utility messages are our loopback pings while a loopback test is running
+    if (message_type == 0x0 && ((packet.data[0] >> 20) & 0xF) == 0x2 && loopbackActive.load(std::memory_order_acquire)) {
+        onLoopbackPing(static_cast<uint16_t>(packet.data[0] & 0xFFFF));
+        return;
+    }
+    
+    if (message_type == 0xF) {
+        onUmpStreamMessage(packet.data);
+        return;
+    }
+    
+    // A MIDI 1.0 device's channel voice is upscaled first, so RPN/NRPN sequences arrive as one message
+    if (message_type == 0x2 &&
+        (inputIsMidi1.load(std::memory_order_relaxed) || endpointIsMidi1.load(std::memory_order_relaxed))) {
+        uint32_t upscaled[2];
+        uint8_t status = static_cast<uint8_t>(packet.data[0] >> 16);
+        if (inputUpscaler.convert(umpGroup(packet.data[0]), status, (packet.data[0] >> 8) & 0x7F, packet.data[0] & 0x7F,
+                                  upscaled) == 0) {
+            return;  // bank or parameter selection: remembered by the converter
+        }
+        packet = libremidi::ump(upscaled[0], upscaled[1], 0, 0);
+        message_type = 0x4;
+    }
+    
+    // Channel Voice from the device only updates the mirror; the UI picks changes up by polling
+    if (message_type == 0x2 || message_type == 0x4) {
+        deviceState.observe(packet.data);
+        return;
+    }
+    
     if (message_type == 0x3) { // SysEx7 UMP
         uint8_t group = (packet.data[0] >> 24) & 0xF;
         uint8_t status = (packet.data[0] >> 20) & 0xF;
@@ -290,10 +892,10 @@ void KeyboardController::onMidiInput(libremidi::ump&& packet) {
                     if (sysex_buffer_.size() >= 4 && 
                         sysex_buffer_[0] == 0xF0 && sysex_buffer_[1] == 0x7E && sysex_buffer_[3] == 0x0D) {
                         std::cout << "[SYSEX INPUT] Processing legitimate MIDI-CI message" << std::endl;
-                        processSysExForMidiCI(sysex_buffer_);
+                        processSysExForMidiCI(group, sysex_buffer_);
                     } else {
                         std::cout << "[SYSEX INPUT] Processing SysEx message (not MIDI-CI or not in recent outgoing)" << std::endl;
-                        processSysExForMidiCI(sysex_buffer_);
+                        processSysExForMidiCI(group, sysex_buffer_);
                     }
                 }
                 sysex_in_progress_ = false;
@@ -351,10 +953,10 @@ void KeyboardController::onMidiInput(libremidi::ump&& packet) {
                     if (sysex_buffer_.size() >= 4 && 
                         sysex_buffer_[0] == 0xF0 && sysex_buffer_[1] == 0x7E && sysex_buffer_[3] == 0x0D) {
                         std::cout << "[SYSEX INPUT] Processing legitimate MIDI-CI message (multi-packet)" << std::endl;
-                        processSysExForMidiCI(sysex_buffer_);
+                        processSysExForMidiCI(group, sysex_buffer_);
                     } else {
                         std::cout << "[SYSEX INPUT] Processing SysEx message (not MIDI-CI or not in recent outgoing, multi-packet)" << std::endl;
-                        processSysExForMidiCI(sysex_buffer_);
+                        processSysExForMidiCI(group, sysex_buffer_);
                     }
                 }
                 sysex_in_progress_ = false;
@@ -367,85 +969,83 @@ void KeyboardController::onMidiInput(libremidi::ump&& packet) {
     }
 }
 
-libremidi::ump KeyboardController::createUmpNoteOn(int channel, int note, int velocity) {
+libremidi::ump KeyboardController::createUmpNoteOn(int group, int channel, int note, uint16_t velocity) {
     // Create MIDI 2.0 Note On UMP packet
-    // Format: [Message Type (4) | Channel (4) | Status (8) | Note (8) | Reserved (8)] [Velocity (16) | Attribute Type (8) | Velocity MSB (8)] [0] [0]
-    uint32_t word0 = (0x4 << 28) | (channel << 24) | (0x90 << 16) | (note << 8) | 0x00;
-    uint32_t word1 = (velocity << 24) | (velocity << 16); // MIDI 2.0 uses 16-bit velocity
+    // Format: [Message Type (4) | Group (4) | Status (4) | Channel (4) | Note (8) | Attribute Type (8)] [Velocity (16) | Attribute (16)] [0] [0]
+    uint32_t word0 = (0x4u << 28) | ((group & 0xF) << 24) | (0x9 << 20) | ((channel & 0xF) << 16) | ((note & 0x7F) << 8);
+    uint32_t word1 = static_cast<uint32_t>(velocity) << 16; // MIDI 2.0 uses 16-bit velocity
     return libremidi::ump(word0, word1, 0, 0);
 }
 
-libremidi::ump KeyboardController::createUmpNoteOff(int channel, int note) {
+libremidi::ump KeyboardController::createUmpNoteOff(int group, int channel, int note) {
     // Create MIDI 2.0 Note Off UMP packet
-    // Format: [Message Type (4) | Channel (4) | Status (8) | Note (8) | Reserved (8)] [Velocity (16) | Attribute Type (8) | Velocity MSB (8)] [0] [0]
-    uint32_t word0 = (0x4 << 28) | (channel << 24) | (0x80 << 16) | (note << 8) | 0x00;
+    // Format: [Message Type (4) | Group (4) | Status (4) | Channel (4) | Note (8) | Attribute Type (8)] [Velocity (16) | Attribute (16)] [0] [0]
+    uint32_t word0 = (0x4u << 28) | ((group & 0xF) << 24) | (0x8 << 20) | ((channel & 0xF) << 16) | ((note & 0x7F) << 8);
     uint32_t word1 = 0; // Zero velocity for note off
     return libremidi::ump(word0, word1, 0, 0);
 }
 
-
 void KeyboardController::sendMidiCIDiscovery() {
-    if (midiCIManager && midiCIManager->isInitialized()) {
+    // Before a deferred startup finishes the manager is still being created on another thread
+    if (isReady() && midiCIManager && midiCIManager->isInitialized()) {
         midiCIManager->sendDiscovery();
     }
 }
 
 std::vector<std::string> KeyboardController::getMidiCIDevices() {
-    if (midiCIManager && midiCIManager->isInitialized()) {
+    if (isReady() && midiCIManager && midiCIManager->isInitialized()) {
         return midiCIManager->getDiscoveredDevices();
     }
     return {};
 }
 
 std::vector<MidiCIDeviceInfo> KeyboardController::getMidiCIDeviceDetails() {
-    if (midiCIManager && midiCIManager->isInitialized()) {
+    if (isReady() && midiCIManager && midiCIManager->isInitialized()) {
         return midiCIManager->getDiscoveredDeviceDetails();
     }
     return {};
 }
 
 MidiCIDeviceInfo* KeyboardController::getMidiCIDeviceByMuid(uint32_t muid) {
-    if (midiCIManager && midiCIManager->isInitialized()) {
+    if (isReady() && midiCIManager && midiCIManager->isInitialized()) {
         return midiCIManager->getDeviceByMuid(muid);
     }
     return nullptr;
 }
 
 bool KeyboardController::isMidiCIInitialized() const {
-    return midiCIManager && midiCIManager->isInitialized();
+    return isReady() && midiCIManager && midiCIManager->isInitialized();
 }
 
 uint32_t KeyboardController::getMidiCIMuid() const {
-    if (midiCIManager) {
+    if (isReady() && midiCIManager) {
         return midiCIManager->getMuid();
     }
     return 0;
 }
 
 std::string KeyboardController::getMidiCIDeviceName() const {
-    if (midiCIManager) {
+    if (isReady() && midiCIManager) {
         return midiCIManager->getDeviceName();
     }
     return "";
 }
 
 void KeyboardController::setMidiCIDevicesChangedCallback(std::function<void()> callback) {
+    // The manager calls onMidiCIDevicesChanged(), which forwards to this
     midiCIDevicesChangedCallback = callback;
-    if (midiCIManager) {
-        midiCIManager->setDevicesChangedCallback(callback);
-    }
 }
 
 // MIDI-CI Property methods - simplified API using PropertyClientFacade
 std::optional<std::vector<midicci::commonproperties::MidiCIControl>> KeyboardController::getAllCtrlList(uint32_t muid) {
-    if (midiCIManager && midiCIManager->isInitialized()) {
+    if (isReady() && midiCIManager && midiCIManager->isInitialized()) {
         return midiCIManager->getAllCtrlList(muid);
     }
     return std::nullopt;
 }
 
 std::optional<std::vector<midicci::commonproperties::MidiCIProgram>> KeyboardController::getProgramList(uint32_t muid) {
-    if (midiCIManager && midiCIManager->isInitialized()) {
+    if (isReady() && midiCIManager && midiCIManager->isInitialized()) {
         return midiCIManager->getProgramList(muid);
     }
     return std::nullopt;
@@ -453,56 +1053,73 @@ std::optional<std::vector<midicci::commonproperties::MidiCIProgram>> KeyboardCon
 
 void KeyboardController::setMidiCIPropertiesChangedCallback(std::function<void(uint32_t)> callback) {
     midiCIPropertiesChangedCallback = callback;
-    if (midiCIManager) {
+    // Before startup completes, initializeMidiCI() hands the stored callback to the new manager
+    if (isReady() && midiCIManager) {
         midiCIManager->setPropertiesChangedCallback(callback);
     }
 }
 
+void KeyboardController::setMidiCIPropertyRowsChangedCallback(MidiCIManager::PropertyRowsChangedCallback callback) {
+    midiCIPropertyRowsChangedCallback = callback;
+    if (isReady() && midiCIManager) {
+        midiCIManager->setPropertyRowsChangedCallback(callback);
+    }
+}
+
 
 bool KeyboardController::hasValidMidiPair() const {
-    return midiIn && midiIn->is_port_open() && midiOut && midiOut->is_port_open();
+    return isReady() && midiIn && midiIn->is_port_open() && midiOut && midiOut->is_port_open();
 }
 
 void KeyboardController::setMidiConnectionChangedCallback(std::function<void(bool)> callback) {
     midiConnectionChangedCallback = callback;
 }
 
-void KeyboardController::initializeMidiCI() {
+void KeyboardController::initializeMidiCI(uint32_t muid) {
     try {
         // Ensure any existing manager is properly shut down first
         if (midiCIManager) {
+            // A new MUID is a new identity: devices that knew the old one must drop it
+            bool identityChanged = midiCIManager->isInitialized() && muid != midiCIManager->getMuid();
             std::cout << "[MIDI-CI] Reinitializing MIDI-CI manager" << std::endl;
-            midiCIManager->shutdown();
+            midiCIManager->shutdown(identityChanged);
             midiCIManager.reset();
         }
         
-        midiCIManager = std::make_unique<MidiCIManager>();
+        // Built and initialized aside, then moved in, so the member never holds a half-set-up manager
+        auto manager = std::make_unique<MidiCIManager>();
         
         // Set up logging callback
-        midiCIManager->setLogCallback([](const std::string& message) {
+        manager->setLogCallback([](const std::string& message) {
             std::cout << message << std::endl;
         });
         
         // Set up SysEx sender callback BEFORE initialization
-        midiCIManager->setSysExSender([this](uint8_t group, const std::vector<uint8_t>& data) -> bool {
+        manager->setSysExSender([this](uint8_t group, const std::vector<uint8_t>& data) -> bool {
             std::cout << "[SYSEX CALLBACK] External SysEx sender called with " << data.size() << " bytes" << std::endl;
             return sendSysExViaMidi(group, data);
         });
         
         // Initialize the MIDI-CI manager (will now use the SysEx sender)
-        if (!midiCIManager->initialize()) {
+        if (!manager->initialize(muid)) {
             std::cerr << "Failed to initialize MIDI-CI manager" << std::endl;
-            midiCIManager.reset();
         } else {
             // Set up stored callbacks after successful initialization
             if (midiCIPropertiesChangedCallback) {
-                midiCIManager->setPropertiesChangedCallback(midiCIPropertiesChangedCallback);
+                manager->setPropertiesChangedCallback(midiCIPropertiesChangedCallback);
                 std::cout << "[MIDI-CI] Properties changed callback restored after initialization" << std::endl;
             }
-            if (midiCIDevicesChangedCallback) {
-                midiCIManager->setDevicesChangedCallback(midiCIDevicesChangedCallback);
-                std::cout << "[MIDI-CI] Devices changed callback restored after initialization" << std::endl;
+            if (midiCIPropertyRowsChangedCallback) {
+                manager->setPropertyRowsChangedCallback(midiCIPropertyRowsChangedCallback);
             }
+            manager->setDevicesChangedCallback([this]() {
+                onMidiCIDevicesChanged();
+            });
+            // Replays need our MUID to get CI replies addressed to us accepted again
+            if (captureRecorder) {
+                captureRecorder->setLocalMuid(manager->getMuid());
+            }
+            midiCIManager = std::move(manager);
         }
         
     } catch (const std::exception& e) {
@@ -511,10 +1128,12 @@ void KeyboardController::initializeMidiCI() {
     }
 }
 
-void KeyboardController::processSysExForMidiCI(const std::vector<uint8_t>& sysex_data) {
+void KeyboardController::processSysExForMidiCI(uint8_t group, const std::vector<uint8_t>& sysex_data) {
+    TraceSpan trace("processSysExForMidiCI", "midi");
+    trace.setArg("bytes", static_cast<int64_t>(sysex_data.size()));
     std::cout << "[MIDI-CI CHECK] Processing SysEx for MIDI-CI, size: " << sysex_data.size() << std::endl;
     
-    if (midiCIManager && midiCIManager->isInitialized()) {
+    if (isReady() && midiCIManager && midiCIManager->isInitialized()) {
         // Check if this is a MIDI-CI message (starts with 0x7E for Universal Non-Real Time)
         if (!sysex_data.empty() && sysex_data[0] == 0xF0 && sysex_data.size() > 2 && sysex_data[1] == 0x7E) {
             std::cout << "[MIDI-CI DETECTED] Universal Non-Real Time SysEx (0x7E)" << std::endl;
@@ -551,7 +1170,7 @@ void KeyboardController::processSysExForMidiCI(const std::vector<uint8_t>& sysex
                     if (payload_data.size() > 16) std::cout << "...";
                     std::cout << std::dec << std::endl;
                     
-                    midiCIManager->processMidi1SysEx(payload_data);
+                    midiCIManager->processUmpSysEx(group, payload_data);
                 } else {
                     std::cout << "[MIDI-CI ERROR] Invalid SysEx payload after stripping F0/F7" << std::endl;
                 }
@@ -565,7 +1184,7 @@ void KeyboardController::processSysExForMidiCI(const std::vector<uint8_t>& sysex
 }
 
 bool KeyboardController::sendSysExViaMidi(uint8_t group, const std::vector<uint8_t>& data) {
-    if (!midiOut || !initialized) {
+    if (!isReady() || !midiOut) {
         return false;
     }
     
@@ -578,38 +1197,43 @@ bool KeyboardController::sendSysExViaMidi(uint8_t group, const std::vector<uint8
             recentOutgoingSysEx.erase(it);
         }
 
-        // Use cmidi2 to convert SysEx to UMP SYSEX7 packets
+        // MIDI-CI goes to a group whose function block speaks it, or nowhere if none does
+        uint16_t ciGroups = midiCIGroups.load(std::memory_order_relaxed);
+        if (ciGroups == 0) {
+            std::cout << "[UMP ENDPOINT] No active function block supports MIDI-CI; not sending" << std::endl;
+            return false;
+        }
+        if (!(ciGroups & (1u << (group & 0xF)))) {
+            group = static_cast<uint8_t>(std::countr_zero(ciGroups));
+        }
+        
+        // Use cmidi2 to convert SysEx to UMP SYSEX7 packets, collected into one batch so the
+        // message reaches the wire in one piece
+        std::vector<uint32_t> words;
+        words.reserve((data.size() / 6 + 1) * 2);
         void* result = cmidi2_ump_sysex7_process(
             group,
             const_cast<void*>(static_cast<const void*>(data.data())),
             [](uint64_t umpData, void* context) -> void* {
-                auto* controller = static_cast<KeyboardController*>(context);
+                auto* words = static_cast<std::vector<uint32_t>*>(context);
                 
                 // Extract the two 32-bit words from the 64-bit UMP data
-                uint32_t word0 = static_cast<uint32_t>(umpData >> 32);
-                uint32_t word1 = static_cast<uint32_t>(umpData & 0xFFFFFFFF);
-                
-                // Create UMP packet and send it
-                libremidi::ump packet(word0, word1, 0, 0);
-
-                try {
-                    controller->midiOut->send_ump(packet);
-                } catch (const std::exception& e) {
-                    std::cerr << "Failed to send UMP SYSEX7 packet: " << e.what() << std::endl;
-                    return const_cast<void*>(static_cast<const void*>(&e)); // Return error
-                }
-                
+                words->push_back(static_cast<uint32_t>(umpData >> 32));
+                words->push_back(static_cast<uint32_t>(umpData & 0xFFFFFFFF));
                 return nullptr; // Success
             },
-            this
+            &words
         );
         
         if (result != nullptr) {
             std::cerr << "[SYSEX SEND] cmidi2_ump_sysex7_process failed" << std::endl;
             return false;
         }
+        if (!submitOutput(UmpLane::Bulk, std::move(words))) {
+            return false;
+        }
         
-        std::cout << "[SYSEX SEND] UMP SYSEX7 packets sent successfully using cmidi2" << std::endl;
+        std::cout << "[SYSEX SEND] UMP SYSEX7 packets queued using cmidi2" << std::endl;
         return true;
     } catch (const std::exception& e) {
         std::cerr << "Error sending SysEx via UMP: " << e.what() << std::endl;
@@ -618,88 +1242,401 @@ bool KeyboardController::sendSysExViaMidi(uint8_t group, const std::vector<uint8
 }
 
 void KeyboardController::sendControlChange(int channel, int controller, uint32_t value) {
-    if (!midiOut || !initialized) return;
+    sendControlChange(noteRouter.controlGroup(), channel, controller, value);
+}
+
+void KeyboardController::sendRPN(int channel, int msb, int lsb, uint32_t value) {
+    sendRPN(noteRouter.controlGroup(), channel, msb, lsb, value);
+}
+
+void KeyboardController::sendNRPN(int channel, int msb, int lsb, uint32_t value) {
+    sendNRPN(noteRouter.controlGroup(), channel, msb, lsb, value);
+}
+
+void KeyboardController::sendPerNoteControlChange(int channel, int note, int controller, uint32_t value) {
+    sendPerNoteControlChange(noteRouter.controlGroup(), channel, note, controller, value);
+}
+
+void KeyboardController::sendPerNoteAftertouch(int channel, int note, uint32_t value) {
+    sendPerNoteAftertouch(noteRouter.controlGroup(), channel, note, value);
+}
+
+void KeyboardController::sendControlChange(int group, int channel, int controller, uint32_t value) {
+    if (!isReady() || !midiOut) return;
     
     try {
         // Create MIDI 2.0 Control Change UMP packet
-        auto cc = cmidi2_ump_midi2_cc(0, channel, controller, value);
+        auto cc = cmidi2_ump_midi2_cc(group, channel, controller, value);
         libremidi::ump packet(cc >> 32, cc & 0xFFFFFFFF, 0, 0);
-        midiOut->send_ump(packet);
+        sendUmp(packet);
         
-        std::cout << "[MIDI OUT] CC Ch:" << channel << " CC:" << controller << " Val:" << value << std::endl;
+        std::cout << "[MIDI OUT] CC Grp:" << group << " Ch:" << channel << " CC:" << controller << " Val:" << value << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Error sending control change: " << e.what() << std::endl;
     }
 }
 
-void KeyboardController::sendRPN(int channel, int msb, int lsb, uint32_t value) {
-    if (!midiOut || !initialized) return;
+void KeyboardController::sendRPN(int group, int channel, int msb, int lsb, uint32_t value) {
+    if (!isReady() || !midiOut) return;
     
     try {
-        auto rpn = cmidi2_ump_midi2_rpn(0, channel, msb, lsb, value);
+        auto rpn = cmidi2_ump_midi2_rpn(group, channel, msb, lsb, value);
         libremidi::ump packet(rpn >> 32, rpn & 0xFFFFFFFF, 0, 0);
-        midiOut->send_ump(packet);
+        sendUmp(packet);
 
-        std::cout << "[MIDI OUT] RPN Ch:" << channel << " MSB:" << msb << " LSB:" << lsb << " Val:" << value << std::endl;
+        std::cout << "[MIDI OUT] RPN Grp:" << group << " Ch:" << channel << " MSB:" << msb << " LSB:" << lsb << " Val:" << value << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Error sending RPN: " << e.what() << std::endl;
     }
 }
 
-void KeyboardController::sendNRPN(int channel, int msb, int lsb, uint32_t value) {
-    if (!midiOut || !initialized) return;
+void KeyboardController::sendNRPN(int group, int channel, int msb, int lsb, uint32_t value) {
+    if (!isReady() || !midiOut) return;
     
     try {
-        auto nrpn = cmidi2_ump_midi2_nrpn(0, channel, msb, lsb, value);
+        auto nrpn = cmidi2_ump_midi2_nrpn(group, channel, msb, lsb, value);
         libremidi::ump packet(nrpn >> 32, nrpn & 0xFFFFFFFF, 0, 0);
-        midiOut->send_ump(packet);
+        sendUmp(packet);
         
-        std::cout << "[MIDI OUT] NRPN Ch:" << channel << " MSB:" << msb << " LSB:" << lsb << " Val:" << value << std::endl;
+        std::cout << "[MIDI OUT] NRPN Grp:" << group << " Ch:" << channel << " MSB:" << msb << " LSB:" << lsb << " Val:" << value << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Error sending NRPN: " << e.what() << std::endl;
     }
 }
 
-void KeyboardController::sendPerNoteControlChange(int channel, int note, int controller, uint32_t value) {
-    if (!midiOut || !initialized) return;
+void KeyboardController::sendPerNoteControlChange(int group, int channel, int note, int controller, uint32_t value) {
+    if (!isReady() || !midiOut) return;
     
     try {
         // Create MIDI 2.0 Per-Note Control Change UMP packet
-        auto pnac = cmidi2_ump_midi2_per_note_acc(0, channel, note, controller, value);
+        auto pnac = cmidi2_ump_midi2_per_note_acc(group, channel, note, controller, value);
         libremidi::ump packet(pnac >> 32, pnac & 0xFFFFFFFF, 0, 0);
-        midiOut->send_ump(packet);
+        sendUmp(packet);
         
-        std::cout << "[MIDI OUT] Per-Note CC Ch:" << channel << " Note:" << note << " CC:" << controller << " Val:" << value << std::endl;
+        std::cout << "[MIDI OUT] Per-Note CC Grp:" << group << " Ch:" << channel << " Note:" << note << " CC:" << controller << " Val:" << value << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Error sending per-note control change: " << e.what() << std::endl;
     }
 }
 
-void KeyboardController::sendPerNoteAftertouch(int channel, int note, uint32_t value) {
-    if (!midiOut || !initialized) return;
+void KeyboardController::sendPerNoteAftertouch(int group, int channel, int note, uint32_t value) {
+    if (!isReady() || !midiOut) return;
     
     try {
         // Create MIDI 2.0 Per-Note Aftertouch UMP packet
-        auto paf = cmidi2_ump_midi2_paf(0, channel, note, value);
+        auto paf = cmidi2_ump_midi2_paf(group, channel, note, value);
         libremidi::ump packet(paf >> 32, paf & 0xFFFFFFFF, 0, 0);
-        midiOut->send_ump(packet);
+        sendUmp(packet);
         
-        std::cout << "[MIDI OUT] Per-Note AC Ch:" << channel << " Note:" << note << " Val:" << value << std::endl;
+        std::cout << "[MIDI OUT] Per-Note AC Grp:" << group << " Ch:" << channel << " Note:" << note << " Val:" << value << std::endl;
     } catch (const std::exception& e) {
         std::cerr << "Error sending per-note aftertouch: " << e.what() << std::endl;
     }
 }
 
-void KeyboardController::updateUIConnectionState() {
+size_t KeyboardController::sendUmpBatch(const uint32_t* words, size_t wordCount, UmpLane lane) {
+    if (!isReady() || !midiOut) return 0;
+    
+    size_t packets = 0;
+    try {
+        size_t pos = 0;
+        while (pos < wordCount) {
+            int count = umpWordCount(words[pos]);
+            if (pos + count > wordCount) {
+                std::cerr << "Truncated UMP at the end of a batch" << std::endl;
+                break;
+            }
+            pos += count;
+            packets++;
+        }
+        // Submitted as one batch: a snapshot or chord is not split by other traffic
+        submitOutput(lane, std::vector<uint32_t>(words, words + pos));
+    } catch (const std::exception& e) {
+        std::cerr << "Error sending UMP batch: " << e.what() << std::endl;
+    }
+    return packets;
+}
+
+void KeyboardController::updateUIConnectionState(ConnectionEvents& events) {
     bool currentConnectionState = hasValidMidiPair();
     
     if (currentConnectionState != previousConnectionState) {
         previousConnectionState = currentConnectionState;
-        
+        events.connectionChanges.push_back(currentConnectionState);
+        if (currentConnectionState) {
+            events.outputDeviceId = currentOutputDeviceId;
+        }
+    }
+}
+
+void KeyboardController::dispatchConnectionEvents(const ConnectionEvents& events) {
+    for (bool connected : events.connectionChanges) {
+        // Before the callback, so the MIDI-CI discovery it sends already uses cached function blocks
+        if (connected) {
+            startEndpointDiscovery(events.outputDeviceId);
+        }
         if (midiConnectionChangedCallback) {
-            midiConnectionChangedCallback(currentConnectionState);
+            midiConnectionChangedCallback(connected);
+        }
+        
+        std::cout << "MIDI connection pair state changed: " << (connected ? "CONNECTED" : "DISCONNECTED") << std::endl;
+    }
+    if (events.pairLost && portPairLostCallback) {
+        portPairLostCallback();
+    }
+    if (events.pairRestored && portPairRestoredCallback) {
+        portPairRestoredCallback(*events.pairRestored);
+    }
+}
+
+void KeyboardController::dumpLatencyStatistics() {
+    LatencyTracker::instance().dump(std::cout);
+    RealtimeSetup::instance().report(std::cout);
+    auto output = outputQueue.stats();
+    std::cout << "[MIDI OUT] " << output.realtimeBatches << " realtime / " << output.bulkBatches
+              << " bulk batches, " << output.words << " words, " << output.overtakes
+              << " realtime batches sent ahead of waiting SysEx" << std::endl;
+    std::cout << "[MIDI OUT] Throughput " << static_cast<uint64_t>(output.voiceBytesPerSecond) << " B/s voice, "
+              << static_cast<uint64_t>(output.bulkBytesPerSecond) << " B/s bulk (MIDI 1.0 bytes); waited "
+              << output.pacedNs / 1000000 << " ms for pacing, dropped " << output.droppedBulkBatches
+              << " bulk messages at shutdown" << std::endl;
+}
+
+MidiCIMetricsSnapshot KeyboardController::getMidiCIMetrics() const {
+    return MidiCIMetrics::instance().snapshot();
+}
+
+void KeyboardController::dumpMidiCIStatistics() {
+    MidiCIMetrics::instance().dump(std::cout);
+}
+
+bool KeyboardController::isLoopbackTestRunning() const {
+    return loopbackActive.load(std::memory_order_acquire);
+}
+
+bool KeyboardController::startLoopbackTest(int pingCount, std::chrono::milliseconds interval,
+                                           std::function<void(const LoopbackTestReport&)> onComplete) {
+    if (!hasValidMidiPair()) {
+        std::cerr << "[LOOPBACK] Cannot start loopback test - select an input and output port first" << std::endl;
+        return false;
+    }
+    if (loopbackActive.load(std::memory_order_acquire)) {
+        std::cerr << "[LOOPBACK] Loopback test already running" << std::endl;
+        return false;
+    }
+    if (loopbackThread.joinable()) {
+        loopbackThread.join();
+    }
+    
+    if (!loopbackState) {
+        loopbackState = std::make_unique<LoopbackTestState>();
+    }
+    pingCount = std::clamp(pingCount, 1, LoopbackTestState::MAX_PINGS);
+    for (int i = 0; i < pingCount; i++) {
+        loopbackState->sentAt[i].store(0, std::memory_order_relaxed);
+    }
+    loopbackState->received = 0;
+    loopbackState->cancelled = false;
+    loopbackState->roundTrip.reset();
+    loopbackActive.store(true, std::memory_order_release);
+    
+    std::cout << "[LOOPBACK] Starting loopback test: " << pingCount << " pings, "
+              << interval.count() << "ms interval" << std::endl;
+    
+    loopbackThread = std::thread([this, pingCount, interval, onComplete]() {
+        auto& state = *loopbackState;
+        uint32_t sent = 0;
+        
+        for (int i = 0; i < pingCount && !state.cancelled; i++) {
+            uint16_t sequence = static_cast<uint16_t>(i);
+            // JR Timestamp utility message (UMP type 0, status 2); the 16-bit payload carries the sequence number
+            libremidi::ump ping((0x2u << 20) | sequence, 0, 0, 0);
+            state.sentAt[sequence].store(LatencyTracker::now(), std::memory_order_release);
+            try {
+                sendUmp(ping);
+                sent++;
+            } catch (const std::exception& e) {
+                state.sentAt[sequence].store(0, std::memory_order_relaxed);
+                std::cerr << "[LOOPBACK] Failed to send ping: " << e.what() << std::endl;
+            }
+            std::this_thread::sleep_for(interval);
+        }
+        
+        // Give in-flight pings a moment to arrive before reporting them as lost
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (state.received.load() < sent && !state.cancelled && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
         }
+        loopbackActive.store(false, std::memory_order_release);
         
-        std::cout << "MIDI connection pair state changed: " << (currentConnectionState ? "CONNECTED" : "DISCONNECTED") << std::endl;
+        LoopbackTestReport report;
+        report.sent = sent;
+        report.received = state.received.load();
+        report.minNs = state.roundTrip.min();
+        report.meanNs = static_cast<uint64_t>(state.roundTrip.mean());
+        report.p50Ns = state.roundTrip.percentile(50.0);
+        report.p99Ns = state.roundTrip.percentile(99.0);
+        report.p999Ns = state.roundTrip.percentile(99.9);
+        report.maxNs = state.roundTrip.max();
+        
+        std::cout << "[LOOPBACK] Received " << report.received << "/" << report.sent << " pings, RTT us:"
+                  << " min " << report.minNs / 1000.0
+                  << " p50 " << report.p50Ns / 1000.0
+                  << " p99 " << report.p99Ns / 1000.0
+                  << " p99.9 " << report.p999Ns / 1000.0
+                  << " max " << report.maxNs / 1000.0
+                  << " jitter(p99-p50) " << (report.p99Ns - report.p50Ns) / 1000.0 << std::endl;
+        
+        if (onComplete) {
+            onComplete(report);
+        }
+    });
+    
+    return true;
+}
+
+void KeyboardController::onLoopbackPing(uint16_t sequence) {
+    int64_t received = LatencyTracker::now();
+    auto& state = *loopbackState;
+    
+    // exchange() makes duplicates (e.g. a port that echoes twice) count only once
+    int64_t sentAt = state.sentAt[sequence].exchange(0, std::memory_order_acq_rel);
+    if (sentAt == 0) {
+        return;
+    }
+    
+    state.roundTrip.record(static_cast<uint64_t>(received - sentAt));
+    // The ping was stamped as it was queued, so the probe yields the loopback round trip
+    LatencyProbe probe;
+    probe.stamp(LatencyStage::Queue, sentAt);
+    probe.stamp(LatencyStage::LoopbackReceive, received);
+    LatencyTracker::instance().commit(probe);
+    state.received.fetch_add(1, std::memory_order_relaxed);
+}
+
+void KeyboardController::sendUmp(const libremidi::ump& packet) {
+    submitOutput(UmpLane::Realtime, std::vector<uint32_t>(packet.data, packet.data + umpWordCount(packet.data[0])));
+}
+
+bool KeyboardController::submitOutput(UmpLane lane, std::vector<uint32_t> words) {
+    if (!isReady() || outputMuted.load(std::memory_order_relaxed)) return false;
+    
+    uint16_t groups = activeGroups.load(std::memory_order_relaxed);
+    if (groups != UmpEndpointDiscovery::ALL_GROUPS && !dropInactiveGroups(words, groups)) {
+        return false;
+    }
+    // Observed when submitted, so allNotesOff() also releases notes still waiting in the queue
+    for (size_t pos = 0; pos < words.size(); pos += umpWordCount(words[pos])) {
+        activeNotes.observe(words.data() + pos);
+    }
+    return outputQueue.submit(lane, std::move(words));
+}
+
+void KeyboardController::writeOutputBatch(const uint32_t* words, size_t wordCount) {
+    RealtimeSetup::instance().enterIoThread("midi out");
+    // Port changes close and reopen midiOut under the same lock
+    std::lock_guard<std::mutex> lock(connectionMutex);
+    if (!midiOut) return;
+    
+    bool midi1 = outputIsMidi1.load(std::memory_order_relaxed) || endpointIsMidi1.load(std::memory_order_relaxed);
+    size_t pos = 0;
+    try {
+        while (pos < wordCount) {
+            uint32_t packetWords[4] = {};
+            int count = umpWordCount(words[pos]);
+            std::copy_n(words + pos, std::min<size_t>(count, wordCount - pos), packetWords);
+            pos += count;
+            if (!midi1) {
+                libremidi::ump packet(packetWords[0], packetWords[1], packetWords[2], packetWords[3]);
+                midiOut->send_ump(packet);
+                captureUmp(UmpCaptureDirection::Outgoing, packet);
+                continue;
+            }
+            // MIDI 1.0 device: one MIDI 2.0 message may become several MIDI 1.0 ones (or none)
+            uint32_t translated[Midi2ToMidi1Converter::MAX_WORDS];
+            size_t translatedWords = outputDownscaler.toUmp(packetWords, translated);
+            for (size_t i = 0; i < translatedWords; i += umpWordCount(translated[i])) {
+                uint32_t out[4] = {};
+                std::copy_n(translated + i, std::min<size_t>(umpWordCount(translated[i]), translatedWords - i), out);
+                libremidi::ump packet(out[0], out[1], out[2], out[3]);
+                midiOut->send_ump(packet);
+                captureUmp(UmpCaptureDirection::Outgoing, packet);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[MIDI OUT] Failed to send UMP batch: " << e.what() << std::endl;
+    }
+}
+
+void KeyboardController::captureUmp(UmpCaptureDirection direction, const libremidi::ump& packet) {
+    captureUsers.fetch_add(1);
+    if (auto* recorder = activeCapture.load()) {
+        recorder->append(direction, packet.data, umpWordCount(packet.data[0]));
+    }
+    captureUsers.fetch_sub(1);
+}
+
+bool KeyboardController::startCapture(const std::string& path, uint64_t capacityRecords) {
+    stopCapture();
+    
+    auto recorder = std::make_unique<UmpCaptureRecorder>();
+    if (!recorder->open(path, capacityRecords, getMidiCIMuid())) {
+        std::cerr << "[CAPTURE] Failed to start capture to " << path << std::endl;
+        return false;
     }
-}
\ No newline at end of file
+    // Both MIDI threads append to the ring; fault it in now rather than on the first notes
+    if (RealtimeSetup::instance().isEnabled()) {
+        RealtimeSetup::instance().prefault(recorder->mappedData(), recorder->mappedSize());
+    }
+    
+    captureRecorder = std::move(recorder);
+    activeCapture.store(captureRecorder.get());
+    return true;
+}
+
+void KeyboardController::stopCapture() {
+    if (!captureRecorder) return;
+    
+    activeCapture.store(nullptr);
+    // Wait for appends that picked up the recorder before it was unpublished
+    while (captureUsers.load() != 0) {
+        std::this_thread::yield();
+    }
+    captureRecorder->close();
+    captureRecorder.reset();
+}
+
+bool KeyboardController::isCapturing() const {
+    return activeCapture.load() != nullptr;
+}
+
+void KeyboardController::injectMidiInput(const libremidi::ump& packet) {
+    onMidiInput(libremidi::ump(packet));
+}
+
+bool KeyboardController::resetMidiCI(uint32_t muid) {
+    if (!isReady()) {
+        return false;
+    }
+    initializeMidiCI(muid);
+    return isMidiCIInitialized();
+}
+
+void KeyboardController::setOutputMuted(bool muted) {
+    outputMuted.store(muted, std::memory_order_relaxed);
+}
+
+void KeyboardController::setLiveInputSuspended(bool suspended) {
+    liveInputSuspended.store(suspended);
+    // A callback that counted itself before the store may still be inside onMidiInput()
+    while (suspended && liveInputUsers.load() != 0) {
+        std::this_thread::yield();
+    }
+}
+
+std::map<std::string, std::vector<uint8_t>> KeyboardController::getMidiCICachedProperties(uint32_t muid) {
+    if (isReady() && midiCIManager && midiCIManager->isInitialized()) {
+        return midiCIManager->getCachedProperties(muid);
+    }
+    return {};
+}
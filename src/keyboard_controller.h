@@ -6,27 +6,107 @@
 #include <vector>
 #include <string>
 #include <set>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <thread>
 #include "midi_ci_manager.h"
+#include "midi_ci_metrics.h"
+#include "latency_tracker.h"
+#include "ump_capture.h"
+#include "note_router.h"
+#include "active_note_tracker.h"
+#include "device_state_mirror.h"
+#include "expression_coalescer.h"
+#include "port_registry.h"
+#include "auto_reconnect.h"
+#include "ump_output_queue.h"
+#include "midi1_to_midi2.h"
+#include "midi2_to_midi1.h"
+#include "ump_endpoint.h"
+
+// Result of a loopback latency test (see KeyboardController::startLoopbackTest)
+struct LoopbackTestReport {
+    uint32_t sent = 0;
+    uint32_t received = 0;
+    uint64_t minNs = 0;
+    uint64_t meanNs = 0;
+    uint64_t p50Ns = 0;
+    uint64_t p99Ns = 0;
+    uint64_t p999Ns = 0;
+    uint64_t maxNs = 0;
+};
+
+// When the MIDI backends and MIDI-CI are brought up (see KeyboardController::startAsync)
+enum class MidiStartup {
+    Immediate,  // in the constructor
+    Deferred,   // when startAsync() is called
+};
 
 class KeyboardController {
 public:
-    KeyboardController();
+    explicit KeyboardController(MidiStartup startup = MidiStartup::Immediate);
     ~KeyboardController();
     
+    // Deferred startup: runs resetMidiConnections() (observer, UMP ports, MIDI-CI) on a worker thread
+    // so the UI can show first. `onReady` is invoked from that thread with the result. Until then
+    // sending is a no-op, queries return empty results and no port deltas are reported; list the
+    // devices from onReady.
+    bool startAsync(std::function<void(bool)> onReady);
+    bool isReady() const { return initialized.load(std::memory_order_acquire); }
+    
     bool resetMidiConnections();
     void noteOn(int note, int velocity);
+    void noteOnHighResolution(int note, uint16_t velocity);  // MIDI 2.0 16-bit velocity
     void noteOff(int note);
+    
+    // Per-note expression for a held key. Updates are coalesced; call flushNoteExpression()
+    // periodically (it returns true while updates are still waiting to be sent).
+    void setNoteBend(int note, float semitones);
+    void setNotePressure(int note, float pressure);  // 0..1
+    bool flushNoteExpression();
+    void setPerNotePitchBendRange(float semitones);
+    // Releases every sounding note (from any source) in one batch
     void allNotesOff();
+    // allNotesOff plus All Sound Off / All Notes Off on all 16 groups x 16 channels
+    void panic();
+    std::vector<ActiveNote> getActiveNotes() const;
+    std::vector<ActiveNote> getStuckNotes(std::chrono::milliseconds threshold) const;
+    
+    // Key -> (group, channel) routing; notes are released on the destination they were sent to
+    void setKeyboardZones(const std::vector<KeyboardZone>& zones);
+    std::vector<KeyboardZone> getKeyboardZones() const;
+    void setControlGroup(int group);
+    int getControlGroup() const;
     
-    // Device enumeration
+    // Device state mirrored from incoming Channel Voice messages; poll from the UI at display rate
+    bool takeDeviceStateChanges(DeviceStateChanges& changes);
+    
+    // Device enumeration, served from the port registry; IDs are stable across hotplug
     std::vector<std::pair<std::string, std::string>> getInputDevices();
     std::vector<std::pair<std::string, std::string>> getOutputDevices();
     
-    // Device selection
+    // Device selection. Changing ports keeps the MIDI-CI manager and MUID; only the devices
+    // discovered through the previous ports are forgotten.
     bool selectInputDevice(const std::string& deviceId);
     bool selectOutputDevice(const std::string& deviceId);
+    // Switches both ports in one step ("" closes a side); MIDI-CI is rebound once for the new pair
+    bool reconfigurePorts(const std::string& inputDeviceId, const std::string& outputDeviceId);
     
+    // Re-lists the backend ports and reports any difference through the ports-changed callback
     void refreshDevices();
+    // Called for every port added or removed, from the observer's thread
+    void setPortsChangedCallback(std::function<void(const PortDelta&)> callback);
+    
+    // Reopen the selected ports when they come back after an unplug (on by default), re-establish
+    // MIDI-CI with the same MUID and serve the rediscovered device's lists from the old cache.
+    // Both callbacks run on the observer's thread: "lost" once per outage, "restored" when the
+    // pair is open again (resend control state from there).
+    void setAutoReconnect(bool enabled);
+    bool isAutoReconnectEnabled() const;
+    void setPortPairLostCallback(std::function<void()> callback);
+    void setPortPairRestoredCallback(std::function<void(const ReconnectReport&)> callback);
     
     // MIDI-CI functionality
     void sendMidiCIDiscovery();
@@ -42,6 +122,9 @@ public:
     std::optional<std::vector<midicci::commonproperties::MidiCIControl>> getAllCtrlList(uint32_t muid);
     std::optional<std::vector<midicci::commonproperties::MidiCIProgram>> getProgramList(uint32_t muid);
     void setMidiCIPropertiesChangedCallback(std::function<void(uint32_t)> callback);
+    void setMidiCIPropertyRowsChangedCallback(MidiCIManager::PropertyRowsChangedCallback callback);
+    // Property bodies already received from the device, keyed by property ID; never sends a request
+    std::map<std::string, std::vector<uint8_t>> getMidiCICachedProperties(uint32_t muid);
     
     // MIDI control sending
     void sendControlChange(int channel, int controller, uint32_t value);
@@ -49,44 +132,184 @@ public:
     void sendNRPN(int channel, int msb, int lsb, uint32_t value);
     void sendPerNoteControlChange(int channel, int note, int controller, uint32_t value);
     void sendPerNoteAftertouch(int channel, int note, uint32_t value);
+    // Explicit-group variants; the overloads above use the control group
+    void sendControlChange(int group, int channel, int controller, uint32_t value);
+    void sendRPN(int group, int channel, int msb, int lsb, uint32_t value);
+    void sendNRPN(int group, int channel, int msb, int lsb, uint32_t value);
+    void sendPerNoteControlChange(int group, int channel, int note, int controller, uint32_t value);
+    void sendPerNoteAftertouch(int group, int channel, int note, uint32_t value);
+    // Sends a run of pre-encoded UMPs (any message types, packed back to back) as one batch on
+    // `lane`, which also picks the pacing budget it is charged to; returns packets sent
+    size_t sendUmpBatch(const uint32_t* words, size_t wordCount, UmpLane lane = UmpLane::Realtime);
     
     // MIDI connection state
     bool hasValidMidiPair() const;
     void setMidiConnectionChangedCallback(std::function<void(bool)> callback);
     
+    // Latency instrumentation
+    void dumpLatencyStatistics();
+    // MIDI-CI traffic counters (process-wide, survive MIDI-CI reinitialization)
+    MidiCIMetricsSnapshot getMidiCIMetrics() const;
+    void dumpMidiCIStatistics();
+    // Round-trips JR Timestamp pings through the selected output -> input pair (e.g. a virtual loopback port).
+    // Runs on a worker thread; the callback is invoked from that thread when the test completes.
+    bool startLoopbackTest(int pingCount, std::chrono::milliseconds interval,
+                           std::function<void(const LoopbackTestReport&)> onComplete);
+    bool isLoopbackTestRunning() const;
+    
+    // UMP capture: records every incoming and outgoing UMP into a memory-mapped ring file
+    bool startCapture(const std::string& path, uint64_t capacityRecords = UmpCaptureRecorder::DEFAULT_CAPACITY);
+    void stopCapture();
+    bool isCapturing() const;
+    
+    // Replay support: feed a UMP as if it arrived from the input port, recreate MIDI-CI with a given MUID,
+    // keep replies from reaching the (possibly real) output port, and drop live input meanwhile so
+    // injected packets are the only ones touching the SysEx buffer and MIDI-CI state
+    void injectMidiInput(const libremidi::ump& packet);
+    bool resetMidiCI(uint32_t muid = 0);
+    void setOutputMuted(bool muted);
+    // Returns once no live input callback is running any more
+    void setLiveInputSuspended(bool suspended);
+    
+    UmpOutputStats getOutputStats() const { return outputQueue.stats(); }
+    // Pacing for output ports whose name contains `portName` ("*" = every port); the last matching
+    // rule wins. Applied when such a port is opened, or right away if it is open already.
+    void setOutputPacing(const std::string& portName, const OutputPacingConfig& config);
+    // Ports whose name contains `portName` ("*" = every port) speak MIDI 1.0 protocol: outgoing MIDI 2.0
+    // channel voice is translated down, incoming MIDI 1.0 channel voice is translated up
+    void setMidi1Port(const std::string& portName);
+    
+    // UMP Endpoint discovery, run whenever a port pair connects. Until the endpoint has described its
+    // function blocks everything goes out as before; after that notes, controllers and MIDI-CI only go
+    // to groups an active function block receives, and MIDI-CI moves to a group that supports it.
+    std::optional<UmpEndpointInfo> getUmpEndpoint() const;  // nullopt until the endpoint answers
+    uint16_t getActiveGroups() const { return activeGroups.load(std::memory_order_relaxed); }
+    // Protocol and JR Timestamps to ask for; used from the next discovery on
+    void setUmpStreamPreferences(const UmpStreamPreferences& preferences);
+    
 private:
     std::unique_ptr<libremidi::midi_in> midiIn;
     std::unique_ptr<libremidi::midi_out> midiOut;
     std::unique_ptr<libremidi::observer> observer;
+    PortRegistry portRegistry;
+    AutoReconnect autoReconnect;
+    mutable std::mutex connectionMutex;  // port open/close from the UI and from hotplug callbacks
+    // Property bodies of the devices on a lost port pair, by manufacturer/model, until rediscovered
+    std::map<std::string, std::map<std::string, std::vector<uint8_t>>> propertiesToRestore;
+    std::mutex restoreMutex;
     std::unique_ptr<MidiCIManager> midiCIManager;
     
     std::string currentInputDeviceId;
     std::string currentOutputDeviceId;
+    std::pair<std::string, std::string> midiCIPortPair;  // ports MIDI-CI discovered devices through
+    std::vector<std::pair<std::string, OutputPacingConfig>> outputPacingRules;  // guarded by connectionMutex
+    std::vector<std::string> midi1PortNames;                                     // guarded by connectionMutex
+    std::atomic<bool> inputIsMidi1{false};
+    std::atomic<bool> outputIsMidi1{false};
+    Midi1ToMidi2Converter inputUpscaler;      // input callback thread only
+    Midi2ToMidi1Converter outputDownscaler;   // output thread only
+    
+    UmpEndpointDiscovery umpEndpoint;                         // guarded by umpEndpointMutex
+    std::map<std::string, UmpEndpointInfo> umpEndpointCache;  // by output device ID, guarded by umpEndpointMutex
+    std::string umpEndpointPortId;                            // guarded by umpEndpointMutex
+    mutable std::mutex umpEndpointMutex;
+    // What the senders check, updated from the discovery results
+    std::atomic<uint16_t> activeGroups{UmpEndpointDiscovery::ALL_GROUPS};
+    std::atomic<uint16_t> midiCIGroups{UmpEndpointDiscovery::ALL_GROUPS};
+    std::atomic<uint16_t> droppedGroupsReported{0};
+    std::atomic<bool> endpointIsMidi1{false};  // negotiated MIDI 1.0 protocol: translate like a MIDI 1.0 port
     
     std::function<void(bool)> midiConnectionChangedCallback;
+    std::function<void(const PortDelta&)> portsChangedCallback;
+    std::function<void()> portPairLostCallback;
+    std::function<void(const ReconnectReport&)> portPairRestoredCallback;
     std::function<void(uint32_t)> midiCIPropertiesChangedCallback;
+    MidiCIManager::PropertyRowsChangedCallback midiCIPropertyRowsChangedCallback;
     std::function<void()> midiCIDevicesChangedCallback;
-    bool initialized = false;
+    // Release-stored once midiIn, midiOut and midiCIManager are built; every public entry point
+    // checks isReady() before it touches them, as startup may still be assigning them on startupThread
+    std::atomic<bool> initialized{false};
+    std::thread startupThread;
     
     // Track outgoing SysEx messages to avoid feedback loops
     std::set<std::vector<uint8_t>> recentOutgoingSysEx;
     
     void onMidiInput(libremidi::ump&& packet);
+    void notifyPortDelta(const std::optional<PortDelta>& delta);
+    void syncPorts();
+    void handlePortRemoved(PortDirection direction, const std::string& id);
+    void handlePortAdded(PortDirection direction, const std::string& id);
+    struct ConnectionEvents;
+    void handlePortRemovedLocked(PortDirection direction, const std::string& id, ConnectionEvents& events);
+    void handlePortAddedLocked(PortDirection direction, const std::string& id, ConnectionEvents& events);
+    bool openPort(PortDirection direction, const std::string& id);
+    void applyOutputPacingLocked(const libremidi::port_information& port);
+    bool isMidi1PortLocked(const libremidi::port_information& port) const;
+    bool reconfigurePortsLocked(const std::string& inputDeviceId, const std::string& outputDeviceId,
+                                ConnectionEvents& events);
+    void bindMidiCIToPortPair(bool remoteRestarted);
+    void startEndpointDiscovery(const std::string& outputDeviceId);
+    void onUmpStreamMessage(const uint32_t* words);
+    void applyEndpointStateLocked();
+    // Removes packets for groups no active function block receives; returns false if nothing is left
+    bool dropInactiveGroups(std::vector<uint32_t>& words, uint16_t groups);
+    void saveMidiCIPropertiesForRestore();
+    void onMidiCIDevicesChanged();
+    
+    // All outgoing UMPs go through sendUmp()/submitOutput() to the output thread, which is the only
+    // caller of midiOut->send_ump(), so capture sees exactly what went over the wire
+    void sendUmp(const libremidi::ump& packet);
+    bool submitOutput(UmpLane lane, std::vector<uint32_t> words);
+    void writeOutputBatch(const uint32_t* words, size_t wordCount);  // on the output thread
+    void captureUmp(UmpCaptureDirection direction, const libremidi::ump& packet);
     
     // Helper functions for creating UMP packets
-    libremidi::ump createUmpNoteOn(int channel, int note, int velocity);
-    libremidi::ump createUmpNoteOff(int channel, int note);
+    libremidi::ump createUmpNoteOn(int group, int channel, int note, uint16_t velocity);
+    libremidi::ump createUmpNoteOff(int group, int channel, int note);
+    
+    NoteRouter noteRouter;
+    ActiveNoteTracker activeNotes;
+    DeviceStateMirror deviceState;
+    ExpressionCoalescer noteExpression;
+    float perNotePitchBendRange = 48.0f;  // MPE convention; receivers may be configured differently
     
     // MIDI-CI helper methods
-    void initializeMidiCI();
-    void processSysExForMidiCI(const std::vector<uint8_t>& sysex_data);
+    void initializeMidiCI(uint32_t muid = 0);
+    void processSysExForMidiCI(uint8_t group, const std::vector<uint8_t>& sysex_data);
     bool sendSysExViaMidi(uint8_t group, const std::vector<uint8_t>& data);
     
-    // Connection state helpers
-    void updateUIConnectionState();
-    bool previousConnectionState = false;
+    // Connection state helpers. Port changes run under connectionMutex, which the output thread
+    // takes for every batch, so they only record what happened; the discovery and callbacks run
+    // once the lock is released, where a callback may wait for output or call back in.
+    struct ConnectionEvents {
+        std::vector<bool> connectionChanges;  // each change of hasValidMidiPair(), in order
+        std::string outputDeviceId;           // the output of the last pair that connected
+        bool pairLost = false;
+        std::optional<ReconnectReport> pairRestored;
+    };
+    void updateUIConnectionState(ConnectionEvents& events);  // under connectionMutex
+    void dispatchConnectionEvents(const ConnectionEvents& events);  // without connectionMutex
+    bool previousConnectionState = false;  // guarded by connectionMutex
     
     // SysEx reconstruction state for multi-packet UMP SysEx7
     std::vector<uint8_t> sysex_buffer_;
     bool sysex_in_progress_ = false;
+    
+    // Loopback latency test state
+    struct LoopbackTestState;
+    std::unique_ptr<LoopbackTestState> loopbackState;
+    std::thread loopbackThread;
+    std::atomic<bool> loopbackActive{false};
+    void onLoopbackPing(uint16_t sequence);
+    
+    // Capture state; captureUsers counts in-flight appends so stopCapture() can unmap safely
+    std::unique_ptr<UmpCaptureRecorder> captureRecorder;
+    std::atomic<UmpCaptureRecorder*> activeCapture{nullptr};
+    std::atomic<int> captureUsers{0};
+    
+    std::atomic<bool> outputMuted{false};
+    // Live input suspension for replay; liveInputUsers counts callbacks inside onMidiInput()
+    std::atomic<bool> liveInputSuspended{false};
+    std::atomic<int> liveInputUsers{0};
+    UmpOutputQueue outputQueue;
 };
\ No newline at end of file
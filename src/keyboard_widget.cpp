@@ -2,79 +2,41 @@
 #include <QtWidgets/QSpacerItem>
 #include <QtWidgets/QGridLayout>
 #include <QtWidgets/QSlider>
+#include <QtWidgets/QFileDialog>
+#include <QtWidgets/QInputDialog>
 #include <QtCore/QThread>
 #include <QtCore/QMetaObject>
+#include <QtCore/QSignalBlocker>
+#include <QtGui/QKeyEvent>
+#include <QtGui/QGuiApplication>
+#include <QtGui/QScreen>
+#include "latency_tracker.h"
+#include "trace_recorder.h"
+#include "midi_value_scaling.h"
 #include <iostream>
+#include <algorithm>
 
-class PianoKey : public QPushButton {
-    Q_OBJECT
-public:
-    PianoKey(int note, bool isBlack = false, QWidget* parent = nullptr) 
-        : QPushButton(parent), noteValue(note), isBlackKey(isBlack) {
-        setupKey();
-    }
-    
-    int getNote() const { return noteValue; }
-    bool isBlack() const { return isBlackKey; }
-
-protected:
-    void mousePressEvent(QMouseEvent* event) override {
-        QPushButton::mousePressEvent(event);
-        emit keyPressed(noteValue);
-    }
-    
-    void mouseReleaseEvent(QMouseEvent* event) override {
-        QPushButton::mouseReleaseEvent(event);
-        emit keyReleased(noteValue);
-    }
-
-signals:
-    void keyPressed(int note);
-    void keyReleased(int note);
-
-private:
-    void setupKey() {
-        if (isBlackKey) {
-            setFixedSize(30, 80);
-            setStyleSheet(
-                "QPushButton {"
-                "  background-color: #1a1a1a;"
-                "  border: 1px solid #333;"
-                "  border-radius: 4px;"
-                "  color: white;"
-                "}"
-                "QPushButton:pressed {"
-                "  background-color: #404040;"
-                "}"
-            );
-        } else {
-            setFixedSize(50, 120);
-            setStyleSheet(
-                "QPushButton {"
-                "  background-color: white;"
-                "  border: 1px solid #333;"
-                "  border-radius: 4px;"
-                "  color: black;"
-                "}"
-                "QPushButton:pressed {"
-                "  background-color: #f0f0f0;"
-                "}"
-            );
+namespace {
+
+// Marks a selected port that went away and is kept in the list until it returns or is deselected
+constexpr int DisconnectedRole = Qt::UserRole + 1;
+
+// Drops disconnected ports other than the current one; the current port's ID does not change
+void pruneDisconnectedDevices(QComboBox* combo) {
+    QSignalBlocker blocker(combo);
+    for (int i = combo->count() - 1; i > 0; i--) {
+        if (i != combo->currentIndex() && combo->itemData(i, DisconnectedRole).toBool()) {
+            combo->removeItem(i);
         }
     }
-    
-    int noteValue;
-    bool isBlackKey;
-};
+}
+
+}  // namespace
 
 KeyboardWidget::KeyboardWidget(QWidget* parent) 
-    : QWidget(parent), pressMapper(new QSignalMapper(this)), releaseMapper(new QSignalMapper(this)), 
-      selectedDeviceMuid(0) {
+    : QWidget(parent), selectedDeviceMuid(0) {
     setupUI();
     
-    connect(pressMapper, &QSignalMapper::mappedInt, this, &KeyboardWidget::onKeyPressed);
-    connect(releaseMapper, &QSignalMapper::mappedInt, this, &KeyboardWidget::onKeyReleased);
-    
     // Timer-based updates removed - using event-driven updates instead
 }
 
@@ -135,9 +97,11 @@ void KeyboardWidget::setupUI() {
     velocityLabel->setAlignment(Qt::AlignVCenter);
     controlsLayout->addWidget(velocityLabel);
     
+    // Shows the 16-bit velocity of the last key press (set by the vertical click position)
     velocityBar = new QProgressBar();
     velocityBar->setFixedSize(200, 20);
-    velocityBar->setValue(80);
+    velocityBar->setRange(0, 65535);
+    velocityBar->setValue(0);
     velocityBar->setStyleSheet(
         "QProgressBar {"
         "  border: 1px solid gray;"
@@ -150,7 +114,77 @@ void KeyboardWidget::setupUI() {
     );
     controlsLayout->addWidget(velocityBar);
     
+    dragBendsPitchCheck = new QCheckBox("Drag bends pitch");
+    dragBendsPitchCheck->setToolTip("Dragging sideways on a key sends per-note pitch bend instead of sliding to other keys");
+    connect(dragBendsPitchCheck, &QCheckBox::toggled, this, [this](bool checked) {
+        pianoView->setDragBendsPitch(checked);
+    });
+    controlsLayout->addWidget(dragBendsPitchCheck);
+    
+    qwertyOctaveLabel = new QLabel();
+    qwertyOctaveLabel->setToolTip("Play from the computer keyboard while the piano has focus; Z/X shift the octave");
+    controlsLayout->addWidget(qwertyOctaveLabel);
+    updateQwertyOctaveLabel();
+    
+    // Coalesced per-note expression goes out at most every 5 ms per note and parameter
+    expressionTimer = new QTimer(this);
+    expressionTimer->setTimerType(Qt::PreciseTimer);
+    expressionTimer->setInterval(5);
+    connect(expressionTimer, &QTimer::timeout, this, &KeyboardWidget::flushExpression);
+    
+    // Device state is mirrored lock-free on the MIDI input thread and picked up once per frame
+    deviceStateTimer = new QTimer(this);
+    double refreshRate = QGuiApplication::primaryScreen() ? QGuiApplication::primaryScreen()->refreshRate() : 60.0;
+    deviceStateTimer->setInterval(std::max(1, static_cast<int>(1000.0 / std::max(refreshRate, 1.0))));
+    connect(deviceStateTimer, &QTimer::timeout, this, &KeyboardWidget::pollDeviceState);
+    
     controlsLayout->addStretch();
+    
+    // Latency instrumentation
+    latencyStatsButton = new QPushButton("Latency Stats");
+    latencyStatsButton->setToolTip("Print p50/p99/p99.9 latency of each send stage to the console");
+    connect(latencyStatsButton, &QPushButton::clicked, this, [this]() {
+        if (latencyStatsCallback) {
+            latencyStatsCallback();
+        }
+    });
+    controlsLayout->addWidget(latencyStatsButton);
+    
+    loopbackTestButton = new QPushButton("Loopback Test");
+    loopbackTestButton->setToolTip("Round-trip pings through the selected output -> input ports and report RTT");
+    connect(loopbackTestButton, &QPushButton::clicked, this, [this]() {
+        if (loopbackTestCallback) {
+            loopbackTestCallback();
+        }
+    });
+    controlsLayout->addWidget(loopbackTestButton);
+    
+    playFileButton = new QPushButton("Play File...");
+    playFileButton->setToolTip("Play a MIDI Clip File (.midi2) or Standard MIDI File (.mid) to the selected output");
+    connect(playFileButton, &QPushButton::clicked, this, [this]() {
+        if (playbackActive) {
+            if (stopPlaybackCallback) {
+                stopPlaybackCallback();
+            }
+            return;
+        }
+        QString path = QFileDialog::getOpenFileName(this, "Play MIDI File", QString(),
+                                                    "MIDI files (*.midi2 *.mid *.midi *.smf);;All files (*)");
+        if (!path.isEmpty() && playFileCallback) {
+            playFileCallback(path.toStdString());
+        }
+    });
+    controlsLayout->addWidget(playFileButton);
+    
+    panicButton = new QPushButton("Panic");
+    panicButton->setToolTip("Release all sounding notes and send All Sound Off / All Notes Off on every group and channel");
+    connect(panicButton, &QPushButton::clicked, this, [this]() {
+        if (panicCallback) {
+            panicCallback();
+        }
+    });
+    controlsLayout->addWidget(panicButton);
+    
     mainLayout->addLayout(controlsLayout);
 }
 
@@ -194,95 +228,109 @@ void KeyboardWidget::setupKeyboard() {
 }
 
 QWidget* KeyboardWidget::createKeyboardWidget() {
-    QWidget* container = new QWidget();
-    container->setFixedSize(850, 140);
-    
-    // Create all keys
-    struct KeyInfo {
-        int note;
-        bool isBlack;
-        QString label;
-        int whiteKeyIndex; // For positioning black keys
-    };
-    
-    // Define two octaves of keys (C4 to B5)
-    std::vector<KeyInfo> keyInfos = {
-        {60, false, "C", 0},   // C4
-        {61, true, "", 0},     // C#4 (between C and D)
-        {62, false, "D", 1},   // D4
-        {63, true, "", 1},     // D#4 (between D and E)
-        {64, false, "E", 2},   // E4
-        {65, false, "F", 3},   // F4
-        {66, true, "", 3},     // F#4 (between F and G)
-        {67, false, "G", 4},   // G4
-        {68, true, "", 4},     // G#4 (between G and A)
-        {69, false, "A", 5},   // A4
-        {70, true, "", 5},     // A#4 (between A and B)
-        {71, false, "B", 6},   // B4
-        {72, false, "C", 7},   // C5
-        {73, true, "", 7},     // C#5
-        {74, false, "D", 8},   // D5
-        {75, true, "", 8},     // D#5
-        {76, false, "E", 9},   // E5
-        {77, false, "F", 10},  // F5
-        {78, true, "", 10},    // F#5
-        {79, false, "G", 11},  // G5
-        {80, true, "", 11},    // G#5
-        {81, false, "A", 12},  // A5
-        {82, true, "", 12},    // A#5
-        {83, false, "B", 13},  // B5
-    };
-    
-    // Create white keys first
-    for (const auto& keyInfo : keyInfos) {
-        if (!keyInfo.isBlack) {
-            PianoKey* key = new PianoKey(keyInfo.note, false, container);
-            key->setText(keyInfo.label);
-            key->move(keyInfo.whiteKeyIndex * 52, 20);
-            
-            connect(key, &PianoKey::keyPressed, pressMapper, QOverload<>::of(&QSignalMapper::map));
-            connect(key, &PianoKey::keyReleased, releaseMapper, QOverload<>::of(&QSignalMapper::map));
-            pressMapper->setMapping(key, keyInfo.note);
-            releaseMapper->setMapping(key, keyInfo.note);
-            
-            whiteKeys.append(key);
-        }
-    }
+    pianoView = new PianoKeyboardView();
+    pianoView->setFixedHeight(140);
+    pianoView->setToolTip("Drag across keys for glissando; mouse wheel scrolls, Ctrl+wheel zooms");
+    // Unhandled key events propagate from the view to us, so focusing it enables QWERTY playing
+    pianoView->setFocusPolicy(Qt::StrongFocus);
     
-    // Create black keys on top
-    for (const auto& keyInfo : keyInfos) {
-        if (keyInfo.isBlack) {
-            PianoKey* key = new PianoKey(keyInfo.note, true, container);
-            
-            // Position black keys between white keys
-            int xPos = keyInfo.whiteKeyIndex * 52 + 37; // 52 is white key width + spacing, 37 centers the black key
-            key->move(xPos, 20);
-            key->raise(); // Bring black keys to front
-            
-            connect(key, &PianoKey::keyPressed, pressMapper, QOverload<>::of(&QSignalMapper::map));
-            connect(key, &PianoKey::keyReleased, releaseMapper, QOverload<>::of(&QSignalMapper::map));
-            pressMapper->setMapping(key, keyInfo.note);
-            releaseMapper->setMapping(key, keyInfo.note);
-            
-            blackKeys.append(key);
-        }
-    }
+    connect(pianoView, &PianoKeyboardView::notePressed, this, &KeyboardWidget::onKeyPressed);
+    connect(pianoView, &PianoKeyboardView::noteReleased, this, &KeyboardWidget::onKeyReleased);
+    connect(pianoView, &PianoKeyboardView::noteBendChanged, this, &KeyboardWidget::onNoteBendChanged);
+    connect(pianoView, &PianoKeyboardView::notePressureChanged, this, &KeyboardWidget::onNotePressureChanged);
     
-    return container;
+    return pianoView;
 }
 
-void KeyboardWidget::setKeyPressedCallback(std::function<void(int)> callback) {
+void KeyboardWidget::setKeyPressedCallback(std::function<void(int, uint16_t)> callback) {
     keyPressedCallback = callback;
 }
 
+void KeyboardWidget::setNoteBendCallback(std::function<void(int, float)> callback) {
+    noteBendCallback = callback;
+}
+
+void KeyboardWidget::setNotePressureCallback(std::function<void(int, float)> callback) {
+    notePressureCallback = callback;
+}
+
+void KeyboardWidget::setExpressionFlushCallback(std::function<bool()> callback) {
+    expressionFlushCallback = callback;
+}
+
 void KeyboardWidget::setKeyReleasedCallback(std::function<void(int)> callback) {
     keyReleasedCallback = callback;
 }
 
+bool KeyboardWidget::setQwertyLayout(const std::string& keys) {
+    return qwertyLayout.setLayout(keys);
+}
+
+void KeyboardWidget::setQwertyBaseNote(int note) {
+    qwertyLayout.setBaseNote(note);
+    updateQwertyOctaveLabel();
+}
+
 void KeyboardWidget::setDeviceRefreshCallback(std::function<void()> callback) {
     deviceRefreshCallback = callback;
 }
 
+void KeyboardWidget::setDeviceStatePollCallback(std::function<bool(DeviceStateChanges&)> callback) {
+    deviceStatePollCallback = callback;
+    if (deviceStatePollCallback) {
+        deviceStateTimer->start();
+    } else {
+        deviceStateTimer->stop();
+    }
+}
+
+void KeyboardWidget::pollDeviceState() {
+    deviceStateChanges.clear();
+    if (!deviceStatePollCallback || !deviceStatePollCallback(deviceStateChanges)) {
+        return;
+    }
+    
+    if (!deviceStateChanges.controls.empty()) {
+        ControlSnapshot snapshot;
+        snapshot.reserve(deviceStateChanges.controls.size());
+        for (const auto& [group, control] : deviceStateChanges.controls) {
+            snapshot.push_back(control);
+        }
+        controlListWidget->applySnapshot(snapshot);
+    }
+    for (const auto& note : deviceStateChanges.notes) {
+        pianoView->setNoteHighlighted(note.note, note.on);
+    }
+    if (deviceStateChanges.droppedParameters > 0) {
+        std::cerr << "[MIRROR] Parameter table full, dropped " << deviceStateChanges.droppedParameters << " RPN/NRPN updates" << std::endl;
+    }
+}
+
+void KeyboardWidget::setLatencyStatsCallback(std::function<void()> callback) {
+    latencyStatsCallback = callback;
+}
+
+void KeyboardWidget::setLoopbackTestCallback(std::function<void()> callback) {
+    loopbackTestCallback = callback;
+}
+
+void KeyboardWidget::setPanicCallback(std::function<void()> callback) {
+    panicCallback = callback;
+}
+
+void KeyboardWidget::setPlayFileCallback(std::function<void(const std::string&)> callback) {
+    playFileCallback = callback;
+}
+
+void KeyboardWidget::setStopPlaybackCallback(std::function<void()> callback) {
+    stopPlaybackCallback = callback;
+}
+
+void KeyboardWidget::setPlaybackActive(bool active) {
+    playbackActive = active;
+    playFileButton->setText(active ? "Stop Playback" : "Play File...");
+}
+
 void KeyboardWidget::setControlChangeCallback(std::function<void(int,int,uint32_t)> callback) {
     controlChangeCallback = callback;
 }
@@ -303,6 +351,33 @@ void KeyboardWidget::setPerNoteAftertouchCallback(std::function<void(int,int,uin
     perNoteAftertouchCallback = callback;
 }
 
+void KeyboardWidget::setControlSnapshotCallback(std::function<void(const ControlSnapshot&)> callback) {
+    controlSnapshotCallback = callback;
+}
+
+void KeyboardWidget::setPresetCallbacks(
+    std::function<std::vector<std::string>(uint32_t)> namesProvider,
+    std::function<bool(uint32_t, const std::string&, const ControlSnapshot&)> saveCallback,
+    std::function<std::optional<ControlSnapshot>(uint32_t, const std::string&, const ControlSnapshot&)> switchCallback) {
+    presetNamesProvider = namesProvider;
+    savePresetCallback = saveCallback;
+    switchPresetCallback = switchCallback;
+    refreshPresetList();
+}
+
+void KeyboardWidget::refreshPresetList() {
+    presetCombo->clear();
+    presetCombo->addItem("Presets");
+    if (presetNamesProvider && selectedDeviceMuid != 0) {
+        for (const auto& name : presetNamesProvider(selectedDeviceMuid)) {
+            presetCombo->addItem(QString::fromStdString(name));
+        }
+    }
+    bool hasDevice = selectedDeviceMuid != 0 && savePresetCallback;
+    presetCombo->setEnabled(hasDevice && presetCombo->count() > 1);
+    savePresetButton->setEnabled(hasDevice);
+}
+
 void KeyboardWidget::updateMidiDevices(
     const std::vector<std::pair<std::string, std::string>>& inputDevices,
     const std::vector<std::pair<std::string, std::string>>& outputDevices) {
@@ -324,9 +399,70 @@ void KeyboardWidget::updateMidiDevices(
     }
 }
 
-void KeyboardWidget::onKeyPressed(int note) {
+void KeyboardWidget::applyMidiDeviceDelta(const PortDelta& delta) {
+    QComboBox* combo = delta.direction == PortDirection::Input ? inputDeviceCombo : outputDeviceCombo;
+    QString id = QString::fromStdString(delta.id);
+    QString name = QString::fromStdString(delta.name);
+    int index = combo->findData(id);
+    
+    if (delta.kind == PortDelta::Kind::Added) {
+        if (index < 0) {
+            combo->addItem(name, id);
+        } else {
+            combo->setItemText(index, name);  // a selected port came back
+            combo->setItemData(index, false, DisconnectedRole);
+        }
+        return;
+    }
+    if (index < 0) {
+        return;
+    }
+    // The selected port stays selected so the controller can reopen it when it returns
+    if (combo->currentIndex() == index) {
+        combo->setItemText(index, name + " (disconnected)");
+        combo->setItemData(index, true, DisconnectedRole);
+        return;
+    }
+    combo->removeItem(index);
+}
+
+ControlSnapshot KeyboardWidget::currentControlSnapshot() const {
+    return controlListWidget->currentSnapshot();
+}
+
+void KeyboardWidget::restoreControlValuesOnReload(const ControlSnapshot& snapshot) {
+    pendingControlValues = snapshot;
+}
+
+void KeyboardWidget::onKeyPressed(int note, float velocity) {
+    auto velocity16 = static_cast<uint16_t>(std::clamp(velocity, 0.0f, 1.0f) * 65535.0f);
+    velocityBar->setValue(velocity16);
     if (keyPressedCallback) {
-        keyPressedCallback(note);
+        keyPressedCallback(note, velocity16);
+    }
+}
+
+void KeyboardWidget::onNoteBendChanged(int note, float semitones) {
+    if (noteBendCallback) {
+        noteBendCallback(note, semitones);
+        flushExpression();
+    }
+}
+
+void KeyboardWidget::onNotePressureChanged(int note, float pressure) {
+    if (notePressureCallback) {
+        notePressureCallback(note, pressure);
+        flushExpression();
+    }
+}
+
+void KeyboardWidget::flushExpression() {
+    // Anything not due yet is retried by the timer, which stops once nothing is pending
+    bool pending = expressionFlushCallback && expressionFlushCallback();
+    if (pending && !expressionTimer->isActive()) {
+        expressionTimer->start();
+    } else if (!pending && expressionTimer->isActive()) {
+        expressionTimer->stop();
     }
 }
 
@@ -336,9 +472,111 @@ void KeyboardWidget::onKeyReleased(int note) {
     }
 }
 
+void KeyboardWidget::setFirstPaintCallback(std::function<void()> callback) {
+    firstPaintCallback = callback;
+}
+
+void KeyboardWidget::paintEvent(QPaintEvent* event) {
+    QWidget::paintEvent(event);
+    if (firstPaintCallback) {
+        auto callback = std::move(firstPaintCallback);
+        firstPaintCallback = nullptr;
+        callback();
+    }
+}
+
+void KeyboardWidget::keyPressEvent(QKeyEvent* event) {
+    // Held keys auto-repeat as press/release pairs; the note is already sounding
+    if (event->isAutoRepeat()) {
+        if (qwertyLayout.isMapped(event->key())) {
+            event->accept();
+            return;
+        }
+        QWidget::keyPressEvent(event);
+        return;
+    }
+    if (event->modifiers() & (Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier)) {
+        QWidget::keyPressEvent(event);
+        return;
+    }
+    
+    if (event->key() == QwertyLayout::OCTAVE_DOWN_KEY || event->key() == QwertyLayout::OCTAVE_UP_KEY) {
+        qwertyLayout.shiftOctave(event->key() == QwertyLayout::OCTAVE_UP_KEY ? 1 : -1);
+        updateQwertyOctaveLabel();
+        event->accept();
+        return;
+    }
+    
+    auto note = qwertyLayout.press(event->key());
+    if (!note) {
+        QWidget::keyPressEvent(event);
+        return;
+    }
+    LatencyTracker::instance().markKeyEvent();
+    
+    // Send first; the velocity bar and key highlight are repainted after the note is out
+    uint16_t velocity = static_cast<uint16_t>(velocityBar->value());
+    if (velocity == 0) {
+        velocity = midi7To16(100);
+    }
+    if (keyPressedCallback) {
+        keyPressedCallback(*note, velocity);
+    }
+    pianoView->setNoteHighlighted(*note, true);
+    event->accept();
+}
+
+void KeyboardWidget::keyReleaseEvent(QKeyEvent* event) {
+    if (event->isAutoRepeat()) {
+        if (qwertyLayout.isMapped(event->key())) {
+            event->accept();
+            return;
+        }
+        QWidget::keyReleaseEvent(event);
+        return;
+    }
+    
+    auto note = qwertyLayout.release(event->key());
+    if (!note) {
+        QWidget::keyReleaseEvent(event);
+        return;
+    }
+    
+    LatencyTracker::instance().markKeyEvent();
+    if (keyReleasedCallback) {
+        keyReleasedCallback(*note);
+    }
+    pianoView->setNoteHighlighted(*note, false);
+    event->accept();
+}
+
+void KeyboardWidget::changeEvent(QEvent* event) {
+    // Key releases that happen while another window is active never reach us
+    if (event->type() == QEvent::ActivationChange && !isActiveWindow()) {
+        releaseQwertyNotes();
+    }
+    QWidget::changeEvent(event);
+}
+
+void KeyboardWidget::releaseQwertyNotes() {
+    for (int note : qwertyLayout.releaseAll()) {
+        if (keyReleasedCallback) {
+            keyReleasedCallback(note);
+        }
+        pianoView->setNoteHighlighted(note, false);
+    }
+}
+
+void KeyboardWidget::updateQwertyOctaveLabel() {
+    static const char* names[] = {"C", "C#", "D", "D#", "E", "F", "F#", "G", "G#", "A", "A#", "B"};
+    int base = qwertyLayout.baseNote();
+    qwertyOctaveLabel->setText(QString("QWERTY: %1%2").arg(names[base % 12]).arg(base / 12 - 1));
+}
+
 void KeyboardWidget::onInputDeviceChanged(int index) {
     if (index >= 0) {
         QString deviceId = inputDeviceCombo->itemData(index).toString();
+        pruneDisconnectedDevices(inputDeviceCombo);
         emit midiInputDeviceChanged(deviceId);
     }
 }
@@ -346,6 +584,7 @@ void KeyboardWidget::onInputDeviceChanged(int index) {
 void KeyboardWidget::onOutputDeviceChanged(int index) {
     if (index >= 0) {
         QString deviceId = outputDeviceCombo->itemData(index).toString();
+        pruneDisconnectedDevices(outputDeviceCombo);
         emit midiOutputDeviceChanged(deviceId);
     }
 }
@@ -432,6 +671,54 @@ void KeyboardWidget::setupPropertiesPanel() {
     refreshPropertiesButton->setToolTip("Click to request properties again (forces new requests)");
     connect(refreshPropertiesButton, &QPushButton::clicked, this, &KeyboardWidget::refreshProperties);
     headerLayout->addWidget(refreshPropertiesButton);
+    
+    sendAllControlsButton = new QPushButton("Send All Controls");
+    sendAllControlsButton->setMaximumWidth(150);
+    sendAllControlsButton->setToolTip("Send the current value of every CC/RPN/NRPN control in one paced burst (restores device state)");
+    connect(sendAllControlsButton, &QPushButton::clicked, this, [this]() {
+        auto snapshot = controlListWidget->currentSnapshot();
+        if (snapshot.empty()) {
+            std::cout << "[SNAPSHOT] No controls to send" << std::endl;
+            return;
+        }
+        if (controlSnapshotCallback) {
+            controlSnapshotCallback(snapshot);
+        }
+    });
+    headerLayout->addWidget(sendAllControlsButton);
+    
+    presetCombo = new QComboBox();
+    presetCombo->setMinimumWidth(150);
+    presetCombo->setToolTip("Switch to a saved preset; only controls whose value differs are sent");
+    connect(presetCombo, QOverload<int>::of(&QComboBox::activated), this, [this](int index) {
+        if (index <= 0 || !switchPresetCallback) {
+            return;
+        }
+        auto changes = switchPresetCallback(selectedDeviceMuid, presetCombo->itemText(index).toStdString(),
+                                            controlListWidget->currentSnapshot());
+        if (changes) {
+            controlListWidget->applySnapshot(*changes);
+        }
+    });
+    headerLayout->addWidget(presetCombo);
+    
+    savePresetButton = new QPushButton("Save Preset...");
+    savePresetButton->setMaximumWidth(120);
+    connect(savePresetButton, &QPushButton::clicked, this, [this]() {
+        if (!savePresetCallback) {
+            return;
+        }
+        bool ok = false;
+        QString name = QInputDialog::getText(this, "Save Preset", "Preset name:", QLineEdit::Normal,
+                                             presetCombo->currentIndex() > 0 ? presetCombo->currentText() : QString(), &ok);
+        if (ok && !name.trimmed().isEmpty() &&
+            savePresetCallback(selectedDeviceMuid, name.trimmed().toStdString(), controlListWidget->currentSnapshot())) {
+            refreshPresetList();
+            presetCombo->setCurrentText(name.trimmed());
+        }
+    });
+    headerLayout->addWidget(savePresetButton);
+    refreshPresetList();
     propertiesLayout->addLayout(headerLayout);
     
     // Create horizontal layout for the two property lists
@@ -684,7 +971,30 @@ void KeyboardWidget::updateProperties(uint32_t muid) {
     updatePropertiesOnMainThread(muid);
 }
 
+namespace {
+
+// Format: title [bank:PC = X:Y:Z]
+QString programDisplayText(const midicci::commonproperties::MidiCIProgram& prog) {
+    QString title = QString::fromStdString(prog.title);
+    if (prog.bankPC.size() >= 3) {
+        return QString("%1 [bank:PC = %2:%3:%4]")
+               .arg(title)
+               .arg(prog.bankPC[0])
+               .arg(prog.bankPC[1])
+               .arg(prog.bankPC[2]);
+    }
+    return title;
+}
+
+}  // namespace
+
 void KeyboardWidget::updatePropertiesOnMainThread(uint32_t muid) {
+    TraceSpan trace("updatePropertiesOnMainThread", "ui");
+    updateControlList(muid);
+    updateProgramList(muid);
+}
+
+void KeyboardWidget::updateControlList(uint32_t muid) {
     // Update control list using virtualized widget
     if (ctrlListProvider) {
         auto controls_opt = ctrlListProvider(muid);
@@ -696,10 +1006,16 @@ void KeyboardWidget::updatePropertiesOnMainThread(uint32_t muid) {
             auto controls = controls_opt.value();
             controlListWidget->setControls(controls);
             controlListWidget->setEnabled(!controls.empty());
+            if (!controls.empty() && !pendingControlValues.empty()) {
+                controlListWidget->applySnapshot(pendingControlValues);
+                pendingControlValues.clear();
+            }
         }
+        refreshPresetList();
     }
-    
-    // Update program list
+}
+
+void KeyboardWidget::updateProgramList(uint32_t muid) {
     if (programListProvider) {
         auto programs_opt = programListProvider(muid);
         programListWidget->clear();
@@ -715,30 +1031,42 @@ void KeyboardWidget::updatePropertiesOnMainThread(uint32_t muid) {
             } else {
                 programListWidget->setEnabled(true);
                 for (const auto& prog : programs) {
-                    QString displayText;
-                    
-                    // Format: title [bank:PC = X:Y:Z]
-                    QString title = QString::fromStdString(prog.title);
-                    
-                    if (prog.bankPC.size() >= 3) {
-                        displayText = QString("%1 [bank:PC = %2:%3:%4]")
-                                     .arg(title)
-                                     .arg(prog.bankPC[0])
-                                     .arg(prog.bankPC[1])
-                                     .arg(prog.bankPC[2]);
-                    } else {
-                        displayText = title;
-                    }
-                    
-                    programListWidget->addItem(displayText);
+                    programListWidget->addItem(programDisplayText(prog));
+                }
+            }
+        }
+    }
+}
+
+void KeyboardWidget::onPropertyRowsUpdated(uint32_t muid, const PropertyRowUpdate& update) {
+    if (muid != selectedDeviceMuid) {
+        return;
+    }
+    TraceSpan trace("onPropertyRowsUpdated", "ui");
+    
+    using midicci::commonproperties::StandardPropertyNames;
+    if (update.resource == StandardPropertyNames::ALL_CTRL_LIST) {
+        auto controls = ctrlListProvider ? ctrlListProvider(muid) : std::nullopt;
+        if (update.reset || !controls) {
+            updateControlList(muid);
+        } else {
+            controlListWidget->updateControlRows(*controls, update.rows);
+        }
+    } else if (update.resource == StandardPropertyNames::PROGRAM_LIST) {
+        auto programs = programListProvider ? programListProvider(muid) : std::nullopt;
+        if (update.reset || !programs || static_cast<int>(programs->size()) != programListWidget->count()) {
+            updateProgramList(muid);
+        } else {
+            for (size_t row : update.rows) {
+                if (row < programs->size()) {
+                    programListWidget->item(static_cast<int>(row))->setText(programDisplayText((*programs)[row]));
                 }
             }
         }
     }
+    // ChCtrlList is subscribed for the cache but not shown
 }
 
 void KeyboardWidget::onPropertiesUpdated(uint32_t muid) {
     updateProperties(muid);
 }
-
-#include "keyboard_widget.moc"
\ No newline at end of file
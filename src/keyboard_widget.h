@@ -10,13 +10,15 @@
 #include <QtWidgets/QGroupBox>
 #include <QtWidgets/QListWidget>
 #include <QtWidgets/QSplitter>
-#include <QtCore/QSignalMapper>
+#include <QtWidgets/QCheckBox>
 #include <QtCore/QTimer>
 #include <functional>
 #include "midi_ci_manager.h"
 #include "virtualized_control_list.h"
-
-class PianoKey;
+#include "piano_keyboard_view.h"
+#include "qwerty_layout.h"
+#include "device_state_mirror.h"
+#include "port_registry.h"
 
 class KeyboardWidget : public QWidget {
     Q_OBJECT
@@ -24,19 +26,61 @@ class KeyboardWidget : public QWidget {
 public:
     explicit KeyboardWidget(QWidget* parent = nullptr);
     
-    void setKeyPressedCallback(std::function<void(int)> callback);
+    void setKeyPressedCallback(std::function<void(int, uint16_t)> callback); // note, 16-bit velocity
     void setKeyReleasedCallback(std::function<void(int)> callback);
+    
+    // Per-note expression: bend in semitones, pressure 0..1. The flush callback is polled by a
+    // timer while expression is moving and returns true as long as updates are still pending.
+    void setNoteBendCallback(std::function<void(int, float)> callback);
+    void setNotePressureCallback(std::function<void(int, float)> callback);
+    void setExpressionFlushCallback(std::function<bool()> callback);
     void setDeviceRefreshCallback(std::function<void()> callback);
     
+    // Polled at display refresh rate; fills in device-side changes (controls already filtered to
+    // the ones the control list shows) and returns true if there were any
+    void setDeviceStatePollCallback(std::function<bool(DeviceStateChanges&)> callback);
+    // Called once, after the widget has painted for the first time (startup instrumentation)
+    void setFirstPaintCallback(std::function<void()> callback);
+    
+    // Computer-keyboard playing; see QwertyLayout for the layout string format
+    bool setQwertyLayout(const std::string& keys);
+    void setQwertyBaseNote(int note);
+    
+    // Latency instrumentation callbacks
+    void setLatencyStatsCallback(std::function<void()> callback);
+    void setLoopbackTestCallback(std::function<void()> callback);
+    void setPanicCallback(std::function<void()> callback);
+    
+    // File playback: the play callback receives the chosen file, stop is used while playback is active
+    void setPlayFileCallback(std::function<void(const std::string&)> callback);
+    void setStopPlaybackCallback(std::function<void()> callback);
+    void setPlaybackActive(bool active);
+    
     // Control change callbacks
     void setControlChangeCallback(std::function<void(int,int,uint32_t)> callback); // channel, controller, value
     void setRPNCallback(std::function<void(int,int,int,uint32_t)> callback); // channel, msb, lsb, value
     void setNRPNCallback(std::function<void(int,int,int,uint32_t)> callback); // channel, msb, lsb, value
     void setPerNoteControlCallback(std::function<void(int,int,int,uint32_t)> callback); // channel, note, controller, value
     void setPerNoteAftertouchCallback(std::function<void(int,int,uint32_t)> callback); // channel, note, value
+    // Receives the stored value of every control when "Send All Controls" is clicked
+    void setControlSnapshotCallback(std::function<void(const ControlSnapshot&)> callback);
+    
+    // Presets of the selected device (by MUID): list names, save the current values under a name,
+    // and switch to a preset, which returns the controls that differ from the current values
+    void setPresetCallbacks(std::function<std::vector<std::string>(uint32_t)> namesProvider,
+                            std::function<bool(uint32_t, const std::string&, const ControlSnapshot&)> saveCallback,
+                            std::function<std::optional<ControlSnapshot>(uint32_t, const std::string&, const ControlSnapshot&)> switchCallback);
     
     void updateMidiDevices(const std::vector<std::pair<std::string, std::string>>& inputDevices,
                           const std::vector<std::pair<std::string, std::string>>& outputDevices);
+    // Adds or removes one port without rebuilding the lists; repeated deltas are harmless.
+    // A selected port that goes away is kept and shown as disconnected.
+    void applyMidiDeviceDelta(const PortDelta& delta);
+    // Stored values of the controls shown for the selected MIDI-CI device
+    ControlSnapshot currentControlSnapshot() const;
+    // Shows these values instead of the defaults the next time the control list is reloaded
+    // (after a replug, the values were resent to the device before its lists came back)
+    void restoreControlValuesOnReload(const ControlSnapshot& snapshot);
     
     // MIDI-CI UI methods
     void updateMidiCIStatus(bool initialized, uint32_t muid, const std::string& deviceName);
@@ -55,7 +99,11 @@ signals:
     void midiOutputDeviceChanged(const QString& deviceId);
 
 private slots:
-    void onKeyPressed(int note);
+    void onKeyPressed(int note, float velocity);
+    void onNoteBendChanged(int note, float semitones);
+    void onNotePressureChanged(int note, float pressure);
+    void flushExpression();
+    void pollDeviceState();
     void onKeyReleased(int note);
     void onInputDeviceChanged(int index);
     void onOutputDeviceChanged(int index);
@@ -66,6 +114,14 @@ private slots:
 
 public slots:
     void onPropertiesUpdated(uint32_t muid);
+    void onPropertyRowsUpdated(uint32_t muid, const PropertyRowUpdate& update);  // subscribed lists, rows only
+
+protected:
+    // QWERTY key events bypass signal/slot dispatch and call the note callbacks directly
+    void keyPressEvent(QKeyEvent* event) override;
+    void keyReleaseEvent(QKeyEvent* event) override;
+    void paintEvent(QPaintEvent* event) override;
+    void changeEvent(QEvent* event) override;
 
 private:
     void setupUI();
@@ -74,11 +130,26 @@ private:
     void setupMidiCIControls();
     void setupPropertiesPanel();
     QWidget* createKeyboardWidget();
+    void releaseQwertyNotes();
+    void updateQwertyOctaveLabel();
+    void refreshPresetList();
+    void updateControlList(uint32_t muid);
+    void updateProgramList(uint32_t muid);
     
-    std::function<void(int)> keyPressedCallback;
+    std::function<void(int, uint16_t)> keyPressedCallback;
+    std::function<void(int, float)> noteBendCallback;
+    std::function<void(int, float)> notePressureCallback;
+    std::function<bool()> expressionFlushCallback;
     std::function<void(int)> keyReleasedCallback;
     std::function<void()> deviceRefreshCallback;
+    std::function<bool(DeviceStateChanges&)> deviceStatePollCallback;
+    std::function<void()> firstPaintCallback;
     std::function<void()> midiCIDiscoveryCallback;
+    std::function<void()> latencyStatsCallback;
+    std::function<void()> loopbackTestCallback;
+    std::function<void(const std::string&)> playFileCallback;
+    std::function<void()> stopPlaybackCallback;
+    std::function<void()> panicCallback;
     
     // Control change callbacks
     std::function<void(int,int,int)> controlChangeCallback;
@@ -86,6 +157,10 @@ private:
     std::function<void(int,int,int,int)> nrpnCallback;
     std::function<void(int,int,int,int)> perNoteControlCallback;
     std::function<void(int,int,int)> perNoteAftertouchCallback;
+    std::function<void(const ControlSnapshot&)> controlSnapshotCallback;
+    std::function<std::vector<std::string>(uint32_t)> presetNamesProvider;
+    std::function<bool(uint32_t, const std::string&, const ControlSnapshot&)> savePresetCallback;
+    std::function<std::optional<ControlSnapshot>(uint32_t, const std::string&, const ControlSnapshot&)> switchPresetCallback;
     std::function<MidiCIDeviceInfo*(uint32_t)> midiCIDeviceProvider;
     std::function<std::optional<std::vector<midicci::commonproperties::MidiCIControl>>(uint32_t)> ctrlListProvider;
     std::function<std::optional<std::vector<midicci::commonproperties::MidiCIProgram>>(uint32_t)> programListProvider;
@@ -101,6 +176,17 @@ private:
     QLabel* titleLabel;
     QLabel* velocityLabel;
     QProgressBar* velocityBar;
+    QCheckBox* dragBendsPitchCheck;
+    QLabel* qwertyOctaveLabel;
+    QTimer* expressionTimer;
+    QTimer* deviceStateTimer;
+    DeviceStateChanges deviceStateChanges;  // reused between polls
+    ControlSnapshot pendingControlValues;   // applied on the next control list reload
+    QPushButton* latencyStatsButton;
+    QPushButton* loopbackTestButton;
+    QPushButton* playFileButton;
+    QPushButton* panicButton;
+    bool playbackActive = false;
     
     // MIDI-CI UI elements
     QGroupBox* midiCIGroup;
@@ -115,14 +201,14 @@ private:
     QSplitter* mainSplitter;
     QGroupBox* propertiesGroup;
     QPushButton* refreshPropertiesButton;
+    QPushButton* sendAllControlsButton;
+    QComboBox* presetCombo;
+    QPushButton* savePresetButton;
     VirtualizedControlList* controlListWidget;
     QListWidget* programListWidget;
     
     uint32_t selectedDeviceMuid;
     
-    QList<PianoKey*> whiteKeys;
-    QList<PianoKey*> blackKeys;
-    
-    QSignalMapper* pressMapper;
-    QSignalMapper* releaseMapper;
+    PianoKeyboardView* pianoView;
+    QwertyLayout qwertyLayout;
 };
\ No newline at end of file
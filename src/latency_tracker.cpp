@@ -0,0 +1,220 @@
+#include "latency_tracker.h"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+
+LatencyHistogram::LatencyHistogram() {
+    reset();
+}
+
+size_t LatencyHistogram::bucketIndex(uint64_t value) {
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<size_t>(value);
+    }
+    // value >> shift lands in [SUB_BUCKET_COUNT, 2 * SUB_BUCKET_COUNT)
+    int magnitude = std::bit_width(value) - 1;
+    int shift = magnitude - SUB_BUCKET_BITS;
+    uint64_t sub = (value >> shift) - SUB_BUCKET_COUNT;
+    return static_cast<size_t>(SUB_BUCKET_COUNT + static_cast<uint64_t>(shift) * SUB_BUCKET_COUNT + sub);
+}
+
+uint64_t LatencyHistogram::bucketUpperBound(size_t index) {
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+    uint64_t shift = (index - SUB_BUCKET_COUNT) / SUB_BUCKET_COUNT;
+    uint64_t sub = (index - SUB_BUCKET_COUNT) % SUB_BUCKET_COUNT;
+    uint64_t lower = (SUB_BUCKET_COUNT + sub) << shift;
+    uint64_t width = 1ULL << shift;
+    // The topmost bucket would overflow; saturate instead
+    if (lower > std::numeric_limits<uint64_t>::max() - width) {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    return lower + width - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds) {
+    buckets_[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t current = min_.load(std::memory_order_relaxed);
+    while (nanoseconds < current && !min_.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed)) {}
+    current = max_.load(std::memory_order_relaxed);
+    while (nanoseconds > current && !max_.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed)) {}
+}
+
+void LatencyHistogram::reset() {
+    for (auto& bucket : buckets_) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    min_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::count() const {
+    return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::min() const {
+    return count() == 0 ? 0 : min_.load(std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::max() const {
+    return max_.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return n == 0 ? 0.0 : static_cast<double>(sum_.load(std::memory_order_relaxed)) / static_cast<double>(n);
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const {
+    uint64_t total = count();
+    if (total == 0) {
+        return 0;
+    }
+
+    percent = std::clamp(percent, 0.0, 100.0);
+    uint64_t target = static_cast<uint64_t>(std::ceil(percent / 100.0 * static_cast<double>(total)));
+    if (target == 0) {
+        target = 1;
+    }
+
+    uint64_t cumulative = 0;
+    for (size_t i = 0; i < BUCKET_COUNT; i++) {
+        cumulative += buckets_[i].load(std::memory_order_relaxed);
+        if (cumulative >= target) {
+            // Report the highest value equivalent to this bucket, but never beyond what was seen
+            return std::min(bucketUpperBound(i), max());
+        }
+    }
+    return max();
+}
+
+void LatencyProbe::stamp(LatencyStage stage) {
+    stamp(stage, LatencyTracker::now());
+}
+
+void LatencyProbe::stamp(LatencyStage stage, int64_t nanoseconds) {
+    stamps[static_cast<size_t>(stage)] = nanoseconds;
+}
+
+LatencyTracker& LatencyTracker::instance() {
+    static LatencyTracker tracker;
+    return tracker;
+}
+
+LatencyTracker::LatencyTracker()
+    : enabled_(true), pending_ui_event_(0), pending_key_event_(0) {
+}
+
+int64_t LatencyTracker::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void LatencyTracker::setEnabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+bool LatencyTracker::isEnabled() const {
+    return enabled_.load(std::memory_order_relaxed);
+}
+
+void LatencyTracker::markUiEvent() {
+    if (!isEnabled()) return;
+    pending_ui_event_.store(now(), std::memory_order_relaxed);
+}
+
+void LatencyTracker::markKeyEvent() {
+    if (!isEnabled()) return;
+    pending_key_event_.store(now(), std::memory_order_relaxed);
+}
+
+LatencyProbe LatencyTracker::begin() {
+    LatencyProbe probe;
+    if (!isEnabled()) return probe;
+
+    // A UI stamp belongs to exactly one controller call; scripted notes have none
+    int64_t ui = pending_ui_event_.exchange(0, std::memory_order_relaxed);
+    if (ui != 0) {
+        probe.stamp(LatencyStage::UiEvent, ui);
+    }
+    int64_t key = pending_key_event_.exchange(0, std::memory_order_relaxed);
+    if (key != 0) {
+        probe.stamp(LatencyStage::KeyEvent, key);
+    }
+    probe.stamp(LatencyStage::ControllerEntry);
+    return probe;
+}
+
+void LatencyTracker::commit(const LatencyProbe& probe) {
+    if (!isEnabled()) return;
+
+    auto interval = [&probe](LatencyStage from, LatencyStage to) -> int64_t {
+        if (!probe.has(from) || !probe.has(to)) return -1;
+        return probe.at(to) - probe.at(from);
+    };
+    auto add = [this](LatencyInterval which, int64_t ns) {
+        if (ns >= 0) recordInterval(which, static_cast<uint64_t>(ns));
+    };
+
+    add(LatencyInterval::UiToController, interval(LatencyStage::UiEvent, LatencyStage::ControllerEntry));
+    add(LatencyInterval::ControllerToEncode, interval(LatencyStage::ControllerEntry, LatencyStage::Encode));
+    add(LatencyInterval::EncodeToQueue, interval(LatencyStage::Encode, LatencyStage::Queue));
+    add(LatencyInterval::UiToQueue, interval(LatencyStage::UiEvent, LatencyStage::Queue));
+    add(LatencyInterval::KeyToQueue, interval(LatencyStage::KeyEvent, LatencyStage::Queue));
+    add(LatencyInterval::ControllerToQueue, interval(LatencyStage::ControllerEntry, LatencyStage::Queue));
+    add(LatencyInterval::LoopbackRoundTrip, interval(LatencyStage::Queue, LatencyStage::LoopbackReceive));
+}
+
+void LatencyTracker::recordInterval(LatencyInterval interval, uint64_t nanoseconds) {
+    histograms_[static_cast<size_t>(interval)].record(nanoseconds);
+}
+
+const LatencyHistogram& LatencyTracker::histogram(LatencyInterval interval) const {
+    return histograms_[static_cast<size_t>(interval)];
+}
+
+void LatencyTracker::reset() {
+    for (auto& histogram : histograms_) {
+        histogram.reset();
+    }
+}
+
+const char* LatencyTracker::intervalName(LatencyInterval interval) {
+    switch (interval) {
+        case LatencyInterval::UiToController: return "ui->controller";
+        case LatencyInterval::ControllerToEncode: return "controller->encode";
+        case LatencyInterval::EncodeToQueue: return "encode->queue";
+        case LatencyInterval::UiToQueue: return "ui->queue";
+        case LatencyInterval::KeyToQueue: return "key->queue";
+        case LatencyInterval::ControllerToQueue: return "controller->queue";
+        case LatencyInterval::QueueToWire: return "queue->wire";
+        case LatencyInterval::LoopbackRoundTrip: return "loopback rtt";
+        default: return "unknown";
+    }
+}
+
+void LatencyTracker::dump(std::ostream& out) const {
+    auto us = [](uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+
+    out << "[LATENCY] " << std::left << std::setw(20) << "interval" << std::right
+        << std::setw(10) << "count" << std::setw(12) << "p50(us)" << std::setw(12) << "p99(us)"
+        << std::setw(12) << "p99.9(us)" << std::setw(12) << "max(us)" << std::endl;
+
+    for (size_t i = 0; i < histograms_.size(); i++) {
+        const auto& h = histograms_[i];
+        out << "[LATENCY] " << std::left << std::setw(20) << intervalName(static_cast<LatencyInterval>(i)) << std::right
+            << std::setw(10) << h.count() << std::fixed << std::setprecision(1)
+            << std::setw(12) << us(h.percentile(50.0))
+            << std::setw(12) << us(h.percentile(99.0))
+            << std::setw(12) << us(h.percentile(99.9))
+            << std::setw(12) << us(h.max()) << std::defaultfloat << std::endl;
+    }
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Log-linear latency histogram in the spirit of HdrHistogram.
+// Values (in nanoseconds) are grouped by power of two, and each power is split
+// into SUB_BUCKET_COUNT linear sub-buckets, so the relative error of any reported
+// percentile stays below 1/SUB_BUCKET_COUNT over the whole 64-bit range.
+// record() is a handful of relaxed atomic operations and is safe to call from any thread.
+class LatencyHistogram {
+public:
+    static constexpr int SUB_BUCKET_BITS = 5;
+    static constexpr uint64_t SUB_BUCKET_COUNT = 1ULL << SUB_BUCKET_BITS;
+    static constexpr size_t BUCKET_COUNT = SUB_BUCKET_COUNT + (64 - SUB_BUCKET_BITS) * SUB_BUCKET_COUNT;
+
+    LatencyHistogram();
+
+    void record(uint64_t nanoseconds);
+    void reset();
+
+    uint64_t count() const;
+    uint64_t min() const;
+    uint64_t max() const;
+    double mean() const;
+    uint64_t percentile(double percent) const;  // percent in [0, 100], result in nanoseconds
+
+    static size_t bucketIndex(uint64_t value);
+    static uint64_t bucketUpperBound(size_t index);
+
+private:
+    std::array<std::atomic<uint64_t>, BUCKET_COUNT> buckets_;
+    std::atomic<uint64_t> count_;
+    std::atomic<uint64_t> sum_;
+    std::atomic<uint64_t> min_;
+    std::atomic<uint64_t> max_;
+};
+
+// Stages a note (or any outgoing UMP) goes through on its way out of the app.
+enum class LatencyStage {
+    UiEvent = 0,        // pointer event entered the piano view
+    KeyEvent,           // computer-keyboard event entered the widget
+    ControllerEntry,    // KeyboardController API was called
+    Encode,             // UMP packet was built
+    Queue,              // handed to the output queue; the writer thread sends it (see QueueToWire)
+    LoopbackReceive,    // the packet came back through onMidiInput (loopback test)
+    Count
+};
+
+// Intervals between stages that are accumulated into histograms.
+enum class LatencyInterval {
+    UiToController = 0,
+    ControllerToEncode,
+    EncodeToQueue,
+    UiToQueue,
+    KeyToQueue,
+    ControllerToQueue,
+    QueueToWire,        // realtime batch submitted -> midiOut->send_ump() returned on the writer thread
+    LoopbackRoundTrip,
+    Count
+};
+
+// Per-operation stamp set. It lives on the stack of the thread doing the send,
+// so no synchronization is needed until it is committed to the tracker.
+struct LatencyProbe {
+    std::array<int64_t, static_cast<size_t>(LatencyStage::Count)> stamps{};
+
+    void stamp(LatencyStage stage);
+    void stamp(LatencyStage stage, int64_t nanoseconds);
+    bool has(LatencyStage stage) const { return stamps[static_cast<size_t>(stage)] != 0; }
+    int64_t at(LatencyStage stage) const { return stamps[static_cast<size_t>(stage)]; }
+};
+
+// Process-wide latency instrumentation.
+// The UI stamps the moment an input event arrives with markUiEvent(); the controller
+// picks that stamp up in begin() so the whole UI -> send path is measured even though
+// the widget and the controller do not know about each other. QWERTY key events use
+// markKeyEvent() instead so their path is reported separately from pointer input.
+class LatencyTracker {
+public:
+    static LatencyTracker& instance();
+
+    static int64_t now();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const;
+
+    void markUiEvent();
+    void markKeyEvent();
+    LatencyProbe begin();
+    void commit(const LatencyProbe& probe);
+    void recordInterval(LatencyInterval interval, uint64_t nanoseconds);
+
+    const LatencyHistogram& histogram(LatencyInterval interval) const;
+    void reset();
+
+    void dump(std::ostream& out) const;
+    static const char* intervalName(LatencyInterval interval);
+
+private:
+    LatencyTracker();
+
+    std::atomic<bool> enabled_;
+    std::atomic<int64_t> pending_ui_event_;
+    std::atomic<int64_t> pending_key_event_;
+    std::array<LatencyHistogram, static_cast<size_t>(LatencyInterval::Count)> histograms_;
+};
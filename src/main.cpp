@@ -1,20 +1,167 @@
 
 #include <QtWidgets/QApplication>
 #include <QMetaObject>
+#include <QCommandLineParser>
+#include <QStandardPaths>
+#include <QTimer>
 #include "keyboard_widget.h"
 #include "keyboard_controller.h"
+#include "ump_replay.h"
+#include "midi_clip_player.h"
+#include "control_snapshot.h"
+#include "preset_store.h"
+#include "metrics_exporter.h"
+#include "trace_recorder.h"
+#include "startup_profiler.h"
+#include "notification_bus.h"
+#include "realtime_config.h"
 #include <iostream>
 
 int main(int argc, char** argv) {
+    StartupProfiler::instance().mark("main");
     QApplication app(argc, argv);
     
+    QCommandLineParser parser;
+    parser.setApplicationDescription("MIDI 2.0 UMP keyboard for MIDI 2.0 device testing");
+    parser.addHelpOption();
+    QCommandLineOption captureOption("capture", "Record every incoming/outgoing UMP into <file> (ring buffer).", "file");
+    QCommandLineOption captureRecordsOption("capture-records", "Capacity of the capture ring in UMP records.", "count",
+                                            QString::number(UmpCaptureRecorder::DEFAULT_CAPACITY));
+    QCommandLineOption replayOption("replay", "Replay the incoming side of a capture file headless, then exit.", "file");
+    QCommandLineOption replaySpeedOption("replay-speed", "Replay timing: 'original', 'max' or a speed factor (e.g. 4).", "speed", "max");
+    QCommandLineOption replayExpectOption("replay-expect", "Compare MIDI-CI state after replay against an expectation file.", "file");
+    QCommandLineOption replayWriteOption("replay-write-expectation", "Write MIDI-CI state after replay to an expectation file.", "file");
+    QCommandLineOption zonesOption("zones", "Keyboard zones as low-high:group/channel[:transpose],... (group and channel 1-16).", "spec");
+    QCommandLineOption controlGroupOption("control-group", "Group (1-16) for controller, RPN/NRPN and per-note messages.", "group", "1");
+    QCommandLineOption qwertyLayoutOption("qwerty-layout", "Computer-keyboard keys that play consecutive semitones from the base note.", "keys",
+                                          QwertyLayout::DEFAULT_LAYOUT);
+    QCommandLineOption qwertyBaseOption("qwerty-base", "MIDI note played by the first key of the QWERTY layout.", "note",
+                                        QString::number(QwertyLayout::DEFAULT_BASE_NOTE));
+    QCommandLineOption metricsFileOption("metrics-file", "Rewrite MIDI-CI metrics in Prometheus text format to <file> every second.", "file");
+    QCommandLineOption metricsPortOption("metrics-port", "Serve MIDI-CI metrics for Prometheus on 127.0.0.1:<port>.", "port");
+    QCommandLineOption noAutoReconnectOption("no-auto-reconnect", "Leave the ports closed when the selected MIDI device is unplugged and plugged back.");
+    QCommandLineOption outputPacingOption("output-pacing", "Pace output ports whose name contains <port> ('*' = all): "
+                                          "<port>=din|ble|voice=<bytes/s>[/<burst>],bulk=<bytes/s>[/<burst>]. Repeatable.", "rule");
+    QCommandLineOption midi1PortOption("midi1-port", "Ports whose name contains <port> ('*' = all) speak MIDI 1.0 protocol; "
+                                       "translate channel voice messages to and from MIDI 2.0. Repeatable.", "port");
+    QCommandLineOption realtimeOption("realtime", "Run MIDI I/O threads real-time as fifo|rr[:priority][@cpu,...] (e.g. fifo:80@2,3), lock memory and pre-fault buffers.", "spec");
+    QCommandLineOption traceOption("trace", "Record a timeline of MIDI and UI work and write it as Chrome trace JSON to <file> on exit.", "file");
+    parser.addOption(captureOption);
+    parser.addOption(captureRecordsOption);
+    parser.addOption(replayOption);
+    parser.addOption(replaySpeedOption);
+    parser.addOption(replayExpectOption);
+    parser.addOption(replayWriteOption);
+    parser.addOption(zonesOption);
+    parser.addOption(controlGroupOption);
+    parser.addOption(qwertyLayoutOption);
+    parser.addOption(qwertyBaseOption);
+    parser.addOption(metricsFileOption);
+    parser.addOption(metricsPortOption);
+    parser.addOption(noAutoReconnectOption);
+    parser.addOption(outputPacingOption);
+    parser.addOption(midi1PortOption);
+    parser.addOption(realtimeOption);
+    parser.addOption(traceOption);
+    parser.process(app);
+    
+    if (parser.isSet(replayOption)) {
+        UmpReplayOptions options;
+        QString speed = parser.value(replaySpeedOption);
+        if (speed == "original") {
+            options.timing = ReplayTiming::Original;
+        } else if (speed != "max") {
+            bool ok = false;
+            options.timing = ReplayTiming::Scaled;
+            options.speed = speed.toDouble(&ok);
+            if (!ok || options.speed <= 0.0) {
+                std::cerr << "Invalid --replay-speed: " << speed.toStdString() << std::endl;
+                return 1;
+            }
+        }
+        
+        KeyboardController controller;
+        UmpReplayer replayer(controller);
+        if (!replayer.replay(parser.value(replayOption).toStdString(), options)) {
+            return 1;
+        }
+        if (parser.isSet(replayWriteOption) && !replayer.writeExpectation(parser.value(replayWriteOption).toStdString())) {
+            return 1;
+        }
+        if (parser.isSet(replayExpectOption) && !replayer.verifyExpectation(parser.value(replayExpectOption).toStdString())) {
+            return 1;
+        }
+        return 0;
+    }
+    
+    // Before the MIDI threads exist: memory locking covers everything allocated from here on
+    if (parser.isSet(realtimeOption)) {
+        auto config = RealtimeConfig::parse(parser.value(realtimeOption).toStdString());
+        if (!config) {
+            return 1;
+        }
+        RealtimeSetup::instance().apply(*config);
+    }
+    
+    StartupProfiler::instance().expect({"first paint", "devices listed", "MIDI-CI ready"});
     KeyboardWidget keyboard;
-    KeyboardController controller;
+    NotificationBus uiBus;  // outlives the controller threads that post to it
+    // MIDI backends and MIDI-CI come up after the window is shown (see startAsync below)
+    KeyboardController controller(MidiStartup::Deferred);
+    MidiClipPlayer player(controller);
+    ControlSnapshotSender snapshotSender(controller);
+    PresetStore presets((QStandardPaths::writableLocation(QStandardPaths::AppDataLocation) + "/presets").toStdString());
+    
+    if (parser.isSet(zonesOption)) {
+        auto zones = NoteRouter::parseZones(parser.value(zonesOption).toStdString());
+        if (!zones) {
+            return 1;
+        }
+        controller.setKeyboardZones(*zones);
+    }
+    int controlGroup = parser.value(controlGroupOption).toInt();
+    if (controlGroup < 1 || controlGroup > 16) {
+        std::cerr << "Invalid --control-group: " << parser.value(controlGroupOption).toStdString() << std::endl;
+        return 1;
+    }
+    controller.setControlGroup(controlGroup - 1);
+    
+    if (!keyboard.setQwertyLayout(parser.value(qwertyLayoutOption).toStdString())) {
+        return 1;
+    }
+    bool baseOk = false;
+    int qwertyBase = parser.value(qwertyBaseOption).toInt(&baseOk);
+    if (!baseOk || qwertyBase < 0 || qwertyBase > 127) {
+        std::cerr << "Invalid --qwerty-base: " << parser.value(qwertyBaseOption).toStdString() << std::endl;
+        return 1;
+    }
+    keyboard.setQwertyBaseNote(qwertyBase);
+    
+    MetricsExporter metricsExporter([](std::ostream& out) { MidiCIMetrics::instance().writePrometheus(out); });
+    if (parser.isSet(metricsFileOption) || parser.isSet(metricsPortOption)) {
+        int metricsPort = -1;
+        if (parser.isSet(metricsPortOption)) {
+            bool portOk = false;
+            metricsPort = parser.value(metricsPortOption).toInt(&portOk);
+            if (!portOk || metricsPort < 1 || metricsPort > 65535) {
+                std::cerr << "Invalid --metrics-port: " << parser.value(metricsPortOption).toStdString() << std::endl;
+                return 1;
+            }
+        }
+        if (!metricsExporter.start(parser.value(metricsFileOption).toStdString(), metricsPort)) {
+            return 1;
+        }
+    }
+    
+    if (parser.isSet(captureOption)) {
+        controller.startCapture(parser.value(captureOption).toStdString(),
+                                parser.value(captureRecordsOption).toULongLong());
+    }
     
     // Set up callbacks
-    keyboard.setKeyPressedCallback([&controller](int note) {
-        controller.noteOn(note, 80); // Default velocity
-        std::cout << "Note ON: " << note << std::endl;
+    keyboard.setKeyPressedCallback([&controller](int note, uint16_t velocity) {
+        controller.noteOnHighResolution(note, velocity);
+        std::cout << "Note ON: " << note << " velocity " << velocity << std::endl;
     });
     
     keyboard.setKeyReleasedCallback([&controller](int note) {
@@ -22,14 +169,102 @@ int main(int argc, char** argv) {
         std::cout << "Note OFF: " << note << std::endl;
     });
     
-    keyboard.setDeviceRefreshCallback([&controller, &keyboard]() {
-        auto inputDevices = controller.getInputDevices();
-        auto outputDevices = controller.getOutputDevices();
-        keyboard.updateMidiDevices(inputDevices, outputDevices);
+    keyboard.setNoteBendCallback([&controller](int note, float semitones) {
+        controller.setNoteBend(note, semitones);
+    });
+    
+    keyboard.setNotePressureCallback([&controller](int note, float pressure) {
+        controller.setNotePressure(note, pressure);
+    });
+    
+    keyboard.setExpressionFlushCallback([&controller]() {
+        return controller.flushNoteExpression();
+    });
+    
+    keyboard.setLatencyStatsCallback([&controller]() {
+        controller.dumpLatencyStatistics();
+        controller.dumpMidiCIStatistics();
+    });
+    
+    keyboard.setLoopbackTestCallback([&controller]() {
+        // Requires the selected output to be looped back into the selected input (e.g. a virtual port)
+        controller.startLoopbackTest(1000, std::chrono::milliseconds(2), nullptr);
+    });
+    
+    keyboard.setPanicCallback([&controller, &player, &keyboard]() {
+        if (player.isPlaying()) {
+            player.stop();
+            keyboard.setPlaybackActive(false);
+        }
+        for (const auto& note : controller.getStuckNotes(std::chrono::seconds(10))) {
+            std::cout << "[PANIC] Stuck note " << static_cast<int>(note.note) << " on group " << (note.group + 1)
+                      << " channel " << (note.channel + 1) << " held " << note.heldFor.count() << " ms" << std::endl;
+        }
+        controller.panic();
+    });
+    
+    keyboard.setPlayFileCallback([&player, &keyboard](const std::string& path) {
+        keyboard.setPlaybackActive(player.start(path));
+    });
+    
+    keyboard.setStopPlaybackCallback([&player, &keyboard]() {
+        player.stop();
+        keyboard.setPlaybackActive(false);
+    });
+    
+    player.setFinishedCallback([&keyboard](const ClipPlayerStats&) {
+        // Called from the player's sender thread
+        QMetaObject::invokeMethod(&keyboard, [&keyboard]() {
+            keyboard.setPlaybackActive(false);
+        }, Qt::QueuedConnection);
+    });
+    
+    keyboard.setDeviceRefreshCallback([&controller]() {
+        // Differences arrive as port deltas below
+        controller.refreshDevices();
         
         // MIDI-CI status should remain static - only update device list if connections change
     });
     
+    // Hotplug: the observer reports single ports, applied on the Qt thread
+    controller.setPortsChangedCallback([&keyboard](const PortDelta& delta) {
+        QMetaObject::invokeMethod(&keyboard, [&keyboard, delta]() {
+            keyboard.applyMidiDeviceDelta(delta);
+        }, Qt::QueuedConnection);
+    });
+    
+    // Replug: remember the control values when the device goes away and send them once it is back.
+    // Both posts are queued in order, so the snapshot is taken before MIDI-CI rediscovery can
+    // replace the control list.
+    controller.setAutoReconnect(!parser.isSet(noAutoReconnectOption));
+    for (const QString& port : parser.values(midi1PortOption)) {
+        controller.setMidi1Port(port.toStdString());
+    }
+    for (const QString& rule : parser.values(outputPacingOption)) {
+        int split = rule.indexOf('=');
+        auto config = split > 0 ? OutputPacingConfig::parse(rule.mid(split + 1).toStdString()) : std::nullopt;
+        if (!config) {
+            std::cerr << "Invalid --output-pacing: " << rule.toStdString() << std::endl;
+            return 1;
+        }
+        controller.setOutputPacing(rule.left(split).toStdString(), *config);
+    }
+    ControlSnapshot reconnectSnapshot;
+    controller.setPortPairLostCallback([&keyboard, &reconnectSnapshot]() {
+        QMetaObject::invokeMethod(&keyboard, [&keyboard, &reconnectSnapshot]() {
+            reconnectSnapshot = keyboard.currentControlSnapshot();
+        }, Qt::QueuedConnection);
+    });
+    controller.setPortPairRestoredCallback([&controller, &keyboard, &snapshotSender, &reconnectSnapshot](const ReconnectReport&) {
+        QMetaObject::invokeMethod(&keyboard, [&controller, &keyboard, &snapshotSender, &reconnectSnapshot]() {
+            if (!reconnectSnapshot.empty()) {
+                snapshotSender.send(reconnectSnapshot, static_cast<uint8_t>(controller.getControlGroup()));
+                keyboard.restoreControlValuesOnReload(reconnectSnapshot);
+                reconnectSnapshot.clear();
+            }
+        }, Qt::QueuedConnection);
+    });
+    
     // Set up MIDI-CI callback
     keyboard.setMidiCIDiscoveryCallback([&controller, &keyboard]() {
         controller.sendMidiCIDiscovery();
@@ -39,14 +274,36 @@ int main(int argc, char** argv) {
         keyboard.updateMidiCIDevices(controller.getMidiCIDeviceDetails());
     });
     
+    // Controller callbacks arrive in bursts (one per discovery reply, property chunk or subscription
+    // update); the bus hands them to the UI thread at most once per topic and frame
+    uiBus.setWaker([&keyboard, &uiBus](std::chrono::nanoseconds delay) {
+        int delayMs = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(delay).count());
+        QMetaObject::invokeMethod(&keyboard, [&keyboard, &uiBus, delayMs]() {
+            QTimer::singleShot(delayMs, &keyboard, [&uiBus]() { uiBus.deliver(); });
+        }, Qt::QueuedConnection);
+    });
+    uiBus.setDevicesHandler([&controller, &keyboard]() {
+        keyboard.updateMidiCIDevices(controller.getMidiCIDeviceDetails());
+    });
+    uiBus.setConnectionHandler([&controller, &keyboard](bool) {
+        // Binding a new pair may have created the MIDI-CI manager
+        keyboard.updateMidiCIStatus(
+            controller.isMidiCIInitialized(),
+            controller.getMidiCIMuid(),
+            controller.getMidiCIDeviceName()
+        );
+    });
+    uiBus.setPropertiesHandler([&keyboard](uint32_t muid) {
+        keyboard.onPropertiesUpdated(muid);
+    });
+    uiBus.setPropertyRowsHandler([&keyboard](uint32_t muid, const PropertyRowUpdate& update) {
+        keyboard.onPropertyRowsUpdated(muid, update);
+    });
+    
     // Set up MIDI-CI devices changed callback for automatic updates
-    controller.setMidiCIDevicesChangedCallback([&controller, &keyboard]() {
+    controller.setMidiCIDevicesChangedCallback([&uiBus]() {
         std::cout << "MIDI-CI device list updated" << std::endl;
-        
-        // Ensure UI updates happen on the main Qt thread
-        QMetaObject::invokeMethod(&keyboard, [&controller, &keyboard]() {
-            keyboard.updateMidiCIDevices(controller.getMidiCIDeviceDetails());
-        }, Qt::QueuedConnection);
+        uiBus.postDevicesChanged();
     });
     
     // Removed periodic MIDI-CI updates - now using event-driven callbacks
@@ -63,34 +320,27 @@ int main(int argc, char** argv) {
     );
     
     // Set up properties changed callback
-    controller.setMidiCIPropertiesChangedCallback([&keyboard](uint32_t muid) {
+    controller.setMidiCIPropertiesChangedCallback([&uiBus](uint32_t muid) {
         std::cout << "Properties updated for MUID: 0x" << std::hex << muid << std::dec << std::endl;
-        
-        // Ensure UI updates happen on the main Qt thread
-        QMetaObject::invokeMethod(&keyboard, [&keyboard, muid]() {
-            keyboard.onPropertiesUpdated(muid);
-        }, Qt::QueuedConnection);
+        uiBus.postPropertiesChanged(muid);
+    });
+
+    // Subscribed lists only touch the rows that changed
+    controller.setMidiCIPropertyRowsChangedCallback([&uiBus](uint32_t muid, const PropertyRowUpdate& update) {
+        uiBus.postPropertyRows(muid, update);
     });
     
     
     // Set up MIDI connection state change callback for auto-discovery
-    controller.setMidiConnectionChangedCallback([&controller, &keyboard](bool hasValidPair) {
+    controller.setMidiConnectionChangedCallback([&controller, &uiBus](bool hasValidPair) {
         if (hasValidPair && controller.isMidiCIInitialized()) {
             std::cout << "Valid MIDI pair established - sending MIDI-CI Discovery" << std::endl;
             controller.sendMidiCIDiscovery();
-            
-            // Ensure UI updates happen on the main Qt thread
-            QMetaObject::invokeMethod(&keyboard, [&controller, &keyboard]() {
-                keyboard.updateMidiCIDevices(controller.getMidiCIDeviceDetails());
-            }, Qt::QueuedConnection);
         } else if (!hasValidPair) {
             std::cout << "MIDI pair disconnected - clearing MIDI-CI device list" << std::endl;
-            
-            // Ensure UI updates happen on the main Qt thread
-            QMetaObject::invokeMethod(&keyboard, [&controller, &keyboard]() {
-                keyboard.updateMidiCIDevices(controller.getMidiCIDeviceDetails());
-            }, Qt::QueuedConnection);
         }
+        uiBus.postConnectionChanged(hasValidPair);
+        uiBus.postDevicesChanged();
     });
     
     // Set up control change callbacks
@@ -114,6 +364,48 @@ int main(int argc, char** argv) {
         controller.sendPerNoteAftertouch(channel, note, value);
     });
     
+    keyboard.setControlSnapshotCallback([&controller, &snapshotSender](const ControlSnapshot& snapshot) {
+        snapshotSender.send(snapshot, static_cast<uint8_t>(controller.getControlGroup()));
+    });
+    
+    // Presets are stored per device model; MUIDs change every session
+    auto selectPresetDevice = [&controller, &presets](uint32_t muid) {
+        auto* device = controller.getMidiCIDeviceByMuid(muid);
+        if (!device) {
+            return false;
+        }
+        auto key = PresetStore::deviceKey(device->manufacturer, device->model);
+        return key == presets.selectedDevice() || presets.selectDevice(key);
+    };
+    keyboard.setPresetCallbacks(
+        [&presets, selectPresetDevice](uint32_t muid) {
+            return selectPresetDevice(muid) ? presets.presetNames() : std::vector<std::string>{};
+        },
+        [&presets, selectPresetDevice](uint32_t muid, const std::string& name, const ControlSnapshot& snapshot) {
+            return selectPresetDevice(muid) && presets.save(name, snapshot);
+        },
+        [&controller, &presets, &snapshotSender, selectPresetDevice](uint32_t muid, const std::string& name,
+                                                                     const ControlSnapshot& current) -> std::optional<ControlSnapshot> {
+            if (!selectPresetDevice(muid)) {
+                return std::nullopt;
+            }
+            auto changes = presets.switchTo(name, current);
+            if (changes && !changes->empty()) {
+                snapshotSender.send(*changes, static_cast<uint8_t>(controller.getControlGroup()));
+            }
+            return changes;
+        });
+    
+    keyboard.setDeviceStatePollCallback([&controller](DeviceStateChanges& changes) {
+        if (!controller.takeDeviceStateChanges(changes)) {
+            return false;
+        }
+        // The control list shows the control group only
+        uint8_t controlGroup = static_cast<uint8_t>(controller.getControlGroup());
+        std::erase_if(changes.controls, [controlGroup](const auto& change) { return change.first != controlGroup; });
+        return true;
+    });
+    
     // Connect device selection signals
     QObject::connect(&keyboard, &KeyboardWidget::midiInputDeviceChanged,
                     [&controller](const QString& deviceId) {
@@ -125,21 +417,38 @@ int main(int argc, char** argv) {
                         controller.selectOutputDevice(deviceId.toStdString());
                     });
     
-    // Initialize device lists
-    auto inputDevices = controller.getInputDevices();
-    auto outputDevices = controller.getOutputDevices();
-    keyboard.updateMidiDevices(inputDevices, outputDevices);
-    
-    // Update MIDI-CI status
-    keyboard.updateMidiCIStatus(
-        controller.isMidiCIInitialized(),
-        controller.getMidiCIMuid(),
-        controller.getMidiCIDeviceName()
-    );
-    keyboard.updateMidiCIDevices(controller.getMidiCIDeviceDetails());
+    if (parser.isSet(traceOption)) {
+        TraceRecorder::instance().setThreadName("ui");
+        TraceRecorder::instance().setEnabled(true);
+    }
     
+    keyboard.setFirstPaintCallback([]() {
+        StartupProfiler::instance().mark("first paint");
+    });
     keyboard.show();
     
-    return app.exec();
+    // Enumerate ports and initialize MIDI-CI off the GUI thread; fill in the lists when done
+    controller.startAsync([&controller, &keyboard](bool ok) {
+        QMetaObject::invokeMethod(&keyboard, [&controller, &keyboard, ok]() {
+            if (!ok) {
+                std::cerr << "MIDI startup failed; no devices available" << std::endl;
+            }
+            keyboard.updateMidiDevices(controller.getInputDevices(), controller.getOutputDevices());
+            keyboard.updateMidiCIStatus(
+                controller.isMidiCIInitialized(),
+                controller.getMidiCIMuid(),
+                controller.getMidiCIDeviceName()
+            );
+            keyboard.updateMidiCIDevices(controller.getMidiCIDeviceDetails());
+            StartupProfiler::instance().mark("devices listed");
+        }, Qt::QueuedConnection);
+    });
+    
+    int result = app.exec();
+    if (parser.isSet(traceOption)) {
+        TraceRecorder::instance().setEnabled(false);
+        TraceRecorder::instance().writeChromeTrace(parser.value(traceOption).toStdString());
+    }
+    return result;
 }
 
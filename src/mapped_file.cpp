@@ -0,0 +1,223 @@
+#include "mapped_file.h"
+#include <iostream>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        data_ = std::exchange(other.data_, nullptr);
+        size_ = std::exchange(other.size_, 0);
+        path_ = std::move(other.path_);
+#ifdef _WIN32
+        file_handle_ = std::exchange(other.file_handle_, nullptr);
+        mapping_handle_ = std::exchange(other.mapping_handle_, nullptr);
+#else
+        fd_ = std::exchange(other.fd_, -1);
+#endif
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+
+bool MappedFile::openReadOnly(const std::string& path) {
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "[MAPPED FILE] Cannot open " << path << std::endl;
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        CloseHandle(file);
+        std::cerr << "[MAPPED FILE] Cannot map empty file " << path << std::endl;
+        return false;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        std::cerr << "[MAPPED FILE] CreateFileMapping failed for " << path << std::endl;
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        std::cerr << "[MAPPED FILE] MapViewOfFile failed for " << path << std::endl;
+        return false;
+    }
+
+    file_handle_ = file;
+    mapping_handle_ = mapping;
+    data_ = static_cast<uint8_t*>(view);
+    size_ = static_cast<size_t>(fileSize.QuadPart);
+    path_ = path;
+    return true;
+}
+
+bool MappedFile::createReadWrite(const std::string& path, size_t size) {
+    close();
+
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                              CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "[MAPPED FILE] Cannot create " << path << std::endl;
+        return false;
+    }
+
+    LARGE_INTEGER mappingSize;
+    mappingSize.QuadPart = static_cast<LONGLONG>(size);
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, mappingSize.HighPart, mappingSize.LowPart, nullptr);
+    if (!mapping) {
+        CloseHandle(file);
+        std::cerr << "[MAPPED FILE] CreateFileMapping failed for " << path << std::endl;
+        return false;
+    }
+
+    void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if (!view) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        std::cerr << "[MAPPED FILE] MapViewOfFile failed for " << path << std::endl;
+        return false;
+    }
+
+    file_handle_ = file;
+    mapping_handle_ = mapping;
+    data_ = static_cast<uint8_t*>(view);
+    size_ = size;
+    path_ = path;
+    return true;
+}
+
+void MappedFile::flush() {
+    if (data_) {
+        FlushViewOfFile(data_, 0);
+    }
+}
+
+void MappedFile::close() {
+    if (data_) {
+        UnmapViewOfFile(data_);
+        data_ = nullptr;
+    }
+    if (mapping_handle_) {
+        CloseHandle(static_cast<HANDLE>(mapping_handle_));
+        mapping_handle_ = nullptr;
+    }
+    if (file_handle_) {
+        CloseHandle(static_cast<HANDLE>(file_handle_));
+        file_handle_ = nullptr;
+    }
+    size_ = 0;
+}
+
+#else
+
+bool MappedFile::openReadOnly(const std::string& path) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        std::cerr << "[MAPPED FILE] Cannot open " << path << std::endl;
+        return false;
+    }
+
+    struct stat st {};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        std::cerr << "[MAPPED FILE] Cannot map empty file " << path << std::endl;
+        return false;
+    }
+
+    void* view = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        ::close(fd);
+        std::cerr << "[MAPPED FILE] mmap failed for " << path << std::endl;
+        return false;
+    }
+
+    fd_ = fd;
+    data_ = static_cast<uint8_t*>(view);
+    size_ = static_cast<size_t>(st.st_size);
+    path_ = path;
+    return true;
+}
+
+bool MappedFile::createReadWrite(const std::string& path, size_t size) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "[MAPPED FILE] Cannot create " << path << std::endl;
+        return false;
+    }
+
+    // Preallocate so that appends never hit ENOSPC/SIGBUS halfway through a session
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        ::close(fd);
+        std::cerr << "[MAPPED FILE] Cannot resize " << path << " to " << size << " bytes" << std::endl;
+        return false;
+    }
+#if defined(__linux__)
+    posix_fallocate(fd, 0, static_cast<off_t>(size));
+#endif
+
+    void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED) {
+        ::close(fd);
+        std::cerr << "[MAPPED FILE] mmap failed for " << path << std::endl;
+        return false;
+    }
+
+    fd_ = fd;
+    data_ = static_cast<uint8_t*>(view);
+    size_ = size;
+    path_ = path;
+    return true;
+}
+
+void MappedFile::flush() {
+    if (data_) {
+        msync(data_, size_, MS_ASYNC);
+    }
+}
+
+void MappedFile::close() {
+    if (data_) {
+        munmap(data_, size_);
+        data_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    size_ = 0;
+}
+
+#endif
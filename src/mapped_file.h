@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Minimal cross-platform memory-mapped file.
+// Used for the UMP capture ring file and for streaming readers that must not load whole files into memory.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    // Map an existing file read-only
+    bool openReadOnly(const std::string& path);
+    // Create (or truncate) a file of exactly `size` bytes and map it read-write
+    bool createReadWrite(const std::string& path, size_t size);
+    void close();
+
+    bool isOpen() const { return data_ != nullptr; }
+    uint8_t* data() { return data_; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+    const std::string& path() const { return path_; }
+
+    // Ask the OS to write dirty pages back (asynchronously where supported)
+    void flush();
+
+private:
+    uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+    std::string path_;
+#ifdef _WIN32
+    void* file_handle_ = nullptr;
+    void* mapping_handle_ = nullptr;
+#else
+    int fd_ = -1;
+#endif
+};
@@ -0,0 +1,243 @@
+#include "metrics_exporter.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+#ifdef _WIN32
+
+using NativeSocket = SOCKET;
+constexpr int SEND_FLAGS = 0;
+
+// Winsock is reference counted per process: every startSockets() is paired with a stopSockets()
+bool startSockets() {
+    WSADATA data;
+    return WSAStartup(MAKEWORD(2, 2), &data) == 0;
+}
+
+void stopSockets() {
+    WSACleanup();
+}
+
+void closeSocket(intptr_t socket) {
+    ::closesocket(static_cast<SOCKET>(socket));
+}
+
+int pollSocket(pollfd& descriptor, int timeoutMs) {
+    return ::WSAPoll(&descriptor, 1, timeoutMs);
+}
+
+std::string socketError() {
+    return "Winsock error " + std::to_string(WSAGetLastError());
+}
+
+#else
+
+using NativeSocket = int;
+constexpr int SEND_FLAGS = MSG_NOSIGNAL;
+
+bool startSockets() {
+    return true;
+}
+
+void stopSockets() {
+}
+
+void closeSocket(intptr_t socket) {
+    ::close(static_cast<int>(socket));
+}
+
+int pollSocket(pollfd& descriptor, int timeoutMs) {
+    return ::poll(&descriptor, 1, timeoutMs);
+}
+
+std::string socketError() {
+    return std::strerror(errno);
+}
+
+#endif
+
+NativeSocket native(intptr_t socket) {
+    return static_cast<NativeSocket>(socket);
+}
+
+}  // namespace
+
+MetricsExporter::MetricsExporter(Writer writer)
+    : writer_(std::move(writer)) {
+}
+
+MetricsExporter::~MetricsExporter() {
+    stop();
+}
+
+bool MetricsExporter::start(const std::string& filePath, int port, std::chrono::milliseconds fileInterval) {
+    stop();
+    filePath_ = filePath;
+    fileInterval_ = fileInterval;
+
+    if (port >= 0) {
+        if (!startSockets()) {
+            std::cerr << "[METRICS] Cannot initialize sockets: " << socketError() << std::endl;
+            return false;
+        }
+        // INVALID_SOCKET becomes -1 as well
+        listenSocket_ = static_cast<intptr_t>(::socket(AF_INET, SOCK_STREAM, 0));
+        if (listenSocket_ < 0) {
+            std::cerr << "[METRICS] Cannot create socket: " << socketError() << std::endl;
+            stopSockets();
+            return false;
+        }
+        int reuse = 1;
+        ::setsockopt(native(listenSocket_), SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse),
+                     sizeof(reuse));
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        address.sin_port = htons(static_cast<uint16_t>(port));
+        if (::bind(native(listenSocket_), reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            ::listen(native(listenSocket_), 4) != 0) {
+            std::cerr << "[METRICS] Cannot listen on 127.0.0.1:" << port << ": " << socketError() << std::endl;
+            closeSocket(listenSocket_);
+            listenSocket_ = -1;
+            stopSockets();
+            return false;
+        }
+        socklen_t length = sizeof(address);
+        ::getsockname(native(listenSocket_), reinterpret_cast<sockaddr*>(&address), &length);
+        boundPort_ = ntohs(address.sin_port);
+        std::cout << "[METRICS] Serving Prometheus metrics on http://127.0.0.1:" << boundPort_ << "/metrics" << std::endl;
+    }
+
+    if (filePath_.empty() && listenSocket_ < 0) {
+        return false;
+    }
+    if (!filePath_.empty()) {
+        std::cout << "[METRICS] Writing Prometheus metrics to " << filePath_ << " every " << fileInterval_.count()
+                  << " ms" << std::endl;
+    }
+
+    running_.store(true);
+    thread_ = std::thread(&MetricsExporter::run, this);
+    return true;
+}
+
+void MetricsExporter::stop() {
+    running_.store(false);
+    if (thread_.joinable()) {
+        thread_.join();
+    }
+    if (listenSocket_ >= 0) {
+        closeSocket(listenSocket_);
+        listenSocket_ = -1;
+        stopSockets();
+    }
+    boundPort_ = 0;
+}
+
+bool MetricsExporter::writeFile() const {
+    if (filePath_.empty()) {
+        return false;
+    }
+    const std::string tempPath = filePath_ + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::trunc);
+        if (!out) {
+            std::cerr << "[METRICS] Cannot write " << tempPath << std::endl;
+            return false;
+        }
+        writer_(out);
+        if (!out) {
+            return false;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(tempPath, filePath_, ec);
+    if (ec) {
+        std::cerr << "[METRICS] Cannot replace " << filePath_ << ": " << ec.message() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void MetricsExporter::run() {
+    auto nextWrite = std::chrono::steady_clock::now();
+    while (running_.load()) {
+        auto now = std::chrono::steady_clock::now();
+        if (!filePath_.empty() && now >= nextWrite) {
+            writeFile();
+            nextWrite = now + fileInterval_;
+        }
+
+        // Wake up at least every 100 ms so stop() is never kept waiting
+        auto wait = std::chrono::milliseconds(100);
+        if (!filePath_.empty()) {
+            wait = std::min(wait, std::chrono::duration_cast<std::chrono::milliseconds>(nextWrite - now));
+        }
+        if (listenSocket_ < 0) {
+            std::this_thread::sleep_for(wait);
+            continue;
+        }
+
+        pollfd descriptor{native(listenSocket_), POLLIN, 0};
+        if (pollSocket(descriptor, static_cast<int>(std::max<int64_t>(wait.count(), 0))) > 0 &&
+            (descriptor.revents & POLLIN)) {
+            auto client = static_cast<intptr_t>(::accept(native(listenSocket_), nullptr, nullptr));
+            if (client >= 0) {
+                serve(client);
+                closeSocket(client);
+            }
+        }
+    }
+    if (!filePath_.empty()) {
+        writeFile();  // leave the final counters behind
+    }
+}
+
+void MetricsExporter::serve(intptr_t client) const {
+    // The request itself does not matter; drain what has arrived so the peer does not see a reset
+    pollfd descriptor{native(client), POLLIN, 0};
+    if (pollSocket(descriptor, 100) > 0) {
+        char request[1024];
+        [[maybe_unused]] auto ignored = ::recv(native(client), request, sizeof(request), 0);
+    }
+
+    std::ostringstream body;
+    writer_(body);
+    const std::string text = body.str();
+    std::ostringstream response;
+    response << "HTTP/1.0 200 OK\r\n"
+             << "Content-Type: text/plain; version=0.0.4\r\n"
+             << "Content-Length: " << text.size() << "\r\n"
+             << "Connection: close\r\n\r\n"
+             << text;
+    const std::string data = response.str();
+    size_t written = 0;
+    while (written < data.size()) {
+        auto result = ::send(native(client), data.data() + written, static_cast<int>(data.size() - written), SEND_FLAGS);
+        if (result <= 0) {
+            break;
+        }
+        written += static_cast<size_t>(result);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <thread>
+
+// Publishes a Prometheus text dump from a background thread, to a file, a local HTTP port,
+// or both.
+//
+// The file is rewritten every interval through a temp file and rename, so the node_exporter
+// textfile collector (or a plain `cat`) never sees a half-written dump. The port is bound to
+// 127.0.0.1 only and answers every connection with the current dump, which is what a
+// Prometheus scrape of http://localhost:<port>/metrics needs (BSD sockets, Winsock on Windows).
+// The writer callback runs on the exporter thread, so it must only read lock-free state.
+class MetricsExporter {
+public:
+    using Writer = std::function<void(std::ostream&)>;
+
+    explicit MetricsExporter(Writer writer);
+    ~MetricsExporter();
+
+    MetricsExporter(const MetricsExporter&) = delete;
+    MetricsExporter& operator=(const MetricsExporter&) = delete;
+
+    // An empty path skips the file, a negative port skips the socket and port 0 picks a free one;
+    // returns false if nothing could be started
+    bool start(const std::string& filePath, int port,
+               std::chrono::milliseconds fileInterval = std::chrono::milliseconds(1000));
+    void stop();
+    bool isRunning() const { return running_.load(); }
+
+    uint16_t port() const { return boundPort_; }  // the actual port when started with one
+    bool writeFile() const;                        // one immediate dump to the configured file
+
+private:
+    void run();
+    void serve(intptr_t client) const;
+
+    Writer writer_;
+    std::string filePath_;
+    std::chrono::milliseconds fileInterval_{1000};
+    intptr_t listenSocket_ = -1;  // a file descriptor, or a SOCKET on Windows
+    uint16_t boundPort_ = 0;
+    std::atomic<bool> running_{false};
+    std::thread thread_;
+};
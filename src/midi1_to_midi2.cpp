@@ -0,0 +1,146 @@
+#include "midi1_to_midi2.h"
+#include "midi_value_scaling.h"
+#include <algorithm>
+
+namespace {
+uint32_t midi2Word0(uint8_t group, uint8_t opcode, uint8_t channel, uint8_t index1, uint8_t index2) {
+    return (0x4u << 28) | (static_cast<uint32_t>(group & 0xF) << 24) | (static_cast<uint32_t>(opcode & 0xF) << 20) |
+           (static_cast<uint32_t>(channel & 0xF) << 16) | (static_cast<uint32_t>(index1 & 0x7F) << 8) | (index2 & 0x7F);
+}
+}
+
+Midi1ToMidi2Converter::Midi1ToMidi2Converter() {
+    reset();
+}
+
+void Midi1ToMidi2Converter::reset() {
+    for (auto& group : channels_) {
+        for (auto& channel : group) {
+            channel = ChannelState{};
+        }
+    }
+}
+
+int Midi1ToMidi2Converter::convert(uint8_t group, uint8_t status, uint8_t data1, uint8_t data2, uint32_t out[2]) {
+    const uint8_t opcode = status >> 4;
+    const uint8_t channel = status & 0xF;
+    data1 &= 0x7F;
+    data2 &= 0x7F;
+
+    switch (opcode) {
+        case 0x8:
+            out[0] = midi2Word0(group, 0x8, channel, data1, 0);
+            out[1] = static_cast<uint32_t>(midi7To16(data2)) << 16;
+            return 2;
+        case 0x9:
+            if (data2 == 0) {
+                // Note On with velocity 0 is a Note Off with the MIDI 1.0 default release velocity
+                out[0] = midi2Word0(group, 0x8, channel, data1, 0);
+                out[1] = static_cast<uint32_t>(midi7To16(64)) << 16;
+            } else {
+                out[0] = midi2Word0(group, 0x9, channel, data1, 0);
+                out[1] = static_cast<uint32_t>(midi7To16(data2)) << 16;
+            }
+            return 2;
+        case 0xA:
+            out[0] = midi2Word0(group, 0xA, channel, data1, 0);
+            out[1] = midi7To32(data2);
+            return 2;
+        case 0xB:
+            return convertControlChange(group, channel, data1, data2, out);
+        case 0xC: {
+            const ChannelState& state = channels_[group & 0xF][channel];
+            out[0] = midi2Word0(group, 0xC, channel, 0, state.bankValid ? 1 : 0);
+            out[1] = (static_cast<uint32_t>(data1) << 24) |
+                     (state.bankValid ? (static_cast<uint32_t>(state.bankMsb) << 8) | state.bankLsb : 0);
+            return 2;
+        }
+        case 0xD:
+            out[0] = midi2Word0(group, 0xD, channel, 0, 0);
+            out[1] = midi7To32(data1);
+            return 2;
+        case 0xE:
+            out[0] = midi2Word0(group, 0xE, channel, 0, 0);
+            out[1] = midi14To32(static_cast<uint16_t>((data2 << 7) | data1));
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+int Midi1ToMidi2Converter::convertControlChange(uint8_t group, uint8_t channel, uint8_t controller, uint8_t value,
+                                                uint32_t out[2]) {
+    ChannelState& state = channels_[group & 0xF][channel];
+
+    switch (controller) {
+        case 0:
+            state.bankMsb = value;
+            state.bankValid = true;
+            return 0;
+        case 32:
+            state.bankLsb = value;
+            state.bankValid = true;
+            return 0;
+        case 99:
+            state.paramMsb = value;
+            state.paramIsNrpn = true;
+            return 0;
+        case 98:
+            state.paramLsb = value;
+            state.paramIsNrpn = true;
+            return 0;
+        case 101:
+            state.paramMsb = value;
+            state.paramIsNrpn = false;
+            return 0;
+        case 100:
+            state.paramLsb = value;
+            state.paramIsNrpn = false;
+            return 0;
+        case 6:
+        case 38: {
+            // RPN 127/127 is "null": data entry without a selected parameter passes through as a plain CC
+            if (state.paramMsb == 0x7F && state.paramLsb == 0x7F) {
+                break;
+            }
+            uint16_t combined;
+            if (controller == 6) {
+                state.dataMsb = value;
+                combined = static_cast<uint16_t>(value << 7);
+            } else {
+                combined = static_cast<uint16_t>((state.dataMsb << 7) | value);
+            }
+            out[0] = midi2Word0(group, state.paramIsNrpn ? 0x3 : 0x2, channel, state.paramMsb, state.paramLsb);
+            out[1] = midi14To32(combined);
+            return 2;
+        }
+        default:
+            break;
+    }
+
+    out[0] = midi2Word0(group, 0xB, channel, controller, 0);
+    out[1] = midi7To32(value);
+    return 2;
+}
+
+void Midi1ToMidi2Converter::appendSysEx7(uint8_t group, const uint8_t* data, size_t length, std::vector<uint32_t>& out) {
+    size_t offset = 0;
+    do {
+        size_t chunk = std::min<size_t>(6, length - offset);
+        uint8_t status;
+        if (offset == 0) {
+            status = chunk == length - offset ? 0x0 : 0x1;  // complete in one packet : start
+        } else {
+            status = offset + chunk == length ? 0x3 : 0x2;  // end : continue
+        }
+
+        uint8_t bytes[6] = {};
+        for (size_t i = 0; i < chunk; i++) {
+            bytes[i] = data[offset + i] & 0x7F;
+        }
+        out.push_back((0x3u << 28) | (static_cast<uint32_t>(group & 0xF) << 24) | (static_cast<uint32_t>(status) << 20) |
+                      (static_cast<uint32_t>(chunk) << 16) | (bytes[0] << 8) | bytes[1]);
+        out.push_back((static_cast<uint32_t>(bytes[2]) << 24) | (bytes[3] << 16) | (bytes[4] << 8) | bytes[5]);
+        offset += chunk;
+    } while (offset < length);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Stateful translation of MIDI 1.0 channel voice messages into MIDI 2.0 channel voice UMPs
+// (MIDI 2.0 UMP specification, "Translation: MIDI 1.0 Protocol to MIDI 2.0 Protocol").
+//
+// Bank Select is remembered and folded into Program Change, and the CC 99/98/101/100 + 6/38
+// sequences become single RPN/NRPN messages; everything else maps 1:1 with upscaled values.
+class Midi1ToMidi2Converter {
+public:
+    Midi1ToMidi2Converter();
+
+    // Converts one complete MIDI 1.0 channel voice message. Writes 0 or 2 words to `out`
+    // and returns the count; 0 means the message only updated translator state.
+    int convert(uint8_t group, uint8_t status, uint8_t data1, uint8_t data2, uint32_t out[2]);
+
+    void reset();
+
+    // Appends SysEx7 UMPs (2 words each) for a MIDI 1.0 SysEx body without the F0/F7 framing
+    static void appendSysEx7(uint8_t group, const uint8_t* data, size_t length, std::vector<uint32_t>& out);
+
+private:
+    struct ChannelState {
+        uint8_t bankMsb = 0;
+        uint8_t bankLsb = 0;
+        bool bankValid = false;
+        uint8_t paramMsb = 0x7F;
+        uint8_t paramLsb = 0x7F;
+        bool paramIsNrpn = false;
+        uint8_t dataMsb = 0;
+    };
+
+    ChannelState channels_[16][16];  // [group][channel]
+
+    int convertControlChange(uint8_t group, uint8_t channel, uint8_t controller, uint8_t value, uint32_t out[2]);
+};
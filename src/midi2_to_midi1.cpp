@@ -0,0 +1,152 @@
+#include "midi2_to_midi1.h"
+#include <algorithm>
+#include "midi_value_scaling.h"
+#include "ump_utils.h"
+
+namespace {
+
+enum class Rule : uint8_t {
+    Drop,
+    NoteOff,
+    NoteOn,
+    PolyPressure,
+    Control,
+    Parameter,
+    Program,
+    ChannelPressure,
+    PitchBend,
+};
+
+// MIDI 2.0 channel voice opcode -> how it is sent as MIDI 1.0
+constexpr Rule RULES[16] = {
+    Rule::Drop,             // 0x0 registered per-note controller
+    Rule::Drop,             // 0x1 assignable per-note controller
+    Rule::Parameter,        // 0x2 RPN
+    Rule::Parameter,        // 0x3 NRPN
+    Rule::Drop,             // 0x4 relative RPN
+    Rule::Drop,             // 0x5 relative NRPN
+    Rule::Drop,             // 0x6 per-note pitch bend
+    Rule::Drop,             // 0x7 reserved
+    Rule::NoteOff,          // 0x8
+    Rule::NoteOn,           // 0x9
+    Rule::PolyPressure,     // 0xA
+    Rule::Control,          // 0xB
+    Rule::Program,          // 0xC
+    Rule::ChannelPressure,  // 0xD
+    Rule::PitchBend,        // 0xE
+    Rule::Drop,             // 0xF per-note management
+};
+
+}  // namespace
+
+void Midi2ToMidi1Converter::reset() {
+    for (auto& group : selections_) {
+        for (auto& selection : group) {
+            selection = ParameterSelection{};
+        }
+    }
+}
+
+void Midi2ToMidi1Converter::observeMidi1(uint8_t group, uint8_t status, uint8_t controller) {
+    // Someone else moved the selection: select explicitly next time
+    if ((status & 0xF0) == 0xB0 && controller >= 98 && controller <= 101) {
+        selections_[group & 0xF][status & 0xF].valid = false;
+    }
+}
+
+size_t Midi2ToMidi1Converter::translate(const uint32_t* ump, Midi1Message out[4]) {
+    const uint32_t word0 = ump[0];
+    const uint32_t word1 = ump[1];
+    const uint8_t group = umpGroup(word0);
+    const uint8_t opcode = (word0 >> 20) & 0xF;
+    const uint8_t channel = (word0 >> 16) & 0xF;
+    const uint8_t index1 = (word0 >> 8) & 0x7F;
+    const uint8_t index2 = word0 & 0x7F;
+    const uint8_t control = 0xB0 | channel;
+
+    switch (RULES[opcode]) {
+        case Rule::NoteOff:
+            out[0] = {static_cast<uint8_t>(0x80 | channel), index1, midi16To7(word1 >> 16), 3};
+            return 1;
+        case Rule::NoteOn: {
+            // Velocity 0 would turn it into a Note Off
+            uint8_t velocity = std::max<uint8_t>(midi16To7(word1 >> 16), 1);
+            out[0] = {static_cast<uint8_t>(0x90 | channel), index1, velocity, 3};
+            return 1;
+        }
+        case Rule::PolyPressure:
+            out[0] = {static_cast<uint8_t>(0xA0 | channel), index1, midi32To7(word1), 3};
+            return 1;
+        case Rule::Control:
+            observeMidi1(group, control, index1);
+            out[0] = {control, index1, midi32To7(word1), 3};
+            return 1;
+        case Rule::Parameter: {
+            bool nrpn = opcode == 0x3;
+            ParameterSelection& selection = selections_[group][channel];
+            bool reselect = !selection.valid || selection.nrpn != nrpn;
+            size_t count = 0;
+            if (reselect || selection.msb != index1) {
+                out[count++] = {control, static_cast<uint8_t>(nrpn ? 99 : 101), index1, 3};
+            }
+            if (reselect || selection.lsb != index2) {
+                out[count++] = {control, static_cast<uint8_t>(nrpn ? 98 : 100), index2, 3};
+            }
+            selection = {true, nrpn, index1, index2};
+            uint16_t value = midi32To14(word1);
+            out[count++] = {control, 6, static_cast<uint8_t>(value >> 7), 3};
+            out[count++] = {control, 38, static_cast<uint8_t>(value & 0x7F), 3};
+            return count;
+        }
+        case Rule::Program: {
+            size_t count = 0;
+            if (word0 & 0x1) {  // bank valid
+                out[count++] = {control, 0, static_cast<uint8_t>((word1 >> 8) & 0x7F), 3};
+                out[count++] = {control, 32, static_cast<uint8_t>(word1 & 0x7F), 3};
+            }
+            out[count++] = {static_cast<uint8_t>(0xC0 | channel), static_cast<uint8_t>((word1 >> 24) & 0x7F), 0, 2};
+            return count;
+        }
+        case Rule::ChannelPressure:
+            out[0] = {static_cast<uint8_t>(0xD0 | channel), midi32To7(word1), 0, 2};
+            return 1;
+        case Rule::PitchBend: {
+            uint16_t value = midi32To14(word1);
+            out[0] = {static_cast<uint8_t>(0xE0 | channel), static_cast<uint8_t>(value & 0x7F),
+                      static_cast<uint8_t>(value >> 7), 3};
+            return 1;
+        }
+        case Rule::Drop:
+            break;
+    }
+    return 0;
+}
+
+size_t Midi2ToMidi1Converter::toUmp(const uint32_t* ump, uint32_t* out) {
+    const uint32_t word0 = ump[0];
+    switch (umpMessageType(word0)) {
+        case 0x2:
+            observeMidi1(umpGroup(word0), static_cast<uint8_t>(word0 >> 16), (word0 >> 8) & 0x7F);
+            [[fallthrough]];
+        case 0x0:
+        case 0x1:
+        case 0x3:
+        case 0xF: {
+            size_t words = static_cast<size_t>(umpWordCount(word0));
+            std::copy_n(ump, words, out);
+            return words;
+        }
+        case 0x4: {
+            Midi1Message messages[4];
+            size_t count = translate(ump, messages);
+            uint32_t groupBits = word0 & 0x0F000000u;
+            for (size_t i = 0; i < count; i++) {
+                out[i] = 0x20000000u | groupBits | (static_cast<uint32_t>(messages[i].status) << 16) |
+                         (static_cast<uint32_t>(messages[i].data1) << 8) | (messages[i].length > 2 ? messages[i].data2 : 0);
+            }
+            return count;
+        }
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Stateful translation of outgoing UMPs for devices that only speak MIDI 1.0 (MIDI 2.0 UMP
+// specification, "Translation: MIDI 2.0 Protocol to MIDI 1.0 Protocol").
+//
+// MIDI 2.0 channel voice messages are mapped through a table indexed by opcode: values are scaled
+// down, Note On velocities that would become 0 are sent as 1, Program Change carries its bank as
+// CC 0/32, and RPN/NRPN become CC 101/100 (99/98) + 6/38, where the selector CCs are left out when
+// the channel already has that parameter selected. Messages without a MIDI 1.0 form (per-note
+// controllers and pitch bend, relative RPN/NRPN, per-note management, SysEx8, flex data) are
+// dropped. One instance per output stream; not thread-safe.
+class Midi2ToMidi1Converter {
+public:
+    static constexpr size_t MAX_WORDS = 4;  // RPN: four controller messages
+
+    // MIDI 2.0 channel voice becomes MIDI 1.0 channel voice UMPs (one word per message) in the same
+    // group; utility, system, MIDI 1.0 channel voice, SysEx7 and stream messages pass through.
+    // Writes up to MAX_WORDS words; returns the count.
+    size_t toUmp(const uint32_t* ump, uint32_t* out);
+
+    void reset();
+
+private:
+    struct Midi1Message {
+        uint8_t status = 0;
+        uint8_t data1 = 0;
+        uint8_t data2 = 0;
+        uint8_t length = 0;
+    };
+
+    struct ParameterSelection {
+        bool valid = false;
+        bool nrpn = false;
+        uint8_t msb = 0;
+        uint8_t lsb = 0;
+    };
+
+    // MIDI 2.0 channel voice (type 4) to up to four MIDI 1.0 messages
+    size_t translate(const uint32_t* ump, Midi1Message out[4]);
+    // A MIDI 1.0 controller message that selects or edits parameters outside of translate()
+    void observeMidi1(uint8_t group, uint8_t status, uint8_t controller);
+
+    ParameterSelection selections_[16][16];  // [group][channel]
+};
@@ -1,4 +1,6 @@
 #include "midi_ci_manager.h"
+#include "midi_ci_metrics.h"
+#include "trace_recorder.h"
 #include <iostream>
 #include <iomanip>
 #include <random>
@@ -53,6 +55,7 @@ bool MidiCIManager::initialize(uint32_t muid) {
         if (sysex_sender_) {
             device_->set_sysex_sender([this](uint8_t group, const std::vector<uint8_t>& data) -> bool {
                 if (sysex_sender_) {
+                    MidiCIMetrics::instance().observe(CIDirection::Sent, data.data(), data.size());
                     return sysex_sender_(group, data);
                 }
                 return false;
@@ -70,11 +73,21 @@ bool MidiCIManager::initialize(uint32_t muid) {
     }
 }
 
-void MidiCIManager::shutdown() {
+void MidiCIManager::shutdown(bool invalidateMuid) {
     if (!initialized_) return;
     
     try {
-        // Clear all state before shutting down
+        // Tell devices to stop pushing updates, then clear all state before shutting down
+        for (uint32_t muid : subscribed_muids_) {
+            if (auto connection = device_->get_connection(muid)) {
+                for (const auto& resource : PropertyModel::subscribedResources()) {
+                    connection->get_property_client_facade().send_unsubscribe_property(resource, "");
+                }
+            }
+        }
+        if (invalidateMuid) {
+            sendInvalidateMuid();
+        }
         clearDiscoveredDevices();
         
         device_.reset();
@@ -99,6 +112,8 @@ void MidiCIManager::processMidi1SysEx(const std::vector<uint8_t>& sysex_data) {
     
     try {
         // Process MIDI 1.0 SysEx data through MIDI-CI device
+        TraceSpan trace("midicci processInput", "midi-ci");
+        MidiCIMetrics::instance().observe(CIDirection::Received, sysex_data.data(), sysex_data.size());
         device_->processInput(0, sysex_data); // Use group 0 for MIDI 1.0
         std::cout << "[MIDICCI] SysEx processed successfully" << std::endl;
     } catch (const std::exception& e) {
@@ -106,14 +121,15 @@ void MidiCIManager::processMidi1SysEx(const std::vector<uint8_t>& sysex_data) {
     }
 }
 
-// Claude Code was stupid - it somehow did not use this function to process UMP input
-// while this app is totally based on UMP...
-// We may fix this inconsistency, but I'm afraid that Claude Code is not clever enough to handle this...
+// Entry point for SysEx7 reassembled from UMP input; keeps the group the message arrived on
 void MidiCIManager::processUmpSysEx(uint8_t group, const std::vector<uint8_t>& sysex_data) {
     if (!initialized_ || !device_) return;
     
     try {
         // Process UMP SysEx data through MIDI-CI device
+        TraceSpan trace("midicci processInput", "midi-ci");
+        trace.setArg("bytes", static_cast<int64_t>(sysex_data.size()));
+        MidiCIMetrics::instance().observe(CIDirection::Received, sysex_data.data(), sysex_data.size());
         device_->processInput(group, sysex_data);
     } catch (const std::exception& e) {
         std::cerr << "[MIDI-CI ERROR] Error processing UMP SysEx: " << e.what() << std::endl;
@@ -137,6 +153,28 @@ void MidiCIManager::sendDiscovery() {
     }
 }
 
+std::vector<uint8_t> MidiCIManager::invalidateMuidMessage(uint32_t muid) {
+    // Universal SysEx, whole function block, MIDI-CI, Invalidate MUID, CI version 2
+    std::vector<uint8_t> message = {0x7E, 0x7F, 0x0D, 0x7E, 0x02};
+    for (uint32_t value : {muid, 0x0FFFFFFFu, muid}) {  // source, broadcast destination, target
+        for (int i = 0; i < 4; i++) {
+            message.push_back(static_cast<uint8_t>((value >> (7 * i)) & 0x7F));
+        }
+    }
+    message.push_back(0xF7);
+    return message;
+}
+
+bool MidiCIManager::sendInvalidateMuid() {
+    if (!initialized_ || !sysex_sender_) {
+        return false;
+    }
+    auto message = invalidateMuidMessage(muid_);
+    MidiCIMetrics::instance().observe(CIDirection::Sent, message.data(), message.size());
+    log("InvalidateMUID sent for our MUID", true);
+    return sysex_sender_(0, message);
+}
+
 std::vector<std::string> MidiCIManager::getDiscoveredDevices() const {
     std::vector<std::string> devices;
     
@@ -169,6 +207,7 @@ void MidiCIManager::setSysExSender(SysExSender sender) {
         // Set up the CI output sender for the device
         device_->set_sysex_sender([this](uint8_t group, const std::vector<uint8_t>& data) -> bool {
             if (sysex_sender_) {
+                MidiCIMetrics::instance().observe(CIDirection::Sent, data.data(), data.size());
                 return sysex_sender_(group, data);
             }
             return false;
@@ -188,6 +227,10 @@ void MidiCIManager::setPropertiesChangedCallback(std::function<void(uint32_t)> c
     properties_changed_callback_ = callback;
 }
 
+void MidiCIManager::setPropertyRowsChangedCallback(PropertyRowsChangedCallback callback) {
+    property_rows_changed_callback_ = callback;
+}
+
 uint32_t MidiCIManager::getMuid() const {
     return muid_;
 }
@@ -392,6 +435,7 @@ void MidiCIManager::log(const std::string& message, bool is_outgoing) {
 
 // Property management methods using PropertyClientFacade for remote device access
 std::optional<std::vector<midicci::commonproperties::MidiCIControl>> MidiCIManager::getAllCtrlList(uint32_t muid) {
+    TraceSpan trace("getAllCtrlList", "midi-ci");
     std::lock_guard<std::recursive_mutex> lock(midi_ci_mutex_);
     
     if (!initialized_ || !device_) {
@@ -406,6 +450,12 @@ std::optional<std::vector<midicci::commonproperties::MidiCIControl>> MidiCIManag
         return std::nullopt;
     }
     
+    // Subscribed lists are already parsed
+    auto model = property_models_.find(muid);
+    if (model != property_models_.end() && model->second.has(StandardPropertyNames::ALL_CTRL_LIST)) {
+        return model->second.controls(StandardPropertyNames::ALL_CTRL_LIST);
+    }
+    
     try {
         // Clean up expired requests first
         cleanupExpiredPropertyRequests();
@@ -464,6 +514,7 @@ std::optional<std::vector<midicci::commonproperties::MidiCIControl>> MidiCIManag
 }
 
 std::optional<std::vector<midicci::commonproperties::MidiCIProgram>> MidiCIManager::getProgramList(uint32_t muid) {
+    TraceSpan trace("getProgramList", "midi-ci");
     std::lock_guard<std::recursive_mutex> lock(midi_ci_mutex_);
     
     if (!initialized_ || !device_) {
@@ -478,6 +529,12 @@ std::optional<std::vector<midicci::commonproperties::MidiCIProgram>> MidiCIManag
         return std::nullopt;
     }
     
+    // Subscribed lists are already parsed
+    auto model = property_models_.find(muid);
+    if (model != property_models_.end() && model->second.has(StandardPropertyNames::PROGRAM_LIST)) {
+        return model->second.programs();
+    }
+    
     try {
         // Clean up expired requests first
         cleanupExpiredPropertyRequests();
@@ -525,12 +582,65 @@ std::optional<std::vector<midicci::commonproperties::MidiCIProgram>> MidiCIManag
     }
 }
 
+std::map<std::string, std::vector<uint8_t>> MidiCIManager::getCachedProperties(uint32_t muid) {
+    std::lock_guard<std::recursive_mutex> lock(midi_ci_mutex_);
+    std::map<std::string, std::vector<uint8_t>> result;
+    
+    if (!initialized_ || !device_) {
+        return result;
+    }
+    
+    auto connection = device_->get_connection(muid);
+    if (!connection) {
+        return result;
+    }
+    
+    try {
+        auto* properties = connection->get_property_client_facade().get_properties();
+        if (properties) {
+            for (const auto& value : properties->getValues()) {
+                result[value.id] = value.body;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "[MIDI-CI ERROR] Failed to read cached properties for MUID 0x" << std::hex << muid << std::dec << ": " << e.what() << std::endl;
+    }
+    return result;
+}
+
+size_t MidiCIManager::restoreProperties(uint32_t muid, const std::map<std::string, std::vector<uint8_t>>& bodies) {
+    std::lock_guard<std::recursive_mutex> lock(midi_ci_mutex_);
+    if (!initialized_ || !device_) {
+        return 0;
+    }
+    
+    size_t restored = 0;
+    auto& model = property_models_[muid];
+    for (const auto& resource : PropertyModel::subscribedResources()) {
+        auto body = bodies.find(resource);
+        if (body != bodies.end() && !model.has(resource)) {
+            model.update(resource, body->second);
+            restored++;
+        }
+    }
+    if (restored > 0) {
+        std::cout << "[MIDI-CI] Restored " << restored << " cached property lists for MUID: 0x" << std::hex << muid
+                  << std::dec << std::endl;
+    }
+    return restored;
+}
+
 void MidiCIManager::setupPropertyCallbacks(uint32_t muid) {
     if (!initialized_ || !device_) {
         std::cerr << "[PROPERTY CALLBACKS] Cannot setup callbacks - not initialized" << std::endl;
         return;
     }
     
+    // Connections change for every device, so only set up each MUID once
+    if (subscribed_muids_.count(muid)) {
+        return;
+    }
+    
     // Get connection to the remote device
     auto connection = device_->get_connection(muid);
     if (!connection) {
@@ -551,15 +661,7 @@ void MidiCIManager::setupPropertyCallbacks(uint32_t muid) {
         
         // Register callback for property value updates
         properties->addPropertyUpdatedCallback([this, muid](const std::string& propertyId) {
-            std::cout << "[PROPERTY VALUE UPDATED] Property '" << propertyId << "' updated for MUID: 0x" << std::hex << muid << std::dec << std::endl;
-            
-            // Clear any pending requests for this specific property
-            this->removePendingPropertyRequest(muid, propertyId);
-            
-            // Notify UI about property changes
-            if (this->properties_changed_callback_) {
-                this->properties_changed_callback_(muid);
-            }
+            this->onPropertyUpdated(muid, propertyId);
         });
         
         // Register callback for property catalog updates (when metadata changes)
@@ -572,13 +674,62 @@ void MidiCIManager::setupPropertyCallbacks(uint32_t muid) {
             }
         });
         
-        std::cout << "[PROPERTY CALLBACKS] Successfully set up property callbacks for MUID: 0x" << std::hex << muid << std::dec << std::endl;
+        // Subscribe to the list resources so the device pushes full and partial updates itself
+        for (const auto& resource : PropertyModel::subscribedResources()) {
+            property_client.send_subscribe_property(resource, "");
+        }
+        subscribed_muids_.insert(muid);
+        
+        std::cout << "[PROPERTY CALLBACKS] Successfully set up property callbacks and subscriptions for MUID: 0x" << std::hex << muid << std::dec << std::endl;
         
     } catch (const std::exception& e) {
         std::cerr << "[PROPERTY CALLBACKS ERROR] Failed to setup callbacks for MUID 0x" << std::hex << muid << std::dec << ": " << e.what() << std::endl;
     }
 }
 
+void MidiCIManager::onPropertyUpdated(uint32_t muid, const std::string& property_id) {
+    TraceSpan trace("onPropertyUpdated", "midi-ci");
+    std::cout << "[PROPERTY VALUE UPDATED] Property '" << property_id << "' updated for MUID: 0x" << std::hex << muid << std::dec << std::endl;
+    
+    // Clear any pending requests for this specific property
+    removePendingPropertyRequest(muid, property_id);
+    
+    if (!PropertyModel::isListResource(property_id) || !property_rows_changed_callback_) {
+        if (properties_changed_callback_) {
+            properties_changed_callback_(muid);
+        }
+        return;
+    }
+    
+    PropertyRowUpdate update;
+    {
+        std::lock_guard<std::recursive_mutex> lock(midi_ci_mutex_);
+        auto connection = device_ ? device_->get_connection(muid) : nullptr;
+        auto* properties = connection ? connection->get_property_client_facade().get_properties() : nullptr;
+        if (!properties) {
+            return;
+        }
+        
+        // midicci has already merged full or partial subscription bodies into its cache
+        for (const auto& value : properties->getValues()) {
+            if (value.id == property_id) {
+                update = property_models_[muid].update(property_id, value.body);
+                break;
+            }
+        }
+    }
+    
+    if (update.empty()) {
+        return;
+    }
+    if (update.reset) {
+        std::cout << "[PROPERTY VALUE UPDATED] " << property_id << " reloaded" << std::endl;
+    } else {
+        std::cout << "[PROPERTY VALUE UPDATED] " << property_id << ": " << update.rows.size() << " rows changed" << std::endl;
+    }
+    property_rows_changed_callback_(muid, update);
+}
+
 bool MidiCIManager::isPropertyRequestPending(uint32_t muid, const std::string& property_name) {
     return std::any_of(pending_property_requests_.begin(), pending_property_requests_.end(),
                        [muid, &property_name](const PendingPropertyRequest& req) {
@@ -613,7 +764,11 @@ void MidiCIManager::cleanupExpiredPropertyRequests() {
     
     auto it = std::remove_if(pending_property_requests_.begin(), pending_property_requests_.end(),
                             [now, timeout](const PendingPropertyRequest& req) {
-                                return (now - req.request_time) > timeout;
+                                if ((now - req.request_time) > timeout) {
+                                    MidiCIMetrics::instance().recordTimeout(req.property_name);
+                                    return true;
+                                }
+                                return false;
                             });
     
     if (it != pending_property_requests_.end()) {
@@ -627,6 +782,8 @@ void MidiCIManager::clearDiscoveredDevices() {
     std::cout << "[MIDI-CI] Clearing all discovered devices and pending property requests" << std::endl;
     discovered_devices_.clear();
     pending_property_requests_.clear();
+    property_models_.clear();
+    subscribed_muids_.clear();
     
     // Notify UI about device list change
     if (devices_changed_callback_) {
@@ -8,8 +8,10 @@
 #include <map>
 #include <chrono>
 #include <mutex>
+#include <set>
 #include <midicci/midicci.hpp>
 #include <midicci/details/commonproperties/StandardProperties.hpp>
+#include "property_model.h"
 
 struct MidiCIDeviceInfo {
     uint32_t muid;
@@ -41,13 +43,15 @@ public:
     using LogCallback = std::function<void(const std::string&)>;
     using SysExSender = std::function<bool(uint8_t group, const std::vector<uint8_t>& data)>;
     using DevicesChangedCallback = std::function<void()>;
+    using PropertyRowsChangedCallback = std::function<void(uint32_t muid, const PropertyRowUpdate& update)>;
     
     MidiCIManager();
     ~MidiCIManager();
     
     // Initialization and cleanup
     bool initialize(uint32_t muid = 0);
-    void shutdown();
+    // invalidateMuid: our MUID is being replaced, so tell remote devices to forget it (after unsubscribing)
+    void shutdown(bool invalidateMuid = false);
     
     // MIDI message processing
     void processMidi1SysEx(const std::vector<uint8_t>& sysex_data);
@@ -55,6 +59,9 @@ public:
     
     // Device management
     void sendDiscovery();
+    bool sendInvalidateMuid();
+    // CI payload (no F0, F7-terminated) announcing that `muid` is no longer valid, sent from itself
+    static std::vector<uint8_t> invalidateMuidMessage(uint32_t muid);
     std::vector<std::string> getDiscoveredDevices() const;
     std::vector<MidiCIDeviceInfo> getDiscoveredDeviceDetails() const;
     MidiCIDeviceInfo* getDeviceByMuid(uint32_t muid);
@@ -76,6 +83,15 @@ public:
     std::optional<std::vector<midicci::commonproperties::MidiCIControl>> getAllCtrlList(uint32_t muid);
     std::optional<std::vector<midicci::commonproperties::MidiCIProgram>> getProgramList(uint32_t muid);
     void setPropertiesChangedCallback(std::function<void(uint32_t)> callback);
+    // Subscribed list resources report only the rows that changed; without this callback they
+    // fall back to the properties changed callback
+    void setPropertyRowsChangedCallback(PropertyRowsChangedCallback callback);
+    // Raw property bodies currently held for a remote device (no requests are sent)
+    std::map<std::string, std::vector<uint8_t>> getCachedProperties(uint32_t muid);
+    // Seeds the parsed lists of a rediscovered device with bodies kept from before it went away, so
+    // they are served at once; subscription replies then only report rows that differ. Returns the
+    // number of lists restored.
+    size_t restoreProperties(uint32_t muid, const std::map<std::string, std::vector<uint8_t>>& bodies);
 
 private:
     std::unique_ptr<midicci::MidiCIDevice> device_;
@@ -85,6 +101,7 @@ private:
     LogCallback log_callback_;
     DevicesChangedCallback devices_changed_callback_;
     std::function<void(uint32_t)> properties_changed_callback_;
+    PropertyRowsChangedCallback property_rows_changed_callback_;
     uint32_t muid_;
     bool initialized_;
     
@@ -101,6 +118,10 @@ private:
     };
     std::vector<PendingPropertyRequest> pending_property_requests_;
     
+    // Parsed subscribed lists per remote MUID, and the MUIDs whose callbacks and subscriptions are set up
+    std::map<uint32_t, PropertyModel> property_models_;
+    std::set<uint32_t> subscribed_muids_;
+    
     // Note: Remote device access is now handled through ClientConnection objects
     // obtained via device_->get_connection(muid) - no need for separate storage
     
@@ -109,6 +130,7 @@ private:
     void setupCallbacks();
 
     void setupPropertyCallbacks(uint32_t muid);
+    void onPropertyUpdated(uint32_t muid, const std::string& property_id);
     bool isPropertyRequestPending(uint32_t muid, const std::string& property_name);
     void addPendingPropertyRequest(uint32_t muid, const std::string& property_name);
     void removePendingPropertyRequest(uint32_t muid, const std::string& property_name);
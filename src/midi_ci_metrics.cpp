@@ -0,0 +1,428 @@
+#include "midi_ci_metrics.h"
+#include <algorithm>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+
+constexpr size_t CI_HEADER_SIZE = 13;       // 7E, device ID, 0D, Sub-ID#2, version, source MUID, destination MUID
+constexpr size_t PE_HEADER_OFFSET = 16;     // request ID, header length (2)
+constexpr uint8_t SUB_ID_GET_PROPERTY = 0x34;
+constexpr uint8_t SUB_ID_SET_PROPERTY = 0x36;
+constexpr uint8_t SUB_ID_SUBSCRIPTION = 0x38;
+constexpr uint8_t SUB_ID_NAK = 0x7F;
+
+uint32_t readMuid(const uint8_t* bytes) {
+    return static_cast<uint32_t>(bytes[0] & 0x7F) | (static_cast<uint32_t>(bytes[1] & 0x7F) << 7) |
+           (static_cast<uint32_t>(bytes[2] & 0x7F) << 14) | (static_cast<uint32_t>(bytes[3] & 0x7F) << 21);
+}
+
+uint16_t read14(const uint8_t* bytes) {
+    return static_cast<uint16_t>((bytes[0] & 0x7F) | ((bytes[1] & 0x7F) << 7));
+}
+
+bool isPropertyInquiry(uint8_t subId2) {
+    return subId2 == SUB_ID_GET_PROPERTY || subId2 == SUB_ID_SET_PROPERTY || subId2 == SUB_ID_SUBSCRIPTION;
+}
+
+bool isPropertyReply(uint8_t subId2) {
+    return subId2 == SUB_ID_GET_PROPERTY + 1 || subId2 == SUB_ID_SET_PROPERTY + 1 || subId2 == SUB_ID_SUBSCRIPTION + 1;
+}
+
+std::string hexMuid(uint32_t muid) {
+    std::ostringstream text;
+    text << "0x" << std::hex << std::setw(7) << std::setfill('0') << muid;
+    return text.str();
+}
+
+// Label values may only need ", \ and newline escaped
+std::string escapeLabel(const std::string& value) {
+    std::string escaped;
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if (c == '\n') {
+            escaped += "\\n";
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+const char* directionLabel(size_t direction) {
+    return direction == static_cast<size_t>(CIDirection::Sent) ? "sent" : "received";
+}
+
+}  // namespace
+
+MidiCIMetrics& MidiCIMetrics::instance() {
+    static MidiCIMetrics metrics;
+    return metrics;
+}
+
+MidiCIMetrics::MidiCIMetrics() = default;
+
+const char* MidiCIMetrics::messageTypeName(uint8_t subId2) {
+    switch (subId2) {
+        case 0x10: return "InitiateProtocolNegotiation";
+        case 0x11: return "InitiateProtocolNegotiationReply";
+        case 0x12: return "SetNewProtocol";
+        case 0x13: return "TestNewProtocolInitiatorToResponder";
+        case 0x14: return "TestNewProtocolResponderToInitiator";
+        case 0x15: return "ConfirmNewProtocolEstablished";
+        case 0x20: return "ProfileInquiry";
+        case 0x21: return "ProfileInquiryReply";
+        case 0x22: return "SetProfileOn";
+        case 0x23: return "SetProfileOff";
+        case 0x24: return "ProfileEnabledReport";
+        case 0x25: return "ProfileDisabledReport";
+        case 0x26: return "ProfileAddedReport";
+        case 0x27: return "ProfileRemovedReport";
+        case 0x28: return "ProfileDetailsInquiry";
+        case 0x29: return "ProfileDetailsReply";
+        case 0x2F: return "ProfileSpecificData";
+        case 0x30: return "PropertyExchangeCapabilities";
+        case 0x31: return "PropertyExchangeCapabilitiesReply";
+        case 0x32: return "HasPropertyData";
+        case 0x33: return "HasPropertyDataReply";
+        case 0x34: return "GetPropertyData";
+        case 0x35: return "GetPropertyDataReply";
+        case 0x36: return "SetPropertyData";
+        case 0x37: return "SetPropertyDataReply";
+        case 0x38: return "SubscribeProperty";
+        case 0x39: return "SubscribePropertyReply";
+        case 0x3F: return "PropertyNotify";
+        case 0x40: return "ProcessInquiryCapabilities";
+        case 0x41: return "ProcessInquiryCapabilitiesReply";
+        case 0x42: return "MidiMessageReportInquiry";
+        case 0x43: return "MidiMessageReportReply";
+        case 0x44: return "EndOfMidiMessageReport";
+        case 0x70: return "DiscoveryInquiry";
+        case 0x71: return "DiscoveryReply";
+        case 0x72: return "EndpointInquiry";
+        case 0x73: return "EndpointReply";
+        case 0x7D: return "Ack";
+        case 0x7E: return "InvalidateMUID";
+        case 0x7F: return "Nak";
+        default: return "Unknown";
+    }
+}
+
+std::string_view MidiCIMetrics::headerResource(std::string_view header) {
+    auto key = header.find("\"resource\"");
+    if (key == std::string_view::npos) return {};
+    auto colon = header.find(':', key + 10);
+    if (colon == std::string_view::npos) return {};
+    auto open = header.find('"', colon + 1);
+    if (open == std::string_view::npos) return {};
+    auto close = header.find('"', open + 1);
+    if (close == std::string_view::npos) return {};
+    return header.substr(open + 1, close - open - 1);
+}
+
+MidiCIMetrics::DeviceSlot* MidiCIMetrics::deviceSlot(uint32_t muid) {
+    const uint32_t key = muid + 1;
+    size_t start = (muid * 2654435761u) % DEVICE_SLOTS;
+    for (size_t probe = 0; probe < DEVICE_SLOTS; probe++) {
+        auto& slot = devices_[(start + probe) % DEVICE_SLOTS];
+        uint32_t current = slot.key.load(std::memory_order_acquire);
+        if (current == key) return &slot;
+        if (current == 0) {
+            uint32_t expected = 0;
+            if (slot.key.compare_exchange_strong(expected, key, std::memory_order_acq_rel) || expected == key) {
+                return &slot;
+            }
+        }
+    }
+    return nullptr;
+}
+
+MidiCIMetrics::PropertySlot* MidiCIMetrics::propertySlot(std::string_view name) {
+    if (name.empty()) return nullptr;
+    name = name.substr(0, PROPERTY_NAME_SIZE - 1);
+    size_t start = std::hash<std::string_view>{}(name) % PROPERTY_SLOTS;
+    for (size_t probe = 0; probe < PROPERTY_SLOTS; probe++) {
+        auto& slot = properties_[(start + probe) % PROPERTY_SLOTS];
+        uint32_t state = slot.state.load(std::memory_order_acquire);
+        if (state == 0) {
+            uint32_t expected = 0;
+            if (slot.state.compare_exchange_strong(expected, 1, std::memory_order_acq_rel)) {
+                std::memcpy(slot.name, name.data(), name.size());
+                slot.name[name.size()] = '\0';
+                slot.state.store(2, std::memory_order_release);
+                return &slot;
+            }
+            state = expected;
+        }
+        // Another thread is naming this slot right now; it is as likely to be ours as not, so wait it out
+        while (state == 1) {
+            state = slot.state.load(std::memory_order_acquire);
+        }
+        if (name == std::string_view(slot.name)) return &slot;
+    }
+    return nullptr;
+}
+
+void MidiCIMetrics::observe(CIDirection direction, const uint8_t* payload, size_t size) {
+    const auto d = static_cast<size_t>(direction);
+    sysexBytes_[d].fetch_add(size, std::memory_order_relaxed);
+    if (size < CI_HEADER_SIZE || payload[0] != 0x7E || payload[2] != 0x0D) {
+        malformed_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    const uint8_t subId2 = payload[3] & 0x7F;
+    messages_[d][subId2].fetch_add(1, std::memory_order_relaxed);
+    if (subId2 == SUB_ID_NAK && direction == CIDirection::Received) {
+        naks_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // The remote side is the destination of what we send and the source of what we receive
+    uint32_t muid = readMuid(payload + (direction == CIDirection::Sent ? 9 : 5));
+    if (auto* device = deviceSlot(muid)) {
+        device->messages[d].fetch_add(1, std::memory_order_relaxed);
+        device->bytes[d].fetch_add(size, std::memory_order_relaxed);
+    } else {
+        untrackedDevices_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (isPropertyInquiry(subId2) || isPropertyReply(subId2)) {
+        observePropertyExchange(direction, subId2, payload, size);
+    }
+}
+
+void MidiCIMetrics::observePropertyExchange(CIDirection direction, uint8_t subId2, const uint8_t* payload, size_t size) {
+    if (size < PE_HEADER_OFFSET) return;
+    const uint8_t requestId = payload[13] & 0x7F;
+    const size_t headerLength = read14(payload + 14);
+    if (size < PE_HEADER_OFFSET + headerLength) return;
+
+    // Chunk numbering follows the header; treat a message without it as a single chunk
+    uint16_t chunkCount = 1;
+    uint16_t chunk = 1;
+    if (size >= PE_HEADER_OFFSET + headerLength + 4) {
+        chunkCount = read14(payload + PE_HEADER_OFFSET + headerLength);
+        chunk = read14(payload + PE_HEADER_OFFSET + headerLength + 2);
+    }
+
+    auto& pending = pending_[requestId];
+    if (direction == CIDirection::Sent && isPropertyInquiry(subId2)) {
+        if (chunk > 1) return;  // later chunks of a Set inquiry
+        std::string_view header(reinterpret_cast<const char*>(payload + PE_HEADER_OFFSET), headerLength);
+        auto* slot = propertySlot(headerResource(header));
+        if (!slot) return;
+        slot->requests.fetch_add(1, std::memory_order_relaxed);
+        if (slot->outstanding.fetch_add(1, std::memory_order_relaxed) > 0) {
+            // Asked again while the previous request for this resource is still unanswered
+            slot->retries.fetch_add(1, std::memory_order_relaxed);
+            retries_.fetch_add(1, std::memory_order_relaxed);
+        }
+        pending.property.store(static_cast<uint32_t>(slot - properties_.data()) + 1, std::memory_order_relaxed);
+        pending.startNs.store(LatencyTracker::now(), std::memory_order_release);
+    } else if (direction == CIDirection::Received && isPropertyReply(subId2) && chunk >= chunkCount) {
+        int64_t start = pending.startNs.exchange(0, std::memory_order_acq_rel);
+        uint32_t property = pending.property.load(std::memory_order_relaxed);
+        if (start == 0 || property == 0) return;
+        auto& slot = properties_[property - 1];
+        slot.replies.fetch_add(1, std::memory_order_relaxed);
+        slot.outstanding.store(0, std::memory_order_relaxed);
+        int64_t elapsed = LatencyTracker::now() - start;
+        slot.latency.record(elapsed > 0 ? static_cast<uint64_t>(elapsed) : 0);
+    }
+}
+
+void MidiCIMetrics::recordTimeout(std::string_view property) {
+    timeouts_.fetch_add(1, std::memory_order_relaxed);
+    if (auto* slot = propertySlot(property)) {
+        slot->timeouts.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void MidiCIMetrics::reset() {
+    // Claimed device and property rows keep their keys so concurrent writers never see a slot vanish
+    for (auto& direction : messages_) {
+        for (auto& count : direction) count.store(0, std::memory_order_relaxed);
+    }
+    for (auto& bytes : sysexBytes_) bytes.store(0, std::memory_order_relaxed);
+    naks_.store(0, std::memory_order_relaxed);
+    timeouts_.store(0, std::memory_order_relaxed);
+    retries_.store(0, std::memory_order_relaxed);
+    malformed_.store(0, std::memory_order_relaxed);
+    untrackedDevices_.store(0, std::memory_order_relaxed);
+    for (auto& device : devices_) {
+        for (auto& count : device.messages) count.store(0, std::memory_order_relaxed);
+        for (auto& bytes : device.bytes) bytes.store(0, std::memory_order_relaxed);
+    }
+    for (auto& property : properties_) {
+        property.requests.store(0, std::memory_order_relaxed);
+        property.replies.store(0, std::memory_order_relaxed);
+        property.timeouts.store(0, std::memory_order_relaxed);
+        property.retries.store(0, std::memory_order_relaxed);
+        property.outstanding.store(0, std::memory_order_relaxed);
+        property.latency.reset();
+    }
+    for (auto& pending : pending_) {
+        pending.startNs.store(0, std::memory_order_relaxed);
+        pending.property.store(0, std::memory_order_relaxed);
+    }
+}
+
+MidiCIMetricsSnapshot MidiCIMetrics::snapshot() const {
+    constexpr auto sent = static_cast<size_t>(CIDirection::Sent);
+    constexpr auto received = static_cast<size_t>(CIDirection::Received);
+
+    MidiCIMetricsSnapshot snapshot;
+    for (size_t subId2 = 0; subId2 < 128; subId2++) {
+        uint64_t out = messages_[sent][subId2].load(std::memory_order_relaxed);
+        uint64_t in = messages_[received][subId2].load(std::memory_order_relaxed);
+        if (out || in) {
+            snapshot.messageTypes.push_back({static_cast<uint8_t>(subId2), messageTypeName(static_cast<uint8_t>(subId2)), out, in});
+        }
+    }
+
+    for (const auto& slot : devices_) {
+        uint32_t key = slot.key.load(std::memory_order_acquire);
+        if (key == 0) continue;
+        MidiCIMetricsSnapshot::Device device;
+        device.muid = key - 1;
+        device.sent = slot.messages[sent].load(std::memory_order_relaxed);
+        device.received = slot.messages[received].load(std::memory_order_relaxed);
+        device.bytesSent = slot.bytes[sent].load(std::memory_order_relaxed);
+        device.bytesReceived = slot.bytes[received].load(std::memory_order_relaxed);
+        if (device.sent || device.received) {
+            snapshot.devices.push_back(device);
+        }
+    }
+    std::sort(snapshot.devices.begin(), snapshot.devices.end(),
+              [](const auto& a, const auto& b) { return a.muid < b.muid; });
+
+    for (const auto& slot : properties_) {
+        if (slot.state.load(std::memory_order_acquire) != 2) continue;
+        MidiCIMetricsSnapshot::Property property;
+        property.name = slot.name;
+        property.requests = slot.requests.load(std::memory_order_relaxed);
+        property.replies = slot.replies.load(std::memory_order_relaxed);
+        property.timeouts = slot.timeouts.load(std::memory_order_relaxed);
+        property.retries = slot.retries.load(std::memory_order_relaxed);
+        property.latencyCount = slot.latency.count();
+        property.latencySumNs = static_cast<uint64_t>(slot.latency.mean() * static_cast<double>(property.latencyCount));
+        property.latencyP50Ns = slot.latency.percentile(50.0);
+        property.latencyP99Ns = slot.latency.percentile(99.0);
+        property.latencyMaxNs = slot.latency.max();
+        if (property.requests || property.replies || property.timeouts) {
+            snapshot.properties.push_back(std::move(property));
+        }
+    }
+    std::sort(snapshot.properties.begin(), snapshot.properties.end(),
+              [](const auto& a, const auto& b) { return a.name < b.name; });
+
+    snapshot.sysexBytesSent = sysexBytes_[sent].load(std::memory_order_relaxed);
+    snapshot.sysexBytesReceived = sysexBytes_[received].load(std::memory_order_relaxed);
+    snapshot.naks = naks_.load(std::memory_order_relaxed);
+    snapshot.timeouts = timeouts_.load(std::memory_order_relaxed);
+    snapshot.retries = retries_.load(std::memory_order_relaxed);
+    snapshot.malformed = malformed_.load(std::memory_order_relaxed);
+    snapshot.untrackedDevices = untrackedDevices_.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void MidiCIMetrics::dump(std::ostream& out) const {
+    auto stats = snapshot();
+    std::ostringstream text;
+    text << "[MIDI-CI STATS] sysex bytes sent " << stats.sysexBytesSent << ", received " << stats.sysexBytesReceived
+         << ", NAKs " << stats.naks << ", timeouts " << stats.timeouts << ", retries " << stats.retries << "\n";
+    for (const auto& type : stats.messageTypes) {
+        text << "[MIDI-CI STATS] " << std::left << std::setw(36) << type.name << std::right
+             << " sent " << std::setw(8) << type.sent << "  received " << std::setw(8) << type.received << "\n";
+    }
+    for (const auto& device : stats.devices) {
+        text << "[MIDI-CI STATS] MUID " << hexMuid(device.muid) << " sent " << device.sent << " (" << device.bytesSent
+             << " B), received " << device.received << " (" << device.bytesReceived << " B)\n";
+    }
+    for (const auto& property : stats.properties) {
+        text << "[MIDI-CI STATS] " << std::left << std::setw(20) << property.name << std::right
+             << " requests " << property.requests << ", replies " << property.replies
+             << ", p50 " << std::fixed << std::setprecision(1) << property.latencyP50Ns / 1e6 << " ms"
+             << ", p99 " << property.latencyP99Ns / 1e6 << " ms" << std::defaultfloat
+             << ", timeouts " << property.timeouts << ", retries " << property.retries << "\n";
+    }
+    out << text.str() << std::flush;
+}
+
+void MidiCIMetrics::writePrometheus(std::ostream& out) const {
+    auto stats = snapshot();
+    std::ostringstream text;
+
+    text << "# HELP ump_keyboard_midici_messages_total MIDI-CI messages by Sub-ID#2.\n"
+         << "# TYPE ump_keyboard_midici_messages_total counter\n";
+    for (const auto& type : stats.messageTypes) {
+        for (size_t d = 0; d < static_cast<size_t>(CIDirection::Count); d++) {
+            uint64_t value = d == static_cast<size_t>(CIDirection::Sent) ? type.sent : type.received;
+            text << "ump_keyboard_midici_messages_total{direction=\"" << directionLabel(d) << "\",type=\"" << type.name
+                 << "\"} " << value << "\n";
+        }
+    }
+
+    text << "# HELP ump_keyboard_midici_device_messages_total MIDI-CI messages by remote MUID.\n"
+         << "# TYPE ump_keyboard_midici_device_messages_total counter\n";
+    for (const auto& device : stats.devices) {
+        text << "ump_keyboard_midici_device_messages_total{direction=\"sent\",muid=\"" << hexMuid(device.muid) << "\"} "
+             << device.sent << "\n"
+             << "ump_keyboard_midici_device_messages_total{direction=\"received\",muid=\"" << hexMuid(device.muid) << "\"} "
+             << device.received << "\n";
+    }
+    text << "# HELP ump_keyboard_midici_device_bytes_total MIDI-CI SysEx bytes by remote MUID.\n"
+         << "# TYPE ump_keyboard_midici_device_bytes_total counter\n";
+    for (const auto& device : stats.devices) {
+        text << "ump_keyboard_midici_device_bytes_total{direction=\"sent\",muid=\"" << hexMuid(device.muid) << "\"} "
+             << device.bytesSent << "\n"
+             << "ump_keyboard_midici_device_bytes_total{direction=\"received\",muid=\"" << hexMuid(device.muid) << "\"} "
+             << device.bytesReceived << "\n";
+    }
+
+    text << "# HELP ump_keyboard_midici_sysex_bytes_total MIDI-CI SysEx payload bytes.\n"
+         << "# TYPE ump_keyboard_midici_sysex_bytes_total counter\n"
+         << "ump_keyboard_midici_sysex_bytes_total{direction=\"sent\"} " << stats.sysexBytesSent << "\n"
+         << "ump_keyboard_midici_sysex_bytes_total{direction=\"received\"} " << stats.sysexBytesReceived << "\n";
+    text << "# HELP ump_keyboard_midici_naks_total NAK messages received.\n"
+         << "# TYPE ump_keyboard_midici_naks_total counter\n"
+         << "ump_keyboard_midici_naks_total " << stats.naks << "\n";
+    text << "# HELP ump_keyboard_midici_malformed_total SysEx payloads too short for a MIDI-CI header.\n"
+         << "# TYPE ump_keyboard_midici_malformed_total counter\n"
+         << "ump_keyboard_midici_malformed_total " << stats.malformed << "\n";
+
+    text << "# HELP ump_keyboard_midici_property_requests_total Property Exchange inquiries sent.\n"
+         << "# TYPE ump_keyboard_midici_property_requests_total counter\n";
+    for (const auto& property : stats.properties) {
+        text << "ump_keyboard_midici_property_requests_total{property=\"" << escapeLabel(property.name) << "\"} "
+             << property.requests << "\n";
+    }
+    text << "# HELP ump_keyboard_midici_property_timeouts_total Property requests that expired unanswered.\n"
+         << "# TYPE ump_keyboard_midici_property_timeouts_total counter\n";
+    for (const auto& property : stats.properties) {
+        text << "ump_keyboard_midici_property_timeouts_total{property=\"" << escapeLabel(property.name) << "\"} "
+             << property.timeouts << "\n";
+    }
+    text << "# HELP ump_keyboard_midici_property_retries_total Property requests sent again before a reply.\n"
+         << "# TYPE ump_keyboard_midici_property_retries_total counter\n";
+    for (const auto& property : stats.properties) {
+        text << "ump_keyboard_midici_property_retries_total{property=\"" << escapeLabel(property.name) << "\"} "
+             << property.retries << "\n";
+    }
+
+    text << "# HELP ump_keyboard_midici_property_latency_seconds Property request to final reply chunk.\n"
+         << "# TYPE ump_keyboard_midici_property_latency_seconds summary\n";
+    for (const auto& property : stats.properties) {
+        std::string label = "property=\"" + escapeLabel(property.name) + "\"";
+        text << "ump_keyboard_midici_property_latency_seconds{" << label << ",quantile=\"0.5\"} "
+             << property.latencyP50Ns / 1e9 << "\n"
+             << "ump_keyboard_midici_property_latency_seconds{" << label << ",quantile=\"0.99\"} "
+             << property.latencyP99Ns / 1e9 << "\n"
+             << "ump_keyboard_midici_property_latency_seconds_sum{" << label << "} " << property.latencySumNs / 1e9 << "\n"
+             << "ump_keyboard_midici_property_latency_seconds_count{" << label << "} " << property.latencyCount << "\n";
+    }
+    out << text.str();
+}
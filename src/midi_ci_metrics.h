@@ -0,0 +1,127 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "latency_tracker.h"
+
+enum class CIDirection {
+    Sent = 0,
+    Received,
+    Count
+};
+
+// Point-in-time copy of the MIDI-CI counters; only non-zero rows are included
+struct MidiCIMetricsSnapshot {
+    struct MessageType {
+        uint8_t subId2 = 0;
+        std::string name;
+        uint64_t sent = 0;
+        uint64_t received = 0;
+    };
+    struct Device {
+        uint32_t muid = 0;
+        uint64_t sent = 0;
+        uint64_t received = 0;
+        uint64_t bytesSent = 0;
+        uint64_t bytesReceived = 0;
+    };
+    struct Property {
+        std::string name;
+        uint64_t requests = 0;
+        uint64_t replies = 0;
+        uint64_t timeouts = 0;
+        uint64_t retries = 0;
+        uint64_t latencyCount = 0;  // request -> final reply chunk
+        uint64_t latencySumNs = 0;
+        uint64_t latencyP50Ns = 0;
+        uint64_t latencyP99Ns = 0;
+        uint64_t latencyMaxNs = 0;
+    };
+
+    std::vector<MessageType> messageTypes;
+    std::vector<Device> devices;
+    std::vector<Property> properties;
+    uint64_t sysexBytesSent = 0;
+    uint64_t sysexBytesReceived = 0;
+    uint64_t naks = 0;
+    uint64_t timeouts = 0;
+    uint64_t retries = 0;
+    uint64_t malformed = 0;         // too short to carry a MIDI-CI header
+    uint64_t untrackedDevices = 0;  // messages from MUIDs beyond the device table
+};
+
+// Process-wide MIDI-CI traffic counters.
+//
+// observe() classifies raw CI payloads (the SysEx body without F0/F7, as midicci sends and
+// receives them) by Sub-ID#2, so every message type is counted, not only the ones midicci
+// exposes as typed messages. Property Exchange inquiries are matched to their replies by
+// request ID to measure request -> reply latency per resource. Everything is relaxed atomics in
+// fixed tables; device and property rows are claimed with a CAS, so the MIDI input thread, the
+// midicci sender and a scraping thread never take a lock.
+class MidiCIMetrics {
+public:
+    static constexpr size_t DEVICE_SLOTS = 64;
+    static constexpr size_t PROPERTY_SLOTS = 32;
+    static constexpr size_t PROPERTY_NAME_SIZE = 48;
+
+    static MidiCIMetrics& instance();
+
+    void observe(CIDirection direction, const uint8_t* payload, size_t size);
+    void recordTimeout(std::string_view property);
+    void reset();
+
+    MidiCIMetricsSnapshot snapshot() const;
+    void dump(std::ostream& out) const;              // human readable, [MIDI-CI STATS] lines
+    void writePrometheus(std::ostream& out) const;   // Prometheus text exposition format 0.0.4
+
+    static const char* messageTypeName(uint8_t subId2);
+    // "resource" from a Property Exchange header, or empty
+    static std::string_view headerResource(std::string_view header);
+
+    MidiCIMetrics();  // public for tests; the app uses instance()
+
+private:
+    struct DeviceSlot {
+        std::atomic<uint32_t> key{0};  // muid + 1, 0 = free
+        std::atomic<uint64_t> messages[2] = {};
+        std::atomic<uint64_t> bytes[2] = {};
+    };
+
+    struct PropertySlot {
+        std::atomic<uint32_t> state{0};  // 0 = free, 1 = being claimed, 2 = ready
+        char name[PROPERTY_NAME_SIZE] = {};
+        std::atomic<uint64_t> requests{0};
+        std::atomic<uint64_t> replies{0};
+        std::atomic<uint64_t> timeouts{0};
+        std::atomic<uint64_t> retries{0};
+        std::atomic<int64_t> outstanding{0};
+        LatencyHistogram latency;
+    };
+
+    // Outstanding inquiries we sent, indexed by request ID
+    struct PendingRequest {
+        std::atomic<int64_t> startNs{0};
+        std::atomic<uint32_t> property{0};  // property slot + 1
+    };
+
+    DeviceSlot* deviceSlot(uint32_t muid);
+    PropertySlot* propertySlot(std::string_view name);
+    void observePropertyExchange(CIDirection direction, uint8_t subId2, const uint8_t* payload, size_t size);
+
+    std::atomic<uint64_t> messages_[static_cast<size_t>(CIDirection::Count)][128] = {};
+    std::atomic<uint64_t> sysexBytes_[static_cast<size_t>(CIDirection::Count)] = {};
+    std::atomic<uint64_t> naks_{0};
+    std::atomic<uint64_t> timeouts_{0};
+    std::atomic<uint64_t> retries_{0};
+    std::atomic<uint64_t> malformed_{0};
+    std::atomic<uint64_t> untrackedDevices_{0};
+    std::array<DeviceSlot, DEVICE_SLOTS> devices_;
+    std::array<PropertySlot, PROPERTY_SLOTS> properties_;
+    std::array<PendingRequest, 128> pending_;
+};
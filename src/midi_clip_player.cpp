@@ -0,0 +1,237 @@
+#include "midi_clip_player.h"
+#include "keyboard_controller.h"
+#include "ump_utils.h"
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+namespace {
+
+bool isSysExPacket(uint32_t word0) {
+    uint8_t type = umpMessageType(word0);
+    return type == 0x3 || type == 0x5;
+}
+
+// Complete-in-one or end packet of a SysEx7 / SysEx8 message
+bool endsSysEx(uint32_t word0) {
+    uint8_t status = (word0 >> 20) & 0xF;
+    return status == 0x0 || status == 0x3;
+}
+
+}  // namespace
+
+MidiClipPlayer::MidiClipPlayer(KeyboardController& controller)
+    : sink_([&controller](const uint32_t* words, size_t wordCount, UmpLane lane) {
+          return controller.sendUmpBatch(words, wordCount, lane);
+      }) {
+}
+
+MidiClipPlayer::MidiClipPlayer(Sink sink)
+    : sink_(std::move(sink)) {
+}
+
+MidiClipPlayer::~MidiClipPlayer() {
+    stop();
+}
+
+bool MidiClipPlayer::start(const std::string& path) {
+    stop();
+
+    source_ = openMidiEventSource(path);
+    if (!source_) {
+        return false;
+    }
+    if (!ring_) {
+        ring_ = std::make_unique<Batch[]>(RING_BATCHES);
+        sysex_.reserve(BATCH_WORDS * 4);
+    }
+    sysex_.clear();
+    notes_.clear();
+
+    writeIndex_.store(0);
+    readIndex_.store(0);
+    encodedHorizonNs_.store(0);
+    encoderDone_.store(false);
+    stopRequested_.store(false);
+    packets_.store(0);
+    batches_.store(0);
+    underruns_.store(0);
+    lateBatches_.store(0);
+    maxLatenessNs_.store(0);
+
+    std::cout << "[PLAYER] Playing " << path << " (" << source_->formatName() << ")" << std::endl;
+
+    playing_.store(true);
+    startTime_ = std::chrono::steady_clock::now() + START_DELAY;
+    encoderThread_ = std::thread(&MidiClipPlayer::encodeLoop, this);
+    senderThread_ = std::thread(&MidiClipPlayer::sendLoop, this);
+    return true;
+}
+
+void MidiClipPlayer::stop() {
+    stopRequested_.store(true);
+    if (encoderThread_.joinable()) {
+        encoderThread_.join();
+    }
+    if (senderThread_.joinable()) {
+        senderThread_.join();
+    }
+
+    if (source_) {
+        source_.reset();
+        // Playback may have been cut off between a note on and its note off. Only the player's
+        // own notes are released: keys held on the keyboard meanwhile keep sounding.
+        std::vector<uint32_t> words;
+        notes_.appendNoteOffs(words);
+        if (!words.empty()) {
+            sink_(words.data(), words.size(), UmpLane::Realtime);
+        }
+        notes_.clear();
+    }
+    playing_.store(false);
+}
+
+bool MidiClipPlayer::isPlaying() const {
+    return playing_.load();
+}
+
+ClipPlayerStats MidiClipPlayer::stats() const {
+    ClipPlayerStats stats;
+    stats.packets = packets_.load(std::memory_order_relaxed);
+    stats.batches = batches_.load(std::memory_order_relaxed);
+    stats.underruns = underruns_.load(std::memory_order_relaxed);
+    stats.lateBatches = lateBatches_.load(std::memory_order_relaxed);
+    stats.maxLatenessNs = maxLatenessNs_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void MidiClipPlayer::setFinishedCallback(std::function<void(const ClipPlayerStats&)> callback) {
+    finishedCallback_ = callback;
+}
+
+void MidiClipPlayer::send(const uint32_t* words, size_t wordCount, UmpLane lane) {
+    if (lane == UmpLane::Realtime) {
+        for (size_t pos = 0; pos < wordCount; pos += umpWordCount(words[pos])) {
+            notes_.observe(words + pos);
+        }
+    }
+    packets_.fetch_add(sink_(words, wordCount, lane), std::memory_order_relaxed);
+    batches_.fetch_add(1, std::memory_order_relaxed);
+}
+
+int64_t MidiClipPlayer::elapsedNs() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime_).count();
+}
+
+void MidiClipPlayer::encodeLoop() {
+    const int64_t lookaheadNs = std::chrono::duration_cast<std::chrono::nanoseconds>(LOOKAHEAD).count();
+    const int64_t windowNs = std::chrono::duration_cast<std::chrono::nanoseconds>(BATCH_WINDOW).count();
+
+    TimedUmp event;
+    bool haveEvent = source_->next(event);
+
+    while (haveEvent && !stopRequested_.load(std::memory_order_relaxed)) {
+        uint64_t write = writeIndex_.load(std::memory_order_relaxed);
+
+        // Wait for a free slot, then until the next event is inside the lookahead window
+        if (write - readIndex_.load(std::memory_order_acquire) >= RING_BATCHES ||
+            event.timeNs > elapsedNs() + lookaheadNs) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+
+        Batch& batch = ring_[write % RING_BATCHES];
+        batch.timeNs = event.timeNs;
+        batch.wordCount = 0;
+        batch.lane = isSysExPacket(event.words[0]) ? UmpLane::Bulk : UmpLane::Realtime;
+        bool ended = false;
+        do {
+            // A bulk batch holds the packets of one SysEx message and nothing else
+            if (isSysExPacket(event.words[0]) != (batch.lane == UmpLane::Bulk) ||
+                batch.wordCount + event.wordCount > BATCH_WORDS) {
+                break;  // the rest goes into the next batch with the same due time
+            }
+            std::copy_n(event.words, event.wordCount, batch.words + batch.wordCount);
+            batch.wordCount += event.wordCount;
+            ended = batch.lane == UmpLane::Bulk && endsSysEx(event.words[0]);
+            haveEvent = source_->next(event);
+        } while (haveEvent && !ended &&
+                 (batch.lane == UmpLane::Bulk || event.timeNs - batch.timeNs <= windowNs));
+        // A message cut short by other traffic or the end of the file is sent as it is
+        batch.messageEnds = batch.lane == UmpLane::Realtime || ended || !haveEvent ||
+                            !isSysExPacket(event.words[0]);
+
+        writeIndex_.store(write + 1, std::memory_order_release);
+        encodedHorizonNs_.store(haveEvent ? event.timeNs : std::numeric_limits<int64_t>::max(),
+                                std::memory_order_release);
+    }
+
+    encoderDone_.store(true, std::memory_order_release);
+}
+
+void MidiClipPlayer::sendLoop() {
+    const int64_t lateThresholdNs = std::chrono::duration_cast<std::chrono::nanoseconds>(LATE_THRESHOLD).count();
+    bool starved = false;
+    bool finished = false;
+
+    while (!stopRequested_.load(std::memory_order_relaxed)) {
+        uint64_t read = readIndex_.load(std::memory_order_relaxed);
+
+        if (read == writeIndex_.load(std::memory_order_acquire)) {
+            if (encoderDone_.load(std::memory_order_acquire) && read == writeIndex_.load(std::memory_order_acquire)) {
+                finished = true;
+                break;
+            }
+            // Count each stall once, and only if something should already have been sent
+            if (!starved && elapsedNs() >= encodedHorizonNs_.load(std::memory_order_acquire)) {
+                starved = true;
+                underruns_.fetch_add(1, std::memory_order_relaxed);
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            continue;
+        }
+        starved = false;
+
+        const Batch& batch = ring_[read % RING_BATCHES];
+        const auto due = startTime_ + std::chrono::nanoseconds(batch.timeNs);
+
+        // Sleep in short slices so stop() stays responsive across long pauses in the file
+        while (!stopRequested_.load(std::memory_order_relaxed)) {
+            auto now = std::chrono::steady_clock::now();
+            if (now >= due) break;
+            std::this_thread::sleep_until(std::min(due, now + std::chrono::milliseconds(10)));
+        }
+        if (stopRequested_.load(std::memory_order_relaxed)) break;
+
+        int64_t lateness = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - due).count();
+        if (lateness > lateThresholdNs) {
+            lateBatches_.fetch_add(1, std::memory_order_relaxed);
+        }
+        if (lateness > maxLatenessNs_.load(std::memory_order_relaxed)) {
+            maxLatenessNs_.store(lateness, std::memory_order_relaxed);
+        }
+
+        if (batch.lane == UmpLane::Bulk && (!batch.messageEnds || !sysex_.empty())) {
+            sysex_.insert(sysex_.end(), batch.words, batch.words + batch.wordCount);
+            if (batch.messageEnds) {
+                send(sysex_.data(), sysex_.size(), UmpLane::Bulk);
+                sysex_.clear();
+            }
+        } else {
+            send(batch.words, batch.wordCount, batch.lane);
+        }
+        readIndex_.store(read + 1, std::memory_order_release);
+    }
+
+    playing_.store(false);
+
+    if (finished) {
+        ClipPlayerStats result = stats();
+        std::cout << "[PLAYER] Finished: " << result.packets << " packets in " << result.batches << " batches, "
+                  << result.underruns << " underruns, " << result.lateBatches << " late batches (max "
+                  << result.maxLatenessNs / 1000 << " us late)" << std::endl;
+        if (finishedCallback_) {
+            finishedCallback_(result);
+        }
+    }
+}
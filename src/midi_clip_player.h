@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "active_note_tracker.h"
+#include "midi_file_source.h"
+#include "output_pacer.h"
+
+class KeyboardController;
+
+struct ClipPlayerStats {
+    uint64_t packets = 0;
+    uint64_t batches = 0;
+    uint64_t underruns = 0;      // the sender found nothing encoded although a batch was already due
+    uint64_t lateBatches = 0;    // sent more than LATE_THRESHOLD after their scheduled time
+    int64_t maxLatenessNs = 0;
+};
+
+// Plays MIDI Clip Files and Standard MIDI Files through KeyboardController::sendUmpBatch().
+//
+// An encoder thread streams events from the memory-mapped file and packs them into UMP batches
+// up to LOOKAHEAD ahead of the play cursor; a sender thread waits for each batch's due time and
+// sends it. The two only share a fixed ring of preallocated batches, so neither thread allocates
+// in steady state and a slow disk page-in never stalls the sender while the ring has data. Past
+// the player, each batch costs one allocation: UmpOutputQueue copies it into a queue node.
+//
+// Channel voice and system messages go out on the realtime lane. Each SysEx message goes out
+// whole as one bulk batch; one longer than a ring slot is gathered by the sender first. The
+// notes the player has sent are tracked, so stop() releases those and leaves the rest alone.
+class MidiClipPlayer {
+public:
+    using Sink = std::function<size_t(const uint32_t* words, size_t wordCount, UmpLane lane)>;
+
+    static constexpr std::chrono::milliseconds LOOKAHEAD{250};
+    static constexpr std::chrono::microseconds BATCH_WINDOW{500};   // events this close together go out together
+    static constexpr std::chrono::milliseconds LATE_THRESHOLD{2};
+    static constexpr std::chrono::milliseconds START_DELAY{20};     // head start for the encoder before the first batch is due
+    static constexpr size_t RING_BATCHES = 512;
+    static constexpr size_t BATCH_WORDS = 256;
+
+    explicit MidiClipPlayer(KeyboardController& controller);
+    // For tests and offline use: batches go to `sink` instead of a controller
+    explicit MidiClipPlayer(Sink sink);
+    ~MidiClipPlayer();
+
+    MidiClipPlayer(const MidiClipPlayer&) = delete;
+    MidiClipPlayer& operator=(const MidiClipPlayer&) = delete;
+
+    bool start(const std::string& path);
+    void stop();
+    bool isPlaying() const;
+
+    ClipPlayerStats stats() const;
+
+    // Invoked from the sender thread when playback reaches the end of the file (not on stop()).
+    // The callback must not call stop() or start() directly; post to another thread instead.
+    void setFinishedCallback(std::function<void(const ClipPlayerStats&)> callback);
+
+private:
+    struct Batch {
+        int64_t timeNs = 0;
+        uint32_t wordCount = 0;
+        UmpLane lane = UmpLane::Realtime;  // Bulk: packets of one SysEx message and nothing else
+        bool messageEnds = true;           // false: the SysEx message continues in the next batch
+        uint32_t words[BATCH_WORDS];
+    };
+
+    void encodeLoop();
+    void sendLoop();
+    void send(const uint32_t* words, size_t wordCount, UmpLane lane);
+    int64_t elapsedNs() const;
+
+    Sink sink_;
+    std::unique_ptr<MidiEventSource> source_;
+    std::unique_ptr<Batch[]> ring_;
+
+    // Single producer (encoder) / single consumer (sender) indices into ring_
+    alignas(64) std::atomic<uint64_t> writeIndex_{0};
+    alignas(64) std::atomic<uint64_t> readIndex_{0};
+    // Time up to which the encoder has looked; an empty ring before this point is not an underrun
+    std::atomic<int64_t> encodedHorizonNs_{0};
+    std::atomic<bool> encoderDone_{false};
+
+    std::atomic<bool> stopRequested_{false};
+    std::atomic<bool> playing_{false};
+    std::chrono::steady_clock::time_point startTime_;
+    std::thread encoderThread_;
+    std::thread senderThread_;
+
+    std::atomic<uint64_t> packets_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> underruns_{0};
+    std::atomic<uint64_t> lateBatches_{0};
+    std::atomic<int64_t> maxLatenessNs_{0};
+
+    std::vector<uint32_t> sysex_;  // sender thread: a SysEx message spanning several batches
+    ActiveNoteTracker notes_;      // what the player has sent, released by stop()
+
+    std::function<void(const ClipPlayerStats&)> finishedCallback_;
+};
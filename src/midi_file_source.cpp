@@ -0,0 +1,360 @@
+#include "midi_file_source.h"
+#include "mapped_file.h"
+#include "midi1_to_midi2.h"
+#include "ump_utils.h"
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+constexpr int64_t DEFAULT_NS_PER_QUARTER = 500000000;  // 120 BPM
+
+uint32_t readBigEndian32(const uint8_t* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+           (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+uint16_t readBigEndian16(const uint8_t* p) {
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+// Converts musical ticks to nanoseconds across tempo changes without accumulating rounding error
+class TickClock {
+public:
+    void setTicksPerQuarter(uint32_t ticksPerQuarter) {
+        ticksPerQuarter_ = ticksPerQuarter ? ticksPerQuarter : 1;
+    }
+
+    // Fixed SMPTE timing: tempo changes no longer apply
+    void setTicksPerSecond(uint32_t ticksPerSecond) {
+        smpteTicksPerSecond_ = ticksPerSecond ? ticksPerSecond : 1;
+    }
+
+    void setTempo(uint64_t tick, int64_t nsPerQuarter) {
+        if (smpteTicksPerSecond_ || nsPerQuarter <= 0) return;
+        baseNs_ = toNs(tick);
+        baseTick_ = tick;
+        nsPerQuarter_ = nsPerQuarter;
+    }
+
+    int64_t toNs(uint64_t tick) const {
+        if (smpteTicksPerSecond_) {
+            return scale(tick, 1000000000, smpteTicksPerSecond_);
+        }
+        return baseNs_ + scale(tick - baseTick_, nsPerQuarter_, ticksPerQuarter_);
+    }
+
+private:
+    // ticks * numerator / denominator, split so the intermediate product cannot overflow
+    static int64_t scale(uint64_t ticks, int64_t numerator, uint32_t denominator) {
+        uint64_t whole = ticks / denominator;
+        uint64_t rest = ticks % denominator;
+        return static_cast<int64_t>(whole) * numerator + static_cast<int64_t>(rest) * numerator / denominator;
+    }
+
+    uint32_t ticksPerQuarter_ = 480;
+    uint32_t smpteTicksPerSecond_ = 0;
+    int64_t nsPerQuarter_ = DEFAULT_NS_PER_QUARTER;
+    uint64_t baseTick_ = 0;
+    int64_t baseNs_ = 0;
+};
+
+// MIDI Clip File: "SMF2CLIP" followed by big-endian UMPs, each preceded by a Delta Clockstamp
+class ClipFileSource : public MidiEventSource {
+public:
+    explicit ClipFileSource(MappedFile&& file)
+        : file_(std::move(file)), pos_(HEADER_SIZE) {
+    }
+
+    static constexpr size_t HEADER_SIZE = 8;
+
+    const char* formatName() const override { return "MIDI Clip File"; }
+
+    bool next(TimedUmp& event) override {
+        const uint8_t* data = file_.data();
+        const size_t size = file_.size();
+
+        while (!ended_ && pos_ + 4 <= size) {
+            uint32_t words[4] = {readBigEndian32(data + pos_)};
+            int count = umpWordCount(words[0]);
+            if (pos_ + count * 4 > size) {
+                break;
+            }
+            for (int i = 1; i < count; i++) {
+                words[i] = readBigEndian32(data + pos_ + i * 4);
+            }
+            pos_ += count * 4;
+
+            switch (umpMessageType(words[0])) {
+                case 0x0: {
+                    uint8_t status = (words[0] >> 20) & 0xF;
+                    if (status == 0x3) {  // Delta Clockstamp Ticks Per Quarter Note
+                        clock_.setTicksPerQuarter(words[0] & 0xFFFF);
+                    } else if (status == 0x4) {  // Delta Clockstamp
+                        tick_ += words[0] & 0xFFFFF;
+                    }
+                    continue;
+                }
+                case 0xD:
+                    // Flex Data Set Tempo (bank 0, status 0): 10 ns units per quarter note
+                    if (((words[0] >> 8) & 0xFF) == 0x00 && (words[0] & 0xFF) == 0x00) {
+                        clock_.setTempo(tick_, static_cast<int64_t>(words[1]) * 10);
+                    }
+                    continue;  // other metadata is not sent to the device
+                case 0xF:
+                    if (((words[0] >> 16) & 0x3FF) == 0x21) {  // End of Clip
+                        ended_ = true;
+                    }
+                    continue;
+                case 0x2: {
+                    uint32_t converted[2];
+                    uint8_t status = (words[0] >> 16) & 0xFF;
+                    if (converter_.convert(umpGroup(words[0]), status, (words[0] >> 8) & 0x7F, words[0] & 0x7F,
+                                           converted) == 0) {
+                        continue;
+                    }
+                    event.timeNs = clock_.toNs(tick_);
+                    event.words[0] = converted[0];
+                    event.words[1] = converted[1];
+                    event.words[2] = event.words[3] = 0;
+                    event.wordCount = 2;
+                    return true;
+                }
+                case 0x1:
+                case 0x3:
+                case 0x4:
+                case 0x5:
+                    event.timeNs = clock_.toNs(tick_);
+                    std::memcpy(event.words, words, sizeof(words));
+                    event.wordCount = static_cast<uint8_t>(count);
+                    return true;
+                default:
+                    continue;
+            }
+        }
+        return false;
+    }
+
+private:
+    MappedFile file_;
+    size_t pos_;
+    uint64_t tick_ = 0;
+    bool ended_ = false;
+    TickClock clock_;
+    Midi1ToMidi2Converter converter_;
+};
+
+// Standard MIDI File format 0/1. Tracks are merged lazily: each track keeps a cursor into the
+// mapping and the track with the earliest pending event is advanced next.
+class StandardMidiFileSource : public MidiEventSource {
+public:
+    explicit StandardMidiFileSource(MappedFile&& file)
+        : file_(std::move(file)) {
+    }
+
+    const char* formatName() const override { return "Standard MIDI File"; }
+
+    bool parseHeader() {
+        const uint8_t* data = file_.data();
+        const size_t size = file_.size();
+        if (size < 14 || readBigEndian32(data + 4) < 6) {
+            std::cerr << "[PLAYER] Truncated MThd chunk in " << file_.path() << std::endl;
+            return false;
+        }
+
+        uint16_t format = readBigEndian16(data + 8);
+        uint16_t trackCount = readBigEndian16(data + 10);
+        uint16_t division = readBigEndian16(data + 12);
+        if (format > 1) {
+            std::cerr << "[PLAYER] SMF format " << format << " is not supported" << std::endl;
+            return false;
+        }
+
+        if (division & 0x8000) {
+            int framesPerSecond = -static_cast<int8_t>(division >> 8);
+            clock_.setTicksPerSecond(static_cast<uint32_t>(framesPerSecond * (division & 0xFF)));
+        } else {
+            clock_.setTicksPerQuarter(division);
+        }
+
+        size_t pos = 8 + readBigEndian32(data + 4);
+        while (pos + 8 <= size && tracks_.size() < trackCount) {
+            uint32_t length = readBigEndian32(data + pos + 4);
+            size_t begin = pos + 8;
+            size_t end = std::min(size, begin + length);
+            if (std::memcmp(data + pos, "MTrk", 4) == 0) {
+                Track track;
+                track.pos = begin;
+                track.end = end;
+                tracks_.push_back(track);
+                advanceDelta(tracks_.back());
+            }
+            pos = begin + length;  // unknown chunks are skipped
+        }
+
+        if (tracks_.empty()) {
+            std::cerr << "[PLAYER] No tracks in " << file_.path() << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool next(TimedUmp& event) override {
+        while (pendingPos_ >= pending_.size()) {
+            pending_.clear();
+            pendingPos_ = 0;
+            if (!readNextEvent()) {
+                return false;
+            }
+        }
+
+        int count = umpWordCount(pending_[pendingPos_]);
+        event.timeNs = pendingTimeNs_;
+        for (int i = 0; i < 4; i++) {
+            event.words[i] = i < count ? pending_[pendingPos_ + i] : 0;
+        }
+        event.wordCount = static_cast<uint8_t>(count);
+        pendingPos_ += count;
+        return true;
+    }
+
+private:
+    struct Track {
+        size_t pos = 0;
+        size_t end = 0;
+        uint64_t tick = 0;
+        uint8_t runningStatus = 0;
+        bool done = false;
+    };
+
+    bool readVarLen(Track& track, uint32_t& value) {
+        const uint8_t* data = file_.data();
+        value = 0;
+        for (int i = 0; i < 4; i++) {
+            if (track.pos >= track.end) return false;
+            uint8_t byte = data[track.pos++];
+            value = (value << 7) | (byte & 0x7F);
+            if (!(byte & 0x80)) return true;
+        }
+        return false;
+    }
+
+    void advanceDelta(Track& track) {
+        uint32_t delta;
+        if (!readVarLen(track, delta)) {
+            track.done = true;
+            return;
+        }
+        track.tick += delta;
+    }
+
+    // Decodes one event of the earliest track into pending_; false when every track is done
+    bool readNextEvent() {
+        const uint8_t* data = file_.data();
+
+        while (true) {
+            Track* track = nullptr;
+            for (auto& candidate : tracks_) {
+                if (!candidate.done && (!track || candidate.tick < track->tick)) {
+                    track = &candidate;
+                }
+            }
+            if (!track) {
+                return false;
+            }
+            if (track->pos >= track->end) {
+                track->done = true;
+                continue;
+            }
+
+            pendingTimeNs_ = clock_.toNs(track->tick);
+            uint8_t status = data[track->pos];
+            if (status & 0x80) {
+                track->pos++;
+            } else {
+                status = track->runningStatus;  // running status: the byte we peeked is data
+            }
+
+            if (status == 0xFF) {
+                if (track->pos >= track->end) { track->done = true; continue; }
+                uint8_t type = data[track->pos++];
+                uint32_t length;
+                if (!readVarLen(*track, length) || track->pos + length > track->end) { track->done = true; continue; }
+                if (type == 0x51 && length == 3) {
+                    int64_t usPerQuarter = (data[track->pos] << 16) | (data[track->pos + 1] << 8) | data[track->pos + 2];
+                    clock_.setTempo(track->tick, usPerQuarter * 1000);
+                } else if (type == 0x2F) {
+                    track->done = true;
+                    continue;
+                }
+                track->pos += length;
+            } else if (status == 0xF0 || status == 0xF7) {
+                uint32_t length;
+                if (!readVarLen(*track, length) || track->pos + length > track->end) { track->done = true; continue; }
+                // F7 "escape" packets carry arbitrary bytes and are not sent; F0 bodies become SysEx7 UMPs
+                if (status == 0xF0) {
+                    size_t bodyLength = (length > 0 && data[track->pos + length - 1] == 0xF7) ? length - 1 : length;
+                    Midi1ToMidi2Converter::appendSysEx7(0, data + track->pos, bodyLength, pending_);
+                }
+                track->pos += length;
+                track->runningStatus = 0;
+            } else if (status >= 0x80 && status < 0xF0) {
+                track->runningStatus = status;
+                int dataBytes = ((status & 0xF0) == 0xC0 || (status & 0xF0) == 0xD0) ? 1 : 2;
+                if (track->pos + dataBytes > track->end) { track->done = true; continue; }
+                uint8_t data1 = data[track->pos];
+                uint8_t data2 = dataBytes == 2 ? data[track->pos + 1] : 0;
+                track->pos += dataBytes;
+
+                uint32_t words[2];
+                if (converter_.convert(0, status, data1, data2, words) == 2) {
+                    pending_.push_back(words[0]);
+                    pending_.push_back(words[1]);
+                }
+            } else {
+                std::cerr << "[PLAYER] Unexpected status byte 0x" << std::hex << static_cast<int>(status) << std::dec
+                          << " in track data; skipping the rest of the track" << std::endl;
+                track->done = true;
+                continue;
+            }
+
+            advanceDelta(*track);
+            if (!pending_.empty()) {
+                return true;
+            }
+        }
+    }
+
+    MappedFile file_;
+    std::vector<Track> tracks_;
+    TickClock clock_;
+    Midi1ToMidi2Converter converter_;
+    std::vector<uint32_t> pending_;
+    size_t pendingPos_ = 0;
+    int64_t pendingTimeNs_ = 0;
+};
+
+}
+
+std::unique_ptr<MidiEventSource> openMidiEventSource(const std::string& path) {
+    MappedFile file;
+    if (!file.openReadOnly(path)) {
+        return nullptr;
+    }
+
+    if (file.size() >= ClipFileSource::HEADER_SIZE && std::memcmp(file.data(), "SMF2CLIP", 8) == 0) {
+        return std::make_unique<ClipFileSource>(std::move(file));
+    }
+
+    if (file.size() >= 4 && std::memcmp(file.data(), "MThd", 4) == 0) {
+        auto source = std::make_unique<StandardMidiFileSource>(std::move(file));
+        if (!source->parseHeader()) {
+            return nullptr;
+        }
+        return source;
+    }
+
+    std::cerr << "[PLAYER] " << path << " is neither a MIDI Clip File nor a Standard MIDI File" << std::endl;
+    return nullptr;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// One playable UMP with its presentation time relative to the start of the file
+struct TimedUmp {
+    int64_t timeNs = 0;
+    uint32_t words[4] = {};
+    uint8_t wordCount = 0;
+};
+
+// Streaming, time-ordered view of a MIDI file. Implementations read straight from a
+// memory mapping, so only the pages around the current cursor are ever resident.
+class MidiEventSource {
+public:
+    virtual ~MidiEventSource() = default;
+
+    // Produces the next UMP in time order; returns false once the file is exhausted
+    virtual bool next(TimedUmp& event) = 0;
+    virtual const char* formatName() const = 0;
+};
+
+// Opens a MIDI Clip File ("SMF2CLIP", UMP based) or a legacy Standard MIDI File ("MThd").
+// Legacy channel voice messages are up-converted to MIDI 2.0 on the fly.
+std::unique_ptr<MidiEventSource> openMidiEventSource(const std::string& path);
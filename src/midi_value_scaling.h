@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+
+// Resolution conversion between MIDI 1.0 and MIDI 2.0 data values, following the
+// min-center-max algorithm from the MIDI 2.0 UMP specification (appendix D):
+// 0 stays 0, the center value maps exactly to the center, and the maximum maps to all ones.
+
+inline uint32_t midiScaleUp(uint32_t value, uint8_t srcBits, uint8_t dstBits) {
+    const uint8_t scaleBits = dstBits - srcBits;
+    uint32_t shifted = value << scaleBits;
+    const uint32_t srcCenter = 1u << (srcBits - 1);
+    if (value <= srcCenter) {
+        return shifted;
+    }
+
+    // Above center, fill the new low bits by repeating the source bits below the MSB
+    const uint8_t repeatBits = srcBits - 1;
+    uint32_t repeat = value & ((1u << repeatBits) - 1);
+    if (scaleBits > repeatBits) {
+        repeat <<= scaleBits - repeatBits;
+    } else {
+        repeat >>= repeatBits - scaleBits;
+    }
+    while (repeat != 0) {
+        shifted |= repeat;
+        repeat >>= repeatBits;
+    }
+    return shifted;
+}
+
+inline uint32_t midiScaleDown(uint32_t value, uint8_t srcBits, uint8_t dstBits) {
+    return value >> (srcBits - dstBits);
+}
+
+inline uint16_t midi7To16(uint8_t value) {
+    return static_cast<uint16_t>(midiScaleUp(value & 0x7F, 7, 16));
+}
+
+inline uint32_t midi7To32(uint8_t value) {
+    return midiScaleUp(value & 0x7F, 7, 32);
+}
+
+inline uint32_t midi14To32(uint16_t value) {
+    return midiScaleUp(value & 0x3FFF, 14, 32);
+}
+
+inline uint8_t midi16To7(uint16_t value) {
+    return static_cast<uint8_t>(midiScaleDown(value, 16, 7));
+}
+
+inline uint8_t midi32To7(uint32_t value) {
+    return static_cast<uint8_t>(midiScaleDown(value, 32, 7));
+}
+
+inline uint16_t midi32To14(uint32_t value) {
+    return static_cast<uint16_t>(midiScaleDown(value, 32, 14));
+}
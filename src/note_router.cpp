@@ -0,0 +1,103 @@
+#include "note_router.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+
+NoteRouter::NoteRouter() {
+    setZones({KeyboardZone{}});
+}
+
+void NoteRouter::setZones(const std::vector<KeyboardZone>& zones) {
+    zones_ = zones;
+    rebuildTable();
+}
+
+void NoteRouter::rebuildTable() {
+    table_.fill(NoteRoute{});
+
+    for (const auto& zone : zones_) {
+        int low = std::max(0, zone.lowKey);
+        int high = std::min(127, zone.highKey);
+        for (int key = low; key <= high; key++) {
+            int note = key + zone.transpose;
+            if (note < 0 || note > 127) {
+                table_[key] = NoteRoute{};
+                continue;
+            }
+            table_[key] = NoteRoute{static_cast<uint8_t>(zone.group & 0xF), static_cast<uint8_t>(zone.channel & 0xF),
+                                    static_cast<uint8_t>(note), true};
+        }
+    }
+}
+
+std::optional<NoteRoute> NoteRouter::noteOn(int key, const NoteRoute& route) {
+    if (key < 0 || key > 127 || !route.valid) return std::nullopt;
+
+    std::optional<NoteRoute> previous;
+    if (sounding_[key].valid) {
+        previous = sounding_[key];
+    } else {
+        activeCount_++;
+    }
+    sounding_[key] = route;
+    return previous;
+}
+
+std::optional<NoteRoute> NoteRouter::noteOff(int key) {
+    if (key < 0 || key > 127 || !sounding_[key].valid) return std::nullopt;
+
+    NoteRoute route = sounding_[key];
+    sounding_[key] = NoteRoute{};
+    activeCount_--;
+    return route;
+}
+
+std::vector<NoteRoute> NoteRouter::releaseAll() {
+    std::vector<NoteRoute> released;
+    released.reserve(activeCount_);
+    for (auto& route : sounding_) {
+        if (route.valid) {
+            released.push_back(route);
+            route = NoteRoute{};
+        }
+    }
+    activeCount_ = 0;
+    return released;
+}
+
+std::optional<std::vector<KeyboardZone>> NoteRouter::parseZones(const std::string& spec) {
+    std::vector<KeyboardZone> zones;
+    std::stringstream entries(spec);
+
+    for (std::string entry; std::getline(entries, entry, ',');) {
+        KeyboardZone zone;
+        int group = 0;
+        int channel = 0;
+        int transpose = 0;
+        char dash = 0, colon = 0, slash = 0;
+
+        std::istringstream in(entry);
+        if (!(in >> zone.lowKey >> dash >> zone.highKey >> colon >> group >> slash >> channel) ||
+            dash != '-' || colon != ':' || slash != '/') {
+            std::cerr << "[ROUTER] Malformed zone '" << entry << "' (expected low-high:group/channel[:transpose])" << std::endl;
+            return std::nullopt;
+        }
+        if (in >> colon) {
+            if (colon != ':' || !(in >> transpose)) {
+                std::cerr << "[ROUTER] Malformed transpose in zone '" << entry << "'" << std::endl;
+                return std::nullopt;
+            }
+        }
+
+        if (zone.lowKey < 0 || zone.highKey > 127 || zone.lowKey > zone.highKey ||
+            group < 1 || group > 16 || channel < 1 || channel > 16) {
+            std::cerr << "[ROUTER] Zone '" << entry << "' is out of range (keys 0-127, group and channel 1-16)" << std::endl;
+            return std::nullopt;
+        }
+        zone.group = static_cast<uint8_t>(group - 1);
+        zone.channel = static_cast<uint8_t>(channel - 1);
+        zone.transpose = transpose;
+        zones.push_back(zone);
+    }
+    return zones;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// A key range played on one (group, channel) destination, optionally transposed
+struct KeyboardZone {
+    int lowKey = 0;
+    int highKey = 127;
+    uint8_t group = 0;
+    uint8_t channel = 0;
+    int transpose = 0;
+};
+
+// Where a key's notes go; `valid` is false for keys outside every zone or transposed out of range
+struct NoteRoute {
+    uint8_t group = 0;
+    uint8_t channel = 0;
+    uint8_t note = 0;
+    bool valid = false;
+};
+
+// Maps keyboard keys to (group, channel, note) destinations through a 128-entry table that is
+// rebuilt whenever the zones change, so routing a note is a single lookup.
+//
+// It also remembers where each held key was sent, so that a Note Off always reaches the
+// destination of its Note On even if the zones change while the key is down, and so that
+// all-notes-off only has to release what is actually sounding. Used from the UI thread.
+class NoteRouter {
+public:
+    NoteRouter();
+
+    // Later zones take precedence where ranges overlap. An empty list routes nothing.
+    void setZones(const std::vector<KeyboardZone>& zones);
+    const std::vector<KeyboardZone>& zones() const { return zones_; }
+
+    // Group for messages that are not tied to a key (controllers, RPN/NRPN, the control panel)
+    void setControlGroup(uint8_t group) { controlGroup_ = group & 0xF; }
+    uint8_t controlGroup() const { return controlGroup_; }
+
+    NoteRoute route(int key) const {
+        return (key >= 0 && key < 128) ? table_[key] : NoteRoute{};
+    }
+
+    // Records a sounding key; returns the route of an earlier, still held note on that key (if any)
+    std::optional<NoteRoute> noteOn(int key, const NoteRoute& route);
+    // Where a held key's Note On went (per-note messages for that key must follow it)
+    std::optional<NoteRoute> sounding(int key) const {
+        if (key < 0 || key > 127 || !sounding_[key].valid) return std::nullopt;
+        return sounding_[key];
+    }
+    // Forgets a key and returns where its Note On went
+    std::optional<NoteRoute> noteOff(int key);
+    // Returns and forgets every sounding key's route
+    std::vector<NoteRoute> releaseAll();
+    int activeKeyCount() const { return activeCount_; }
+
+    // Parses "low-high:group/channel[:transpose],..." with 1-based group and channel numbers,
+    // e.g. "0-59:2/1,60-127:1/1:+12". Returns nullopt (and logs) on malformed input.
+    static std::optional<std::vector<KeyboardZone>> parseZones(const std::string& spec);
+
+private:
+    void rebuildTable();
+
+    std::vector<KeyboardZone> zones_;
+    std::array<NoteRoute, 128> table_;
+    std::array<NoteRoute, 128> sounding_;  // valid = key is down
+    int activeCount_ = 0;
+    uint8_t controlGroup_ = 0;
+};
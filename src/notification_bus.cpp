@@ -0,0 +1,180 @@
+#include "notification_bus.h"
+#include <algorithm>
+#include <iostream>
+#include "latency_tracker.h"
+
+void mergePropertyRowUpdate(PropertyRowUpdate& merged, const PropertyRowUpdate& next) {
+    if (merged.reset || next.reset) {
+        merged.reset = true;
+        merged.rows.clear();
+        return;
+    }
+    std::vector<size_t> rows;
+    rows.reserve(merged.rows.size() + next.rows.size());
+    std::set_union(merged.rows.begin(), merged.rows.end(), next.rows.begin(), next.rows.end(),
+                   std::back_inserter(rows));
+    merged.rows = std::move(rows);
+}
+
+NotificationBus::NotificationBus(std::chrono::nanoseconds frameInterval)
+    : frameIntervalNs_(frameInterval.count()) {
+}
+
+void NotificationBus::setWaker(Waker waker) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    waker_ = std::move(waker);
+}
+
+void NotificationBus::setDevicesHandler(std::function<void()> handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    devicesHandler_ = std::move(handler);
+}
+
+void NotificationBus::setConnectionHandler(std::function<void(bool)> handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    connectionHandler_ = std::move(handler);
+}
+
+void NotificationBus::setPropertiesHandler(std::function<void(uint32_t)> handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    propertiesHandler_ = std::move(handler);
+}
+
+void NotificationBus::setPropertyRowsHandler(std::function<void(uint32_t, const PropertyRowUpdate&)> handler) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    propertyRowsHandler_ = std::move(handler);
+}
+
+void NotificationBus::postDevicesChanged() {
+    std::optional<std::chrono::nanoseconds> delay;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.devicesPosted++;
+        pending_.devices = true;
+        delay = scheduleLocked(LatencyTracker::now());
+    }
+    wake(delay);
+}
+
+void NotificationBus::postConnectionChanged(bool connected) {
+    std::optional<std::chrono::nanoseconds> delay;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.connectionPosted++;
+        pending_.connection = true;
+        pending_.connected = connected;
+        delay = scheduleLocked(LatencyTracker::now());
+    }
+    wake(delay);
+}
+
+void NotificationBus::postPropertiesChanged(uint32_t muid) {
+    std::optional<std::chrono::nanoseconds> delay;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.propertiesPosted++;
+        pending_.properties.insert(muid);
+        // The full refresh rereads every list of the device; its row updates are redundant
+        auto first = pending_.rows.lower_bound({muid, std::string()});
+        auto last = first;
+        while (last != pending_.rows.end() && last->first.first == muid) {
+            ++last;
+        }
+        pending_.rows.erase(first, last);
+        delay = scheduleLocked(LatencyTracker::now());
+    }
+    wake(delay);
+}
+
+void NotificationBus::postPropertyRows(uint32_t muid, const PropertyRowUpdate& update) {
+    if (update.empty()) {
+        return;
+    }
+    std::optional<std::chrono::nanoseconds> delay;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.propertiesPosted++;
+        if (!pending_.properties.contains(muid)) {
+            auto [it, inserted] = pending_.rows.try_emplace({muid, update.resource}, update);
+            if (!inserted) {
+                mergePropertyRowUpdate(it->second, update);
+            }
+        }
+        delay = scheduleLocked(LatencyTracker::now());
+    }
+    wake(delay);
+}
+
+std::optional<std::chrono::nanoseconds> NotificationBus::scheduleLocked(int64_t nowNs) {
+    if (scheduled_ || !waker_) {
+        return std::nullopt;
+    }
+    scheduled_ = true;
+    return std::chrono::nanoseconds(std::max<int64_t>(0, lastDeliveryNs_ + frameIntervalNs_ - nowNs));
+}
+
+void NotificationBus::wake(std::optional<std::chrono::nanoseconds> delay) {
+    if (!delay) {
+        return;
+    }
+    Waker waker;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        waker = waker_;
+    }
+    if (waker) {
+        waker(*delay);
+    }
+}
+
+void NotificationBus::deliver() {
+    deliver(LatencyTracker::now());
+}
+
+void NotificationBus::deliver(int64_t nowNs) {
+    Pending batch;
+    std::function<void()> devicesHandler;
+    std::function<void(bool)> connectionHandler;
+    std::function<void(uint32_t)> propertiesHandler;
+    std::function<void(uint32_t, const PropertyRowUpdate&)> propertyRowsHandler;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::swap(batch, pending_);
+        scheduled_ = false;
+        if (batch.empty()) {
+            return;
+        }
+        lastDeliveryNs_ = nowNs;
+        stats_.deliveries++;
+        stats_.devicesDelivered += batch.devices ? 1 : 0;
+        stats_.connectionDelivered += batch.connection ? 1 : 0;
+        stats_.propertiesDelivered += batch.properties.size() + batch.rows.size();
+        devicesHandler = devicesHandler_;
+        connectionHandler = connectionHandler_;
+        propertiesHandler = propertiesHandler_;
+        propertyRowsHandler = propertyRowsHandler_;
+    }
+
+    // Connection first: the device list it invalidates is refreshed right after
+    if (batch.connection && connectionHandler) {
+        connectionHandler(batch.connected);
+    }
+    if (batch.devices && devicesHandler) {
+        devicesHandler();
+    }
+    if (propertiesHandler) {
+        for (uint32_t muid : batch.properties) {
+            propertiesHandler(muid);
+        }
+    }
+    if (propertyRowsHandler) {
+        for (const auto& [key, update] : batch.rows) {
+            propertyRowsHandler(key.first, update);
+        }
+    }
+}
+
+NotificationBusStats NotificationBus::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <utility>
+#include "property_model.h"
+
+// How many notifications were posted and how many reached the handlers, per topic
+struct NotificationBusStats {
+    uint64_t devicesPosted = 0;
+    uint64_t devicesDelivered = 0;
+    uint64_t connectionPosted = 0;
+    uint64_t connectionDelivered = 0;
+    uint64_t propertiesPosted = 0;     // full refreshes and row updates, per MUID
+    uint64_t propertiesDelivered = 0;
+    uint64_t deliveries = 0;           // deliver() calls that had something to do
+};
+
+// Carries controller notifications (any thread) to the UI thread, coalesced per topic.
+//
+// Posting only sets a dirty flag for the topic (devices, connection state, properties of one MUID)
+// and, if nothing is scheduled yet, asks the waker to call deliver() on the UI thread, no sooner
+// than one frame after the previous delivery. deliver() takes all dirty topics at once and calls
+// each handler at most once, so a discovery answered by 50 devices rebuilds the device list once
+// per frame instead of once per reply. State topics deliver the latest value; row updates for a
+// property list are merged, and dropped when a full refresh of the same device is pending.
+class NotificationBus {
+public:
+    static constexpr std::chrono::nanoseconds DEFAULT_FRAME_INTERVAL = std::chrono::milliseconds(16);
+
+    // Must arrange for deliver() to run on the UI thread after `delay`
+    using Waker = std::function<void(std::chrono::nanoseconds delay)>;
+
+    explicit NotificationBus(std::chrono::nanoseconds frameInterval = DEFAULT_FRAME_INTERVAL);
+
+    void setWaker(Waker waker);
+    // Handlers run on the thread that calls deliver()
+    void setDevicesHandler(std::function<void()> handler);
+    void setConnectionHandler(std::function<void(bool)> handler);
+    void setPropertiesHandler(std::function<void(uint32_t)> handler);
+    void setPropertyRowsHandler(std::function<void(uint32_t, const PropertyRowUpdate&)> handler);
+
+    void postDevicesChanged();
+    void postConnectionChanged(bool connected);
+    void postPropertiesChanged(uint32_t muid);
+    void postPropertyRows(uint32_t muid, const PropertyRowUpdate& update);
+
+    void deliver();
+    void deliver(int64_t nowNs);
+
+    NotificationBusStats stats() const;
+
+private:
+    struct Pending {
+        bool devices = false;
+        bool connection = false;
+        bool connected = false;
+        std::set<uint32_t> properties;
+        std::map<std::pair<uint32_t, std::string>, PropertyRowUpdate> rows;
+
+        bool empty() const { return !devices && !connection && properties.empty() && rows.empty(); }
+    };
+
+    // Called with mutex_ held; returns the delay to pass to the waker, or nothing if already scheduled
+    std::optional<std::chrono::nanoseconds> scheduleLocked(int64_t nowNs);
+    void wake(std::optional<std::chrono::nanoseconds> delay);
+
+    const int64_t frameIntervalNs_;
+    mutable std::mutex mutex_;
+    Pending pending_;
+    bool scheduled_ = false;
+    int64_t lastDeliveryNs_ = 0;
+    NotificationBusStats stats_;
+
+    Waker waker_;
+    std::function<void()> devicesHandler_;
+    std::function<void(bool)> connectionHandler_;
+    std::function<void(uint32_t)> propertiesHandler_;
+    std::function<void(uint32_t, const PropertyRowUpdate&)> propertyRowsHandler_;
+};
+
+// Folds `next` into `merged`: a reset wins, otherwise the changed rows are united
+void mergePropertyRowUpdate(PropertyRowUpdate& merged, const PropertyRowUpdate& next);
@@ -0,0 +1,167 @@
+#include "output_pacer.h"
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include "ump_utils.h"
+
+size_t umpMidi1WireBytes(const uint32_t* words) {
+    uint32_t word0 = words[0];
+    switch (umpMessageType(word0)) {
+        case 0x1: {  // system common / real-time
+            uint8_t status = static_cast<uint8_t>(word0 >> 16);
+            return status == 0xF2 ? 3 : (status == 0xF1 || status == 0xF3) ? 2 : 1;
+        }
+        case 0x2: {  // MIDI 1.0 channel voice
+            uint8_t status = static_cast<uint8_t>(word0 >> 16) & 0xF0;
+            return (status == 0xC0 || status == 0xD0) ? 2 : 3;
+        }
+        case 0x3: {  // SysEx7: data bytes, plus F0 on the first packet and F7 on the last
+            uint8_t status = (word0 >> 20) & 0xF;
+            size_t bytes = std::min<size_t>((word0 >> 16) & 0xF, 6);
+            bool first = status == 0x0 || status == 0x1;
+            bool last = status == 0x0 || status == 0x3;
+            return bytes + (first ? 1 : 0) + (last ? 1 : 0);
+        }
+        case 0x4: {  // MIDI 2.0 channel voice, as a translator would emit it
+            switch ((word0 >> 20) & 0xF) {
+                case 0x2: case 0x3: case 0x4: case 0x5:  // (relative) RPN/NRPN: 101/100 (99/98), 6, 38
+                    return 12;
+                case 0xC:  // program change, with bank select MSB/LSB if valid
+                    return (word0 & 0x1) ? 8 : 2;
+                case 0xD:  // channel pressure
+                    return 2;
+                case 0x8: case 0x9: case 0xA: case 0xB: case 0xE:
+                    return 3;
+                default:  // per-note controllers, per-note pitch bend, per-note management
+                    return 0;
+            }
+        }
+        case 0x5:  // SysEx8 has no MIDI 1.0 form; count its payload
+            return std::min<size_t>((word0 >> 16) & 0xF, 14);
+        default:
+            return 0;
+    }
+}
+
+uint32_t PacingBudget::effectiveBurst() const {
+    if (burstBytes > 0) {
+        return burstBytes;
+    }
+    return std::max<uint32_t>(bytesPerSecond / 50, 8);
+}
+
+OutputPacingConfig OutputPacingConfig::din() {
+    OutputPacingConfig config;
+    config.voice.bytesPerSecond = 1000;
+    config.bulk.bytesPerSecond = 2000;
+    return config;
+}
+
+OutputPacingConfig OutputPacingConfig::ble() {
+    OutputPacingConfig config;
+    config.voice.bytesPerSecond = 1500;
+    config.bulk.bytesPerSecond = 2500;
+    return config;
+}
+
+std::optional<OutputPacingConfig> OutputPacingConfig::parse(const std::string& spec) {
+    if (spec == "din") {
+        return din();
+    }
+    if (spec == "ble") {
+        return ble();
+    }
+    if (spec == "off") {
+        return OutputPacingConfig{};
+    }
+
+    OutputPacingConfig config;
+    std::stringstream entries(spec);
+    for (std::string entry; std::getline(entries, entry, ',');) {
+        auto equals = entry.find('=');
+        std::string lane = entry.substr(0, equals);
+        PacingBudget* budget = lane == "voice" ? &config.voice : lane == "bulk" ? &config.bulk : nullptr;
+        if (!budget || equals == std::string::npos) {
+            std::cerr << "[PACING] Malformed budget '" << entry << "' (expected voice=<bytes/s>[/<burst>] or bulk=...)"
+                      << std::endl;
+            return std::nullopt;
+        }
+
+        std::istringstream in(entry.substr(equals + 1));
+        char slash = 0;
+        if (!(in >> budget->bytesPerSecond) || (in >> slash && (slash != '/' || !(in >> budget->burstBytes))) ||
+            !in.eof()) {
+            std::cerr << "[PACING] Malformed rate in '" << entry << "'" << std::endl;
+            return std::nullopt;
+        }
+    }
+    return config;
+}
+
+OutputPacer::OutputPacer(const OutputPacingConfig& config) {
+    configure(config, 0);
+}
+
+void OutputPacer::configure(const OutputPacingConfig& config, int64_t nowNs) {
+    config_ = config;
+    lanes_[index(UmpLane::Realtime)].budget = config.voice;
+    lanes_[index(UmpLane::Bulk)].budget = config.bulk;
+    for (auto& lane : lanes_) {
+        // A new budget starts with a full burst, as after an idle period
+        lane.tokens = lane.budget.effectiveBurst();
+        lane.refilledNs = nowNs;
+    }
+}
+
+void OutputPacer::refill(Lane& lane, int64_t nowNs) {
+    if (nowNs > lane.refilledNs) {
+        lane.tokens = std::min<double>(lane.budget.effectiveBurst(),
+                                       lane.tokens + (nowNs - lane.refilledNs) * 1e-9 * lane.budget.bytesPerSecond);
+        lane.refilledNs = nowNs;
+    }
+}
+
+int64_t OutputPacer::delayNs(UmpLane lane, size_t bytes, int64_t nowNs) {
+    Lane& state = lanes_[index(lane)];
+    if (!state.budget.isLimited() || bytes == 0) {
+        return 0;
+    }
+    refill(state, nowNs);
+    // Anything up to a full bucket may go at once; larger messages wait for a full bucket
+    double needed = std::min<double>(bytes, state.budget.effectiveBurst());
+    if (state.tokens >= needed) {
+        return 0;
+    }
+    return static_cast<int64_t>((needed - state.tokens) * 1e9 / state.budget.bytesPerSecond) + 1;
+}
+
+void OutputPacer::consume(UmpLane lane, size_t bytes, int64_t nowNs) {
+    Lane& state = lanes_[index(lane)];
+    if (state.budget.isLimited()) {
+        refill(state, nowNs);
+        state.tokens -= bytes;
+    }
+
+    state.totalBytes += bytes;
+    if (state.windowStartNs < 0) {
+        state.windowStartNs = nowNs;
+    } else if (nowNs - state.windowStartNs >= THROUGHPUT_WINDOW_NS) {
+        state.lastWindowRate = state.windowBytes * 1e9 / (nowNs - state.windowStartNs);
+        state.windowStartNs = nowNs;
+        state.windowBytes = 0;
+    }
+    state.windowBytes += bytes;
+}
+
+double OutputPacer::throughput(UmpLane lane, int64_t nowNs) const {
+    const Lane& state = lanes_[index(lane)];
+    if (state.windowStartNs < 0) {
+        return 0;
+    }
+    int64_t elapsed = nowNs - state.windowStartNs;
+    if (elapsed >= THROUGHPUT_WINDOW_NS) {
+        // Idle since the window started: the current window is the complete one
+        return state.windowBytes * 1e9 / elapsed;
+    }
+    return std::max(state.lastWindowRate, 0.0);
+}
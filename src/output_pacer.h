@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// Priority of outgoing traffic; each lane has its own pacing budget
+enum class UmpLane : uint8_t {
+    Realtime,  // notes, controllers, expression: sent before any bulk batch that is still waiting
+    Bulk,      // MIDI-CI / SysEx messages: sent one whole message at a time, in order
+};
+
+// Bytes a UMP occupies once bridged to a MIDI 1.0 byte stream (DIN, BLE MIDI 1.0), including the
+// F0/F7 framing of SysEx; messages a bridge drops (utility, per-note, stream, flex data) cost 0
+size_t umpMidi1WireBytes(const uint32_t* words);
+
+// One token bucket: sustained rate in MIDI 1.0 wire bytes per second, and how much may go out
+// back to back after an idle period
+struct PacingBudget {
+    uint32_t bytesPerSecond = 0;  // 0 = unlimited
+    uint32_t burstBytes = 0;      // 0 = 20 ms worth of the rate
+
+    bool isLimited() const { return bytesPerSecond > 0; }
+    uint32_t effectiveBurst() const;
+};
+
+// Separate budgets keep a large property transfer from using up the link: channel voice traffic
+// keeps its share however much SysEx is queued
+struct OutputPacingConfig {
+    PacingBudget voice;  // UmpLane::Realtime
+    PacingBudget bulk;   // UmpLane::Bulk
+
+    bool isEnabled() const { return voice.isLimited() || bulk.isLimited(); }
+
+    // DIN MIDI 1.0 runs at 3125 bytes/s; a third is kept for voice messages
+    static OutputPacingConfig din();
+    // Conservative for BLE MIDI 1.0 at a 15 ms connection interval
+    static OutputPacingConfig ble();
+
+    // Parses "din", "ble", "off" or "voice=<bytes/s>[/<burst>],bulk=<bytes/s>[/<burst>]" (either part
+    // may be left out). Returns nullopt (and logs) on malformed input.
+    static std::optional<OutputPacingConfig> parse(const std::string& spec);
+};
+
+// Token buckets for one output port plus measured throughput per lane. Single-threaded: owned by
+// the thread that writes to the port; time is passed in (steady clock ns).
+class OutputPacer {
+public:
+    static constexpr int64_t THROUGHPUT_WINDOW_NS = 1'000'000'000;
+
+    explicit OutputPacer(const OutputPacingConfig& config = {});
+
+    void configure(const OutputPacingConfig& config, int64_t nowNs);
+    const OutputPacingConfig& config() const { return config_; }
+
+    // How long `bytes` must wait before they fit the lane's budget (0 = send now)
+    int64_t delayNs(UmpLane lane, size_t bytes, int64_t nowNs);
+    // Takes the tokens; a message larger than the burst leaves the bucket in debt
+    void consume(UmpLane lane, size_t bytes, int64_t nowNs);
+
+    // Bytes per second actually sent over the last complete one-second window; 0 until there is one
+    double throughput(UmpLane lane, int64_t nowNs) const;
+    uint64_t totalBytes(UmpLane lane) const { return lanes_[index(lane)].totalBytes; }
+
+private:
+    struct Lane {
+        PacingBudget budget;
+        double tokens = 0;
+        int64_t refilledNs = 0;
+        uint64_t totalBytes = 0;
+        int64_t windowStartNs = -1;
+        uint64_t windowBytes = 0;
+        double lastWindowRate = -1;  // < 0: no window completed yet
+    };
+
+    static size_t index(UmpLane lane) { return static_cast<size_t>(lane); }
+    static void refill(Lane& lane, int64_t nowNs);
+
+    OutputPacingConfig config_;
+    Lane lanes_[2];
+};
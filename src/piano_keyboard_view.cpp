@@ -0,0 +1,367 @@
+#include "piano_keyboard_view.h"
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPointingDevice>
+#include <QScrollBar>
+#include <QTabletEvent>
+#include <QTouchEvent>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
+#include "latency_tracker.h"
+
+namespace {
+constexpr int BASE_WHITE_KEY_WIDTH = 24;
+constexpr int WHITE_KEY_COUNT = 75;  // notes 0-127 span ten octaves plus C-G
+constexpr double MIN_ZOOM = 0.5;
+constexpr double MAX_ZOOM = 4.0;
+
+constexpr bool BLACK_PITCH_CLASS[12] = {false, true, false, true, false, false, true, false, true, false, true, false};
+constexpr int WHITE_INDEX_IN_OCTAVE[12] = {0, 0, 1, 1, 2, 3, 3, 4, 4, 5, 5, 6};
+}
+
+PianoKeyboardView::PianoKeyboardView(QWidget* parent)
+    : QAbstractScrollArea(parent), m_zoom(1.0), m_whiteKeyWidth(BASE_WHITE_KEY_WIDTH), m_blackKeyWidth(0),
+      m_contentWidth(0), m_blackKeyHeight(0), m_dragBendsPitch(false) {
+    m_pressCount.fill(0);
+    m_highlighted.fill(false);
+    for (int note = 0; note < 128; note++) {
+        m_isBlack[note] = BLACK_PITCH_CLASS[note % 12];
+    }
+
+    setHorizontalScrollBarPolicy(Qt::ScrollBarAsNeeded);
+    setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+    viewport()->setAttribute(Qt::WA_AcceptTouchEvents);
+    viewport()->setAttribute(Qt::WA_OpaquePaintEvent);
+
+    rebuildGeometry();
+    scrollToNote(60);
+}
+
+QSize PianoKeyboardView::sizeHint() const {
+    return QSize(36 * m_whiteKeyWidth, 140);  // about five octaves
+}
+
+QSize PianoKeyboardView::minimumSizeHint() const {
+    return QSize(200, 100);
+}
+
+void PianoKeyboardView::setZoom(double zoom) {
+    zoom = std::clamp(zoom, MIN_ZOOM, MAX_ZOOM);
+    if (zoom == m_zoom) return;
+
+    // Keep the key under the center of the view in place
+    double centerFraction = m_contentWidth > 0
+        ? (horizontalScrollBar()->value() + viewport()->width() / 2.0) / m_contentWidth : 0.5;
+    m_zoom = zoom;
+    rebuildGeometry();
+    horizontalScrollBar()->setValue(static_cast<int>(centerFraction * m_contentWidth - viewport()->width() / 2.0));
+    viewport()->update();
+}
+
+void PianoKeyboardView::scrollToNote(int note) {
+    note = std::clamp(note, 0, 127);
+    horizontalScrollBar()->setValue(m_keyRects[note].center().x() - viewport()->width() / 2);
+}
+
+void PianoKeyboardView::setNoteHighlighted(int note, bool highlighted) {
+    if (note < 0 || note > 127 || m_highlighted[note] == highlighted) return;
+    m_highlighted[note] = highlighted;
+    updateKey(note);
+}
+
+bool PianoKeyboardView::isNotePressed(int note) const {
+    return note >= 0 && note < 128 && m_pressCount[note] > 0;
+}
+
+void PianoKeyboardView::rebuildGeometry() {
+    m_whiteKeyWidth = std::max(6, static_cast<int>(std::lround(BASE_WHITE_KEY_WIDTH * m_zoom)));
+    m_blackKeyWidth = m_whiteKeyWidth * 3 / 5;
+    m_contentWidth = WHITE_KEY_COUNT * m_whiteKeyWidth;
+
+    const int height = std::max(1, viewport()->height());
+    m_blackKeyHeight = height * 62 / 100;
+
+    for (int note = 0; note < 128; note++) {
+        int whiteIndex = (note / 12) * 7 + WHITE_INDEX_IN_OCTAVE[note % 12];
+        if (m_isBlack[note]) {
+            // Black keys straddle the boundary after the white key they share an index with
+            int x = (whiteIndex + 1) * m_whiteKeyWidth - m_blackKeyWidth / 2;
+            m_keyRects[note] = QRect(x, 0, m_blackKeyWidth, m_blackKeyHeight);
+        } else {
+            m_keyRects[note] = QRect(whiteIndex * m_whiteKeyWidth, 0, m_whiteKeyWidth, height);
+        }
+    }
+
+    m_whiteKeyAtColumn.assign(m_contentWidth, 0);
+    m_blackKeyAtColumn.assign(m_contentWidth, -1);
+    for (int note = 0; note < 128; note++) {
+        const QRect& rect = m_keyRects[note];
+        auto& table = m_isBlack[note] ? m_blackKeyAtColumn : m_whiteKeyAtColumn;
+        for (int x = std::max(0, rect.left()); x <= rect.right() && x < m_contentWidth; x++) {
+            table[x] = static_cast<int8_t>(note);
+        }
+    }
+
+    horizontalScrollBar()->setRange(0, std::max(0, m_contentWidth - viewport()->width()));
+    horizontalScrollBar()->setPageStep(viewport()->width());
+    horizontalScrollBar()->setSingleStep(m_whiteKeyWidth);
+}
+
+int PianoKeyboardView::noteAt(const QPoint& viewportPos) const {
+    int x = viewportPos.x() + horizontalScrollBar()->value();
+    if (x < 0 || x >= m_contentWidth || viewportPos.y() < 0 || viewportPos.y() >= viewport()->height()) {
+        return -1;
+    }
+    if (viewportPos.y() < m_blackKeyHeight && m_blackKeyAtColumn[x] >= 0) {
+        return m_blackKeyAtColumn[x];
+    }
+    return m_whiteKeyAtColumn[x];
+}
+
+QRect PianoKeyboardView::keyRectInViewport(int note) const {
+    return m_keyRects[note].translated(-horizontalScrollBar()->value(), 0);
+}
+
+void PianoKeyboardView::updateKey(int note) {
+    // A white key's rectangle also covers the neighbouring black keys' lower halves, which
+    // paintEvent redraws on top because it paints everything intersecting the dirty region
+    viewport()->update(keyRectInViewport(note));
+}
+
+void PianoKeyboardView::paintEvent(QPaintEvent* event) {
+    QPainter painter(viewport());
+    const int offset = horizontalScrollBar()->value();
+    const QRect dirty = event->rect().translated(offset, 0);
+
+    painter.fillRect(event->rect(), QColor(0x30, 0x30, 0x30));
+    painter.translate(-offset, 0);
+
+    QFont font = painter.font();
+    font.setPixelSize(std::clamp(m_whiteKeyWidth / 2, 8, 12));
+    painter.setFont(font);
+
+    for (int pass = 0; pass < 2; pass++) {
+        const bool black = pass == 1;
+        for (int note = 0; note < 128; note++) {
+            if (m_isBlack[note] != black || !m_keyRects[note].intersects(dirty)) continue;
+
+            const QRect rect = m_keyRects[note].adjusted(0, 0, -1, -1);
+            QColor fill;
+            if (m_pressCount[note] > 0) {
+                fill = black ? QColor(0x3a, 0x6e, 0xc8) : QColor(0x9e, 0xcb, 0xff);
+            } else if (m_highlighted[note]) {
+                fill = black ? QColor(0x2e, 0x7d, 0x4f) : QColor(0xb8, 0xe6, 0xc4);
+            } else {
+                fill = black ? QColor(0x1a, 0x1a, 0x1a) : Qt::white;
+            }
+            painter.fillRect(rect, fill);
+            painter.setPen(QColor(0x33, 0x33, 0x33));
+            painter.drawRect(rect);
+
+            if (!black && note % 12 == 0 && m_whiteKeyWidth >= 16) {
+                painter.setPen(QColor(0x60, 0x60, 0x60));
+                painter.drawText(rect.adjusted(0, 0, 0, -4), Qt::AlignHCenter | Qt::AlignBottom,
+                                 QString("C%1").arg(note / 12 - 1));
+            }
+        }
+    }
+}
+
+void PianoKeyboardView::resizeEvent(QResizeEvent* event) {
+    QAbstractScrollArea::resizeEvent(event);
+    rebuildGeometry();
+}
+
+void PianoKeyboardView::scrollContentsBy(int dx, int dy) {
+    Q_UNUSED(dy);
+    viewport()->scroll(dx, 0);
+}
+
+float PianoKeyboardView::velocityAt(int note, const QPointF& pos) const {
+    const QRect& rect = m_keyRects[note];
+    float fraction = static_cast<float>((pos.y() - rect.top()) / std::max(1, rect.height()));
+    return std::clamp(fraction, 0.02f, 1.0f);
+}
+
+void PianoKeyboardView::pressNote(int note, float velocity) {
+    if (note < 0 || note > 127) return;
+    if (m_pressCount[note]++ == 0) {
+        LatencyTracker::instance().markUiEvent();
+        updateKey(note);
+        emit notePressed(note, velocity);
+    }
+}
+
+void PianoKeyboardView::releaseNote(int note) {
+    if (note < 0 || note > 127 || m_pressCount[note] == 0) return;
+    if (--m_pressCount[note] == 0) {
+        LatencyTracker::instance().markUiEvent();
+        updateKey(note);
+        emit noteReleased(note);
+    }
+}
+
+void PianoKeyboardView::releaseAllNotes() {
+    m_mouse = Pointer{};
+    m_touches.clear();
+    for (int note = 0; note < 128; note++) {
+        if (m_pressCount[note] > 0) {
+            m_pressCount[note] = 1;
+            releaseNote(note);
+        }
+    }
+}
+
+void PianoKeyboardView::pointerPressed(Pointer& pointer, const QPointF& pos, float pressure) {
+    pointerReleased(pointer);
+    pointer.note = noteAt(pos.toPoint());
+    pointer.pressPos = pos;
+    if (pointer.note < 0) return;
+
+    pressNote(pointer.note, velocityAt(pointer.note, pos));
+    if (pressure >= 0.0f) {
+        emit notePressureChanged(pointer.note, pressure);
+    }
+}
+
+void PianoKeyboardView::pointerMoved(Pointer& pointer, const QPointF& pos, float pressure) {
+    if (pointer.note < 0) return;
+
+    if (m_dragBendsPitch) {
+        // One octave of white keys spans twelve semitones
+        float semitones = static_cast<float>((pos.x() - pointer.pressPos.x()) * 12.0 / (7.0 * m_whiteKeyWidth));
+        emit noteBendChanged(pointer.note, semitones);
+    } else {
+        // Glissando: sliding onto another key releases the previous one
+        int note = noteAt(pos.toPoint());
+        if (note >= 0 && note != pointer.note) {
+            pressNote(note, velocityAt(note, pos));
+            releaseNote(pointer.note);
+            pointer.note = note;
+            pointer.pressPos = pos;
+        }
+    }
+
+    if (pressure >= 0.0f) {
+        emit notePressureChanged(pointer.note, pressure);
+    }
+}
+
+void PianoKeyboardView::pointerReleased(Pointer& pointer) {
+    releaseNote(pointer.note);
+    pointer.note = -1;
+}
+
+void PianoKeyboardView::mousePressEvent(QMouseEvent* event) {
+    if (event->button() != Qt::LeftButton) return;
+    pointerPressed(m_mouse, event->position(), -1.0f);
+}
+
+void PianoKeyboardView::mouseMoveEvent(QMouseEvent* event) {
+    if (!(event->buttons() & Qt::LeftButton)) return;
+    pointerMoved(m_mouse, event->position(), -1.0f);
+}
+
+void PianoKeyboardView::mouseReleaseEvent(QMouseEvent* event) {
+    if (event->button() != Qt::LeftButton) return;
+    pointerReleased(m_mouse);
+}
+
+void PianoKeyboardView::wheelEvent(QWheelEvent* event) {
+    const QPoint delta = event->angleDelta();
+    if (event->modifiers() & Qt::ControlModifier) {
+        setZoom(m_zoom * std::pow(1.0015, delta.y()));
+    } else {
+        int steps = delta.x() != 0 ? delta.x() : delta.y();
+        horizontalScrollBar()->setValue(horizontalScrollBar()->value() - steps * m_whiteKeyWidth / 40);
+    }
+    event->accept();
+}
+
+bool PianoKeyboardView::viewportEvent(QEvent* event) {
+    switch (event->type()) {
+        case QEvent::TouchBegin:
+        case QEvent::TouchUpdate:
+        case QEvent::TouchEnd:
+        case QEvent::TouchCancel:
+            handleTouch(static_cast<QTouchEvent*>(event));
+            return true;
+        case QEvent::TabletPress:
+        case QEvent::TabletMove:
+        case QEvent::TabletRelease:
+            handleTablet(static_cast<QTabletEvent*>(event));
+            return true;
+        default:
+            return QAbstractScrollArea::viewportEvent(event);
+    }
+}
+
+void PianoKeyboardView::handleTablet(QTabletEvent* event) {
+    const float pressure = static_cast<float>(event->pressure());
+    switch (event->type()) {
+        case QEvent::TabletPress:
+            pointerPressed(m_mouse, event->position(), pressure);
+            break;
+        case QEvent::TabletMove:
+            if (event->buttons() != Qt::NoButton) {
+                pointerMoved(m_mouse, event->position(), pressure);
+            }
+            break;
+        case QEvent::TabletRelease:
+            pointerReleased(m_mouse);
+            break;
+        default:
+            break;
+    }
+    event->accept();  // no synthesized mouse events on top
+}
+
+void PianoKeyboardView::handleTouch(QTouchEvent* event) {
+    if (event->type() == QEvent::TouchCancel) {
+        for (auto& [id, pointer] : m_touches) {
+            pointerReleased(pointer);
+        }
+        m_touches.clear();
+        event->accept();
+        return;
+    }
+
+    const bool hasPressure = event->pointingDevice() &&
+                             event->pointingDevice()->capabilities().testFlag(QInputDevice::Capability::Pressure);
+
+    for (const QEventPoint& point : event->points()) {
+        const float pressure = hasPressure ? static_cast<float>(point.pressure()) : -1.0f;
+
+        switch (point.state()) {
+            case QEventPoint::State::Pressed:
+                pointerPressed(m_touches[point.id()], point.position(), pressure);
+                break;
+            case QEventPoint::State::Updated:
+            case QEventPoint::State::Stationary: {
+                auto held = m_touches.find(point.id());
+                if (held != m_touches.end()) {
+                    pointerMoved(held->second, point.position(), pressure);
+                }
+                break;
+            }
+            case QEventPoint::State::Released: {
+                auto held = m_touches.find(point.id());
+                if (held != m_touches.end()) {
+                    pointerReleased(held->second);
+                    m_touches.erase(held);
+                }
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    event->accept();
+}
+
+void PianoKeyboardView::hideEvent(QHideEvent* event) {
+    releaseAllNotes();
+    QAbstractScrollArea::hideEvent(event);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <QAbstractScrollArea>
+#include <QRect>
+#include <array>
+#include <unordered_map>
+#include <vector>
+
+class QTouchEvent;
+class QTabletEvent;
+
+// Full 128-key piano drawn directly with QPainter.
+//
+// Key rectangles and a per-pixel-column hit-test table are computed once per resize/zoom,
+// so hit-testing a pointer is two array lookups and a key state change repaints only that
+// key's rectangle. Mouse, tablet and any number of simultaneous touch points are supported;
+// a key that is held by several pointers sounds once and is released by the last one.
+//
+// Expression: the vertical press position gives the velocity (front edge = loudest),
+// horizontal dragging either glides to other keys or bends the held note, and tablet/touch
+// pressure is reported per note.
+class PianoKeyboardView : public QAbstractScrollArea {
+    Q_OBJECT
+
+public:
+    explicit PianoKeyboardView(QWidget* parent = nullptr);
+
+    void setZoom(double zoom);  // 1.0 = 24 px white keys
+    // false: dragging sideways slides to other keys (glissando); true: it bends the held note
+    void setDragBendsPitch(bool bends) { m_dragBendsPitch = bends; }
+    bool dragBendsPitch() const { return m_dragBendsPitch; }
+    double zoom() const { return m_zoom; }
+    void scrollToNote(int note);  // centers the note horizontally
+
+    // Highlight notes that are sounding for other reasons (file playback, incoming MIDI)
+    void setNoteHighlighted(int note, bool highlighted);
+    bool isNotePressed(int note) const;
+    // Releases everything held by mouse or touch, emitting noteReleased for each
+    void releaseAllNotes();
+
+    int noteAt(const QPoint& viewportPos) const;
+
+    QSize sizeHint() const override;
+    QSize minimumSizeHint() const override;
+
+signals:
+    void notePressed(int note, float velocity);  // velocity 0..1
+    void noteReleased(int note);
+    void noteBendChanged(int note, float semitones);
+    void notePressureChanged(int note, float pressure);  // 0..1
+
+protected:
+    void paintEvent(QPaintEvent* event) override;
+    void resizeEvent(QResizeEvent* event) override;
+    void scrollContentsBy(int dx, int dy) override;
+    void mousePressEvent(QMouseEvent* event) override;
+    void mouseMoveEvent(QMouseEvent* event) override;
+    void mouseReleaseEvent(QMouseEvent* event) override;
+    void wheelEvent(QWheelEvent* event) override;
+    bool viewportEvent(QEvent* event) override;
+    void hideEvent(QHideEvent* event) override;
+
+private:
+    void rebuildGeometry();
+    struct Pointer {
+        int note = -1;
+        QPointF pressPos;
+    };
+
+    void handleTouch(QTouchEvent* event);
+    void handleTablet(QTabletEvent* event);
+    void pointerPressed(Pointer& pointer, const QPointF& pos, float pressure);
+    void pointerMoved(Pointer& pointer, const QPointF& pos, float pressure);
+    void pointerReleased(Pointer& pointer);
+    float velocityAt(int note, const QPointF& pos) const;
+    void pressNote(int note, float velocity);
+    void releaseNote(int note);
+    void updateKey(int note);
+    QRect keyRectInViewport(int note) const;
+
+    double m_zoom;
+    int m_whiteKeyWidth;
+    int m_blackKeyWidth;
+    int m_contentWidth;
+    int m_blackKeyHeight;
+
+    std::array<QRect, 128> m_keyRects;      // content coordinates (unscrolled)
+    std::array<bool, 128> m_isBlack;
+    std::vector<int8_t> m_whiteKeyAtColumn; // content x -> white key note
+    std::vector<int8_t> m_blackKeyAtColumn; // content x -> black key note or -1
+
+    std::array<uint8_t, 128> m_pressCount;  // number of pointers holding each key
+    std::array<bool, 128> m_highlighted;
+    bool m_dragBendsPitch;
+    Pointer m_mouse;                            // mouse and tablet share one pointer
+    std::unordered_map<int, Pointer> m_touches; // touch point id -> pointer
+};
@@ -0,0 +1,174 @@
+#include "port_registry.h"
+#include <algorithm>
+#include <cstdio>
+#include <type_traits>
+#include <variant>
+
+namespace {
+
+std::string containerText(const libremidi::port_information& port) {
+    return std::visit([](const auto& value) -> std::string {
+        using T = std::decay_t<decltype(value)>;
+        if constexpr (std::is_same_v<T, std::monostate>) {
+            return {};
+        } else if constexpr (std::is_same_v<T, std::string>) {
+            return value;
+        } else if constexpr (std::is_integral_v<T>) {
+            return std::to_string(value);
+        } else {
+            // uuid
+            std::string text;
+            char hex[3];
+            for (auto byte : value.bytes) {
+                std::snprintf(hex, sizeof(hex), "%02x", static_cast<unsigned>(byte));
+                text += hex;
+            }
+            return text;
+        }
+    }, port.container);
+}
+
+uint64_t fnv1a(const std::string& text, uint64_t hash = 0xcbf29ce484222325ull) {
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+}  // namespace
+
+std::string PortRegistry::stableId(const libremidi::port_information& port) {
+    // Field separator that cannot occur in the names, so ("ab", "c") and ("a", "bc") differ
+    uint64_t hash = fnv1a(port.port_name);
+    for (const std::string& field : {port.display_name, containerText(port), port.serial}) {
+        hash = fnv1a(field, fnv1a(std::string(1, '\0'), hash));
+    }
+    char id[17];
+    std::snprintf(id, sizeof(id), "%016llx", static_cast<unsigned long long>(hash));
+    return id;
+}
+
+std::string PortRegistry::displayName(const libremidi::port_information& port) {
+    return port.port_name.empty() ? port.display_name : port.port_name;
+}
+
+std::optional<PortDelta> PortRegistry::add(PortDirection direction, const libremidi::port_information& port) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return addLocked(direction, port);
+}
+
+std::optional<PortDelta> PortRegistry::remove(PortDirection direction, const libremidi::port_information& port) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return removeLocked(direction, port);
+}
+
+std::optional<PortDelta> PortRegistry::addLocked(PortDirection direction, const libremidi::port_information& port) {
+    std::string baseId = stableId(port);
+    for (const auto& entry : entries_) {
+        if (entry.direction == direction && entry.baseId == baseId && sameHandle(entry.port, port)) {
+            return std::nullopt;  // e.g. notified again when the observer was recreated
+        }
+    }
+
+    std::string id = baseId;
+    for (int n = 2; std::any_of(entries_.begin(), entries_.end(), [&](const Entry& entry) {
+             return entry.direction == direction && entry.id == id;
+         }); n++) {
+        id = baseId + "-" + std::to_string(n);
+    }
+
+    Entry entry{direction, baseId, id, displayName(port), port};
+    PortDelta delta{PortDelta::Kind::Added, direction, entry.id, entry.name};
+    entries_.push_back(std::move(entry));
+    return delta;
+}
+
+std::optional<PortDelta> PortRegistry::removeLocked(PortDirection direction, const libremidi::port_information& port) {
+    std::string baseId = stableId(port);
+    auto match = entries_.end();
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->direction != direction || it->baseId != baseId) continue;
+        match = it;
+        if (sameHandle(it->port, port)) break;
+        // Otherwise keep looking for an exact handle match; the newest duplicate is the fallback
+    }
+    if (match == entries_.end()) {
+        return std::nullopt;
+    }
+
+    PortDelta delta{PortDelta::Kind::Removed, direction, match->id, match->name};
+    entries_.erase(match);
+    return delta;
+}
+
+std::vector<PortDelta> PortRegistry::sync(PortDirection direction, const std::vector<libremidi::port_information>& ports) {
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    // Pair listed ports with known entries, preferring the same backend handle
+    std::vector<bool> matched(entries_.size(), false);
+    std::vector<const libremidi::port_information*> unknown;
+    for (const auto& port : ports) {
+        std::string baseId = stableId(port);
+        size_t found = entries_.size();
+        for (size_t i = 0; i < entries_.size(); i++) {
+            const auto& entry = entries_[i];
+            if (matched[i] || entry.direction != direction || entry.baseId != baseId) continue;
+            if (sameHandle(entry.port, port)) {
+                found = i;
+                break;
+            }
+            if (found == entries_.size()) found = i;
+        }
+        if (found == entries_.size()) {
+            unknown.push_back(&port);
+        } else {
+            matched[found] = true;
+            entries_[found].port = port;
+        }
+    }
+
+    // Removals first so their duplicate suffixes can be reused by the additions
+    std::vector<PortDelta> deltas;
+    std::vector<Entry> kept;
+    for (size_t i = 0; i < entries_.size(); i++) {
+        if (entries_[i].direction == direction && !matched[i]) {
+            deltas.push_back({PortDelta::Kind::Removed, direction, entries_[i].id, entries_[i].name});
+        } else {
+            kept.push_back(std::move(entries_[i]));
+        }
+    }
+    entries_ = std::move(kept);
+    for (const auto* port : unknown) {
+        if (auto delta = addLocked(direction, *port)) {
+            deltas.push_back(std::move(*delta));
+        }
+    }
+    return deltas;
+}
+
+void PortRegistry::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+std::vector<std::pair<std::string, std::string>> PortRegistry::list(PortDirection direction) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::pair<std::string, std::string>> ports;
+    for (const auto& entry : entries_) {
+        if (entry.direction == direction) {
+            ports.emplace_back(entry.id, entry.name);
+        }
+    }
+    return ports;
+}
+
+std::optional<libremidi::port_information> PortRegistry::find(PortDirection direction, const std::string& id) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& entry : entries_) {
+        if (entry.direction == direction && entry.id == id) {
+            return entry.port;
+        }
+    }
+    return std::nullopt;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include <libremidi/libremidi.hpp>
+
+enum class PortDirection { Input, Output };
+
+// One port appearing or disappearing, as the UI applies it
+struct PortDelta {
+    enum class Kind { Added, Removed };
+
+    Kind kind = Kind::Added;
+    PortDirection direction = PortDirection::Input;
+    std::string id;
+    std::string name;
+};
+
+// MIDI ports known to the observer, addressed by IDs that stay the same while the port exists and
+// when the same port comes back after an unplug.
+//
+// The ID hashes what identifies the port across enumerations (port name, display name, container
+// and serial), never its position in the backend's port list, so a hotplug between listing the
+// ports and selecting one cannot open a different port. Two ports with an identical identity (two
+// units of the same model without a serial) get "-2", "-3"... appended in the order they appeared.
+//
+// The registry is kept current from the observer's added/removed callbacks, which may run on a
+// backend thread; every method locks. Enumeration and selection read from here and never query
+// the backend.
+class PortRegistry {
+public:
+    // ID of the first port with this identity
+    static std::string stableId(const libremidi::port_information& port);
+    static std::string displayName(const libremidi::port_information& port);
+
+    // Return the change to report, or nothing if the port was already known / not known
+    std::optional<PortDelta> add(PortDirection direction, const libremidi::port_information& port);
+    std::optional<PortDelta> remove(PortDirection direction, const libremidi::port_information& port);
+    // Reconciles with a full backend listing (explicit refresh, observer recreated)
+    std::vector<PortDelta> sync(PortDirection direction, const std::vector<libremidi::port_information>& ports);
+    void clear();
+
+    // (id, name) pairs in the order the ports appeared
+    std::vector<std::pair<std::string, std::string>> list(PortDirection direction) const;
+    std::optional<libremidi::port_information> find(PortDirection direction, const std::string& id) const;
+
+private:
+    struct Entry {
+        PortDirection direction;
+        std::string baseId;  // stableId(); id differs only for duplicates
+        std::string id;
+        std::string name;
+        libremidi::port_information port;
+    };
+
+    static bool sameHandle(const libremidi::port_information& a, const libremidi::port_information& b) {
+        return a.client == b.client && a.port == b.port;
+    }
+
+    std::optional<PortDelta> addLocked(PortDirection direction, const libremidi::port_information& port);
+    std::optional<PortDelta> removeLocked(PortDirection direction, const libremidi::port_information& port);
+
+    mutable std::mutex mutex_;
+    std::vector<Entry> entries_;
+};
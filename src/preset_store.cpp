@@ -0,0 +1,306 @@
+#include "preset_store.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+uint32_t presetControlKey(const ControlValue& control) {
+    return (static_cast<uint32_t>(control.kind) << 24) | (static_cast<uint32_t>(control.channel) << 16) |
+           (static_cast<uint32_t>(control.index) << 8) | control.subIndex;
+}
+
+ControlValue controlValueFromPresetEntry(const PresetEntry& entry) {
+    ControlValue control;
+    control.kind = static_cast<ControlKind>(entry.key >> 24);
+    control.channel = static_cast<uint8_t>(entry.key >> 16);
+    control.index = static_cast<uint8_t>(entry.key >> 8);
+    control.subIndex = static_cast<uint8_t>(entry.key);
+    control.value = entry.value;
+    return control;
+}
+
+Preset Preset::fromSnapshot(const std::string& name, const ControlSnapshot& snapshot) {
+    Preset preset;
+    preset.name = name;
+    preset.entries.reserve(snapshot.size());
+    for (const auto& control : snapshot) {
+        preset.entries.push_back({presetControlKey(control), control.value});
+    }
+    // Stable sort plus keeping the last duplicate matches what sending the snapshot in order would leave behind
+    std::stable_sort(preset.entries.begin(), preset.entries.end(),
+                     [](const PresetEntry& a, const PresetEntry& b) { return a.key < b.key; });
+    auto last = std::unique(preset.entries.rbegin(), preset.entries.rend(),
+                            [](const PresetEntry& a, const PresetEntry& b) { return a.key == b.key; });
+    preset.entries.erase(preset.entries.begin(), last.base());
+    return preset;
+}
+
+ControlSnapshot diffPresetEntries(std::span<const PresetEntry> current, std::span<const PresetEntry> target) {
+    ControlSnapshot changes;
+    size_t i = 0;
+    for (const auto& entry : target) {
+        while (i < current.size() && current[i].key < entry.key) {
+            i++;
+        }
+        if (i < current.size() && current[i].key == entry.key && current[i].value == entry.value) {
+            continue;
+        }
+        changes.push_back(controlValueFromPresetEntry(entry));
+    }
+    return changes;
+}
+
+bool writePresetBank(const std::string& path, const std::string& deviceId, const std::vector<Preset>& presets) {
+    PresetFileHeader header{};
+    std::memcpy(header.magic, PresetFileHeader::MAGIC, sizeof(header.magic));
+    header.version = PresetFileHeader::VERSION;
+    header.endian_marker = PresetFileHeader::ENDIAN_MARKER;
+    header.header_size = sizeof(PresetFileHeader);
+    header.record_size = sizeof(PresetRecord);
+    header.entry_size = sizeof(PresetEntry);
+    header.preset_count = static_cast<uint32_t>(presets.size());
+
+    std::vector<PresetRecord> records;
+    std::vector<PresetEntry> entries;
+    std::string strings = deviceId;
+    header.device_id_offset = 0;
+    header.device_id_length = static_cast<uint32_t>(deviceId.size());
+
+    records.reserve(presets.size());
+    for (const auto& preset : presets) {
+        PresetRecord record{};
+        record.name_offset = static_cast<uint32_t>(strings.size());
+        record.name_length = static_cast<uint32_t>(preset.name.size());
+        record.first_entry = static_cast<uint32_t>(entries.size());
+        record.entry_count = static_cast<uint32_t>(preset.entries.size());
+        strings += preset.name;
+        entries.insert(entries.end(), preset.entries.begin(), preset.entries.end());
+        records.push_back(record);
+    }
+    header.entry_count = static_cast<uint32_t>(entries.size());
+    header.strings_size = static_cast<uint32_t>(strings.size());
+
+    // Write next to the target and rename, so a crash never leaves a half-written bank behind
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream out(tempPath, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cerr << "[PRESET] Cannot write " << tempPath << std::endl;
+            return false;
+        }
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(PresetRecord));
+        out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(PresetEntry));
+        out.write(strings.data(), strings.size());
+        if (!out) {
+            std::cerr << "[PRESET] Failed writing " << tempPath << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        std::cerr << "[PRESET] Cannot replace " << path << ": " << ec.message() << std::endl;
+        std::filesystem::remove(tempPath, ec);
+        return false;
+    }
+    return true;
+}
+
+bool PresetBankReader::open(const std::string& path) {
+    close();
+
+    if (!file_.openReadOnly(path)) {
+        return false;
+    }
+
+    if (file_.size() < sizeof(PresetFileHeader)) {
+        std::cerr << "[PRESET] " << path << " is too small to be a preset bank" << std::endl;
+        close();
+        return false;
+    }
+
+    std::memcpy(&header_, file_.data(), sizeof(PresetFileHeader));
+    if (std::memcmp(header_.magic, PresetFileHeader::MAGIC, sizeof(header_.magic)) != 0) {
+        std::cerr << "[PRESET] " << path << " is not a preset bank" << std::endl;
+        close();
+        return false;
+    }
+    if (header_.endian_marker != PresetFileHeader::ENDIAN_MARKER) {
+        std::cerr << "[PRESET] " << path << " was written on a host with different endianness" << std::endl;
+        close();
+        return false;
+    }
+    if (header_.version != PresetFileHeader::VERSION ||
+        header_.header_size != sizeof(PresetFileHeader) ||
+        header_.record_size != sizeof(PresetRecord) ||
+        header_.entry_size != sizeof(PresetEntry)) {
+        std::cerr << "[PRESET] Unsupported preset bank version " << header_.version << std::endl;
+        close();
+        return false;
+    }
+
+    const uint64_t recordsOffset = sizeof(PresetFileHeader);
+    const uint64_t entriesOffset = recordsOffset + uint64_t{header_.preset_count} * sizeof(PresetRecord);
+    const uint64_t stringsOffset = entriesOffset + uint64_t{header_.entry_count} * sizeof(PresetEntry);
+    if (file_.size() < stringsOffset + header_.strings_size ||
+        uint64_t{header_.device_id_offset} + header_.device_id_length > header_.strings_size) {
+        std::cerr << "[PRESET] " << path << " is truncated" << std::endl;
+        close();
+        return false;
+    }
+
+    records_ = reinterpret_cast<const PresetRecord*>(file_.data() + recordsOffset);
+    entries_ = reinterpret_cast<const PresetEntry*>(file_.data() + entriesOffset);
+    strings_ = reinterpret_cast<const char*>(file_.data() + stringsOffset);
+
+    // Validate every record once here so lookups can trust the mapping
+    for (size_t i = 0; i < header_.preset_count; i++) {
+        const auto& record = records_[i];
+        if (uint64_t{record.name_offset} + record.name_length > header_.strings_size ||
+            uint64_t{record.first_entry} + record.entry_count > header_.entry_count) {
+            std::cerr << "[PRESET] " << path << " has a corrupt preset record " << i << std::endl;
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void PresetBankReader::close() {
+    file_.close();
+    header_ = PresetFileHeader{};
+    records_ = nullptr;
+    entries_ = nullptr;
+    strings_ = nullptr;
+}
+
+std::string_view PresetBankReader::deviceId() const {
+    if (!isOpen()) return {};
+    return std::string_view(strings_ + header_.device_id_offset, header_.device_id_length);
+}
+
+std::string_view PresetBankReader::presetName(size_t index) const {
+    if (index >= presetCount()) return {};
+    return std::string_view(strings_ + records_[index].name_offset, records_[index].name_length);
+}
+
+std::span<const PresetEntry> PresetBankReader::presetEntries(size_t index) const {
+    if (index >= presetCount()) return {};
+    return std::span<const PresetEntry>(entries_ + records_[index].first_entry, records_[index].entry_count);
+}
+
+std::optional<size_t> PresetBankReader::findPreset(std::string_view name) const {
+    for (size_t i = 0; i < presetCount(); i++) {
+        if (presetName(i) == name) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+std::vector<Preset> PresetBankReader::readAll() const {
+    std::vector<Preset> presets;
+    presets.reserve(presetCount());
+    for (size_t i = 0; i < presetCount(); i++) {
+        auto entries = presetEntries(i);
+        presets.push_back(Preset{std::string(presetName(i)), std::vector<PresetEntry>(entries.begin(), entries.end())});
+    }
+    return presets;
+}
+
+PresetStore::PresetStore(std::string directory)
+    : directory_(std::move(directory)) {
+}
+
+std::string PresetStore::deviceKey(const std::string& manufacturer, const std::string& model) {
+    auto sanitize = [](const std::string& text) {
+        std::string result;
+        for (char c : text) {
+            bool safe = (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-' || c == '.';
+            result += safe ? c : '_';
+        }
+        return result.empty() ? std::string("unknown") : result;
+    };
+    return sanitize(manufacturer) + "_" + sanitize(model);
+}
+
+std::string PresetStore::bankPath(const std::string& deviceKey) const {
+    return (std::filesystem::path(directory_) / (deviceKey + ".umppresets")).string();
+}
+
+bool PresetStore::selectDevice(const std::string& deviceKey) {
+    bank_.close();
+    deviceKey_ = deviceKey;
+
+    std::error_code ec;
+    if (!std::filesystem::exists(bankPath(deviceKey), ec)) {
+        return true;  // no presets saved for this device yet
+    }
+    return bank_.open(bankPath(deviceKey));
+}
+
+std::vector<std::string> PresetStore::presetNames() const {
+    std::vector<std::string> names;
+    names.reserve(bank_.presetCount());
+    for (size_t i = 0; i < bank_.presetCount(); i++) {
+        names.emplace_back(bank_.presetName(i));
+    }
+    return names;
+}
+
+std::optional<ControlSnapshot> PresetStore::presetSnapshot(const std::string& name) const {
+    auto index = bank_.findPreset(name);
+    if (!index) return std::nullopt;
+    return diffPresetEntries({}, bank_.presetEntries(*index));
+}
+
+bool PresetStore::save(const std::string& name, const ControlSnapshot& snapshot) {
+    if (deviceKey_.empty()) {
+        std::cerr << "[PRESET] No device selected" << std::endl;
+        return false;
+    }
+
+    auto presets = bank_.readAll();
+    auto preset = Preset::fromSnapshot(name, snapshot);
+    auto existing = std::find_if(presets.begin(), presets.end(), [&name](const Preset& p) { return p.name == name; });
+    if (existing != presets.end()) {
+        *existing = std::move(preset);
+    } else {
+        presets.push_back(std::move(preset));
+    }
+    return rewrite(presets);
+}
+
+bool PresetStore::remove(const std::string& name) {
+    auto presets = bank_.readAll();
+    auto erased = std::erase_if(presets, [&name](const Preset& p) { return p.name == name; });
+    return erased > 0 && rewrite(presets);
+}
+
+bool PresetStore::rewrite(const std::vector<Preset>& presets) {
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+
+    const std::string path = bankPath(deviceKey_);
+    bank_.close();
+    bool written = writePresetBank(path, deviceKey_, presets);
+    // Map whatever is on disk now, even if the write failed
+    bool reopened = !std::filesystem::exists(path, ec) || bank_.open(path);
+    if (written) {
+        std::cout << "[PRESET] Saved " << presets.size() << " presets for " << deviceKey_ << std::endl;
+    }
+    return written && reopened;
+}
+
+std::optional<ControlSnapshot> PresetStore::switchTo(const std::string& name, const ControlSnapshot& current) const {
+    auto index = bank_.findPreset(name);
+    if (!index) {
+        std::cerr << "[PRESET] No preset '" << name << "' for " << deviceKey_ << std::endl;
+        return std::nullopt;
+    }
+    auto currentPreset = Preset::fromSnapshot({}, current);
+    return diffPresetEntries(currentPreset.entries, bank_.presetEntries(*index));
+}
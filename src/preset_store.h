@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "control_snapshot.h"
+#include "mapped_file.h"
+
+// Binary preset bank format ("UMPPRE"), one file per device identity:
+//
+//   [PresetFileHeader: 64 bytes][PresetRecord: 16 bytes] x preset_count
+//   [PresetEntry: 8 bytes] x entry_count [UTF-8 string bytes]
+//
+// Each preset owns a contiguous, key-sorted run of entries, so a preset is read straight out
+// of the mapping and two presets are compared with a single merge pass. All multi-byte fields
+// are host-endian; the header stores an endianness marker so readers can reject foreign files.
+
+struct PresetFileHeader {
+    static constexpr char MAGIC[8] = {'U', 'M', 'P', 'P', 'R', 'E', '\0', '\0'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t ENDIAN_MARKER = 0x01020304;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t endian_marker;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint32_t entry_size;
+    uint32_t preset_count;
+    uint32_t entry_count;
+    uint32_t strings_size;
+    uint32_t device_id_offset;    // into the string area
+    uint32_t device_id_length;
+    uint8_t reserved[16];
+};
+static_assert(sizeof(PresetFileHeader) == 64, "preset header layout must stay stable");
+
+struct PresetRecord {
+    uint32_t name_offset;         // into the string area
+    uint32_t name_length;
+    uint32_t first_entry;
+    uint32_t entry_count;
+};
+static_assert(sizeof(PresetRecord) == 16, "preset record layout must stay stable");
+
+// One stored control value; `key` is presetControlKey() of the control
+struct PresetEntry {
+    uint32_t key;
+    uint32_t value;
+};
+static_assert(sizeof(PresetEntry) == 8, "preset entry layout must stay stable");
+
+// Identifies a control independently of its position in the device's control list:
+// kind, channel, index and sub-index, one byte each
+uint32_t presetControlKey(const ControlValue& control);
+ControlValue controlValueFromPresetEntry(const PresetEntry& entry);
+
+// An editable preset; entries are kept sorted by key
+struct Preset {
+    std::string name;
+    std::vector<PresetEntry> entries;
+
+    static Preset fromSnapshot(const std::string& name, const ControlSnapshot& snapshot);
+};
+
+// Controls whose value in `target` differs from `current` (or that `current` does not have).
+// Both ranges must be sorted by key.
+ControlSnapshot diffPresetEntries(std::span<const PresetEntry> current, std::span<const PresetEntry> target);
+
+bool writePresetBank(const std::string& path, const std::string& deviceId, const std::vector<Preset>& presets);
+
+// Read-only, memory-mapped view of a preset bank file
+class PresetBankReader {
+public:
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return file_.isOpen(); }
+
+    std::string_view deviceId() const;
+    size_t presetCount() const { return header_.preset_count; }
+    std::string_view presetName(size_t index) const;
+    std::span<const PresetEntry> presetEntries(size_t index) const;
+    std::optional<size_t> findPreset(std::string_view name) const;
+
+    // Copies every preset out of the mapping (for editing)
+    std::vector<Preset> readAll() const;
+
+private:
+    MappedFile file_;
+    PresetFileHeader header_{};
+    const PresetRecord* records_ = nullptr;
+    const PresetEntry* entries_ = nullptr;
+    const char* strings_ = nullptr;
+};
+
+// Presets for every device, stored as one bank file per device identity in `directory`.
+// The bank of the selected device stays mapped, so switching presets only touches the
+// entries of the two presets involved. Used from the UI thread.
+class PresetStore {
+public:
+    explicit PresetStore(std::string directory);
+
+    // Stable identity of a device across sessions (MUIDs are random per session)
+    static std::string deviceKey(const std::string& manufacturer, const std::string& model);
+
+    // Maps the bank of a device; a device without presets yet gets an empty bank
+    bool selectDevice(const std::string& deviceKey);
+    const std::string& selectedDevice() const { return deviceKey_; }
+
+    std::vector<std::string> presetNames() const;
+    std::optional<ControlSnapshot> presetSnapshot(const std::string& name) const;
+
+    // Adds or replaces a preset and rewrites the bank
+    bool save(const std::string& name, const ControlSnapshot& snapshot);
+    bool remove(const std::string& name);
+
+    // The controls that have to be sent to go from `current` to the preset; nullopt if there is no such preset
+    std::optional<ControlSnapshot> switchTo(const std::string& name, const ControlSnapshot& current) const;
+
+private:
+    std::string bankPath(const std::string& deviceKey) const;
+    bool rewrite(const std::vector<Preset>& presets);
+
+    std::string directory_;
+    std::string deviceKey_;
+    PresetBankReader bank_;
+};
@@ -0,0 +1,105 @@
+#include "property_model.h"
+#include <midicci/details/commonproperties/StandardProperties.hpp>
+#include "trace_recorder.h"
+
+using namespace midicci::commonproperties;
+
+namespace {
+
+template <typename Row>
+void diffRows(const std::vector<Row>& previous, const std::vector<Row>& current, PropertyRowUpdate& update) {
+    if (previous.size() != current.size()) {
+        update.reset = true;
+        return;
+    }
+    for (size_t i = 0; i < current.size(); i++) {
+        if (!samePropertyRow(previous[i], current[i])) {
+            update.rows.push_back(i);
+        }
+    }
+}
+
+}  // namespace
+
+bool samePropertyRow(const MidiCIControl& a, const MidiCIControl& b) {
+    return a.defaultValue == b.defaultValue && a.ctrlIndex == b.ctrlIndex && a.channel == b.channel &&
+           a.ctrlType == b.ctrlType && a.minMax == b.minMax && a.priority == b.priority && a.title == b.title &&
+           a.description == b.description;
+}
+
+bool samePropertyRow(const MidiCIProgram& a, const MidiCIProgram& b) {
+    return a.bankPC == b.bankPC && a.title == b.title;
+}
+
+const std::vector<std::string>& PropertyModel::subscribedResources() {
+    static const std::vector<std::string> resources = {
+        StandardPropertyNames::ALL_CTRL_LIST,
+        StandardPropertyNames::CH_CTRL_LIST,
+        StandardPropertyNames::PROGRAM_LIST,
+    };
+    return resources;
+}
+
+bool PropertyModel::isListResource(const std::string& resource) {
+    for (const auto& name : subscribedResources()) {
+        if (name == resource) return true;
+    }
+    return false;
+}
+
+PropertyRowUpdate PropertyModel::update(const std::string& resource, const std::vector<uint8_t>& body) {
+    PropertyRowUpdate update;
+    update.resource = resource;
+    if (!isListResource(resource)) {
+        return update;
+    }
+
+    auto existing = lists_.find(resource);
+    if (existing != lists_.end() && existing->second.body == body) {
+        return update;  // notification without a content change
+    }
+
+    TraceSpan trace("PropertyModel parse", "json");
+    trace.setArg("bytes", static_cast<int64_t>(body.size()));
+    CachedList list;
+    list.body = body;
+    if (resource == StandardPropertyNames::PROGRAM_LIST) {
+        list.programs = StandardProperties::parseProgramList(body);
+    } else {
+        list.controls = StandardProperties::parseControlList(body);
+    }
+
+    if (existing == lists_.end()) {
+        update.reset = true;
+        lists_.emplace(resource, std::move(list));
+        return update;
+    }
+
+    diffRows(existing->second.controls, list.controls, update);
+    diffRows(existing->second.programs, list.programs, update);
+    if (update.reset) {
+        update.rows.clear();
+    }
+    existing->second = std::move(list);
+    return update;
+}
+
+void PropertyModel::clear() {
+    lists_.clear();
+}
+
+std::optional<std::vector<MidiCIControl>> PropertyModel::controls(const std::string& resource) const {
+    auto it = lists_.find(resource);
+    if (it == lists_.end() || resource == StandardPropertyNames::PROGRAM_LIST) {
+        return std::nullopt;
+    }
+    return it->second.controls;
+}
+
+std::optional<std::vector<MidiCIProgram>> PropertyModel::programs() const {
+    auto it = lists_.find(StandardPropertyNames::PROGRAM_LIST);
+    if (it == lists_.end()) {
+        return std::nullopt;
+    }
+    return it->second.programs;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+#include <midicci/midicci.hpp>
+
+// Which rows of a subscribed list resource changed with one update
+struct PropertyRowUpdate {
+    std::string resource;
+    bool reset = false;        // first load or the row count changed: rebuild the whole list
+    std::vector<size_t> rows;  // rows whose content changed, ascending; only meaningful without reset
+
+    bool empty() const { return !reset && rows.empty(); }
+};
+
+// Parsed copies of the list resources a remote device is subscribed for (AllCtrlList, ChCtrlList,
+// ProgramList), kept per device.
+//
+// The responder sends subscription updates as either a full body or a "partial" patch; midicci
+// merges both into its property cache and then reports the resource id. update() takes the merged
+// body, skips it if it is byte-identical to the previous one, and otherwise compares the freshly
+// parsed rows with the cached ones so the UI only touches rows that actually changed instead of
+// rebuilding every slider and program entry on each notification.
+class PropertyModel {
+public:
+    // Resources we subscribe to; anything else is refetched the old way
+    static const std::vector<std::string>& subscribedResources();
+    static bool isListResource(const std::string& resource);
+
+    PropertyRowUpdate update(const std::string& resource, const std::vector<uint8_t>& body);
+    void clear();
+
+    bool has(const std::string& resource) const { return lists_.count(resource) != 0; }
+    std::optional<std::vector<midicci::commonproperties::MidiCIControl>> controls(const std::string& resource) const;
+    std::optional<std::vector<midicci::commonproperties::MidiCIProgram>> programs() const;
+
+private:
+    struct CachedList {
+        std::vector<uint8_t> body;
+        std::vector<midicci::commonproperties::MidiCIControl> controls;
+        std::vector<midicci::commonproperties::MidiCIProgram> programs;
+    };
+
+    std::map<std::string, CachedList> lists_;
+};
+
+bool samePropertyRow(const midicci::commonproperties::MidiCIControl& a, const midicci::commonproperties::MidiCIControl& b);
+bool samePropertyRow(const midicci::commonproperties::MidiCIProgram& a, const midicci::commonproperties::MidiCIProgram& b);
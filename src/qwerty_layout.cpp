@@ -0,0 +1,101 @@
+#include "qwerty_layout.h"
+#include <algorithm>
+#include <iostream>
+
+QwertyLayout::QwertyLayout() {
+    offsets_.fill(-1);
+    held_.fill(-1);
+    setLayout(DEFAULT_LAYOUT);
+}
+
+int QwertyLayout::normalize(int key) {
+    if (key >= 'a' && key <= 'z') {
+        return key - 'a' + 'A';
+    }
+    return key;
+}
+
+int QwertyLayout::offsetOf(int key) const {
+    key = normalize(key);
+    return (key > ' ' && key < 127) ? offsets_[key] : -1;
+}
+
+bool QwertyLayout::setLayout(const std::string& keys) {
+    if (keys.size() > 127) {
+        std::cerr << "[QWERTY] Layout has more than 127 keys" << std::endl;
+        return false;
+    }
+
+    std::array<int8_t, 128> offsets;
+    offsets.fill(-1);
+    for (size_t i = 0; i < keys.size(); i++) {
+        int key = normalize(static_cast<unsigned char>(keys[i]));
+        if (key <= ' ' || key >= 127) {
+            std::cerr << "[QWERTY] Layout key #" << i << " is not a printable ASCII character" << std::endl;
+            return false;
+        }
+        if (key == OCTAVE_DOWN_KEY || key == OCTAVE_UP_KEY) {
+            std::cerr << "[QWERTY] '" << keys[i] << "' is reserved for octave shift" << std::endl;
+            return false;
+        }
+        if (offsets[key] >= 0) {
+            std::cerr << "[QWERTY] '" << keys[i] << "' appears twice in the layout" << std::endl;
+            return false;
+        }
+        offsets[key] = static_cast<int8_t>(i);
+    }
+
+    // Held keys keep their notes; only new presses use the new layout
+    offsets_ = offsets;
+    layout_ = keys;
+    return true;
+}
+
+void QwertyLayout::setBaseNote(int note) {
+    baseNote_ = std::clamp(note, 0, 127);
+}
+
+void QwertyLayout::shiftOctave(int octaves) {
+    int note = baseNote_ + octaves * 12;
+    while (note < 0) note += 12;
+    while (note > 127) note -= 12;
+    baseNote_ = note;
+}
+
+std::optional<int> QwertyLayout::press(int key) {
+    int offset = offsetOf(key);
+    if (offset < 0) return std::nullopt;
+
+    key = normalize(key);
+    if (held_[key] >= 0) return std::nullopt;
+
+    int note = baseNote_ + offset;
+    if (note > 127) return std::nullopt;
+
+    held_[key] = static_cast<int8_t>(note);
+    heldCount_++;
+    return note;
+}
+
+std::optional<int> QwertyLayout::release(int key) {
+    key = normalize(key);
+    if (key < 0 || key > 127 || held_[key] < 0) return std::nullopt;
+
+    int note = held_[key];
+    held_[key] = -1;
+    heldCount_--;
+    return note;
+}
+
+std::vector<int> QwertyLayout::releaseAll() {
+    std::vector<int> notes;
+    notes.reserve(heldCount_);
+    for (auto& note : held_) {
+        if (note >= 0) {
+            notes.push_back(note);
+            note = -1;
+        }
+    }
+    heldCount_ = 0;
+    return notes;
+}
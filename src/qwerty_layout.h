@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+// Maps computer-keyboard keys to notes for playing from a QWERTY keyboard.
+//
+// Keys are identified by their unshifted character ('a', ';', ...). For printable ASCII that is
+// also the Qt::Key code of the key (letters upper-cased), so the widget can pass event->key()
+// straight in and the lookup is a single table access.
+//
+// The layout remembers which note each held key started, so releasing a key after an octave
+// shift still stops the note it played. Used from the UI thread.
+class QwertyLayout {
+public:
+    // Two chromatic rows: the home row plays the white keys, the row above the black keys
+    static constexpr const char* DEFAULT_LAYOUT = "awsedftgyhujkolp;'";
+    static constexpr int OCTAVE_DOWN_KEY = 'Z';
+    static constexpr int OCTAVE_UP_KEY = 'X';
+    static constexpr int DEFAULT_BASE_NOTE = 60;
+
+    QwertyLayout();
+
+    // The i-th character plays baseNote() + i. Returns false (and logs) for characters outside
+    // printable ASCII, duplicates and the octave keys; the previous layout is kept in that case.
+    bool setLayout(const std::string& keys);
+    const std::string& layout() const { return layout_; }
+
+    void setBaseNote(int note);
+    int baseNote() const { return baseNote_; }
+    // Moves the base note by whole octaves, stopping at the ends of the MIDI note range
+    void shiftOctave(int octaves);
+
+    bool isMapped(int key) const { return offsetOf(key) >= 0; }
+
+    // Note to send for a key going down, or nullopt for unmapped keys, keys that are already
+    // held and notes that would fall outside 0..127
+    std::optional<int> press(int key);
+    // Note that the key started, or nullopt if it was not held
+    std::optional<int> release(int key);
+    // Returns and forgets every held key's note (focus loss, panic)
+    std::vector<int> releaseAll();
+    int heldCount() const { return heldCount_; }
+
+private:
+    static int normalize(int key);
+    int offsetOf(int key) const;
+
+    std::string layout_;
+    std::array<int8_t, 128> offsets_;  // -1 = unmapped
+    std::array<int8_t, 128> held_;     // note started by the key, -1 = up
+    int baseNote_ = DEFAULT_BASE_NOTE;
+    int heldCount_ = 0;
+};
@@ -0,0 +1,241 @@
+#include "realtime_config.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+#endif
+
+namespace {
+
+constexpr size_t STACK_PREFAULT_BYTES = 128 * 1024;
+
+// Shared by all instances so a thread never mistakes another setup's configuration for its own
+std::atomic<uint64_t> nextGeneration{1};
+thread_local uint64_t threadGeneration = 0;
+
+size_t pageSize() {
+#if defined(__linux__)
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+#else
+    return 4096;
+#endif
+}
+
+std::string errorText(int error) {
+    return std::strerror(error);
+}
+
+#if defined(__linux__)
+// Touches the stack below the caller so later calls in this thread do not fault it in
+__attribute__((noinline)) void prefaultStack() {
+    volatile uint8_t stack[STACK_PREFAULT_BYTES];
+    for (size_t i = 0; i < sizeof(stack); i += pageSize()) {
+        stack[i] = 0;
+    }
+}
+#endif
+
+std::string cpuList(const std::vector<int>& cpus) {
+    std::string text;
+    for (int cpu : cpus) {
+        text += (text.empty() ? "" : ",") + std::to_string(cpu);
+    }
+    return text;
+}
+
+}  // namespace
+
+std::optional<RealtimeConfig> RealtimeConfig::parse(const std::string& spec) {
+    RealtimeConfig config;
+    std::string policy = spec;
+    std::string cpus;
+    if (auto at = spec.find('@'); at != std::string::npos) {
+        policy = spec.substr(0, at);
+        cpus = spec.substr(at + 1);
+    }
+
+    std::string priority;
+    if (auto colon = policy.find(':'); colon != std::string::npos) {
+        priority = policy.substr(colon + 1);
+        policy = policy.substr(0, colon);
+    }
+    if (policy == "fifo") {
+        config.policy = RealtimePolicy::Fifo;
+    } else if (policy == "rr") {
+        config.policy = RealtimePolicy::RoundRobin;
+    } else {
+        std::cerr << "[RT] Unknown scheduling policy '" << policy << "' (expected fifo or rr)" << std::endl;
+        return std::nullopt;
+    }
+
+    if (!priority.empty()) {
+        std::istringstream in(priority);
+        char extra = 0;
+        if (!(in >> config.priority) || in >> extra || config.priority < 1 || config.priority > 99) {
+            std::cerr << "[RT] Priority '" << priority << "' is out of range (1-99)" << std::endl;
+            return std::nullopt;
+        }
+    }
+
+    std::stringstream entries(cpus);
+    for (std::string entry; std::getline(entries, entry, ',');) {
+        std::istringstream in(entry);
+        int cpu = -1;
+        char extra = 0;
+        if (!(in >> cpu) || in >> extra || cpu < 0 || cpu >= 1024) {
+            std::cerr << "[RT] Malformed CPU '" << entry << "' in '" << spec << "'" << std::endl;
+            return std::nullopt;
+        }
+        config.cpus.push_back(cpu);
+    }
+    return config;
+}
+
+RealtimeSetup& RealtimeSetup::instance() {
+    static RealtimeSetup setup;
+    return setup;
+}
+
+RealtimeStatus RealtimeSetup::apply(const RealtimeConfig& config) {
+    RealtimeStatus status;
+    status.enabled = true;
+
+#if defined(__linux__)
+    if (config.lockMemory) {
+        if (mlockall(MCL_CURRENT | MCL_FUTURE) == 0) {
+            status.memoryLocked = true;
+        } else {
+            status.memoryProblem = "mlockall: " + errorText(errno);
+        }
+    }
+#if defined(__GLIBC__)
+    // Keep freed memory in the heap instead of returning it to the kernel, and serve large
+    // blocks from the heap too, so the reserve below stays faulted in (and locked)
+    mallopt(M_TRIM_THRESHOLD, -1);
+    mallopt(M_MMAP_MAX, 0);
+#endif
+    if (config.heapReserveBytes > 0) {
+        if (auto* reserve = static_cast<uint8_t*>(std::malloc(config.heapReserveBytes))) {
+            for (size_t i = 0; i < config.heapReserveBytes; i += pageSize()) {
+                static_cast<volatile uint8_t*>(reserve)[i] = 0;
+            }
+            std::free(reserve);
+            status.prefaultedBytes += config.heapReserveBytes;
+        }
+    }
+#else
+    status.memoryProblem = "not supported on this platform";
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config_ = config;
+        status_ = status;
+    }
+    generation_.store(nextGeneration.fetch_add(1), std::memory_order_release);
+    report(std::cout);
+    return status;
+}
+
+void RealtimeSetup::enterIoThread(const char* name) {
+    uint64_t generation = generation_.load(std::memory_order_acquire);
+    if (generation == 0 || threadGeneration == generation) {
+        return;
+    }
+    threadGeneration = generation;
+
+    RealtimeConfig config;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        config = config_;
+    }
+    auto thread = configureThread(name, config);
+#if defined(__linux__)
+    prefaultStack();
+#endif
+
+    std::cout << "[RT] " << name << ": " << (thread.scheduled ? "real-time priority" : "normal priority")
+              << (thread.pinned ? ", pinned to CPUs " + cpuList(config.cpus) : "")
+              << (thread.problem.empty() ? "" : " (" + thread.problem + ")") << std::endl;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+#if defined(__linux__)
+    status_.prefaultedBytes += STACK_PREFAULT_BYTES;
+#endif
+    status_.threads.push_back(std::move(thread));
+}
+
+RealtimeThreadStatus RealtimeSetup::configureThread(const char* name, const RealtimeConfig& config) {
+    RealtimeThreadStatus thread;
+    thread.name = name;
+#if defined(__linux__)
+    sched_param param{};
+    param.sched_priority = config.priority;
+    int policy = config.policy == RealtimePolicy::RoundRobin ? SCHED_RR : SCHED_FIFO;
+    if (int error = pthread_setschedparam(pthread_self(), policy, &param); error == 0) {
+        thread.scheduled = true;
+    } else {
+        thread.problem = "scheduling: " + errorText(error);
+    }
+
+    if (!config.cpus.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : config.cpus) {
+            CPU_SET(cpu, &set);
+        }
+        if (int error = pthread_setaffinity_np(pthread_self(), sizeof(set), &set); error == 0) {
+            thread.pinned = true;
+        } else {
+            thread.problem += (thread.problem.empty() ? "" : ", ") + std::string("affinity: ") + errorText(error);
+        }
+    }
+#else
+    (void)config;
+    thread.problem = "not supported on this platform";
+#endif
+    return thread;
+}
+
+void RealtimeSetup::prefault(void* data, size_t bytes) {
+    if (!data || bytes == 0) {
+        return;
+    }
+    auto* pages = static_cast<volatile uint8_t*>(data);
+    for (size_t i = 0; i < bytes; i += pageSize()) {
+        pages[i] = pages[i];
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    status_.prefaultedBytes += bytes;
+}
+
+RealtimeStatus RealtimeSetup::status() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return status_;
+}
+
+void RealtimeSetup::report(std::ostream& out) const {
+    auto status = this->status();
+    if (!status.enabled) {
+        out << "[RT] Real-time mode off" << std::endl;
+        return;
+    }
+    out << "[RT] Memory " << (status.memoryLocked ? "locked" : "not locked")
+        << (status.memoryProblem.empty() ? "" : " (" + status.memoryProblem + ")") << ", "
+        << status.prefaultedBytes / 1024 << " KiB pre-faulted" << std::endl;
+    for (const auto& thread : status.threads) {
+        out << "[RT]   " << thread.name << ": " << (thread.scheduled ? "real-time" : "normal") << " priority, "
+            << (thread.pinned ? "pinned" : "not pinned")
+            << (thread.problem.empty() ? "" : " (" + thread.problem + ")") << std::endl;
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum class RealtimePolicy : uint8_t {
+    Fifo,        // SCHED_FIFO
+    RoundRobin,  // SCHED_RR
+};
+
+struct RealtimeConfig {
+    RealtimePolicy policy = RealtimePolicy::Fifo;
+    int priority = 70;                   // 1-99; above the audio server's clients, below its own threads
+    std::vector<int> cpus;               // I/O threads are pinned to these; empty = any CPU
+    bool lockMemory = true;              // mlockall(MCL_CURRENT | MCL_FUTURE)
+    size_t heapReserveBytes = 16 << 20;  // faulted in at startup and kept by the allocator
+
+    // Parses "fifo|rr[:priority][@cpu,cpu,...]", e.g. "fifo:80@2,3". Returns nullopt (and logs)
+    // on malformed input.
+    static std::optional<RealtimeConfig> parse(const std::string& spec);
+};
+
+struct RealtimeThreadStatus {
+    std::string name;
+    bool scheduled = false;  // running with the requested policy and priority
+    bool pinned = false;     // restricted to the requested CPUs
+    std::string problem;     // why something was not applied, empty if everything was
+};
+
+// What actually took effect; without privileges (CAP_SYS_NICE, RLIMIT_RTPRIO, RLIMIT_MEMLOCK)
+// parts of the configuration are skipped rather than failing startup
+struct RealtimeStatus {
+    bool enabled = false;
+    bool memoryLocked = false;
+    std::string memoryProblem;
+    size_t prefaultedBytes = 0;
+    std::vector<RealtimeThreadStatus> threads;
+};
+
+// Real-time mode for the MIDI I/O path.
+//
+// apply() does the process-wide part early in main(): locks all current and future memory and
+// faults in a heap reserve that the allocator keeps, so allocations on the MIDI threads do not
+// page-fault. I/O threads call enterIoThread() when they start handling traffic, including
+// backend callback threads we do not create; the first call on a thread sets its scheduling
+// policy, priority and CPU affinity and faults in its stack, later calls are an atomic load.
+class RealtimeSetup {
+public:
+    static RealtimeSetup& instance();
+
+    RealtimeSetup() = default;  // public for tests; the app uses instance()
+
+    RealtimeStatus apply(const RealtimeConfig& config);
+    bool isEnabled() const { return generation_.load(std::memory_order_relaxed) != 0; }
+
+    void enterIoThread(const char* name);
+    // Writes every page of a buffer that is about to be used from an I/O thread (before it is shared)
+    void prefault(void* data, size_t bytes);
+
+    RealtimeStatus status() const;
+    void report(std::ostream& out) const;
+
+private:
+    RealtimeThreadStatus configureThread(const char* name, const RealtimeConfig& config);
+
+    mutable std::mutex mutex_;
+    RealtimeConfig config_;
+    RealtimeStatus status_;
+    std::atomic<uint64_t> generation_{0};  // changes with every apply(); 0 = disabled
+};
@@ -0,0 +1,145 @@
+#include "startup_profiler.h"
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include "latency_tracker.h"
+
+#if defined(__linux__)
+#include <fstream>
+#include <sstream>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+// Fallback start: as early as this translation unit can observe
+const int64_t staticInitNs = LatencyTracker::now();
+
+#if defined(__linux__)
+// Process age from /proc/self/stat (start time in clock ticks since boot), or -1
+int64_t processAgeNs() {
+    std::ifstream stat("/proc/self/stat");
+    std::string line;
+    if (!std::getline(stat, line)) {
+        return -1;
+    }
+    // The command name may contain spaces and parentheses; fields continue after the last ')'
+    auto close = line.rfind(')');
+    if (close == std::string::npos) {
+        return -1;
+    }
+    std::istringstream fields(line.substr(close + 2));
+    std::string field;
+    for (int i = 3; i <= 22 && fields >> field; i++) {
+        if (i == 22) {
+            long ticksPerSecond = sysconf(_SC_CLK_TCK);
+            timespec now{};
+            if (ticksPerSecond <= 0 || clock_gettime(CLOCK_BOOTTIME, &now) != 0) {
+                return -1;
+            }
+            int64_t startedNs = static_cast<int64_t>(std::stoull(field) * (1'000'000'000ull / ticksPerSecond));
+            return static_cast<int64_t>(now.tv_sec) * 1'000'000'000 + now.tv_nsec - startedNs;
+        }
+    }
+    return -1;
+}
+#endif
+
+}  // namespace
+
+int64_t StartupProfiler::processStartNs() {
+    static const int64_t start = []() {
+#if defined(__linux__)
+        int64_t now = LatencyTracker::now();
+        int64_t age = processAgeNs();
+        // Tick resolution is coarse (usually 10 ms); never report a start after static init
+        if (age >= 0) {
+            return std::min(now - age, staticInitNs);
+        }
+#endif
+        return staticInitNs;
+    }();
+    return start;
+}
+
+StartupProfiler& StartupProfiler::instance() {
+    static StartupProfiler profiler;
+    return profiler;
+}
+
+StartupProfiler::StartupProfiler() : StartupProfiler(processStartNs()) {
+}
+
+StartupProfiler::StartupProfiler(int64_t startNs) : startNs_(startNs) {
+}
+
+void StartupProfiler::expect(const std::vector<std::string>& phases) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    expected_ = phases;
+}
+
+bool StartupProfiler::mark(const std::string& phase) {
+    return mark(phase, LatencyTracker::now());
+}
+
+bool StartupProfiler::mark(const std::string& phase, int64_t nowNs) {
+    bool printReport = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& existing : phases_) {
+            if (existing.name == phase) {
+                return false;
+            }
+        }
+        phases_.push_back({phase, nowNs - startNs_});
+        std::sort(phases_.begin(), phases_.end(),
+                  [](const StartupPhase& a, const StartupPhase& b) { return a.sinceStartNs < b.sinceStartNs; });
+        if (!reported_ && completeLocked()) {
+            reported_ = true;
+            printReport = true;
+        }
+    }
+    if (printReport) {
+        report(std::cout);
+    }
+    return true;
+}
+
+std::vector<StartupPhase> StartupProfiler::phases() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return phases_;
+}
+
+bool StartupProfiler::isComplete() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return completeLocked();
+}
+
+bool StartupProfiler::completeLocked() const {
+    if (expected_.empty()) {
+        return false;
+    }
+    for (const auto& name : expected_) {
+        if (std::none_of(phases_.begin(), phases_.end(), [&](const StartupPhase& phase) { return phase.name == name; })) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void StartupProfiler::report(std::ostream& out) const {
+    auto reached = phases();
+    auto flags = out.flags();
+    auto precision = out.precision();
+    out << "[STARTUP] Milestones since process start:" << std::endl;
+    int64_t previous = 0;
+    for (const auto& phase : reached) {
+        out << "[STARTUP]   " << std::left << std::setw(16) << phase.name << std::right << std::fixed
+            << std::setprecision(1) << std::setw(9) << phase.sinceStartNs / 1e6 << " ms  (+"
+            << (phase.sinceStartNs - previous) / 1e6 << " ms)" << std::endl;
+        previous = phase.sinceStartNs;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+struct StartupPhase {
+    std::string name;
+    int64_t sinceStartNs = 0;
+};
+
+// Cold-start milestones measured from process start.
+//
+// The start is taken from the kernel's record of when the process was created where available
+// (Linux), so time spent loading shared libraries before main() counts; elsewhere it is the
+// moment static initialization reached this file. Milestones may be marked from any thread; only
+// the first mark of a phase counts. Once every expected phase is marked the summary is printed.
+class StartupProfiler {
+public:
+    static StartupProfiler& instance();
+
+    // Starts at process start; tests pass their own start time
+    StartupProfiler();
+    explicit StartupProfiler(int64_t startNs);
+
+    // Phases that make up a complete startup, printed as one [STARTUP] summary when all are marked
+    void expect(const std::vector<std::string>& phases);
+    // Returns false if the phase was marked before
+    bool mark(const std::string& phase);
+    bool mark(const std::string& phase, int64_t nowNs);
+
+    std::vector<StartupPhase> phases() const;  // in the order they were reached
+    bool isComplete() const;
+    void report(std::ostream& out) const;
+
+    static int64_t processStartNs();
+
+private:
+    bool completeLocked() const;
+
+    int64_t startNs_;
+    mutable std::mutex mutex_;
+    std::vector<StartupPhase> phases_;
+    std::vector<std::string> expected_;
+    bool reported_ = false;
+};
@@ -0,0 +1,217 @@
+#include "trace_recorder.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include "latency_tracker.h"
+
+namespace {
+
+std::atomic<uint64_t> nextGeneration{1};
+
+// Rings this thread records into, one per live recorder. Dropping the last reference from the
+// thread side marks the ring free for the next thread; the recorder keeps it alive for export.
+struct ThreadRegistration {
+    struct Entry {
+        uint64_t generation;
+        std::shared_ptr<void> owner;  // the ring, type-erased so this struct stays private here
+        void* buffer;
+        std::atomic<bool>* inUse;
+    };
+    std::vector<Entry> entries;
+
+    ~ThreadRegistration() {
+        for (auto& entry : entries) {
+            entry.inUse->store(false, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadRegistration registration;
+
+void writeJsonString(std::ostream& out, const char* text) {
+    out << '"';
+    for (const char* c = text; *c; c++) {
+        switch (*c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            default:
+                if (static_cast<unsigned char>(*c) < 0x20) {
+                    out << ' ';
+                } else {
+                    out << *c;
+                }
+        }
+    }
+    out << '"';
+}
+
+}  // namespace
+
+TraceRecorder& TraceRecorder::instance() {
+    static TraceRecorder recorder;
+    return recorder;
+}
+
+TraceRecorder::TraceRecorder()
+    : epochNs_(LatencyTracker::now()),
+      generation_(nextGeneration.fetch_add(1)) {
+}
+
+TraceRecorder::~TraceRecorder() = default;
+
+void TraceRecorder::setEnabled(bool enabled) {
+    enabled_.store(enabled, std::memory_order_relaxed);
+}
+
+void TraceRecorder::setEventsPerThread(size_t events) {
+    eventsPerThread_.store(std::max<size_t>(events, 1), std::memory_order_relaxed);
+}
+
+TraceRecorder::ThreadBuffer* TraceRecorder::threadBuffer() {
+    for (const auto& entry : registration.entries) {
+        if (entry.generation == generation_) {
+            return static_cast<ThreadBuffer*>(entry.buffer);
+        }
+    }
+
+    // Forget rings of recorders that no longer exist
+    std::erase_if(registration.entries, [](const auto& entry) { return entry.owner.use_count() == 1; });
+
+    std::shared_ptr<ThreadBuffer> buffer;
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex_);
+        for (const auto& candidate : threads_) {
+            bool expected = false;
+            if (candidate->inUse.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+                buffer = candidate;
+                break;
+            }
+        }
+        if (!buffer) {
+            buffer = std::make_shared<ThreadBuffer>(eventsPerThread_.load(std::memory_order_relaxed));
+            threads_.push_back(buffer);
+        }
+        buffer->threadId = nextThreadId_.fetch_add(1);
+    }
+    registration.entries.push_back({generation_, buffer, buffer.get(), &buffer->inUse});
+    return buffer.get();
+}
+
+void TraceRecorder::setThreadName(const std::string& name) {
+    auto* buffer = threadBuffer();
+    std::lock_guard<std::mutex> lock(threadsMutex_);
+    threadNames_[buffer->threadId] = name;
+}
+
+void TraceRecorder::record(const TraceEvent& event) {
+    auto* buffer = threadBuffer();
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    auto& slot = buffer->events[head % buffer->events.size()];
+    slot = event;
+    slot.threadId = buffer->threadId;
+    buffer->head.store(head + 1, std::memory_order_release);
+}
+
+void TraceRecorder::clear() {
+    std::lock_guard<std::mutex> lock(threadsMutex_);
+    for (const auto& buffer : threads_) {
+        buffer->floor.store(buffer->head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+}
+
+std::vector<TraceEvent> TraceRecorder::events() const {
+    std::vector<TraceEvent> events;
+    std::lock_guard<std::mutex> lock(threadsMutex_);
+    for (const auto& buffer : threads_) {
+        const uint64_t capacity = buffer->events.size();
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        uint64_t first = std::max(buffer->floor.load(std::memory_order_acquire), head > capacity ? head - capacity : 0);
+        size_t start = events.size();
+        for (uint64_t i = first; i < head; i++) {
+            events.push_back(buffer->events[i % capacity]);
+        }
+        // Anything the writer reached again while we copied may be torn, including the slot it
+        // is writing right now
+        uint64_t headAfter = buffer->head.load(std::memory_order_acquire);
+        uint64_t valid = headAfter + 1 > capacity ? headAfter + 1 - capacity : 0;
+        if (valid > first) {
+            size_t torn = static_cast<size_t>(std::min<uint64_t>(valid - first, head - first));
+            events.erase(events.begin() + static_cast<std::ptrdiff_t>(start),
+                         events.begin() + static_cast<std::ptrdiff_t>(start + torn));
+        }
+    }
+    std::sort(events.begin(), events.end(), [](const TraceEvent& a, const TraceEvent& b) { return a.startNs < b.startNs; });
+    return events;
+}
+
+void TraceRecorder::writeChromeTrace(std::ostream& out) const {
+    auto recorded = events();
+    std::map<uint32_t, std::string> names;
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex_);
+        names = threadNames_;
+    }
+
+    std::ostringstream text;
+    text << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    bool first = true;
+    for (const auto& [threadId, name] : names) {
+        text << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << threadId
+             << ",\"args\":{\"name\":";
+        writeJsonString(text, name.c_str());
+        text << "}}";
+        first = false;
+    }
+    for (const auto& event : recorded) {
+        text << (first ? "" : ",\n") << "{\"name\":";
+        writeJsonString(text, event.name ? event.name : "?");
+        text << ",\"cat\":";
+        writeJsonString(text, event.category ? event.category : "app");
+        // Chrome expects microseconds; keep sub-microsecond precision as a fraction
+        text << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.threadId
+             << ",\"ts\":" << static_cast<double>(event.startNs - epochNs_) / 1000.0
+             << ",\"dur\":" << static_cast<double>(event.durationNs) / 1000.0;
+        if (event.argName) {
+            text << ",\"args\":{";
+            writeJsonString(text, event.argName);
+            text << ":" << event.argValue << "}";
+        }
+        text << "}";
+        first = false;
+    }
+    text << "\n]}\n";
+    out << text.str();
+}
+
+bool TraceRecorder::writeChromeTrace(const std::string& path) const {
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        std::cerr << "[TRACE] Cannot write " << path << std::endl;
+        return false;
+    }
+    writeChromeTrace(out);
+    if (!out) {
+        std::cerr << "[TRACE] Failed writing " << path << std::endl;
+        return false;
+    }
+    std::cout << "[TRACE] Wrote " << path << " (open in ui.perfetto.dev or chrome://tracing)" << std::endl;
+    return true;
+}
+
+TraceSpan::TraceSpan(const char* name, const char* category, TraceRecorder& recorder)
+    : recorder_(recorder.isEnabled() ? &recorder : nullptr) {
+    if (recorder_) {
+        event_.name = name;
+        event_.category = category;
+        event_.startNs = LatencyTracker::now();
+    }
+}
+
+TraceSpan::~TraceSpan() {
+    if (recorder_) {
+        event_.durationNs = LatencyTracker::now() - event_.startNs;
+        recorder_->record(event_);
+    }
+}
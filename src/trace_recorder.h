@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One completed span. Names, categories and argument names must be string literals (or
+// otherwise outlive the recorder); only the pointers are stored.
+struct TraceEvent {
+    const char* name = nullptr;
+    const char* category = nullptr;
+    int64_t startNs = 0;
+    int64_t durationNs = 0;
+    const char* argName = nullptr;  // optional single numeric argument
+    int64_t argValue = 0;
+    uint32_t threadId = 0;
+};
+
+// Timeline recorder for finding where the time goes during property loads and UI hitches.
+//
+// Every thread that records gets its own ring of TraceEvent, written only by that thread and
+// published with a release store of its head, so recording is a clock read plus a slot write and
+// never contends. Rings are claimed once per thread under a mutex, kept after the thread exits
+// and reused by the next new thread, so short-lived worker threads do not grow memory without
+// bound. When a ring is full the oldest events are overwritten.
+//
+// Disabled (the default), a TraceSpan costs one relaxed atomic load. Export reads each ring's
+// head before and after copying and drops anything the writer may have lapped meanwhile, so it is
+// safe while recording continues. The output is Chrome trace event JSON, which chrome://tracing
+// and ui.perfetto.dev both open.
+class TraceRecorder {
+public:
+    static constexpr size_t DEFAULT_EVENTS_PER_THREAD = 16384;
+
+    static TraceRecorder& instance();
+
+    void setEnabled(bool enabled);
+    bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+    // Applies to rings created afterwards
+    void setEventsPerThread(size_t events);
+
+    // Names the calling thread in the exported timeline
+    void setThreadName(const std::string& name);
+
+    void record(const TraceEvent& event);
+    void clear();
+
+    std::vector<TraceEvent> events() const;  // all rings, sorted by start time
+    void writeChromeTrace(std::ostream& out) const;
+    bool writeChromeTrace(const std::string& path) const;
+
+    TraceRecorder();  // public for tests; the app uses instance()
+    ~TraceRecorder();
+
+private:
+    struct ThreadBuffer {
+        explicit ThreadBuffer(size_t capacity) : events(capacity) {}
+
+        std::vector<TraceEvent> events;
+        std::atomic<uint64_t> head{0};   // total events ever written
+        std::atomic<uint64_t> floor{0};  // events before this index were cleared
+        std::atomic<bool> inUse{true};   // cleared when the owning thread exits
+        uint32_t threadId = 0;           // changes when another thread takes the ring over
+    };
+
+    ThreadBuffer* threadBuffer();
+
+    std::atomic<bool> enabled_{false};
+    std::atomic<size_t> eventsPerThread_{DEFAULT_EVENTS_PER_THREAD};
+    int64_t epochNs_;
+    uint64_t generation_;  // distinguishes recorders so a thread can record into several (tests)
+
+    mutable std::mutex threadsMutex_;
+    std::vector<std::shared_ptr<ThreadBuffer>> threads_;  // the owning thread holds the other reference
+    std::map<uint32_t, std::string> threadNames_;
+    std::atomic<uint32_t> nextThreadId_{1};
+};
+
+// Records the time between construction and destruction as one complete event
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* category = "app",
+                       TraceRecorder& recorder = TraceRecorder::instance());
+    ~TraceSpan();
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+    void setArg(const char* name, int64_t value) {
+        event_.argName = name;
+        event_.argValue = value;
+    }
+
+private:
+    TraceRecorder* recorder_;  // null when recording was disabled at construction
+    TraceEvent event_;
+};
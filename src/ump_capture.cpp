@@ -0,0 +1,209 @@
+#include "ump_capture.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+namespace {
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t systemNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Shared fields in the mapping are plain integers so that the on-disk layout is well defined;
+// concurrent access goes through atomic_ref.
+std::atomic_ref<uint64_t> writeIndexRef(const UmpCaptureFileHeader* header) {
+    return std::atomic_ref<uint64_t>(const_cast<uint64_t&>(header->write_index));
+}
+
+std::atomic_ref<uint32_t> sequenceRef(const UmpCaptureRecord& record) {
+    return std::atomic_ref<uint32_t>(const_cast<uint32_t&>(record.sequence));
+}
+}
+
+UmpCaptureRecorder::~UmpCaptureRecorder() {
+    close();
+}
+
+bool UmpCaptureRecorder::open(const std::string& path, uint64_t capacity, uint32_t localMuid) {
+    close();
+
+    if (capacity == 0) {
+        std::cerr << "[CAPTURE] Capacity must be greater than zero" << std::endl;
+        return false;
+    }
+
+    size_t fileSize = sizeof(UmpCaptureFileHeader) + static_cast<size_t>(capacity) * sizeof(UmpCaptureRecord);
+    if (!file_.createReadWrite(path, fileSize)) {
+        return false;
+    }
+
+    // The file was created by truncation, so all records start out zeroed (sequence 0 = empty)
+    header_ = reinterpret_cast<UmpCaptureFileHeader*>(file_.data());
+    records_ = reinterpret_cast<UmpCaptureRecord*>(file_.data() + sizeof(UmpCaptureFileHeader));
+    capacity_ = capacity;
+    start_steady_ns_ = steadyNowNs();
+
+    std::memcpy(header_->magic, UmpCaptureFileHeader::MAGIC, sizeof(header_->magic));
+    header_->version = UmpCaptureFileHeader::VERSION;
+    header_->endian_marker = UmpCaptureFileHeader::ENDIAN_MARKER;
+    header_->header_size = sizeof(UmpCaptureFileHeader);
+    header_->record_size = sizeof(UmpCaptureRecord);
+    header_->capacity = capacity;
+    header_->start_system_ns = systemNowNs();
+    header_->start_steady_ns = start_steady_ns_;
+    header_->local_muid = localMuid;
+    writeIndexRef(header_).store(0, std::memory_order_release);
+
+    std::cout << "[CAPTURE] Recording UMP traffic to " << path << " (" << capacity << " records ring)" << std::endl;
+    return true;
+}
+
+void UmpCaptureRecorder::close() {
+    if (!file_.isOpen()) return;
+
+    std::cout << "[CAPTURE] Closing " << file_.path() << " after " << recordCount() << " records" << std::endl;
+    file_.flush();
+    file_.close();
+    header_ = nullptr;
+    records_ = nullptr;
+    capacity_ = 0;
+}
+
+void UmpCaptureRecorder::append(UmpCaptureDirection direction, const uint32_t* words, int wordCount) {
+    if (!header_) return;
+
+    uint64_t index = writeIndexRef(header_).fetch_add(1, std::memory_order_relaxed);
+    UmpCaptureRecord& record = records_[index % capacity_];
+    auto sequence = sequenceRef(record);
+
+    // Invalidate the slot first so a concurrent reader never mixes old and new contents
+    sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    record.timestamp_ns = static_cast<uint64_t>(steadyNowNs() - start_steady_ns_);
+    int count = wordCount < 0 ? 0 : (wordCount > 4 ? 4 : wordCount);
+    for (int i = 0; i < 4; i++) {
+        record.words[i] = i < count ? words[i] : 0;
+    }
+    record.direction = static_cast<uint8_t>(direction);
+    record.word_count = static_cast<uint8_t>(count);
+    record.reserved = 0;
+
+    sequence.store(static_cast<uint32_t>(index + 1), std::memory_order_release);
+}
+
+void UmpCaptureRecorder::setLocalMuid(uint32_t muid) {
+    if (header_) {
+        std::atomic_ref<uint32_t>(header_->local_muid).store(muid, std::memory_order_relaxed);
+    }
+}
+
+uint64_t UmpCaptureRecorder::recordCount() const {
+    return header_ ? writeIndexRef(header_).load(std::memory_order_relaxed) : 0;
+}
+
+bool UmpCaptureReader::open(const std::string& path) {
+    close();
+
+    if (!file_.openReadOnly(path)) {
+        return false;
+    }
+
+    if (file_.size() < sizeof(UmpCaptureFileHeader)) {
+        std::cerr << "[CAPTURE] " << path << " is too small to be a capture file" << std::endl;
+        close();
+        return false;
+    }
+
+    std::memcpy(&header_, file_.data(), sizeof(UmpCaptureFileHeader));
+    if (std::memcmp(header_.magic, UmpCaptureFileHeader::MAGIC, sizeof(header_.magic)) != 0) {
+        std::cerr << "[CAPTURE] " << path << " is not a UMP capture file" << std::endl;
+        close();
+        return false;
+    }
+    if (header_.endian_marker != UmpCaptureFileHeader::ENDIAN_MARKER) {
+        std::cerr << "[CAPTURE] " << path << " was recorded on a host with different endianness" << std::endl;
+        close();
+        return false;
+    }
+    if (header_.version != UmpCaptureFileHeader::VERSION ||
+        header_.header_size != sizeof(UmpCaptureFileHeader) ||
+        header_.record_size != sizeof(UmpCaptureRecord)) {
+        std::cerr << "[CAPTURE] Unsupported capture format version " << header_.version << std::endl;
+        close();
+        return false;
+    }
+    if (header_.capacity == 0 ||
+        file_.size() < sizeof(UmpCaptureFileHeader) + header_.capacity * sizeof(UmpCaptureRecord)) {
+        std::cerr << "[CAPTURE] " << path << " is truncated" << std::endl;
+        close();
+        return false;
+    }
+
+    records_ = reinterpret_cast<const UmpCaptureRecord*>(file_.data() + sizeof(UmpCaptureFileHeader));
+    return true;
+}
+
+void UmpCaptureReader::close() {
+    file_.close();
+    records_ = nullptr;
+}
+
+uint64_t UmpCaptureReader::endIndex() const {
+    if (!records_) return 0;
+    return writeIndexRef(reinterpret_cast<const UmpCaptureFileHeader*>(file_.data())).load(std::memory_order_acquire);
+}
+
+uint64_t UmpCaptureReader::firstIndex() const {
+    uint64_t end = endIndex();
+    return end > header_.capacity ? end - header_.capacity : 0;
+}
+
+void UmpCaptureReader::forEach(const std::function<bool(const UmpCaptureEntry&)>& visitor) const {
+    if (!records_) return;
+
+    uint64_t end = endIndex();
+    uint64_t begin = end > header_.capacity ? end - header_.capacity : 0;
+
+    for (uint64_t index = begin; index < end; index++) {
+        const UmpCaptureRecord& record = records_[index % header_.capacity];
+        auto sequence = sequenceRef(record);
+        uint32_t expected = static_cast<uint32_t>(index + 1);
+
+        if (sequence.load(std::memory_order_acquire) != expected) {
+            continue;  // still being written, or already overwritten by a newer lap
+        }
+
+        UmpCaptureEntry entry{};
+        entry.index = index;
+        entry.timestamp_ns = record.timestamp_ns;
+        entry.direction = static_cast<UmpCaptureDirection>(record.direction);
+        entry.word_count = record.word_count;
+        std::memcpy(entry.words, record.words, sizeof(entry.words));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sequence.load(std::memory_order_relaxed) != expected) {
+            continue;  // torn by a concurrent writer
+        }
+
+        if (!visitor(entry)) {
+            break;
+        }
+    }
+}
+
+std::vector<UmpCaptureEntry> UmpCaptureReader::readAll() const {
+    std::vector<UmpCaptureEntry> entries;
+    entries.reserve(static_cast<size_t>(endIndex() - firstIndex()));
+    forEach([&entries](const UmpCaptureEntry& entry) {
+        entries.push_back(entry);
+        return true;
+    });
+    return entries;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+// Binary capture format ("UMPCAP"):
+//
+//   [UmpCaptureFileHeader: 128 bytes][UmpCaptureRecord: 32 bytes] x capacity
+//
+// The record area is a ring: record N lives in slot N % capacity and the header's
+// write_index is the number of records ever appended. All multi-byte fields are
+// host-endian; the header stores an endianness marker so readers can reject foreign captures.
+
+enum class UmpCaptureDirection : uint8_t {
+    Incoming = 0,
+    Outgoing = 1
+};
+
+struct UmpCaptureFileHeader {
+    static constexpr char MAGIC[8] = {'U', 'M', 'P', 'C', 'A', 'P', '\0', '\0'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t ENDIAN_MARKER = 0x01020304;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t endian_marker;
+    uint32_t header_size;
+    uint32_t record_size;
+    uint64_t capacity;
+    int64_t start_system_ns;      // system_clock at capture start, to map timestamps to wall clock
+    int64_t start_steady_ns;      // steady_clock at capture start
+    uint32_t local_muid;          // MIDI-CI MUID of this app, needed to replay CI replies addressed to us
+    uint32_t reserved0;
+    uint8_t reserved1[8];
+    alignas(64) uint64_t write_index;  // updated with atomic_ref; on its own cache line
+    uint8_t reserved2[56];
+};
+static_assert(sizeof(UmpCaptureFileHeader) == 128, "capture header layout must stay stable");
+
+struct UmpCaptureRecord {
+    uint64_t timestamp_ns;        // steady_clock nanoseconds since start_steady_ns
+    uint32_t words[4];
+    uint8_t direction;            // UmpCaptureDirection
+    uint8_t word_count;
+    uint16_t reserved;
+    uint32_t sequence;            // (record index + 1) truncated, written last; 0 while being written
+};
+static_assert(sizeof(UmpCaptureRecord) == 32, "capture record layout must stay stable");
+
+// A decoded record as returned by UmpCaptureReader
+struct UmpCaptureEntry {
+    uint64_t index;
+    uint64_t timestamp_ns;
+    UmpCaptureDirection direction;
+    uint8_t word_count;
+    uint32_t words[4];
+};
+
+// Lock-free writer into a preallocated memory-mapped ring file.
+// append() may be called concurrently from the MIDI input callback and any send path;
+// each call is one fetch_add plus a 32-byte store into the mapping, so it can stay enabled all the time.
+class UmpCaptureRecorder {
+public:
+    static constexpr uint64_t DEFAULT_CAPACITY = 1 << 20;  // 1M records = 32 MiB
+
+    UmpCaptureRecorder() = default;
+    ~UmpCaptureRecorder();
+
+    bool open(const std::string& path, uint64_t capacity = DEFAULT_CAPACITY, uint32_t localMuid = 0);
+    void close();
+    bool isOpen() const { return file_.isOpen(); }
+    const std::string& path() const { return file_.path(); }
+
+    void append(UmpCaptureDirection direction, const uint32_t* words, int wordCount);
+    void setLocalMuid(uint32_t muid);
+
+    uint64_t recordCount() const;
+    uint64_t capacity() const { return capacity_; }
+
+    // The whole mapping (header and ring), e.g. for pre-faulting before appends start
+    uint8_t* mappedData() { return file_.data(); }
+    size_t mappedSize() const { return file_.size(); }
+
+private:
+    MappedFile file_;
+    UmpCaptureFileHeader* header_ = nullptr;
+    UmpCaptureRecord* records_ = nullptr;
+    uint64_t capacity_ = 0;
+    int64_t start_steady_ns_ = 0;
+};
+
+// Reader for capture files; tolerant of a live writer (torn records are skipped).
+class UmpCaptureReader {
+public:
+    bool open(const std::string& path);
+    void close();
+
+    const UmpCaptureFileHeader& header() const { return header_; }
+    uint64_t firstIndex() const;
+    uint64_t endIndex() const;
+
+    // Visit the surviving records in append order. Returning false from the visitor stops the walk.
+    void forEach(const std::function<bool(const UmpCaptureEntry&)>& visitor) const;
+    std::vector<UmpCaptureEntry> readAll() const;
+
+private:
+    MappedFile file_;
+    UmpCaptureFileHeader header_{};
+    const UmpCaptureRecord* records_ = nullptr;
+};
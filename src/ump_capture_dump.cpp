@@ -0,0 +1,140 @@
+// Offline dump tool for UMP capture files written by KeyboardController::startCapture().
+//
+// Usage: ump-capture-dump <capture-file> [--in | --out] [--limit N] [--summary]
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include "ump_capture.h"
+#include "ump_utils.h"
+
+namespace {
+
+const char* messageTypeName(uint32_t word0) {
+    switch (umpMessageType(word0)) {
+        case 0x0: return "Utility";
+        case 0x1: return "System";
+        case 0x2: return "MIDI1 CV";
+        case 0x3: return "SysEx7";
+        case 0x4: return "MIDI2 CV";
+        case 0x5: return "Data128";
+        case 0xD: return "Flex";
+        case 0xF: return "Stream";
+        default: return "Reserved";
+    }
+}
+
+const char* channelVoiceName(uint32_t word0) {
+    switch ((word0 >> 20) & 0xF) {
+        case 0x0: return "RegPerNoteCtrl";
+        case 0x1: return "AsgPerNoteCtrl";
+        case 0x2: return "RPN";
+        case 0x3: return "NRPN";
+        case 0x4: return "RelRPN";
+        case 0x5: return "RelNRPN";
+        case 0x6: return "PerNotePitchBend";
+        case 0x8: return "NoteOff";
+        case 0x9: return "NoteOn";
+        case 0xA: return "PolyPressure";
+        case 0xB: return "CC";
+        case 0xC: return "Program";
+        case 0xD: return "ChannelPressure";
+        case 0xE: return "PitchBend";
+        case 0xF: return "PerNoteMgmt";
+        default: return "?";
+    }
+}
+
+void printUsage() {
+    std::cerr << "Usage: ump-capture-dump <capture-file> [--in | --out] [--limit N] [--summary]" << std::endl;
+}
+
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printUsage();
+        return 1;
+    }
+
+    std::string path;
+    bool onlyIncoming = false;
+    bool onlyOutgoing = false;
+    bool summaryOnly = false;
+    uint64_t limit = UINT64_MAX;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--in") {
+            onlyIncoming = true;
+        } else if (arg == "--out") {
+            onlyOutgoing = true;
+        } else if (arg == "--summary") {
+            summaryOnly = true;
+        } else if (arg == "--limit" && i + 1 < argc) {
+            limit = std::stoull(argv[++i]);
+        } else if (path.empty()) {
+            path = arg;
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+
+    UmpCaptureReader reader;
+    if (!reader.open(path)) {
+        return 2;
+    }
+
+    const auto& header = reader.header();
+    std::cout << "# capture " << path << ": capacity " << header.capacity
+              << ", records " << reader.firstIndex() << ".." << reader.endIndex()
+              << ", local MUID 0x" << std::hex << header.local_muid << std::dec << std::endl;
+
+    uint64_t shown = 0;
+    uint64_t incoming = 0;
+    uint64_t outgoing = 0;
+    uint64_t typeCounts[16] = {};
+
+    reader.forEach([&](const UmpCaptureEntry& entry) {
+        bool isIncoming = entry.direction == UmpCaptureDirection::Incoming;
+        if ((onlyIncoming && !isIncoming) || (onlyOutgoing && isIncoming)) {
+            return true;
+        }
+
+        (isIncoming ? incoming : outgoing)++;
+        typeCounts[umpMessageType(entry.words[0])]++;
+        if (summaryOnly) {
+            return true;
+        }
+
+        char line[160];
+        int n = std::snprintf(line, sizeof(line), "%10llu %6llu.%09llu %-3s G%-2u %-9s",
+                              static_cast<unsigned long long>(entry.index),
+                              static_cast<unsigned long long>(entry.timestamp_ns / 1000000000ULL),
+                              static_cast<unsigned long long>(entry.timestamp_ns % 1000000000ULL),
+                              isIncoming ? "IN" : "OUT",
+                              static_cast<unsigned>(umpGroup(entry.words[0])),
+                              messageTypeName(entry.words[0]));
+        for (int i = 0; i < entry.word_count && n > 0 && n < static_cast<int>(sizeof(line)); i++) {
+            n += std::snprintf(line + n, sizeof(line) - n, " %08X", entry.words[i]);
+        }
+        std::cout << line;
+        if (umpMessageType(entry.words[0]) == 0x4) {
+            std::cout << "  " << channelVoiceName(entry.words[0]) << " ch" << ((entry.words[0] >> 16) & 0xF);
+        }
+        std::cout << '\n';
+
+        return ++shown < limit;
+    });
+
+    std::cout << "# incoming " << incoming << ", outgoing " << outgoing << std::endl;
+    for (int type = 0; type < 16; type++) {
+        if (typeCounts[type] > 0) {
+            std::cout << "#   type 0x" << std::hex << type << std::dec << " (" << messageTypeName(static_cast<uint32_t>(type) << 28)
+                      << "): " << typeCounts[type] << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,265 @@
+#include "ump_endpoint.h"
+#include <algorithm>
+#include <sstream>
+#include "ump_utils.h"
+
+namespace {
+
+// UMP Stream status values
+constexpr uint16_t ENDPOINT_DISCOVERY = 0x000;
+constexpr uint16_t ENDPOINT_INFO = 0x001;
+constexpr uint16_t DEVICE_IDENTITY = 0x002;
+constexpr uint16_t ENDPOINT_NAME = 0x003;
+constexpr uint16_t PRODUCT_INSTANCE_ID = 0x004;
+constexpr uint16_t STREAM_CONFIGURATION_REQUEST = 0x005;
+constexpr uint16_t STREAM_CONFIGURATION = 0x006;
+constexpr uint16_t FUNCTION_BLOCK_DISCOVERY = 0x010;
+constexpr uint16_t FUNCTION_BLOCK_INFO = 0x011;
+constexpr uint16_t FUNCTION_BLOCK_NAME = 0x012;
+
+// Format of a multi-packet UMP Stream message
+constexpr uint8_t FORMAT_COMPLETE = 0x0;
+constexpr uint8_t FORMAT_START = 0x1;
+constexpr uint8_t FORMAT_END = 0x3;
+
+constexpr uint32_t streamWord0(uint16_t status) {
+    return 0xF0000000u | (static_cast<uint32_t>(status & 0x3FF) << 16);
+}
+
+// Appends the text bytes of one packet, starting at byte `first` of the 16-byte message
+void appendText(const uint32_t* ump, size_t first, std::string& out) {
+    for (size_t i = first; i < 16; i++) {
+        char c = static_cast<char>((ump[i / 4] >> (24 - 8 * (i % 4))) & 0xFF);
+        if (c == '\0') {
+            break;
+        }
+        out.push_back(c);
+    }
+}
+
+// Collects a text spread over packets; returns true when the text is complete
+bool collectText(const uint32_t* ump, size_t first, std::string& buffer) {
+    uint8_t format = (ump[0] >> 26) & 0x3;
+    if (format == FORMAT_COMPLETE || format == FORMAT_START) {
+        buffer.clear();
+    }
+    appendText(ump, first, buffer);
+    return format == FORMAT_COMPLETE || format == FORMAT_END;
+}
+
+const char* protocolName(UmpProtocol protocol) {
+    return protocol == UmpProtocol::Midi1 ? "MIDI 1.0" : "MIDI 2.0";
+}
+
+}  // namespace
+
+uint16_t UmpFunctionBlock::groupMask() const {
+    uint16_t mask = 0;
+    for (int group = firstGroup; group < std::min(firstGroup + groupCount, 16); group++) {
+        mask |= static_cast<uint16_t>(1u << group);
+    }
+    return mask;
+}
+
+std::array<uint32_t, 4> UmpEndpointDiscovery::endpointDiscovery(uint8_t filter) {
+    // We implement UMP 1.1
+    return {streamWord0(ENDPOINT_DISCOVERY) | (1u << 8) | 1u, filter, 0, 0};
+}
+
+std::array<uint32_t, 4> UmpEndpointDiscovery::functionBlockDiscovery(uint8_t block, uint8_t filter) {
+    return {streamWord0(FUNCTION_BLOCK_DISCOVERY) | (static_cast<uint32_t>(block) << 8) | filter, 0, 0, 0};
+}
+
+std::array<uint32_t, 4> UmpEndpointDiscovery::streamConfigurationRequest(UmpProtocol protocol, bool rxJr, bool txJr) {
+    return {streamWord0(STREAM_CONFIGURATION_REQUEST) | (static_cast<uint32_t>(protocol) << 8) | (rxJr ? 0x2u : 0u) |
+                (txJr ? 0x1u : 0u),
+            0, 0, 0};
+}
+
+void UmpEndpointDiscovery::start(std::vector<uint32_t>& requests) {
+    start(UmpEndpointInfo{}, requests);
+    endpointKnown_ = false;
+}
+
+void UmpEndpointDiscovery::start(const UmpEndpointInfo& cached, std::vector<uint32_t>& requests) {
+    endpoint_ = cached;
+    // The configuration may have been changed by someone else since; negotiate on the fresh notification
+    endpoint_.configurationKnown = false;
+    endpointKnown_ = true;
+    configurationRequested_ = false;
+    nameBuffer_.clear();
+    productInstanceIdBuffer_.clear();
+    blockNameBuffers_.assign(endpoint_.functionBlocks.size(), std::string());
+    auto request = endpointDiscovery();
+    requests.insert(requests.end(), request.begin(), request.end());
+}
+
+bool UmpEndpointDiscovery::handle(const uint32_t* ump, std::vector<uint32_t>& requests) {
+    if (umpMessageType(ump[0]) != 0xF) {
+        return false;
+    }
+    uint16_t status = (ump[0] >> 16) & 0x3FF;
+    switch (status) {
+        case ENDPOINT_INFO: {
+            endpoint_.umpVersionMajor = (ump[0] >> 8) & 0xFF;
+            endpoint_.umpVersionMinor = ump[0] & 0xFF;
+            endpoint_.staticFunctionBlocks = (ump[1] >> 31) & 0x1;
+            endpoint_.supportsMidi2 = (ump[1] >> 9) & 0x1;
+            endpoint_.supportsMidi1 = (ump[1] >> 8) & 0x1;
+            endpoint_.supportsRxJr = (ump[1] >> 1) & 0x1;
+            endpoint_.supportsTxJr = ump[1] & 0x1;
+            size_t blockCount = (ump[1] >> 24) & 0x7F;
+            if (endpoint_.functionBlocks.size() != blockCount) {
+                endpoint_.functionBlocks.assign(blockCount, UmpFunctionBlock{});
+                for (size_t i = 0; i < blockCount; i++) {
+                    endpoint_.functionBlocks[i].index = static_cast<uint8_t>(i);
+                }
+                blockNameBuffers_.assign(blockCount, std::string());
+            }
+            endpointKnown_ = true;
+            if (blockCount > 0) {
+                auto request = functionBlockDiscovery();
+                requests.insert(requests.end(), request.begin(), request.end());
+            }
+            negotiate(requests);
+            return true;
+        }
+        case DEVICE_IDENTITY:
+            endpoint_.manufacturer = ump[1] & 0x7F7F7F;
+            endpoint_.family = static_cast<uint16_t>((((ump[2] >> 16) & 0x7F) << 7) | ((ump[2] >> 24) & 0x7F));
+            endpoint_.model = static_cast<uint16_t>(((ump[2] & 0x7F) << 7) | ((ump[2] >> 8) & 0x7F));
+            endpoint_.version = ump[3] & 0x7F7F7F7F;
+            return true;
+        case ENDPOINT_NAME:
+            if (collectText(ump, 2, nameBuffer_)) {
+                endpoint_.name = nameBuffer_;
+                return true;
+            }
+            return false;
+        case PRODUCT_INSTANCE_ID:
+            if (collectText(ump, 2, productInstanceIdBuffer_)) {
+                endpoint_.productInstanceId = productInstanceIdBuffer_;
+                return true;
+            }
+            return false;
+        case STREAM_CONFIGURATION: {
+            uint8_t protocol = (ump[0] >> 8) & 0xFF;
+            endpoint_.protocol = protocol == 0x01 ? UmpProtocol::Midi1 : UmpProtocol::Midi2;
+            endpoint_.rxJr = (ump[0] >> 1) & 0x1;
+            endpoint_.txJr = ump[0] & 0x1;
+            endpoint_.configurationKnown = true;
+            negotiate(requests);
+            return true;
+        }
+        case FUNCTION_BLOCK_INFO: {
+            size_t index = (ump[0] >> 8) & 0x7F;
+            if (index >= endpoint_.functionBlocks.size()) {
+                // Announced before the endpoint info (or more than announced): keep it anyway
+                endpoint_.functionBlocks.resize(index + 1);
+                blockNameBuffers_.resize(index + 1);
+            }
+            UmpFunctionBlock& block = endpoint_.functionBlocks[index];
+            block.index = static_cast<uint8_t>(index);
+            block.known = true;
+            block.active = (ump[0] >> 15) & 0x1;
+            block.uiHint = (ump[0] >> 4) & 0x3;
+            block.midi1 = (ump[0] >> 2) & 0x3;
+            block.direction = ump[0] & 0x3;
+            block.firstGroup = (ump[1] >> 24) & 0xF;
+            block.groupCount = (ump[1] >> 16) & 0xFF;
+            block.midiCIVersion = (ump[1] >> 8) & 0xFF;
+            block.maxSysEx8Streams = ump[1] & 0xFF;
+            return true;
+        }
+        case FUNCTION_BLOCK_NAME: {
+            size_t index = (ump[0] >> 8) & 0x7F;
+            if (index >= endpoint_.functionBlocks.size()) {
+                return false;
+            }
+            if (collectText(ump, 3, blockNameBuffers_[index])) {
+                endpoint_.functionBlocks[index].name = blockNameBuffers_[index];
+                return true;
+            }
+            return false;
+        }
+        default:
+            // Our own requests echoed by a loopback, stream start/end, ...
+            return false;
+    }
+}
+
+void UmpEndpointDiscovery::negotiate(std::vector<uint32_t>& requests) {
+    if (!endpointKnown_ || !endpoint_.configurationKnown || configurationRequested_) {
+        return;
+    }
+    // Asked once per discovery: if the endpoint refuses, the configuration it reports is what we use
+    configurationRequested_ = true;
+
+    UmpProtocol protocol = endpoint_.protocol;
+    bool preferredSupported = preferences_.protocol == UmpProtocol::Midi2 ? endpoint_.supportsMidi2 : endpoint_.supportsMidi1;
+    if (preferredSupported) {
+        protocol = preferences_.protocol;
+    } else if (endpoint_.supportsMidi2 || endpoint_.supportsMidi1) {
+        protocol = endpoint_.supportsMidi2 ? UmpProtocol::Midi2 : UmpProtocol::Midi1;
+    }
+    bool rxJr = preferences_.sendJrTimestamps && endpoint_.supportsRxJr;
+    bool txJr = preferences_.receiveJrTimestamps && endpoint_.supportsTxJr;
+    if (protocol == endpoint_.protocol && rxJr == endpoint_.rxJr && txJr == endpoint_.txJr) {
+        return;
+    }
+    auto request = streamConfigurationRequest(protocol, rxJr, txJr);
+    requests.insert(requests.end(), request.begin(), request.end());
+}
+
+bool UmpEndpointDiscovery::functionBlocksKnown() const {
+    return endpointKnown_ && !endpoint_.functionBlocks.empty() &&
+           std::all_of(endpoint_.functionBlocks.begin(), endpoint_.functionBlocks.end(),
+                       [](const UmpFunctionBlock& block) { return block.known; });
+}
+
+uint16_t UmpEndpointDiscovery::receivingGroups() const {
+    if (!functionBlocksKnown()) {
+        return ALL_GROUPS;
+    }
+    uint16_t mask = 0;
+    for (const auto& block : endpoint_.functionBlocks) {
+        if (block.active && block.receives()) {
+            mask |= block.groupMask();
+        }
+    }
+    return mask;
+}
+
+uint16_t UmpEndpointDiscovery::midiCIGroups() const {
+    if (!functionBlocksKnown()) {
+        return ALL_GROUPS;
+    }
+    uint16_t mask = 0;
+    for (const auto& block : endpoint_.functionBlocks) {
+        if (block.active && block.receives() && block.midiCIVersion != 0) {
+            mask |= block.groupMask();
+        }
+    }
+    return mask;
+}
+
+std::string UmpEndpointDiscovery::describe() const {
+    std::ostringstream out;
+    out << '"' << endpoint_.name << "\" UMP " << static_cast<int>(endpoint_.umpVersionMajor) << "."
+        << static_cast<int>(endpoint_.umpVersionMinor) << ", " << protocolName(endpoint_.protocol)
+        << (endpoint_.configurationKnown ? "" : " (assumed)") << ", JR rx " << (endpoint_.rxJr ? "on" : "off")
+        << " tx " << (endpoint_.txJr ? "on" : "off") << ", " << endpoint_.functionBlocks.size()
+        << (endpoint_.staticFunctionBlocks ? " static" : "") << " function blocks";
+    for (const auto& block : endpoint_.functionBlocks) {
+        out << "; [" << static_cast<int>(block.index) << "] ";
+        if (!block.known) {
+            out << "pending";
+            continue;
+        }
+        out << '"' << block.name << "\" groups " << block.firstGroup + 1 << "-" << block.firstGroup + block.groupCount
+            << (block.direction == 0x3 ? " in/out" : block.receives() ? " in" : " out")
+            << (block.midiCIVersion ? " CI" : "") << (block.midi1 ? " MIDI1" : "")
+            << (block.active ? "" : " inactive");
+    }
+    return out.str();
+}
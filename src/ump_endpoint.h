@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class UmpProtocol : uint8_t {
+    Midi1 = 0x01,
+    Midi2 = 0x02,
+};
+
+// One Function Block as reported by Function Block Info/Name Notifications
+struct UmpFunctionBlock {
+    static constexpr uint8_t DIRECTION_INPUT = 0x1;   // the block receives what we send
+    static constexpr uint8_t DIRECTION_OUTPUT = 0x2;  // the block sends to us
+
+    uint8_t index = 0;
+    bool known = false;  // an info notification for this block has arrived
+    bool active = false;
+    uint8_t direction = 0;
+    uint8_t firstGroup = 0;
+    uint8_t groupCount = 0;
+    uint8_t midi1 = 0;            // 0: MIDI 2.0 allowed, 1: MIDI 1.0 only, 2: MIDI 1.0 at 31.25 kbit/s
+    uint8_t uiHint = 0;
+    uint8_t midiCIVersion = 0;    // 0: no MIDI-CI
+    uint8_t maxSysEx8Streams = 0;
+    std::string name;
+
+    bool receives() const { return (direction & DIRECTION_INPUT) != 0; }
+    // Bit n set for every group the block spans
+    uint16_t groupMask() const;
+};
+
+// What an endpoint told us about itself, and the stream configuration in effect
+struct UmpEndpointInfo {
+    uint8_t umpVersionMajor = 0;
+    uint8_t umpVersionMinor = 0;
+    bool staticFunctionBlocks = false;
+    bool supportsMidi2 = false;
+    bool supportsMidi1 = false;
+    bool supportsRxJr = false;  // the endpoint can receive JR Timestamps
+    bool supportsTxJr = false;  // the endpoint can send JR Timestamps
+    uint32_t manufacturer = 0;  // SysEx ID bytes, MSB first
+    uint16_t family = 0;
+    uint16_t model = 0;
+    uint32_t version = 0;
+    std::string name;
+    std::string productInstanceId;
+
+    bool configurationKnown = false;  // a Stream Configuration Notification has arrived
+    UmpProtocol protocol = UmpProtocol::Midi2;
+    bool rxJr = false;
+    bool txJr = false;
+
+    std::vector<UmpFunctionBlock> functionBlocks;
+};
+
+// What we ask the endpoint for during protocol negotiation
+struct UmpStreamPreferences {
+    UmpProtocol protocol = UmpProtocol::Midi2;
+    bool sendJrTimestamps = false;     // we timestamp our output (asks for RxJR)
+    bool receiveJrTimestamps = false;  // we use the endpoint's timestamps (asks for TxJR)
+};
+
+// Client side of UMP Endpoint and Function Block Discovery (UMP specification 1.1, UMP Stream
+// messages). start() yields the Endpoint Discovery request; handle() takes every incoming UMP
+// Stream message, keeps what it reports, and yields the follow-up requests: Function Block
+// Discovery once the block count is known, and one Stream Configuration Request if the
+// configuration in effect differs from the preferred one the endpoint supports.
+//
+// Until the endpoint has reported all of its function blocks every group counts as active, so an
+// endpoint that does not implement UMP Stream messages behaves as before. Not thread-safe.
+class UmpEndpointDiscovery {
+public:
+    static constexpr uint16_t ALL_GROUPS = 0xFFFF;
+
+    // Request packets (four words each)
+    static std::array<uint32_t, 4> endpointDiscovery(uint8_t filter = 0x1F);
+    static std::array<uint32_t, 4> functionBlockDiscovery(uint8_t block = 0xFF, uint8_t filter = 0x03);
+    static std::array<uint32_t, 4> streamConfigurationRequest(UmpProtocol protocol, bool rxJr, bool txJr);
+
+    void setPreferences(const UmpStreamPreferences& preferences) { preferences_ = preferences; }
+    const UmpStreamPreferences& preferences() const { return preferences_; }
+
+    // Forgets the endpoint, or starts from what an earlier discovery found, and appends the
+    // Endpoint Discovery request to `requests`
+    void start(std::vector<uint32_t>& requests);
+    void start(const UmpEndpointInfo& cached, std::vector<uint32_t>& requests);
+
+    // Takes one incoming UMP Stream message (type 0xF; anything else is ignored) and appends any
+    // follow-up requests. Returns true if the endpoint information changed.
+    bool handle(const uint32_t* ump, std::vector<uint32_t>& requests);
+
+    const UmpEndpointInfo& endpoint() const { return endpoint_; }
+    bool isEndpointKnown() const { return endpointKnown_; }
+    // Every announced function block has reported its info
+    bool functionBlocksKnown() const;
+
+    // Groups covered by active function blocks that receive; ALL_GROUPS while unknown
+    uint16_t receivingGroups() const;
+    // Groups of active receiving blocks that support MIDI-CI; ALL_GROUPS while unknown, 0 if none does
+    uint16_t midiCIGroups() const;
+
+    std::string describe() const;
+
+private:
+    void negotiate(std::vector<uint32_t>& requests);
+
+    UmpStreamPreferences preferences_;
+    UmpEndpointInfo endpoint_;
+    bool endpointKnown_ = false;
+    bool configurationRequested_ = false;
+    std::string nameBuffer_;
+    std::string productInstanceIdBuffer_;
+    std::vector<std::string> blockNameBuffers_;
+};
@@ -0,0 +1,229 @@
+#include "ump_output_queue.h"
+#include <algorithm>
+#include "latency_tracker.h"
+#include "trace_recorder.h"
+#include "ump_utils.h"
+
+UmpOutputQueue::Lane::Lane() {
+    tail = new Node;  // stub: the list is never empty, so push and pop never touch the same node
+    head.store(tail);
+}
+
+UmpOutputQueue::Lane::~Lane() {
+    while (tail) {
+        Node* next = tail->next.load();
+        delete tail;
+        tail = next;
+    }
+}
+
+void UmpOutputQueue::Lane::push(Node* node) {
+    waiting.fetch_add(1, std::memory_order_relaxed);
+    Node* previous = head.exchange(node, std::memory_order_acq_rel);
+    previous->next.store(node, std::memory_order_release);
+}
+
+bool UmpOutputQueue::Lane::pop(std::vector<uint32_t>& words, int64_t& submittedNs) {
+    // A producer between its exchange and its link looks like an empty lane; it bumps
+    // submitted_ once linked, which wakes the writer again
+    Node* next = tail->next.load(std::memory_order_acquire);
+    if (!next) {
+        return false;
+    }
+    words.swap(next->words);
+    submittedNs = next->submittedNs;
+    delete tail;
+    tail = next;
+    waiting.fetch_sub(1, std::memory_order_relaxed);
+    return true;
+}
+
+const std::vector<uint32_t>* UmpOutputQueue::Lane::front() const {
+    Node* next = tail->next.load(std::memory_order_acquire);
+    return next ? &next->words : nullptr;
+}
+
+UmpOutputQueue::UmpOutputQueue(Sink sink) : sink_(std::move(sink)) {
+}
+
+UmpOutputQueue::~UmpOutputQueue() {
+    stop();
+}
+
+void UmpOutputQueue::start() {
+    if (writer_.joinable()) {
+        return;
+    }
+    stopping_ = false;
+    writer_ = std::thread([this]() { run(); });
+}
+
+void UmpOutputQueue::stop(StopMode mode) {
+    if (!writer_.joinable()) {
+        return;
+    }
+    drainOnStop_ = mode == StopMode::Drain;
+    stopping_ = true;
+    wakeWriter();
+    writer_.join();
+}
+
+bool UmpOutputQueue::submit(UmpLane lane, const uint32_t* words, size_t wordCount) {
+    return submit(lane, std::vector<uint32_t>(words, words + wordCount));
+}
+
+bool UmpOutputQueue::submit(UmpLane lane, std::vector<uint32_t> words) {
+    if (words.empty() || stopping_.load(std::memory_order_relaxed)) {
+        return false;
+    }
+    auto* node = new Node;
+    node->words = std::move(words);
+    if (LatencyTracker::instance().isEnabled()) {
+        node->submittedNs = LatencyTracker::now();
+    }
+    (lane == UmpLane::Realtime ? realtime_ : bulk_).push(node);
+    wakeWriter();
+    return true;
+}
+
+void UmpOutputQueue::wakeWriter() {
+    // Sequentially consistent with the writer's bulkWaiting_ store and submitted_ load: either the
+    // writer sees the new count before blocking, or this sees bulkWaiting_ and notifies
+    submitted_.fetch_add(1);
+    submitted_.notify_one();
+    if (bulkWaiting_.load()) {
+        { std::lock_guard<std::mutex> lock(wakeMutex_); }
+        wake_.notify_one();
+    }
+}
+
+void UmpOutputQueue::waitForSubmit(uint64_t seen, int64_t timeoutNs) {
+    std::unique_lock<std::mutex> lock(wakeMutex_);
+    bulkWaiting_.store(true);
+    wake_.wait_for(lock, std::chrono::nanoseconds(timeoutNs), [&]() { return submitted_.load() != seen; });
+    bulkWaiting_.store(false);
+}
+
+void UmpOutputQueue::run() {
+    TraceRecorder::instance().setThreadName("midi out");
+    std::vector<uint32_t> scratch;
+    while (true) {
+        uint64_t seen = submitted_.load(std::memory_order_acquire);
+        if (sendOnce(scratch)) {
+            continue;
+        }
+        if (stopping_.load()) {
+            break;
+        }
+        submitted_.wait(seen, std::memory_order_acquire);
+    }
+}
+
+bool UmpOutputQueue::sendOnce(std::vector<uint32_t>& scratch) {
+    bool sent = false;
+    int64_t submittedNs = 0;
+    while (realtime_.pop(scratch, submittedNs)) {
+        if (bulk_.waiting.load(std::memory_order_relaxed) > 0) {
+            overtakes_.fetch_add(1, std::memory_order_relaxed);
+        }
+        sendPaced(UmpLane::Realtime, scratch);
+        if (submittedNs != 0) {
+            // The sink has returned: the last packet of the batch is on the wire
+            LatencyTracker::instance().recordInterval(LatencyInterval::QueueToWire,
+                                                      static_cast<uint64_t>(LatencyTracker::now() - submittedNs));
+        }
+        realtimeBatches_.fetch_add(1, std::memory_order_relaxed);
+        words_.fetch_add(scratch.size(), std::memory_order_relaxed);
+        sent = true;
+    }
+    if (const auto* next = bulk_.front()) {
+        if (int64_t delay = startDelayNs(UmpLane::Bulk, *next); delay > 0) {
+            if (stopping_.load() && !drainOnStop_.load()) {
+                bulk_.pop(scratch, submittedNs);
+                droppedBulkBatches_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            // Not started yet: wait for budget or for a submit, then look at the realtime lane
+            // again. A realtime batch linked after the pop loop above bumped submitted_ after
+            // linking, so it is either counted in `seen` and visible here, or ends the wait.
+            uint64_t seen = submitted_.load(std::memory_order_acquire);
+            if (!realtime_.front()) {
+                waitForSubmit(seen, delay);
+            }
+            return true;
+        }
+        bulk_.pop(scratch, submittedNs);
+        TraceSpan trace("sendBulkBatch", "midi");
+        sendPaced(UmpLane::Bulk, scratch);
+        bulkBatches_.fetch_add(1, std::memory_order_relaxed);
+        words_.fetch_add(scratch.size(), std::memory_order_relaxed);
+        sent = true;
+    }
+    return sent;
+}
+
+int64_t UmpOutputQueue::startDelayNs(UmpLane lane, const std::vector<uint32_t>& words) {
+    std::lock_guard<std::mutex> lock(pacerMutex_);
+    return pacer_.delayNs(lane, umpMidi1WireBytes(words.data()), LatencyTracker::now());
+}
+
+void UmpOutputQueue::sendPaced(UmpLane lane, const std::vector<uint32_t>& words) {
+    size_t chunkStart = 0;
+    size_t pos = 0;
+    while (pos < words.size()) {
+        size_t count = std::min<size_t>(umpWordCount(words[pos]), words.size() - pos);
+        size_t bytes = umpMidi1WireBytes(&words[pos]);
+        int64_t delay = 0;
+        {
+            std::lock_guard<std::mutex> lock(pacerMutex_);
+            int64_t now = LatencyTracker::now();
+            delay = pacer_.delayNs(lane, bytes, now);
+            if (delay == 0) {
+                pacer_.consume(lane, bytes, now);
+            }
+        }
+        if (delay > 0) {
+            // What fits the budget goes out now; the rest of the batch follows with nothing in between
+            if (pos > chunkStart) {
+                sink_(words.data() + chunkStart, pos - chunkStart);
+                chunkStart = pos;
+            }
+            std::this_thread::sleep_for(std::chrono::nanoseconds(delay));
+            pacedNs_.fetch_add(static_cast<uint64_t>(delay), std::memory_order_relaxed);
+            continue;
+        }
+        pos += count;
+    }
+    if (pos > chunkStart) {
+        sink_(words.data() + chunkStart, pos - chunkStart);
+    }
+}
+
+void UmpOutputQueue::setPacing(const OutputPacingConfig& config) {
+    {
+        std::lock_guard<std::mutex> lock(pacerMutex_);
+        pacer_.configure(config, LatencyTracker::now());
+    }
+    // A bulk message waiting for the old budget looks at the new one
+    wakeWriter();
+}
+
+OutputPacingConfig UmpOutputQueue::pacing() const {
+    std::lock_guard<std::mutex> lock(pacerMutex_);
+    return pacer_.config();
+}
+
+UmpOutputStats UmpOutputQueue::stats() const {
+    UmpOutputStats stats;
+    stats.realtimeBatches = realtimeBatches_.load();
+    stats.bulkBatches = bulkBatches_.load();
+    stats.words = words_.load();
+    stats.overtakes = overtakes_.load();
+    stats.pacedNs = pacedNs_.load();
+    stats.droppedBulkBatches = droppedBulkBatches_.load();
+    std::lock_guard<std::mutex> lock(pacerMutex_);
+    int64_t now = LatencyTracker::now();
+    stats.voiceBytesPerSecond = pacer_.throughput(UmpLane::Realtime, now);
+    stats.bulkBytesPerSecond = pacer_.throughput(UmpLane::Bulk, now);
+    return stats;
+}
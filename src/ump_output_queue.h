@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "output_pacer.h"
+
+struct UmpOutputStats {
+    uint64_t realtimeBatches = 0;
+    uint64_t bulkBatches = 0;
+    uint64_t words = 0;
+    uint64_t overtakes = 0;  // realtime batches sent while a bulk batch was waiting
+    uint64_t pacedNs = 0;    // time the writer waited for pacing budget
+    uint64_t droppedBulkBatches = 0;
+    double voiceBytesPerSecond = 0;  // measured in MIDI 1.0 wire bytes, see OutputPacer::throughput
+    double bulkBytesPerSecond = 0;
+};
+
+// Single writer for an output port.
+//
+// Any thread submits pre-encoded UMP batches (lock-free: one allocation and one atomic exchange
+// per batch, plus a brief lock to wake the writer while it waits for bulk budget); a dedicated thread hands each batch to the sink in one piece, so the packets of a
+// multi-packet SysEx message are never interleaved with anything else. Between bulk batches the
+// writer drains the realtime lane, so a note waits for at most the SysEx message in flight.
+// Batches of one lane are sent in submission order per producer thread.
+//
+// With pacing configured, each lane is held to its token-bucket budget packet by packet (a paced
+// batch may reach the sink in several pieces, still with nothing in between), and a bulk message
+// only starts once its first packet fits the bulk budget; realtime batches go ahead meanwhile,
+// each waking the writer as soon as it is submitted.
+class UmpOutputQueue {
+public:
+    // Called on the writer thread with one whole batch
+    using Sink = std::function<void(const uint32_t* words, size_t wordCount)>;
+
+    explicit UmpOutputQueue(Sink sink);
+    ~UmpOutputQueue();
+
+    UmpOutputQueue(const UmpOutputQueue&) = delete;
+    UmpOutputQueue& operator=(const UmpOutputQueue&) = delete;
+
+    // What stop() does with bulk messages still waiting for bulk budget
+    enum class StopMode {
+        DropWaitingBulk,  // drop them, so stopping never waits for the pacer
+        Drain,            // pace them out like everything else (a final flush that must arrive)
+    };
+
+    // Batches submitted before start() are kept and sent once the writer runs
+    void start();
+    // Sends everything already submitted, then joins the writer; later submissions are dropped
+    void stop(StopMode mode = StopMode::DropWaitingBulk);
+    bool isRunning() const { return writer_.joinable(); }
+
+    bool submit(UmpLane lane, const uint32_t* words, size_t wordCount);
+    bool submit(UmpLane lane, std::vector<uint32_t> words);
+
+    // Takes effect before the next packet; may be called from any thread
+    void setPacing(const OutputPacingConfig& config);
+    OutputPacingConfig pacing() const;
+
+    UmpOutputStats stats() const;
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        std::vector<uint32_t> words;
+        int64_t submittedNs = 0;  // for LatencyInterval::QueueToWire; 0 while latency tracking is off
+    };
+
+    // Intrusive multi-producer/single-consumer list: producers swap the head, the writer owns the tail
+    struct Lane {
+        std::atomic<Node*> head;
+        Node* tail;
+        std::atomic<uint64_t> waiting{0};
+
+        Lane();
+        ~Lane();
+        void push(Node* node);
+        bool pop(std::vector<uint32_t>& words, int64_t& submittedNs);
+        const std::vector<uint32_t>* front() const;
+    };
+
+    void run();
+    // Sends the realtime backlog and at most one bulk batch; returns false if both lanes were empty
+    bool sendOnce(std::vector<uint32_t>& scratch);
+    void sendPaced(UmpLane lane, const std::vector<uint32_t>& words);
+    // Delay before the first packet of `words` fits the lane's budget
+    int64_t startDelayNs(UmpLane lane, const std::vector<uint32_t>& words);
+    // Bumps submitted_ and wakes the writer, whether idle or waiting for bulk budget (submits,
+    // stop() and setPacing())
+    void wakeWriter();
+    // Waits until submitted_ moves past `seen` or `timeoutNs` passes
+    void waitForSubmit(uint64_t seen, int64_t timeoutNs);
+
+    Sink sink_;
+    Lane realtime_;
+    Lane bulk_;
+    std::atomic<uint64_t> submitted_{0};  // bumped after each push; the writer waits on it
+    std::atomic<bool> stopping_{false};
+    std::atomic<bool> drainOnStop_{false};
+    // submitted_ has no timed wait, so the wait for bulk budget uses a condition variable
+    std::mutex wakeMutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> bulkWaiting_{false};
+    std::thread writer_;
+
+    std::atomic<uint64_t> realtimeBatches_{0};
+    std::atomic<uint64_t> bulkBatches_{0};
+    std::atomic<uint64_t> words_{0};
+    std::atomic<uint64_t> overtakes_{0};
+    std::atomic<uint64_t> pacedNs_{0};
+    std::atomic<uint64_t> droppedBulkBatches_{0};
+
+    mutable std::mutex pacerMutex_;  // never held while sleeping or calling the sink
+    OutputPacer pacer_;
+};
@@ -0,0 +1,184 @@
+#include "ump_replay.h"
+#include "keyboard_controller.h"
+#include "ump_capture.h"
+#include "ump_utils.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+uint64_t fnv1a(const std::vector<uint8_t>& data) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (uint8_t byte : data) {
+        hash ^= byte;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::string hex(uint64_t value, int width) {
+    std::ostringstream out;
+    out << std::hex << std::setw(width) << std::setfill('0') << value;
+    return out.str();
+}
+}
+
+UmpReplayer::UmpReplayer(KeyboardController& controller)
+    : controller_(controller) {
+}
+
+std::optional<UmpReplayReport> UmpReplayer::replay(const std::string& capturePath, const UmpReplayOptions& options) {
+    UmpCaptureReader reader;
+    if (!reader.open(capturePath)) {
+        return std::nullopt;
+    }
+
+    if (options.timing == ReplayTiming::Scaled && options.speed <= 0.0) {
+        std::cerr << "[REPLAY] Speed must be positive" << std::endl;
+        return std::nullopt;
+    }
+
+    // Muted before the reset, so its InvalidateMUID and discovery stay off the output as well;
+    // live input is held off until the end, as it would race the injected packets
+    controller_.setOutputMuted(options.muteOutput);
+    controller_.setLiveInputSuspended(true);
+
+    // MIDI-CI replies in the capture are addressed to the MUID we had while recording
+    uint32_t muid = options.reuseCapturedMuid ? reader.header().local_muid : 0;
+    if (!controller_.resetMidiCI(muid)) {
+        std::cerr << "[REPLAY] Failed to initialize MIDI-CI for replay" << std::endl;
+        controller_.setLiveInputSuspended(false);
+        controller_.setOutputMuted(false);
+        return std::nullopt;
+    }
+
+    std::cout << "[REPLAY] Replaying " << capturePath << " (records " << reader.firstIndex() << ".." << reader.endIndex()
+              << ") with MUID 0x" << std::hex << muid << std::dec << std::endl;
+
+    UmpReplayReport report;
+    const auto start = std::chrono::steady_clock::now();
+    std::optional<uint64_t> firstTimestamp;
+
+    reader.forEach([&](const UmpCaptureEntry& entry) {
+        if (entry.direction != UmpCaptureDirection::Incoming || entry.word_count == 0) {
+            return true;  // our own outgoing traffic is regenerated by the stack itself
+        }
+
+        if (!firstTimestamp) {
+            firstTimestamp = entry.timestamp_ns;
+        }
+        if (options.timing != ReplayTiming::AsFastAsPossible) {
+            double offset = static_cast<double>(entry.timestamp_ns - *firstTimestamp);
+            if (options.timing == ReplayTiming::Scaled) {
+                offset /= options.speed;
+            }
+            std::this_thread::sleep_until(start + std::chrono::nanoseconds(static_cast<int64_t>(offset)));
+        }
+
+        controller_.injectMidiInput(libremidi::ump(entry.words[0], entry.words[1], entry.words[2], entry.words[3]));
+
+        report.packets++;
+        uint8_t type = umpMessageType(entry.words[0]);
+        if (type == 0x3) {
+            report.sysexPackets++;
+            report.sysexBytes += std::min<uint32_t>((entry.words[0] >> 16) & 0xF, 6);
+        } else if (type == 0x5) {
+            report.sysexPackets++;
+            report.sysexBytes += std::min<uint32_t>((entry.words[0] >> 16) & 0xF, 14);
+        }
+        return true;
+    });
+
+    report.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (report.seconds > 0.0) {
+        report.packetsPerSecond = static_cast<double>(report.packets) / report.seconds;
+        report.sysexBytesPerSecond = static_cast<double>(report.sysexBytes) / report.seconds;
+    }
+
+    controller_.setLiveInputSuspended(false);
+    controller_.setOutputMuted(false);
+    printReport(report);
+    return report;
+}
+
+void UmpReplayer::printReport(const UmpReplayReport& report) {
+    std::cout << "[REPLAY] " << report.packets << " packets (" << report.sysexPackets << " SysEx, "
+              << report.sysexBytes << " bytes) in " << std::fixed << std::setprecision(3) << report.seconds << "s: "
+              << std::setprecision(0) << report.packetsPerSecond << " packets/s, "
+              << report.sysexBytesPerSecond << " SysEx bytes/s" << std::defaultfloat << std::endl;
+}
+
+std::vector<std::string> UmpReplayer::describeState() {
+    std::vector<std::string> lines;
+
+    auto devices = controller_.getMidiCIDeviceDetails();
+    std::sort(devices.begin(), devices.end(), [](const MidiCIDeviceInfo& a, const MidiCIDeviceInfo& b) {
+        return a.muid < b.muid;
+    });
+
+    for (const auto& device : devices) {
+        lines.push_back("device " + hex(device.muid, 8) + " endpoint_ready=" + (device.endpoint_ready ? "1" : "0"));
+
+        // std::map keeps property IDs sorted
+        for (const auto& [id, body] : controller_.getMidiCICachedProperties(device.muid)) {
+            lines.push_back("property " + hex(device.muid, 8) + " " + id + " size=" + std::to_string(body.size()) +
+                            " fnv1a=" + hex(fnv1a(body), 16));
+        }
+    }
+    return lines;
+}
+
+bool UmpReplayer::writeExpectation(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "[REPLAY] Cannot write expectation file " << path << std::endl;
+        return false;
+    }
+    for (const auto& line : describeState()) {
+        out << line << '\n';
+    }
+    std::cout << "[REPLAY] Wrote expectation to " << path << std::endl;
+    return true;
+}
+
+bool UmpReplayer::verifyExpectation(const std::string& path) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "[REPLAY] Cannot read expectation file " << path << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> expected;
+    for (std::string line; std::getline(in, line);) {
+        if (!line.empty() && line[0] != '#') {
+            expected.push_back(line);
+        }
+    }
+    auto actual = describeState();
+
+    std::vector<std::string> missing;
+    std::vector<std::string> unexpected;
+    auto sortedExpected = expected;
+    auto sortedActual = actual;
+    std::sort(sortedExpected.begin(), sortedExpected.end());
+    std::sort(sortedActual.begin(), sortedActual.end());
+    std::set_difference(sortedExpected.begin(), sortedExpected.end(), sortedActual.begin(), sortedActual.end(),
+                        std::back_inserter(missing));
+    std::set_difference(sortedActual.begin(), sortedActual.end(), sortedExpected.begin(), sortedExpected.end(),
+                        std::back_inserter(unexpected));
+
+    for (const auto& line : missing) {
+        std::cerr << "[REPLAY] expected but missing: " << line << std::endl;
+    }
+    for (const auto& line : unexpected) {
+        std::cerr << "[REPLAY] present but not expected: " << line << std::endl;
+    }
+
+    bool matches = missing.empty() && unexpected.empty();
+    std::cout << "[REPLAY] State " << (matches ? "matches" : "DOES NOT match") << " expectation " << path << std::endl;
+    return matches;
+}
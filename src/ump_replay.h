@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
+class KeyboardController;
+
+enum class ReplayTiming {
+    Original,          // honour the captured inter-packet timing
+    AsFastAsPossible,  // no waiting at all; use for benchmarking the MIDI-CI stack
+    Scaled             // original timing divided by UmpReplayOptions::speed
+};
+
+struct UmpReplayOptions {
+    ReplayTiming timing = ReplayTiming::AsFastAsPossible;
+    double speed = 1.0;            // only for ReplayTiming::Scaled; 2.0 = twice as fast
+    bool reuseCapturedMuid = true; // recreate MIDI-CI with the MUID recorded in the capture header
+    bool muteOutput = true;        // keep MIDI-CI replies generated during replay off the real output port
+};
+
+struct UmpReplayReport {
+    uint64_t packets = 0;
+    uint64_t sysexPackets = 0;
+    uint64_t sysexBytes = 0;
+    double seconds = 0.0;
+    double packetsPerSecond = 0.0;
+    double sysexBytesPerSecond = 0.0;
+};
+
+// Feeds the incoming side of a UMP capture (see ump_capture.h) back into
+// KeyboardController::onMidiInput, which reassembles SysEx7 and hands it to
+// MidiCIManager::processUmpSysEx, exactly as live input would.
+class UmpReplayer {
+public:
+    explicit UmpReplayer(KeyboardController& controller);
+
+    std::optional<UmpReplayReport> replay(const std::string& capturePath, const UmpReplayOptions& options);
+
+    // Device and property state after a replay, one line per fact, stable ordering.
+    // Property bodies are summarized by size and FNV-1a hash so expectations stay small.
+    std::vector<std::string> describeState();
+
+    bool writeExpectation(const std::string& path);
+    // Returns true if the current state matches the stored expectation; differences are logged
+    bool verifyExpectation(const std::string& path);
+
+    static void printReport(const UmpReplayReport& report);
+
+private:
+    KeyboardController& controller_;
+};
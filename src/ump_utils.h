@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstdint>
+
+// Small helpers shared by everything that walks raw UMP word streams.
+
+inline uint8_t umpMessageType(uint32_t word0) {
+    return static_cast<uint8_t>((word0 >> 28) & 0xF);
+}
+
+inline uint8_t umpGroup(uint32_t word0) {
+    return static_cast<uint8_t>((word0 >> 24) & 0xF);
+}
+
+// Number of 32-bit words in a UMP, derived from its message type (UMP spec table 1)
+inline int umpWordCount(uint32_t word0) {
+    static constexpr int sizes[16] = {
+        1, 1, 1, 2,   // 0: utility, 1: system, 2: MIDI 1.0 CV, 3: SysEx7
+        2, 4, 1, 1,   // 4: MIDI 2.0 CV, 5: SysEx8/mixed data, 6-7: reserved
+        2, 2, 2, 3,   // 8-A: reserved, B: reserved
+        3, 4, 4, 4    // C: reserved, D: flex data, E: reserved, F: UMP stream
+    };
+    return sizes[umpMessageType(word0)];
+}
@@ -9,6 +9,9 @@
 #include <QMouseEvent>
 #include <QThread>
 #include <QEvent>
+#include <unordered_map>
+#include "preset_store.h"
+#include "trace_recorder.h"
 
 // ControlParameterWidget implementation
 ControlParameterWidget::ControlParameterWidget(QWidget* parent)
@@ -322,6 +325,8 @@ VirtualizedControlList::VirtualizedControlList(QWidget* parent)
 }
 
 void VirtualizedControlList::setControls(const std::vector<midicci::commonproperties::MidiCIControl>& controls) {
+    TraceSpan trace("setControls", "ui");
+    trace.setArg("controls", static_cast<int64_t>(controls.size()));
     m_controls = controls;
     
     // Initialize control values with default values
@@ -361,6 +366,32 @@ void VirtualizedControlList::setControls(const std::vector<midicci::commonproper
     }
 }
 
+void VirtualizedControlList::updateControlRows(const std::vector<midicci::commonproperties::MidiCIControl>& controls,
+                                               const std::vector<size_t>& rows) {
+    TraceSpan trace("updateControlRows", "ui");
+    trace.setArg("rows", static_cast<int64_t>(rows.size()));
+    if (controls.size() != m_controls.size()) {
+        setControls(controls);
+        return;
+    }
+    
+    for (size_t row : rows) {
+        if (row >= controls.size()) {
+            continue;
+        }
+        // A new default is the device announcing a new value; otherwise keep what the user set
+        if (controls[row].defaultValue != m_controls[row].defaultValue) {
+            m_controlValues[row] = controls[row].defaultValue;
+        }
+        m_controls[row] = controls[row];
+        if (auto* listItem = item(static_cast<int>(row))) {
+            if (auto* widget = qobject_cast<ControlParameterWidget*>(itemWidget(listItem))) {
+                widget->updateFromControl(m_controls[row], static_cast<int>(row), m_controlValues[row]);
+            }
+        }
+    }
+}
+
 void VirtualizedControlList::setValueChangeCallback(std::function<void(int, const midicci::commonproperties::MidiCIControl&, uint32_t)> callback) {
     m_valueChangeCallback = callback;
 }
@@ -436,6 +467,62 @@ uint32_t VirtualizedControlList::getControlValue(int controlIndex) const {
     return 0;  // Default value if index is invalid
 }
 
+std::optional<ControlValue> VirtualizedControlList::snapshotValue(size_t controlIndex) const {
+    const auto& control = m_controls[controlIndex];
+    auto kind = controlKindFromCtrlType(control.ctrlType);
+    if (!kind || control.ctrlIndex.empty()) {
+        return std::nullopt;
+    }
+    if (*kind != ControlKind::ControlChange && control.ctrlIndex.size() < 2) {
+        return std::nullopt;
+    }
+    
+    ControlValue value;
+    value.kind = *kind;
+    value.channel = static_cast<uint8_t>(control.channel.value_or(0));
+    value.index = control.ctrlIndex[0];
+    value.subIndex = control.ctrlIndex.size() >= 2 ? control.ctrlIndex[1] : 0;
+    value.value = m_controlValues[controlIndex];
+    return value;
+}
+
+ControlSnapshot VirtualizedControlList::currentSnapshot() const {
+    ControlSnapshot snapshot;
+    snapshot.reserve(m_controls.size());
+    for (size_t i = 0; i < m_controls.size(); ++i) {
+        if (auto value = snapshotValue(i)) {
+            snapshot.push_back(*value);
+        }
+    }
+    return snapshot;
+}
+
+void VirtualizedControlList::applySnapshot(const ControlSnapshot& snapshot) {
+    // Snapshot and list order are unrelated, so match controls by key
+    std::unordered_map<uint32_t, uint32_t> values;
+    values.reserve(snapshot.size());
+    for (const auto& control : snapshot) {
+        values[presetControlKey(control)] = control.value;
+    }
+    
+    for (size_t i = 0; i < m_controls.size(); ++i) {
+        auto current = snapshotValue(i);
+        if (!current) {
+            continue;
+        }
+        auto found = values.find(presetControlKey(*current));
+        if (found == values.end()) {
+            continue;
+        }
+        m_controlValues[i] = found->second;
+        if (auto* listItem = item(static_cast<int>(i))) {
+            if (auto* widget = qobject_cast<ControlParameterWidget*>(itemWidget(listItem))) {
+                widget->updateValue(found->second);
+            }
+        }
+    }
+}
+
 void VirtualizedControlList::updateStoredValue(int controlIndex, uint32_t value) {
     if (controlIndex >= 0 && controlIndex < static_cast<int>(m_controlValues.size())) {
         m_controlValues[controlIndex] = value;
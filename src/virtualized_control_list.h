@@ -9,6 +9,8 @@
 #include <QWidget>
 #include <vector>
 #include <functional>
+#include <optional>
+#include "control_snapshot.h"
 
 namespace midicci::commonproperties {
     struct MidiCIControl;
@@ -60,8 +62,12 @@ public:
     explicit VirtualizedControlList(QWidget* parent = nullptr);
     
     void setControls(const std::vector<midicci::commonproperties::MidiCIControl>& controls);
+    // Refreshes only the given rows from a list of the same length; falls back to setControls otherwise
+    void updateControlRows(const std::vector<midicci::commonproperties::MidiCIControl>& controls, const std::vector<size_t>& rows);
     void setValueChangeCallback(std::function<void(int, const midicci::commonproperties::MidiCIControl&, uint32_t)> callback);
     uint32_t getControlValue(int controlIndex) const;  // Get stored value for a control
+    ControlSnapshot currentSnapshot() const;  // Stored values of every channel-state control
+    void applySnapshot(const ControlSnapshot& snapshot);  // Update stored values and sliders without sending MIDI
 
 protected:
     void resizeEvent(QResizeEvent* event) override;
@@ -75,6 +81,7 @@ private:
     int getVisibleItemCount() const;
     int getFirstVisibleIndex() const;
     void updateStoredValue(int controlIndex, uint32_t value);  // Update stored value for a control
+    std::optional<ControlValue> snapshotValue(size_t controlIndex) const;
     
     std::vector<midicci::commonproperties::MidiCIControl> m_controls;
     std::vector<uint32_t> m_controlValues;  // Store current values for each control
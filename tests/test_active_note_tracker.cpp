@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <thread>
+#include <vector>
+#include "active_note_tracker.h"
+
+class ActiveNoteTrackerTest : public ::testing::Test {
+protected:
+    ActiveNoteTracker tracker;
+};
+
+TEST_F(ActiveNoteTrackerTest, TestObservesMidi2AndMidi1Notes) {
+    uint32_t midi2On[2] = {0x45933C00, 0x80000000};   // group 5, channel 3, note 60
+    uint32_t midi1On[1] = {0x2A917F40};               // group 10, channel 1, note 127
+    tracker.observe(midi2On);
+    tracker.observe(midi1On);
+    EXPECT_TRUE(tracker.isActive(5, 3, 60));
+    EXPECT_TRUE(tracker.isActive(10, 1, 127));
+    EXPECT_EQ(tracker.activeCount(), 2u);
+
+    uint32_t midi1OffByVelocity[1] = {0x2A917F00};
+    uint32_t midi2Off[2] = {0x45833C00, 0};
+    tracker.observe(midi1OffByVelocity);
+    tracker.observe(midi2Off);
+    EXPECT_EQ(tracker.activeCount(), 0u);
+}
+
+TEST_F(ActiveNoteTrackerTest, TestAllNotesOffControllerClearsChannel) {
+    for (uint8_t note = 0; note < 128; note += 3) {
+        tracker.noteOn(2, 9, note);
+    }
+    tracker.noteOn(2, 8, 1);
+    uint32_t allNotesOff[2] = {0x42B97B00, 0};
+    tracker.observe(allNotesOff);
+    EXPECT_EQ(tracker.activeCount(), 1u);
+    EXPECT_TRUE(tracker.isActive(2, 8, 1));
+}
+
+TEST_F(ActiveNoteTrackerTest, TestNoteOffsOnlyForActiveNotes) {
+    tracker.noteOn(0, 0, 0);
+    tracker.noteOn(15, 15, 127);
+    tracker.noteOn(7, 4, 64);
+
+    std::vector<uint32_t> words;
+    tracker.appendNoteOffs(words);
+    ASSERT_EQ(words.size(), 6u);
+    EXPECT_EQ(words[0], 0x40800000u);
+    EXPECT_EQ(words[2], 0x47844000u);
+    EXPECT_EQ(words[4], 0x4F8F7F00u);
+
+    // Feeding the batch back (as the send path does) leaves nothing sounding
+    for (size_t i = 0; i < words.size(); i += 2) {
+        tracker.observe(&words[i]);
+    }
+    EXPECT_EQ(tracker.activeCount(), 0u);
+}
+
+TEST_F(ActiveNoteTrackerTest, TestStuckNotes) {
+    tracker.noteOn(1, 1, 10);
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    tracker.noteOn(1, 1, 11);
+
+    auto stuck = tracker.stuckNotes(std::chrono::milliseconds(20));
+    ASSERT_EQ(stuck.size(), 1u);
+    EXPECT_EQ(stuck[0].note, 10);
+    EXPECT_GE(stuck[0].heldFor.count(), 20);
+    EXPECT_EQ(tracker.activeNotes().size(), 2u);
+    std::cout << "[TEST] Stuck note held for " << stuck[0].heldFor.count() << " ms" << std::endl;
+}
+
+TEST_F(ActiveNoteTrackerTest, TestConcurrentSenders) {
+    auto sender = [this](uint8_t group) {
+        for (int round = 0; round < 1000; round++) {
+            for (uint8_t note = 0; note < 128; note++) {
+                tracker.noteOn(group, 0, note);
+            }
+            for (uint8_t note = 0; note < 128; note += 2) {
+                tracker.noteOff(group, 0, note);
+            }
+        }
+    };
+    std::thread a(sender, 0);
+    std::thread b(sender, 0);
+    std::thread c(sender, 1);
+    a.join();
+    b.join();
+    c.join();
+    EXPECT_EQ(tracker.activeCount(), 128u);
+}
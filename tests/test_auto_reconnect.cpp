@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include "auto_reconnect.h"
+
+class AutoReconnectTest : public ::testing::Test {
+protected:
+    static constexpr int64_t MS = 1'000'000;
+
+    void SetUp() override {
+        policy.select(PortDirection::Input, "in", true);
+        policy.select(PortDirection::Output, "out", true);
+    }
+
+    AutoReconnect policy;
+};
+
+TEST_F(AutoReconnectTest, TestPairIsReopenedAfterReplug) {
+    // Both directions of a USB device go away; other ports are not our business
+    EXPECT_FALSE(policy.portRemoved(PortDirection::Input, "other", 0));
+    EXPECT_TRUE(policy.portRemoved(PortDirection::Input, "in", 100 * MS));
+    EXPECT_TRUE(policy.portRemoved(PortDirection::Output, "out", 101 * MS));
+    EXPECT_TRUE(policy.isWaiting());
+    EXPECT_EQ(policy.selection(PortDirection::Input), "in");
+
+    // Back again: each direction is reopened; the outage ends when both are open
+    EXPECT_TRUE(policy.portAdded(PortDirection::Output, "out", 2000 * MS));
+    EXPECT_FALSE(policy.portReopened(PortDirection::Output, 2001 * MS));
+    EXPECT_FALSE(policy.portAdded(PortDirection::Input, "other", 2002 * MS));
+    EXPECT_TRUE(policy.portAdded(PortDirection::Input, "in", 2010 * MS));
+    auto report = policy.portReopened(PortDirection::Input, 2015 * MS);
+    ASSERT_TRUE(report);
+    EXPECT_EQ(report->downNs, 1915 * MS);
+    EXPECT_EQ(report->recoveryNs, 5 * MS);
+    EXPECT_FALSE(policy.isWaiting());
+
+    // Already open: a repeated add notification does nothing
+    EXPECT_FALSE(policy.portAdded(PortDirection::Input, "in", 3000 * MS));
+}
+
+TEST_F(AutoReconnectTest, TestSelectionAndDisabledPolicy) {
+    // Only the input is selected: its return alone completes the outage
+    policy.select(PortDirection::Output, "", true);
+    EXPECT_FALSE(policy.portRemoved(PortDirection::Output, "out", 0));
+    EXPECT_TRUE(policy.portRemoved(PortDirection::Input, "in", 10 * MS));
+    EXPECT_TRUE(policy.portAdded(PortDirection::Input, "in", 20 * MS));
+    EXPECT_TRUE(policy.portReopened(PortDirection::Input, 21 * MS));
+
+    // Choosing another port while waiting abandons the old one
+    EXPECT_TRUE(policy.portRemoved(PortDirection::Input, "in", 30 * MS));
+    policy.select(PortDirection::Input, "usb2", true);
+    EXPECT_FALSE(policy.isWaiting());
+    EXPECT_FALSE(policy.portAdded(PortDirection::Input, "in", 40 * MS));
+
+    // Disabled: removal still closes the port but nothing is reopened
+    policy.setEnabled(false);
+    EXPECT_TRUE(policy.portRemoved(PortDirection::Input, "usb2", 50 * MS));
+    EXPECT_FALSE(policy.portAdded(PortDirection::Input, "usb2", 60 * MS));
+    EXPECT_TRUE(policy.isWaiting());
+
+    // A failed selection leaves nothing selected
+    policy.select(PortDirection::Input, "gone", false);
+    EXPECT_TRUE(policy.selection(PortDirection::Input).empty());
+    EXPECT_FALSE(policy.isWaiting());
+}
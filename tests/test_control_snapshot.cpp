@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include "control_snapshot.h"
+
+class ControlSnapshotTest : public ::testing::Test {
+protected:
+    ControlSnapshot makeSnapshot(size_t count) {
+        ControlSnapshot snapshot;
+        for (size_t i = 0; i < count; i++) {
+            ControlValue control;
+            control.kind = static_cast<ControlKind>(i % 3);
+            control.channel = static_cast<uint8_t>(i % 16);
+            control.index = static_cast<uint8_t>(i % 128);
+            control.subIndex = static_cast<uint8_t>((i / 128) % 128);
+            control.value = static_cast<uint32_t>(i * 2654435761u);
+            snapshot.push_back(control);
+        }
+        return snapshot;
+    }
+
+    ControlSnapshotSender::BatchSink recordingSink() {
+        return [this](const uint32_t* words, size_t wordCount) {
+            std::lock_guard<std::mutex> lock(mutex);
+            received.insert(received.end(), words, words + wordCount);
+            batchSizes.push_back(wordCount);
+            return wordCount / 2;
+        };
+    }
+
+    std::mutex mutex;
+    std::vector<uint32_t> received;
+    std::vector<size_t> batchSizes;
+};
+
+TEST_F(ControlSnapshotTest, TestEncodesMidi2ChannelVoice) {
+    uint32_t words[2];
+    encodeControlValue(2, ControlValue{ControlKind::ControlChange, 5, 74, 0, 0x80000000}, words);
+    EXPECT_EQ(words[0], 0x42B54A00u);
+    EXPECT_EQ(words[1], 0x80000000u);
+
+    encodeControlValue(0, ControlValue{ControlKind::RPN, 0, 0, 1, 0x12345678}, words);
+    EXPECT_EQ(words[0], 0x40200001u);
+    encodeControlValue(0, ControlValue{ControlKind::NRPN, 15, 3, 7, 1}, words);
+    EXPECT_EQ(words[0], 0x403F0307u);
+
+    EXPECT_EQ(controlKindFromCtrlType("nrpn"), ControlKind::NRPN);
+    EXPECT_FALSE(controlKindFromCtrlType("pnac").has_value());
+}
+
+TEST_F(ControlSnapshotTest, TestPacedBurstCompletionTime) {
+    constexpr size_t controls = 2000;
+    ControlSnapshotOptions options;
+    options.messagesPerSecond = 100000;
+    options.messagesPerBatch = 50;
+
+    ControlSnapshotReport report;
+    ControlSnapshotSender sender(recordingSink());
+    sender.setFinishedCallback([&report](const ControlSnapshotReport& r) { report = r; });
+    ASSERT_TRUE(sender.send(makeSnapshot(controls), 0, options));
+    sender.wait();
+
+    EXPECT_FALSE(sender.isSending());
+    EXPECT_FALSE(report.cancelled);
+    EXPECT_EQ(report.controls, controls);
+    EXPECT_EQ(report.packets, controls);
+    EXPECT_EQ(report.batches, controls / options.messagesPerBatch);
+    ASSERT_EQ(received.size(), controls * 2);
+    for (size_t size : batchSizes) {
+        EXPECT_EQ(size, options.messagesPerBatch * 2);
+    }
+
+    // 40 batches at 0.5 ms spacing: the last one is due 19.5 ms after the start
+    EXPECT_GE(report.seconds, 0.0195);
+    EXPECT_LT(report.seconds, 0.5);
+    std::cout << "[TEST] " << controls << " controls sent in " << report.seconds * 1000.0 << " ms ("
+              << report.batches << " batches)" << std::endl;
+}
+
+TEST_F(ControlSnapshotTest, TestUnpacedBurst) {
+    constexpr size_t controls = 10000;
+    ControlSnapshotOptions options;
+    options.messagesPerSecond = 0;
+    options.messagesPerBatch = 64;
+
+    ControlSnapshotSender sender(recordingSink());
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(sender.send(makeSnapshot(controls), 0, options));
+    sender.wait();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    EXPECT_EQ(received.size(), controls * 2);
+    EXPECT_EQ(batchSizes.back(), (controls % 64) * 2);
+    std::cout << "[TEST] " << controls << " controls encoded and sent unpaced in " << ms << " ms" << std::endl;
+}
+
+TEST_F(ControlSnapshotTest, TestCancelStopsBurst) {
+    ControlSnapshotOptions options;
+    options.messagesPerSecond = 1000;
+    options.messagesPerBatch = 10;
+
+    ControlSnapshotReport report;
+    ControlSnapshotSender sender(recordingSink());
+    sender.setFinishedCallback([&report](const ControlSnapshotReport& r) { report = r; });
+    ASSERT_TRUE(sender.send(makeSnapshot(5000), 0, options));  // would take 5 s
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    sender.cancel();
+
+    EXPECT_TRUE(report.cancelled);
+    EXPECT_LT(report.packets, 5000u);
+    EXPECT_FALSE(sender.isSending());
+}
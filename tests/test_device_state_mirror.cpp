@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "device_state_mirror.h"
+
+class DeviceStateMirrorTest : public ::testing::Test {
+protected:
+    static void midi2(DeviceStateMirror& mirror, uint8_t group, uint8_t opcode, uint8_t channel, uint8_t byte3,
+                      uint8_t byte4, uint32_t data) {
+        uint32_t words[2] = {(0x4u << 28) | (uint32_t{group} << 24) | (uint32_t{opcode} << 20) | (uint32_t{channel} << 16) |
+                                 (uint32_t{byte3} << 8) | byte4,
+                             data};
+        mirror.observe(words);
+    }
+
+    DeviceStateMirror mirror;
+    DeviceStateChanges changes;
+};
+
+TEST_F(DeviceStateMirrorTest, TestControllersAndParameters) {
+    midi2(mirror, 1, 0xB, 2, 74, 0, 0x12345678);
+    midi2(mirror, 1, 0x3, 2, 5, 9, 1000);      // NRPN 5:9
+    midi2(mirror, 1, 0x5, 2, 5, 9, 0xFFFFFFF6);  // relative NRPN -10
+
+    EXPECT_EQ(mirror.controller(1, 2, 74), 0x12345678u);
+    EXPECT_EQ(mirror.parameter(ControlKind::NRPN, 1, 2, 5, 9), 990u);
+    EXPECT_FALSE(mirror.parameter(ControlKind::RPN, 1, 2, 5, 9).has_value());
+
+    ASSERT_TRUE(mirror.takeChanges(changes));
+    ASSERT_EQ(changes.controls.size(), 2u);
+    EXPECT_EQ(changes.controls[0].first, 1);
+    EXPECT_EQ(changes.controls[0].second.kind, ControlKind::ControlChange);
+    EXPECT_EQ(changes.controls[0].second.index, 74);
+    EXPECT_EQ(changes.controls[1].second.kind, ControlKind::NRPN);
+    EXPECT_EQ(changes.controls[1].second.index, 5);
+    EXPECT_EQ(changes.controls[1].second.subIndex, 9);
+    EXPECT_EQ(changes.controls[1].second.value, 990u);
+
+    // Dirty bits are consumed
+    changes.clear();
+    EXPECT_FALSE(mirror.takeChanges(changes));
+}
+
+TEST_F(DeviceStateMirrorTest, TestNotesAndChannelState) {
+    midi2(mirror, 0, 0x9, 0, 60, 0, 0xC0000000);
+    uint32_t midi1NoteOn = 0x20913F7F;  // group 0, channel 1, note 63, velocity 127
+    mirror.observe(&midi1NoteOn);
+    midi2(mirror, 0, 0xE, 0, 0, 0, 0x90000000);
+    midi2(mirror, 0, 0xC, 0, 0, 1, 0x05000102);  // program 5, bank 1:2
+
+    EXPECT_TRUE(mirror.isNoteOn(0, 0, 60));
+    EXPECT_EQ(mirror.noteVelocity(0, 0, 60), 0xC000);
+    EXPECT_TRUE(mirror.isNoteOn(0, 1, 63));
+    EXPECT_EQ(mirror.noteVelocity(0, 1, 63), 0xFFFF);
+
+    ASSERT_TRUE(mirror.takeChanges(changes));
+    EXPECT_EQ(changes.notes.size(), 2u);
+    ASSERT_EQ(changes.channels.size(), 1u);
+    EXPECT_EQ(changes.channels[0].pitchBend, 0x90000000u);
+    EXPECT_EQ(changes.channels[0].program, 5);
+    EXPECT_EQ(changes.channels[0].bank, (1 << 7) | 2);
+
+    // All Notes Off releases what the device had on
+    changes.clear();
+    midi2(mirror, 0, 0xB, 0, 123, 0, 0);
+    EXPECT_FALSE(mirror.isNoteOn(0, 0, 60));
+    EXPECT_TRUE(mirror.isNoteOn(0, 1, 63));
+    ASSERT_TRUE(mirror.takeChanges(changes));
+    ASSERT_EQ(changes.notes.size(), 1u);
+    EXPECT_FALSE(changes.notes[0].on);
+    EXPECT_EQ(changes.notes[0].velocity, 0xC000);
+}
+
+TEST_F(DeviceStateMirrorTest, TestParameterTableOverflowIsCounted) {
+    for (uint32_t i = 0; i < DeviceStateMirror::PARAMETER_SLOTS + 10; i++) {
+        midi2(mirror, static_cast<uint8_t>(i >> 14), 0x2, static_cast<uint8_t>((i >> 14) & 0xF),
+              static_cast<uint8_t>((i >> 7) & 0x7F), static_cast<uint8_t>(i & 0x7F), i);
+    }
+    ASSERT_TRUE(mirror.takeChanges(changes));
+    EXPECT_EQ(changes.controls.size(), DeviceStateMirror::PARAMETER_SLOTS);
+    EXPECT_EQ(changes.droppedParameters, 10u);
+}
+
+TEST_F(DeviceStateMirrorTest, TestConcurrentInputAndPolling) {
+    // The input thread streams controller sweeps while the UI thread polls; the last value of
+    // every controller must be visible after the final poll.
+    constexpr uint32_t sweeps = 200;
+    std::atomic<bool> done{false};
+    std::thread input([this, &done]() {
+        for (uint32_t sweep = 1; sweep <= sweeps; sweep++) {
+            for (uint8_t cc = 0; cc < 128; cc++) {
+                midi2(mirror, 0, 0xB, 0, cc, 0, sweep);
+            }
+        }
+        done.store(true);
+    });
+
+    uint32_t lastSeen[128] = {};
+    size_t polls = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (!done.load()) {
+        changes.clear();
+        mirror.takeChanges(changes);
+        for (const auto& [group, control] : changes.controls) {
+            EXPECT_GE(control.value, lastSeen[control.index]);
+            lastSeen[control.index] = control.value;
+        }
+        polls++;
+    }
+    input.join();
+    changes.clear();
+    mirror.takeChanges(changes);
+    for (const auto& [group, control] : changes.controls) {
+        lastSeen[control.index] = control.value;
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    for (uint32_t cc = 0; cc < 128; cc++) {
+        EXPECT_EQ(lastSeen[cc], sweeps) << "cc " << cc;
+    }
+    std::cout << "[TEST] " << sweeps * 128 << " controller messages mirrored in " << ms << " ms over " << polls
+              << " polls" << std::endl;
+}
@@ -0,0 +1,83 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <vector>
+#include "expression_coalescer.h"
+
+class ExpressionCoalescerTest : public ::testing::Test {
+protected:
+    struct Sent {
+        int key;
+        NoteExpression parameter;
+        uint32_t value;
+    };
+
+    ExpressionCoalescer coalescer{std::chrono::milliseconds(5), 1u << 20};
+    std::vector<Sent> sent;
+    ExpressionCoalescer::Sender sender = [this](int key, NoteExpression parameter, uint32_t value) {
+        sent.push_back({key, parameter, value});
+    };
+    ExpressionCoalescer::Clock::time_point t0 = ExpressionCoalescer::Clock::now();
+};
+
+TEST_F(ExpressionCoalescerTest, TestBurstCollapsesToLatestValue) {
+    for (uint32_t i = 1; i <= 100; i++) {
+        coalescer.set(60, NoteExpression::Pressure, i << 24);
+    }
+    EXPECT_FALSE(coalescer.flush(t0, sender));
+    ASSERT_EQ(sent.size(), 1u);
+    EXPECT_EQ(sent[0].value, 100u << 24);
+    EXPECT_EQ(coalescer.updatesReceived(), 100u);
+    EXPECT_EQ(coalescer.updatesSent(), 1u);
+}
+
+TEST_F(ExpressionCoalescerTest, TestRateLimitPerKeyAndParameter) {
+    coalescer.set(60, NoteExpression::PitchBend, 0x90000000u);
+    coalescer.flush(t0, sender);
+
+    coalescer.set(60, NoteExpression::PitchBend, 0xA0000000u);
+    coalescer.set(61, NoteExpression::PitchBend, 0xA0000000u);  // other key is not throttled
+    EXPECT_TRUE(coalescer.flush(t0 + std::chrono::milliseconds(1), sender));
+    ASSERT_EQ(sent.size(), 2u);
+    EXPECT_EQ(sent[1].key, 61);
+
+    EXPECT_FALSE(coalescer.flush(t0 + std::chrono::milliseconds(5), sender));
+    ASSERT_EQ(sent.size(), 3u);
+    EXPECT_EQ(sent[2].key, 60);
+    EXPECT_EQ(sent[2].value, 0xA0000000u);
+}
+
+TEST_F(ExpressionCoalescerTest, TestDeadbandButExactRestingValues) {
+    coalescer.set(10, NoteExpression::PitchBend, ExpressionCoalescer::PITCH_BEND_CENTER + 100);
+    EXPECT_FALSE(coalescer.hasPending());  // jitter below the deadband
+
+    coalescer.set(10, NoteExpression::PitchBend, 0x90000000u);
+    coalescer.flush(t0, sender);
+    coalescer.set(10, NoteExpression::PitchBend, ExpressionCoalescer::PITCH_BEND_CENTER);
+    coalescer.flush(t0 + std::chrono::milliseconds(10), sender);
+    ASSERT_EQ(sent.size(), 2u);
+    EXPECT_EQ(sent[1].value, ExpressionCoalescer::PITCH_BEND_CENTER);
+    EXPECT_EQ(coalescer.lastSent(10, NoteExpression::PitchBend), ExpressionCoalescer::PITCH_BEND_CENTER);
+}
+
+TEST_F(ExpressionCoalescerTest, TestForgetDropsPending) {
+    coalescer.set(5, NoteExpression::Pressure, 0xFFFFFFFFu);
+    coalescer.forget(5);
+    EXPECT_FALSE(coalescer.hasPending());
+    EXPECT_FALSE(coalescer.flush(t0, sender));
+    EXPECT_TRUE(sent.empty());
+}
+
+TEST_F(ExpressionCoalescerTest, TestContinuousGestureIsBounded) {
+    // 1 kHz pointer events for one second on four fingers
+    auto now = t0;
+    for (int ms = 0; ms < 1000; ms++) {
+        now = t0 + std::chrono::milliseconds(ms);
+        for (int key = 60; key < 64; key++) {
+            coalescer.set(key, NoteExpression::PitchBend, 0x80000000u + static_cast<uint32_t>(ms) * 0x200000u);
+        }
+        coalescer.flush(now, sender);
+    }
+    std::cout << "[TEST] " << coalescer.updatesReceived() << " updates -> " << sent.size() << " messages" << std::endl;
+    EXPECT_LE(sent.size(), 4u * 201u);
+    EXPECT_GE(sent.size(), 4u * 190u);
+}
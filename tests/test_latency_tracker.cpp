@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "latency_tracker.h"
+
+class LatencyTrackerTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        LatencyTracker::instance().reset();
+    }
+
+    void TearDown() override {
+        LatencyTracker::instance().reset();
+    }
+};
+
+TEST_F(LatencyTrackerTest, TestBucketBoundsCoverValues) {
+    // Every value must land in a bucket whose upper bound is >= the value and within ~3%
+    std::vector<uint64_t> values = {0, 1, 31, 32, 33, 63, 64, 1000, 123456, 987654321, 1ULL << 40};
+    for (uint64_t v : values) {
+        size_t index = LatencyHistogram::bucketIndex(v);
+        uint64_t upper = LatencyHistogram::bucketUpperBound(index);
+        EXPECT_GE(upper, v) << "value " << v;
+        EXPECT_LE(static_cast<double>(upper - v), static_cast<double>(v) / LatencyHistogram::SUB_BUCKET_COUNT + 1.0) << "value " << v;
+    }
+
+    EXPECT_LT(LatencyHistogram::bucketIndex(UINT64_MAX), LatencyHistogram::BUCKET_COUNT);
+}
+
+TEST_F(LatencyTrackerTest, TestPercentiles) {
+    LatencyHistogram histogram;
+    // 1..10000 microseconds, uniformly
+    for (uint64_t i = 1; i <= 10000; i++) {
+        histogram.record(i * 1000);
+    }
+
+    EXPECT_EQ(histogram.count(), 10000u);
+    EXPECT_EQ(histogram.min(), 1000u);
+    EXPECT_EQ(histogram.max(), 10000000u);
+
+    auto withinPercent = [](uint64_t actual, uint64_t expected, double percent) {
+        double diff = static_cast<double>(actual) - static_cast<double>(expected);
+        return std::abs(diff) <= static_cast<double>(expected) * percent / 100.0;
+    };
+
+    std::cout << "[TEST] p50=" << histogram.percentile(50.0) << " p99=" << histogram.percentile(99.0)
+              << " p99.9=" << histogram.percentile(99.9) << std::endl;
+
+    EXPECT_TRUE(withinPercent(histogram.percentile(50.0), 5000000, 4.0));
+    EXPECT_TRUE(withinPercent(histogram.percentile(99.0), 9900000, 4.0));
+    EXPECT_TRUE(withinPercent(histogram.percentile(99.9), 9990000, 4.0));
+    EXPECT_EQ(histogram.percentile(100.0), histogram.max());
+}
+
+TEST_F(LatencyTrackerTest, TestConcurrentRecording) {
+    LatencyHistogram histogram;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&histogram]() {
+            for (int i = 0; i < 100000; i++) {
+                histogram.record(static_cast<uint64_t>(i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(histogram.count(), 400000u);
+    EXPECT_EQ(histogram.max(), 99999u);
+}
+
+TEST_F(LatencyTrackerTest, TestProbeIntervals) {
+    auto& tracker = LatencyTracker::instance();
+
+    tracker.markUiEvent();
+    auto probe = tracker.begin();
+    EXPECT_TRUE(probe.has(LatencyStage::UiEvent));
+    probe.stamp(LatencyStage::Encode);
+    probe.stamp(LatencyStage::Queue);
+    tracker.commit(probe);
+
+    // The UI stamp is consumed by the first controller call only
+    auto scripted = tracker.begin();
+    EXPECT_FALSE(scripted.has(LatencyStage::UiEvent));
+    scripted.stamp(LatencyStage::Encode);
+    scripted.stamp(LatencyStage::Queue);
+    tracker.commit(scripted);
+
+    EXPECT_EQ(tracker.histogram(LatencyInterval::UiToQueue).count(), 1u);
+    EXPECT_EQ(tracker.histogram(LatencyInterval::ControllerToQueue).count(), 2u);
+    EXPECT_EQ(tracker.histogram(LatencyInterval::LoopbackRoundTrip).count(), 0u);
+
+    std::ostringstream out;
+    tracker.dump(out);
+    std::cout << out.str();
+    EXPECT_NE(out.str().find("ui->queue"), std::string::npos);
+}
+
+TEST_F(LatencyTrackerTest, TestKeyEventsReportedSeparately) {
+    auto& tracker = LatencyTracker::instance();
+
+    tracker.markKeyEvent();
+    auto probe = tracker.begin();
+    EXPECT_TRUE(probe.has(LatencyStage::KeyEvent));
+    EXPECT_FALSE(probe.has(LatencyStage::UiEvent));
+    probe.stamp(LatencyStage::Encode);
+    probe.stamp(LatencyStage::Queue);
+    tracker.commit(probe);
+
+    EXPECT_EQ(tracker.histogram(LatencyInterval::KeyToQueue).count(), 1u);
+    EXPECT_EQ(tracker.histogram(LatencyInterval::UiToQueue).count(), 0u);
+
+    std::ostringstream out;
+    tracker.dump(out);
+    EXPECT_NE(out.str().find("key->queue"), std::string::npos);
+}
+
+TEST_F(LatencyTrackerTest, TestLoopbackReceiveGivesRoundTrip) {
+    auto& tracker = LatencyTracker::instance();
+
+    // A loopback ping: queued, then received back 250 us later
+    LatencyProbe probe;
+    int64_t queued = LatencyTracker::now();
+    probe.stamp(LatencyStage::Queue, queued);
+    probe.stamp(LatencyStage::LoopbackReceive, queued + 250000);
+    tracker.commit(probe);
+
+    const auto& roundTrip = tracker.histogram(LatencyInterval::LoopbackRoundTrip);
+    EXPECT_EQ(roundTrip.count(), 1u);
+    EXPECT_EQ(roundTrip.min(), 250000u);
+    EXPECT_EQ(tracker.histogram(LatencyInterval::ControllerToQueue).count(), 0u);
+
+    std::ostringstream out;
+    tracker.dump(out);
+    std::cout << out.str();
+    EXPECT_NE(out.str().find("loopback rtt"), std::string::npos);
+}
@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "midi1_to_midi2.h"
+#include "midi2_to_midi1.h"
+#include "midi_value_scaling.h"
+#include "ump_utils.h"
+
+class Midi2ToMidi1Test : public ::testing::Test {
+protected:
+    std::vector<uint32_t> umps(std::initializer_list<uint32_t> ump) {
+        std::vector<uint32_t> words(ump);
+        words.resize(4);
+        uint32_t out[Midi2ToMidi1Converter::MAX_WORDS];
+        size_t count = converter.toUmp(words.data(), out);
+        return std::vector<uint32_t>(out, out + count);
+    }
+
+    static uint32_t midi2(uint8_t opcode, uint8_t channel, uint8_t index1, uint8_t index2) {
+        return 0x40000000u | (opcode << 20) | (channel << 16) | (index1 << 8) | index2;
+    }
+
+    Midi2ToMidi1Converter converter;
+};
+
+TEST_F(Midi2ToMidi1Test, TestChannelVoiceToMidi1Packets) {
+    using Words = std::vector<uint32_t>;
+    // Note On: 16-bit velocity scaled down; a tiny velocity stays a Note On
+    EXPECT_EQ(umps({midi2(0x9, 0, 60, 0), 0xFFFF0000}), (Words{0x20903C7F}));
+    EXPECT_EQ(umps({midi2(0x9, 0, 62, 0), 0x00010000}), (Words{0x20903E01}));
+    EXPECT_EQ(umps({midi2(0x8, 0, 60, 0), 0x80000000}), (Words{0x20803C40}));
+
+    // Controllers: 32-bit values down to 7 bits
+    EXPECT_EQ(umps({midi2(0xB, 1, 7, 0), midi7To32(100)}), (Words{0x20B10764}));
+    EXPECT_EQ(umps({midi2(0xE, 1, 0, 0), 0x80000000}), (Words{0x20E10040}));
+    EXPECT_EQ(umps({midi2(0xD, 1, 0, 0), midi7To32(5)}), (Words{0x20D10500}));
+
+    // Program change with bank
+    EXPECT_EQ(umps({midi2(0xC, 2, 0, 1), 0x05000203}), (Words{0x20B20002, 0x20B22003, 0x20C20500}));
+    EXPECT_EQ(umps({midi2(0xC, 2, 0, 0), 0x06000000}), (Words{0x20C20600}));
+
+    // System, SysEx7, MIDI 1.0 channel voice and utility messages pass through
+    EXPECT_EQ(umps({0x10F80000}), (Words{0x10F80000}));
+    EXPECT_EQ(umps({0x30027E7F, 0}), (Words{0x30027E7F, 0}));
+    EXPECT_EQ(umps({0x20903C64}), (Words{0x20903C64}));
+    EXPECT_EQ(umps({0x00200000}), (Words{0x00200000}));
+
+    // No MIDI 1.0 form: per-note pitch bend, SysEx8
+    EXPECT_TRUE(umps({midi2(0x6, 0, 60, 0), 0x80000000}).empty());
+    EXPECT_TRUE(umps({0x50010000, 0, 0, 0}).empty());
+}
+
+TEST_F(Midi2ToMidi1Test, TestParameterSelectorsAreSentOnce) {
+    using Words = std::vector<uint32_t>;
+    uint32_t value = midi14To32(0x2000 | 0x15);
+    EXPECT_EQ(umps({midi2(0x2, 0, 0, 0), value}), (Words{0x20B06500, 0x20B06400, 0x20B00640, 0x20B02615}));
+    // Same parameter again: data entry only
+    EXPECT_EQ(umps({midi2(0x2, 0, 0, 0), value}), (Words{0x20B00640, 0x20B02615}));
+    // Only the LSB changed
+    EXPECT_EQ(umps({midi2(0x2, 0, 0, 2), value}), (Words{0x20B06402, 0x20B00640, 0x20B02615}));
+    // NRPN with the same numbers is a different parameter
+    EXPECT_EQ(umps({midi2(0x3, 0, 0, 2), value}), (Words{0x20B06300, 0x20B06202, 0x20B00640, 0x20B02615}));
+    // A raw MIDI 1.0 selector from elsewhere invalidates what we know
+    EXPECT_EQ(umps({0x20B06500}), (Words{0x20B06500}));
+    EXPECT_EQ(umps({midi2(0x3, 0, 0, 2), value}), (Words{0x20B06300, 0x20B06202, 0x20B00640, 0x20B02615}));
+
+    // Selections are kept per group, and the packets stay in the message's group
+    converter.reset();
+    uint32_t rpn[] = {midi2(0x2, 0, 0, 0) | 0x03000000u, value};
+    uint32_t out[Midi2ToMidi1Converter::MAX_WORDS];
+    ASSERT_EQ(converter.toUmp(rpn, out), 4u);
+    EXPECT_EQ(out[0], 0x23B06500u);
+    EXPECT_EQ(out[3], 0x23B02615u);
+    ASSERT_EQ(converter.toUmp(rpn, out), 2u);
+    EXPECT_EQ(umps({midi2(0x2, 0, 0, 0), value}).size(), 4u);
+}
+
+TEST_F(Midi2ToMidi1Test, TestRoundTripThroughMidi1Packets) {
+    // Down to MIDI 1.0 packets and back up: 7-bit-representable values survive exactly
+    std::vector<uint32_t> original = {
+        midi2(0x9, 3, 60, 0), static_cast<uint32_t>(midi7To16(100)) << 16,
+        midi2(0xB, 3, 74, 0), midi7To32(90),
+        midi2(0x2, 3, 0, 1), midi14To32(0x1234),
+        midi2(0xE, 3, 0, 0), midi14To32(0x3000),
+        midi2(0x8, 3, 60, 0), static_cast<uint32_t>(midi7To16(64)) << 16,
+    };
+    std::vector<uint32_t> midi1;
+    for (size_t i = 0; i < original.size(); i += 2) {
+        uint32_t out[Midi2ToMidi1Converter::MAX_WORDS];
+        size_t count = converter.toUmp(&original[i], out);
+        midi1.insert(midi1.end(), out, out + count);
+    }
+    // One packet each, except the RPN: two selectors and two data entry controllers
+    EXPECT_EQ(midi1.size(), 1u + 1 + 4 + 1 + 1);
+
+    Midi1ToMidi2Converter upscaler;
+    std::vector<uint32_t> upscaled;
+    for (uint32_t word : midi1) {
+        uint32_t out[2];
+        int count = upscaler.convert(umpGroup(word), static_cast<uint8_t>(word >> 16), (word >> 8) & 0x7F,
+                                     word & 0x7F, out);
+        upscaled.insert(upscaled.end(), out, out + count);
+    }
+
+    // Data entry MSB already produces an RPN with the coarse value; the LSB completes it
+    std::vector<uint32_t> expected(original.begin(), original.begin() + 4);
+    expected.insert(expected.end(), {original[4], midi14To32(0x1234 & ~0x7F)});
+    expected.insert(expected.end(), original.begin() + 4, original.end());
+    EXPECT_EQ(upscaled, expected);
+}
+
+TEST_F(Midi2ToMidi1Test, TestTranslationCost) {
+    // A typical performance mix: notes, controllers, pitch bend and parameter changes
+    std::vector<uint32_t> mix;
+    for (int i = 0; i < 64; i++) {
+        uint8_t channel = static_cast<uint8_t>(i % 4);
+        mix.insert(mix.end(), {midi2(0x9, channel, static_cast<uint8_t>(48 + i % 24), 0), 0x80000000u});
+        mix.insert(mix.end(), {midi2(0xB, channel, 1, 0), static_cast<uint32_t>(i) << 25});
+        mix.insert(mix.end(), {midi2(0xE, channel, 0, 0), static_cast<uint32_t>(i) << 26});
+        mix.insert(mix.end(), {midi2(0x2, channel, 0, static_cast<uint8_t>(i % 2)), 0x40000000u});
+    }
+    constexpr int ROUNDS = 20000;
+    size_t messages = ROUNDS * mix.size() / 2;
+    size_t packets = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < ROUNDS; round++) {
+        // What KeyboardController::writeOutputBatch does per batch for a MIDI 1.0 port, up to send_ump()
+        size_t pos = 0;
+        while (pos < mix.size()) {
+            uint32_t packetWords[4] = {};
+            int count = umpWordCount(mix[pos]);
+            std::copy_n(mix.data() + pos, std::min<size_t>(count, mix.size() - pos), packetWords);
+            pos += count;
+            uint32_t translated[Midi2ToMidi1Converter::MAX_WORDS];
+            size_t translatedWords = converter.toUmp(packetWords, translated);
+            for (size_t i = 0; i < translatedWords; i += umpWordCount(translated[i])) {
+                uint32_t out[4] = {};
+                std::copy_n(translated + i, std::min<size_t>(umpWordCount(translated[i]), translatedWords - i), out);
+                packets += out[0] != 0;
+            }
+        }
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / messages;
+    std::cout << "[TEST] Translated " << messages << " messages into " << packets << " MIDI 1.0 packets, "
+              << ns << " ns per message" << std::endl;
+    // A DIN byte takes 320 us; translation has to stay far below anything audible
+    EXPECT_LT(ns, 1000.0);
+}
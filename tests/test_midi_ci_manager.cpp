@@ -0,0 +1,287 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "keyboard_controller.h"
+#include "midi_ci_manager.h"
+#include "midi_ci_metrics.h"
+#include "property_model.h"
+
+// Virtual UMP port the controller sends to; collects the SysEx7 messages that arrive there
+class VirtualSink {
+public:
+    explicit VirtualSink(const std::string& name)
+        : in_(libremidi::ump_input_configuration{.on_message = [this](libremidi::ump&& packet) { receive(packet); },
+                                                 .ignore_sysex = false},
+              libremidi::midi2::in_default_configuration()) {
+        in_.open_virtual_port(name);
+    }
+
+    // CI messages (without F0) of the given sub-ID #2, waiting up to a second for `count` of them
+    std::vector<std::vector<uint8_t>> waitFor(uint8_t subId2, size_t count) const {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (true) {
+            auto found = messages(subId2);
+            if (found.size() >= count || std::chrono::steady_clock::now() >= deadline) {
+                return found;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> messages(uint8_t subId2) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::vector<std::vector<uint8_t>> found;
+        for (const auto& message : messages_) {
+            if (message.size() > 3 && message[0] == 0x7E && message[2] == 0x0D && message[3] == subId2) {
+                found.push_back(message);
+            }
+        }
+        return found;
+    }
+
+private:
+    void receive(const libremidi::ump& packet) {
+        uint32_t word0 = packet.data[0];
+        if ((word0 >> 28) != 0x3) {
+            return;
+        }
+        uint8_t status = (word0 >> 20) & 0xF;
+        size_t count = std::min<uint32_t>((word0 >> 16) & 0xF, 6);
+        uint8_t bytes[6] = {static_cast<uint8_t>(word0 >> 8), static_cast<uint8_t>(word0),
+                            static_cast<uint8_t>(packet.data[1] >> 24), static_cast<uint8_t>(packet.data[1] >> 16),
+                            static_cast<uint8_t>(packet.data[1] >> 8), static_cast<uint8_t>(packet.data[1])};
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (status == 0x0 || status == 0x1) {
+            buffer_.clear();
+        }
+        buffer_.insert(buffer_.end(), bytes, bytes + count);
+        if (status == 0x0 || status == 0x3) {
+            messages_.push_back(buffer_);
+        }
+    }
+
+    mutable std::mutex mutex_;
+    std::vector<uint8_t> buffer_;
+    std::vector<std::vector<uint8_t>> messages_;
+    libremidi::midi_in in_;
+};
+
+class MidiCIManagerTest : public ::testing::Test {
+protected:
+    static constexpr uint32_t LOCAL_MUID = 0x0123456;
+    static constexpr uint32_t REMOTE_MUID = 0x0ABCDEF;
+
+    void SetUp() override {
+        controller = std::make_unique<KeyboardController>();
+    }
+
+    void TearDown() override {
+        controller.reset();
+    }
+
+    static void appendMuid(std::vector<uint8_t>& out, uint32_t muid) {
+        for (int i = 0; i < 4; i++) {
+            out.push_back(static_cast<uint8_t>((muid >> (7 * i)) & 0x7F));
+        }
+    }
+
+    static uint32_t muidAt(const std::vector<uint8_t>& message, size_t offset) {
+        uint32_t muid = 0;
+        for (size_t i = 0; i < 4 && offset + i < message.size(); i++) {
+            muid |= static_cast<uint32_t>(message[offset + i] & 0x7F) << (7 * i);
+        }
+        return muid;
+    }
+
+    // CI payload as midicci sends and receives it: no F0/F7
+    static std::vector<uint8_t> message(uint8_t subId2, uint32_t source, uint32_t destination) {
+        std::vector<uint8_t> out = {0x7E, 0x7F, 0x0D, subId2, 0x02};
+        appendMuid(out, source);
+        appendMuid(out, destination);
+        return out;
+    }
+
+    // Discovery Reply from a device with Property Exchange
+    static std::vector<uint8_t> discoveryReply(uint32_t destination) {
+        auto out = message(0x71, REMOTE_MUID, destination);
+        out.insert(out.end(), {0x7D, 0x00, 0x00, 0x01, 0x00, 0x02, 0x00, 0x01, 0x00, 0x00, 0x00,  // identity
+                               0x08,                                                              // PE
+                               0x00, 0x20, 0x00, 0x00,                                            // 4096 bytes
+                               0x00, 0x7F});
+        return out;
+    }
+
+    // Property Exchange message with a header and an empty body, in one chunk
+    static std::vector<uint8_t> propertyMessage(uint8_t subId2, uint32_t destination, uint8_t requestId,
+                                                const std::string& header) {
+        auto out = message(subId2, REMOTE_MUID, destination);
+        out.push_back(requestId);
+        out.push_back(static_cast<uint8_t>(header.size() & 0x7F));
+        out.push_back(static_cast<uint8_t>((header.size() >> 7) & 0x7F));
+        out.insert(out.end(), header.begin(), header.end());
+        out.insert(out.end(), {0x01, 0x00, 0x01, 0x00, 0x00, 0x00});
+        return out;
+    }
+
+    static std::string propertyHeader(const std::vector<uint8_t>& message) {
+        if (message.size() < 16) {
+            return "";
+        }
+        size_t size = message[14] | (static_cast<size_t>(message[15]) << 7);
+        return std::string(message.begin() + 16, message.begin() + std::min(message.size(), 16 + size));
+    }
+
+    // Feeds a SysEx as SysEx7 packets, as if it came from the input port
+    void inject(const std::vector<uint8_t>& data) {
+        size_t packets = std::max<size_t>(1, (data.size() + 5) / 6);
+        for (size_t p = 0; p < packets; p++) {
+            size_t count = std::min<size_t>(6, data.size() - p * 6);
+            uint32_t status = packets == 1 ? 0 : p == 0 ? 1 : p == packets - 1 ? 3 : 2;
+            uint8_t bytes[6] = {};
+            std::copy_n(data.begin() + p * 6, count, bytes);
+            controller->injectMidiInput(libremidi::ump(
+                0x30000000u | (status << 20) | (static_cast<uint32_t>(count) << 16) | (bytes[0] << 8) | bytes[1],
+                (static_cast<uint32_t>(bytes[2]) << 24) | (bytes[3] << 16) | (bytes[4] << 8) | bytes[5], 0, 0));
+        }
+    }
+
+    // Hotplug brings virtual ports in asynchronously; empty if the port did not show up
+    std::string waitForPort(PortDirection direction, const std::string& name) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (std::chrono::steady_clock::now() < deadline) {
+            auto devices = direction == PortDirection::Input ? controller->getInputDevices() : controller->getOutputDevices();
+            for (const auto& [id, displayName] : devices) {
+                if (displayName.find(name) != std::string::npos) {
+                    return id;
+                }
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+        return "";
+    }
+
+    std::unique_ptr<KeyboardController> controller;
+};
+
+TEST_F(MidiCIManagerTest, TestInvalidateMuidMessage) {
+    auto invalidate = MidiCIManager::invalidateMuidMessage(LOCAL_MUID);
+    ASSERT_EQ(invalidate.size(), 18u);
+    EXPECT_EQ(invalidate.back(), 0xF7);
+    // Sent from the MUID being invalidated, to everyone, naming itself as the target
+    auto expected = message(0x7E, LOCAL_MUID, 0x0FFFFFFF);
+    appendMuid(expected, LOCAL_MUID);
+    expected.push_back(0xF7);
+    EXPECT_EQ(invalidate, expected);
+
+    MidiCIMetrics metrics;
+    metrics.observe(CIDirection::Sent, invalidate.data(), invalidate.size());
+    auto stats = metrics.snapshot();
+    ASSERT_EQ(stats.messageTypes.size(), 1u);
+    EXPECT_EQ(stats.messageTypes[0].name, "InvalidateMUID");
+    EXPECT_EQ(stats.malformed, 0u);
+}
+
+TEST_F(MidiCIManagerTest, TestReconfigurePortsRebindsMidiCI) {
+    ASSERT_TRUE(controller->isReady());
+    libremidi::midi_out source(libremidi::output_configuration{}, libremidi::midi2::out_default_configuration());
+    source.open_virtual_port("ump-keyboard-test source");
+    VirtualSink first("ump-keyboard-test sink 1");
+    VirtualSink second("ump-keyboard-test sink 2");
+    std::string sourceId = waitForPort(PortDirection::Input, "ump-keyboard-test source");
+    std::string firstId = waitForPort(PortDirection::Output, "ump-keyboard-test sink 1");
+    std::string secondId = waitForPort(PortDirection::Output, "ump-keyboard-test sink 2");
+    if (sourceId.empty() || firstId.empty() || secondId.empty()) {
+        GTEST_SKIP() << "Virtual UMP ports are not available on this backend";
+    }
+
+    std::mutex statesMutex;
+    std::vector<bool> states;
+    controller->setMidiConnectionChangedCallback([&](bool connected) {
+        std::lock_guard<std::mutex> lock(statesMutex);
+        states.push_back(connected);
+    });
+    auto takeStates = [&]() {
+        std::lock_guard<std::mutex> lock(statesMutex);
+        return std::exchange(states, {});
+    };
+
+    ASSERT_TRUE(controller->reconfigurePorts(sourceId, firstId));
+    EXPECT_EQ(takeStates(), (std::vector<bool>{true}));
+    uint32_t muid = controller->getMidiCIMuid();
+    ASSERT_NE(muid, 0u);
+    inject(discoveryReply(muid));
+    ASSERT_NE(controller->getMidiCIDeviceByMuid(REMOTE_MUID), nullptr);
+
+    // Only the output changes: one disconnect and one reconnect for the UI, the device found
+    // behind the old pair is dropped, and our own MUID survives without an InvalidateMUID
+    ASSERT_TRUE(controller->selectOutputDevice(secondId));
+    EXPECT_EQ(takeStates(), (std::vector<bool>{false, true}));
+    EXPECT_EQ(controller->getMidiCIDeviceByMuid(REMOTE_MUID), nullptr);
+    EXPECT_EQ(controller->getMidiCIMuid(), muid);
+    EXPECT_TRUE(controller->isMidiCIInitialized());
+    EXPECT_TRUE(first.messages(0x7E).empty());
+    EXPECT_TRUE(second.messages(0x7E).empty());
+
+    // A new identity is announced: the old MUID is invalidated on the current output
+    constexpr uint32_t NEW_MUID = 0x0654321;
+    ASSERT_TRUE(controller->resetMidiCI(NEW_MUID));
+    EXPECT_EQ(controller->getMidiCIMuid(), NEW_MUID);
+    auto invalidations = second.waitFor(0x7E, 1);
+    ASSERT_EQ(invalidations.size(), 1u);
+    EXPECT_EQ(muidAt(invalidations[0], 5), muid);
+    EXPECT_EQ(muidAt(invalidations[0], 13), muid);
+    EXPECT_TRUE(first.messages(0x7E).empty());
+    std::cout << "[TEST] Port switch kept MUID 0x" << std::hex << muid << ", identity change invalidated it"
+              << std::dec << std::endl;
+}
+
+TEST_F(MidiCIManagerTest, TestUnsubscribesReachOutputOnDestruction) {
+    ASSERT_TRUE(controller->isReady());
+    libremidi::midi_out source(libremidi::output_configuration{}, libremidi::midi2::out_default_configuration());
+    source.open_virtual_port("ump-keyboard-test shutdown source");
+    VirtualSink sink("ump-keyboard-test shutdown sink");
+    std::string sourceId = waitForPort(PortDirection::Input, "ump-keyboard-test shutdown source");
+    std::string sinkId = waitForPort(PortDirection::Output, "ump-keyboard-test shutdown sink");
+    if (sourceId.empty() || sinkId.empty()) {
+        GTEST_SKIP() << "Virtual UMP ports are not available on this backend";
+    }
+    ASSERT_TRUE(controller->reconfigurePorts(sourceId, sinkId));
+    uint32_t muid = controller->getMidiCIMuid();
+
+    // The device answers discovery and PE capabilities, then accepts every subscription
+    inject(discoveryReply(muid));
+    auto capabilities = message(0x31, REMOTE_MUID, muid);
+    capabilities.insert(capabilities.end(), {0x04, 0x00, 0x00});
+    inject(capabilities);
+    size_t resources = PropertyModel::subscribedResources().size();
+    auto starts = sink.waitFor(0x38, resources);
+    ASSERT_EQ(starts.size(), resources);
+    for (const auto& start : starts) {
+        EXPECT_NE(propertyHeader(start).find("start"), std::string::npos);
+        uint8_t requestId = start[13];
+        inject(propertyMessage(0x39, muid, requestId,
+                               R"({"status":200,"subscribeId":"sub)" + std::to_string(requestId) + "\"}"));
+    }
+
+    controller.reset();
+
+    std::vector<std::vector<uint8_t>> ends;
+    for (const auto& subscription : sink.waitFor(0x38, resources * 2)) {
+        if (propertyHeader(subscription).find("end") != std::string::npos) {
+            ends.push_back(subscription);
+        }
+    }
+    std::cout << "[TEST] " << ends.size() << " of " << resources << " subscriptions ended on destruction" << std::endl;
+    ASSERT_EQ(ends.size(), resources);
+    for (const auto& end : ends) {
+        EXPECT_EQ(muidAt(end, 5), muid);
+        EXPECT_EQ(muidAt(end, 9), REMOTE_MUID);
+    }
+}
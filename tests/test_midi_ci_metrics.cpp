@@ -0,0 +1,220 @@
+#include <gtest/gtest.h>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "metrics_exporter.h"
+#include "midi_ci_metrics.h"
+
+class MidiCIMetricsTest : public ::testing::Test {
+protected:
+    static constexpr uint32_t LOCAL_MUID = 0x0123456;
+    static constexpr uint32_t REMOTE_MUID = 0x0ABCDEF;
+
+    static void appendMuid(std::vector<uint8_t>& out, uint32_t muid) {
+        for (int i = 0; i < 4; i++) {
+            out.push_back(static_cast<uint8_t>((muid >> (7 * i)) & 0x7F));
+        }
+    }
+
+    // CI payload as midicci sends and receives it: no F0/F7
+    static std::vector<uint8_t> message(uint8_t subId2, uint32_t source, uint32_t destination) {
+        std::vector<uint8_t> out = {0x7E, 0x7F, 0x0D, subId2, 0x02};
+        appendMuid(out, source);
+        appendMuid(out, destination);
+        return out;
+    }
+
+    static std::vector<uint8_t> propertyMessage(uint8_t subId2, uint32_t source, uint32_t destination, uint8_t requestId,
+                                                const std::string& header, uint16_t chunkCount = 1, uint16_t chunk = 1) {
+        auto out = message(subId2, source, destination);
+        out.push_back(requestId);
+        out.push_back(static_cast<uint8_t>(header.size() & 0x7F));
+        out.push_back(static_cast<uint8_t>((header.size() >> 7) & 0x7F));
+        out.insert(out.end(), header.begin(), header.end());
+        out.push_back(static_cast<uint8_t>(chunkCount & 0x7F));
+        out.push_back(static_cast<uint8_t>(chunkCount >> 7));
+        out.push_back(static_cast<uint8_t>(chunk & 0x7F));
+        out.push_back(static_cast<uint8_t>(chunk >> 7));
+        out.push_back(0);
+        out.push_back(0);
+        return out;
+    }
+
+    void sent(const std::vector<uint8_t>& payload) { metrics.observe(CIDirection::Sent, payload.data(), payload.size()); }
+    void received(const std::vector<uint8_t>& payload) { metrics.observe(CIDirection::Received, payload.data(), payload.size()); }
+
+    MidiCIMetrics metrics;
+};
+
+TEST_F(MidiCIMetricsTest, TestCountsByTypeAndDevice) {
+    auto discovery = message(0x70, LOCAL_MUID, 0x0FFFFFFF);
+    sent(discovery);
+    received(message(0x71, REMOTE_MUID, LOCAL_MUID));
+    received(message(0x7F, REMOTE_MUID, LOCAL_MUID));
+    uint8_t garbage[3] = {0x7E, 0x00, 0x0D};
+    metrics.observe(CIDirection::Received, garbage, sizeof(garbage));
+
+    auto stats = metrics.snapshot();
+    ASSERT_EQ(stats.messageTypes.size(), 3u);
+    EXPECT_EQ(stats.messageTypes[0].name, "DiscoveryInquiry");
+    EXPECT_EQ(stats.messageTypes[0].sent, 1u);
+    EXPECT_EQ(stats.messageTypes[1].name, "DiscoveryReply");
+    EXPECT_EQ(stats.messageTypes[1].received, 1u);
+    EXPECT_EQ(stats.naks, 1u);
+    EXPECT_EQ(stats.malformed, 1u);
+    EXPECT_EQ(stats.sysexBytesSent, discovery.size());
+
+    // Broadcast destination and the remote device each get a row
+    ASSERT_EQ(stats.devices.size(), 2u);
+    EXPECT_EQ(stats.devices[0].muid, REMOTE_MUID);
+    EXPECT_EQ(stats.devices[0].received, 2u);
+    EXPECT_EQ(stats.devices[1].muid, 0x0FFFFFFFu);
+    EXPECT_EQ(stats.devices[1].sent, 1u);
+}
+
+TEST_F(MidiCIMetricsTest, TestPropertyLatencyRetriesAndTimeouts) {
+    const std::string header = R"({"resource":"AllCtrlList"})";
+    sent(propertyMessage(0x34, LOCAL_MUID, REMOTE_MUID, 1, header));
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    // Only the final chunk of a reply completes the request
+    received(propertyMessage(0x35, REMOTE_MUID, LOCAL_MUID, 1, R"({"status":200})", 2, 1));
+    EXPECT_EQ(metrics.snapshot().properties[0].replies, 0u);
+    received(propertyMessage(0x35, REMOTE_MUID, LOCAL_MUID, 1, R"({"status":200})", 2, 2));
+
+    // Asking again before the previous request was answered counts as a retry
+    sent(propertyMessage(0x34, LOCAL_MUID, REMOTE_MUID, 2, R"({"resource":"ProgramList"})"));
+    sent(propertyMessage(0x34, LOCAL_MUID, REMOTE_MUID, 3, R"({"resource":"ProgramList"})"));
+    metrics.recordTimeout("ProgramList");
+
+    auto stats = metrics.snapshot();
+    ASSERT_EQ(stats.properties.size(), 2u);
+    const auto& ctrl = stats.properties[0];
+    EXPECT_EQ(ctrl.name, "AllCtrlList");
+    EXPECT_EQ(ctrl.requests, 1u);
+    EXPECT_EQ(ctrl.replies, 1u);
+    EXPECT_EQ(ctrl.latencyCount, 1u);
+    EXPECT_GE(ctrl.latencyMaxNs, 2'000'000u);
+    const auto& programs = stats.properties[1];
+    EXPECT_EQ(programs.name, "ProgramList");
+    EXPECT_EQ(programs.requests, 2u);
+    EXPECT_EQ(programs.retries, 1u);
+    EXPECT_EQ(programs.timeouts, 1u);
+    EXPECT_EQ(stats.retries, 1u);
+    EXPECT_EQ(stats.timeouts, 1u);
+
+    EXPECT_EQ(MidiCIMetrics::headerResource(R"({"resource" : "X-Custom", "resId":"a"})"), "X-Custom");
+    EXPECT_TRUE(MidiCIMetrics::headerResource(R"({"status":200})").empty());
+}
+
+TEST_F(MidiCIMetricsTest, TestPrometheusText) {
+    sent(propertyMessage(0x34, LOCAL_MUID, REMOTE_MUID, 5, R"({"resource":"ProgramList"})"));
+    received(propertyMessage(0x35, REMOTE_MUID, LOCAL_MUID, 5, R"({"status":200})"));
+
+    std::ostringstream out;
+    metrics.writePrometheus(out);
+    std::string text = out.str();
+    EXPECT_NE(text.find("# TYPE ump_keyboard_midici_messages_total counter"), std::string::npos);
+    EXPECT_NE(text.find("ump_keyboard_midici_messages_total{direction=\"sent\",type=\"GetPropertyData\"} 1"), std::string::npos);
+    EXPECT_NE(text.find("ump_keyboard_midici_device_messages_total{direction=\"received\",muid=\"0x0abcdef\"} 1"),
+              std::string::npos);
+    EXPECT_NE(text.find("ump_keyboard_midici_property_latency_seconds_count{property=\"ProgramList\"} 1"), std::string::npos);
+
+    // Every sample line is "name{labels} value" or "name value"
+    std::istringstream lines(text);
+    std::string line;
+    while (std::getline(lines, line)) {
+        if (line.empty() || line[0] == '#') continue;
+        EXPECT_NE(line.rfind(' '), std::string::npos) << line;
+        EXPECT_EQ(line.rfind("ump_keyboard_midici_", 0), 0u) << line;
+    }
+}
+
+TEST_F(MidiCIMetricsTest, TestConcurrentObservers) {
+    constexpr int threads = 4;
+    constexpr int perThread = 50000;
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([this, t]() {
+            auto payload = message(0x3F, REMOTE_MUID + static_cast<uint32_t>(t), LOCAL_MUID);
+            for (int i = 0; i < perThread; i++) {
+                received(payload);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    auto stats = metrics.snapshot();
+    ASSERT_EQ(stats.messageTypes.size(), 1u);
+    EXPECT_EQ(stats.messageTypes[0].received, static_cast<uint64_t>(threads) * perThread);
+    ASSERT_EQ(stats.devices.size(), static_cast<size_t>(threads));
+    for (const auto& device : stats.devices) {
+        EXPECT_EQ(device.received, static_cast<uint64_t>(perThread));
+    }
+    std::cout << "[TEST] " << threads * perThread << " CI messages counted from " << threads << " threads in " << ms
+              << " ms" << std::endl;
+}
+
+TEST_F(MidiCIMetricsTest, TestExporterFileAndSocket) {
+    received(message(0x71, REMOTE_MUID, LOCAL_MUID));
+    std::string path = (std::filesystem::temp_directory_path() / "midi_ci_metrics_test.prom").string();
+    std::filesystem::remove(path);
+
+    MetricsExporter exporter([this](std::ostream& out) { metrics.writePrometheus(out); });
+    ASSERT_TRUE(exporter.start(path, 0, std::chrono::milliseconds(20)));
+    ASSERT_NE(exporter.port(), 0);
+
+#ifdef _WIN32
+    WSADATA wsa;
+    ASSERT_EQ(WSAStartup(MAKEWORD(2, 2), &wsa), 0);
+    SOCKET client = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_NE(client, INVALID_SOCKET);
+#else
+    int client = ::socket(AF_INET, SOCK_STREAM, 0);
+    ASSERT_GE(client, 0);
+#endif
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(exporter.port());
+    ASSERT_EQ(::connect(client, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+    const char request[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    ::send(client, request, sizeof(request) - 1, 0);
+    std::string response;
+    char buffer[4096];
+    int received;
+    while ((received = static_cast<int>(::recv(client, buffer, sizeof(buffer), 0))) > 0) {
+        response.append(buffer, static_cast<size_t>(received));
+    }
+#ifdef _WIN32
+    ::closesocket(client);
+    WSACleanup();
+#else
+    ::close(client);
+#endif
+    EXPECT_EQ(response.rfind("HTTP/1.0 200 OK", 0), 0u);
+    EXPECT_NE(response.find("type=\"DiscoveryReply\"} 1"), std::string::npos);
+
+    exporter.stop();
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    EXPECT_NE(contents.str().find("type=\"DiscoveryReply\"} 1"), std::string::npos);
+    std::filesystem::remove(path);
+}
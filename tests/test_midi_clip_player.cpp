@@ -0,0 +1,221 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <vector>
+#include "midi_clip_player.h"
+#include "ump_utils.h"
+
+class MidiClipPlayerTest : public ::testing::Test {
+protected:
+    struct SentBatch {
+        UmpLane lane;
+        std::vector<uint32_t> words;
+        std::chrono::steady_clock::time_point sentAt;
+    };
+
+    void SetUp() override {
+        path = (std::filesystem::temp_directory_path() /
+                ("midi_clip_player_test_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()))).string();
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+
+    MidiClipPlayer::Sink recordingSink() {
+        return [this](const uint32_t* words, size_t wordCount, UmpLane lane) {
+            std::lock_guard<std::mutex> lock(mutex);
+            sent.push_back({lane, std::vector<uint32_t>(words, words + wordCount), std::chrono::steady_clock::now()});
+            changed.notify_all();
+            size_t packets = 0;
+            for (size_t pos = 0; pos < wordCount; pos += umpWordCount(words[pos])) {
+                packets++;
+            }
+            return packets;
+        };
+    }
+
+    bool waitForBatches(size_t count) {
+        std::unique_lock<std::mutex> lock(mutex);
+        return changed.wait_for(lock, std::chrono::seconds(5), [&]() { return sent.size() >= count; });
+    }
+
+    // A MIDI Clip File at 1 ms per tick (1000 ticks per quarter, one quarter per second)
+    void beginClip() {
+        clip = {'S', 'M', 'F', '2', 'C', 'L', 'I', 'P'};
+        appendWord(0x00300000 | 1000);
+        appendWord(0x00400000);
+        appendWord(0xF0200000);  // Start of Clip
+        appendWord(0); appendWord(0); appendWord(0);
+        appendWord(0x00400000);
+        appendWord(0xD0100000);  // Set Tempo
+        appendWord(100000000); appendWord(0); appendWord(0);
+    }
+
+    void appendEvent(uint32_t deltaMs, std::initializer_list<uint32_t> words) {
+        appendWord(0x00400000 | deltaMs);
+        for (uint32_t word : words) {
+            appendWord(word);
+        }
+    }
+
+    void endClip() {
+        appendEvent(0, {0xF0210000, 0, 0, 0});  // End of Clip
+        FILE* f = std::fopen(path.c_str(), "wb");
+        ASSERT_NE(f, nullptr);
+        std::fwrite(clip.data(), 1, clip.size(), f);
+        std::fclose(f);
+    }
+
+    void appendWord(uint32_t word) {
+        clip.push_back(word >> 24);
+        clip.push_back((word >> 16) & 0xFF);
+        clip.push_back((word >> 8) & 0xFF);
+        clip.push_back(word & 0xFF);
+    }
+
+    static uint32_t noteOn(uint8_t channel, uint8_t note) { return 0x40900000u | (channel << 16) | (note << 8); }
+    static uint32_t noteOff(uint8_t channel, uint8_t note) { return 0x40800000u | (channel << 16) | (note << 8); }
+
+    std::string path;
+    std::vector<uint8_t> clip;
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::vector<SentBatch> sent;
+};
+
+TEST_F(MidiClipPlayerTest, TestSendsInTimeOrderWithSysExWhole) {
+    // Notes every 10 ms, and a SysEx message longer than one ring slot in the middle
+    constexpr size_t SYSEX_PACKETS = MidiClipPlayer::BATCH_WORDS;  // twice what a slot holds
+    beginClip();
+    for (uint8_t i = 0; i < 10; i++) {
+        appendEvent(i == 0 ? 0 : 5, {noteOn(0, 60 + i), 0xFFFF0000});
+        if (i == 4) {
+            for (size_t p = 0; p < SYSEX_PACKETS; p++) {
+                uint32_t status = p == 0 ? 0x1 : p == SYSEX_PACKETS - 1 ? 0x3 : 0x2;
+                appendEvent(0, {0x30060000u | (status << 20) | static_cast<uint32_t>(p & 0x7F), 0});
+            }
+        }
+        appendEvent(5, {noteOff(0, 60 + i), 0});
+        appendEvent(0, {0x10F80000});  // clock between notes
+    }
+    endClip();
+
+    MidiClipPlayer player(recordingSink());
+    bool finished = false;
+    player.setFinishedCallback([&](const ClipPlayerStats&) { finished = true; });
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(player.start(path));
+    while (player.isPlaying() && std::chrono::steady_clock::now() - start < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    player.stop();
+    EXPECT_TRUE(finished);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<uint32_t> notes;
+    size_t bulkBatches = 0;
+    for (size_t i = 0; i < sent.size(); i++) {
+        const auto& batch = sent[i];
+        if (i > 0) {
+            EXPECT_GE(batch.sentAt, sent[i - 1].sentAt);
+        }
+        if (batch.lane == UmpLane::Bulk) {
+            // The whole message in one batch, with nothing else in it
+            bulkBatches++;
+            ASSERT_EQ(batch.words.size(), 2 * SYSEX_PACKETS);
+            EXPECT_EQ((batch.words.front() >> 20) & 0xF, 0x1u);
+            EXPECT_EQ((batch.words[batch.words.size() - 2] >> 20) & 0xF, 0x3u);
+            for (size_t pos = 0; pos < batch.words.size(); pos += 2) {
+                EXPECT_EQ(batch.words[pos] >> 28, 0x3u);
+            }
+            continue;
+        }
+        for (size_t pos = 0; pos < batch.words.size(); pos += umpWordCount(batch.words[pos])) {
+            EXPECT_NE(batch.words[pos] >> 28, 0x3u);
+            if ((batch.words[pos] >> 28) == 0x4) {
+                notes.push_back(batch.words[pos]);
+            }
+        }
+    }
+    EXPECT_EQ(bulkBatches, 1u);
+    ASSERT_EQ(notes.size(), 20u);
+    for (uint8_t i = 0; i < 10; i++) {
+        EXPECT_EQ(notes[i * 2], noteOn(0, 60 + i));
+        EXPECT_EQ(notes[i * 2 + 1], noteOff(0, 60 + i));
+    }
+    // Ten notes 10 ms apart, the last one off 5 ms later
+    auto span = std::chrono::duration_cast<std::chrono::milliseconds>(sent.back().sentAt - sent.front().sentAt);
+    std::cout << "[TEST] " << sent.size() << " batches over " << span.count() << " ms" << std::endl;
+    EXPECT_GE(span.count(), 90);
+    EXPECT_LT(span.count(), 200);
+}
+
+TEST_F(MidiClipPlayerTest, TestStopReleasesOnlyNotesThePlayerSent) {
+    beginClip();
+    appendEvent(0, {noteOn(0, 60), 0xFFFF0000});
+    appendEvent(0, {noteOn(1, 64), 0xFFFF0000});
+    appendEvent(5, {noteOff(1, 64), 0});
+    appendEvent(10000, {noteOff(0, 60), 0});  // still held when stopped
+    endClip();
+
+    MidiClipPlayer player(recordingSink());
+    ASSERT_TRUE(player.start(path));
+    ASSERT_TRUE(waitForBatches(2));
+    player.stop();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(sent.size(), 3u);
+    // Nothing but the one note the clip left sounding; no All Notes Off for notes held elsewhere
+    EXPECT_EQ(sent.back().lane, UmpLane::Realtime);
+    ASSERT_EQ(sent.back().words.size(), 2u);
+    EXPECT_EQ(sent.back().words[0], noteOff(0, 60));
+
+    // Stopping again has nothing left to release
+    player.stop();
+    EXPECT_EQ(sent.size(), 3u);
+}
+
+TEST_F(MidiClipPlayerTest, TestDenseClipDoesNotUnderrun) {
+    // 16 channels, a note on or off on every channel every millisecond, for two seconds
+    constexpr int DURATION_MS = 2000;
+    beginClip();
+    for (int ms = 0; ms < DURATION_MS; ms++) {
+        for (uint8_t channel = 0; channel < 16; channel++) {
+            uint8_t note = static_cast<uint8_t>(36 + (ms / 2) % 48);
+            uint32_t word0 = ms % 2 == 0 ? noteOn(channel, note) : noteOff(channel, note);
+            appendEvent(channel == 0 && ms > 0 ? 1 : 0, {word0, 0x80000000});
+        }
+    }
+    endClip();
+
+    MidiClipPlayer player(recordingSink());
+    ClipPlayerStats result;
+    bool finished = false;
+    player.setFinishedCallback([&](const ClipPlayerStats& stats) {
+        result = stats;
+        finished = true;
+    });
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(player.start(path));
+    while (player.isPlaying() && std::chrono::steady_clock::now() - start < std::chrono::seconds(10)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    player.stop();
+
+    ASSERT_TRUE(finished);
+    std::cout << "[TEST] Dense clip: " << result.packets << " packets in " << result.batches << " batches, "
+              << result.underruns << " underruns, " << result.lateBatches << " late batches (max "
+              << result.maxLatenessNs / 1000 << " us late)" << std::endl;
+    EXPECT_EQ(result.packets, static_cast<uint64_t>(DURATION_MS) * 16);
+    EXPECT_EQ(result.underruns, 0u);
+    // Every note was turned off by the clip itself
+    std::lock_guard<std::mutex> lock(mutex);
+    EXPECT_EQ(sent.size(), result.batches);
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+#include "midi_file_source.h"
+#include "midi1_to_midi2.h"
+#include "midi_value_scaling.h"
+
+class MidiFileSourceTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = (std::filesystem::temp_directory_path() /
+                ("midi_file_source_test_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()))).string();
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+
+    void writeFile(const std::vector<uint8_t>& bytes) {
+        FILE* f = std::fopen(path.c_str(), "wb");
+        ASSERT_NE(f, nullptr);
+        std::fwrite(bytes.data(), 1, bytes.size(), f);
+        std::fclose(f);
+    }
+
+    static void appendWord(std::vector<uint8_t>& out, uint32_t word) {
+        out.push_back(word >> 24);
+        out.push_back((word >> 16) & 0xFF);
+        out.push_back((word >> 8) & 0xFF);
+        out.push_back(word & 0xFF);
+    }
+
+    static std::vector<TimedUmp> readAll(MidiEventSource& source) {
+        std::vector<TimedUmp> events;
+        TimedUmp event;
+        while (source.next(event)) {
+            events.push_back(event);
+        }
+        return events;
+    }
+
+    std::string path;
+};
+
+TEST_F(MidiFileSourceTest, TestConverterRpnAndBank) {
+    Midi1ToMidi2Converter converter;
+    uint32_t out[2];
+
+    EXPECT_EQ(converter.convert(0, 0xB1, 101, 0, out), 0);
+    EXPECT_EQ(converter.convert(0, 0xB1, 100, 0, out), 0);
+    ASSERT_EQ(converter.convert(0, 0xB1, 6, 2, out), 2);
+    EXPECT_EQ(out[0], 0x40210000u);  // RPN 0/0 (pitch bend sensitivity) on channel 1
+    EXPECT_EQ(out[1], midi14To32(2 << 7));
+
+    EXPECT_EQ(converter.convert(3, 0xB0, 0, 1, out), 0);
+    EXPECT_EQ(converter.convert(3, 0xB0, 32, 5, out), 0);
+    ASSERT_EQ(converter.convert(3, 0xC0, 10, 0, out), 2);
+    EXPECT_EQ(out[0], 0x43C00001u);  // bank valid
+    EXPECT_EQ(out[1], 0x0A000105u);
+}
+
+TEST_F(MidiFileSourceTest, TestStandardMidiFileMergesTracksWithTempo) {
+    std::vector<uint8_t> smf = {'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 1, 0, 2, 0x01, 0xE0};  // format 1, 2 tracks, 480 tpq
+    // Track 0: tempo 250000 us/quarter at tick 0, end of track
+    std::vector<uint8_t> track0 = {0x00, 0xFF, 0x51, 0x03, 0x03, 0xD0, 0x90, 0x00, 0xFF, 0x2F, 0x00};
+    // Track 1: note on at 0, running-status note on (velocity 0 = off) at 480, end
+    std::vector<uint8_t> track1 = {0x00, 0x90, 60, 100, 0x83, 0x60, 60, 0, 0x00, 0xFF, 0x2F, 0x00};
+    for (auto* track : {&track0, &track1}) {
+        smf.insert(smf.end(), {'M', 'T', 'r', 'k'});
+        appendWord(smf, static_cast<uint32_t>(track->size()));
+        smf.insert(smf.end(), track->begin(), track->end());
+    }
+    writeFile(smf);
+
+    auto source = openMidiEventSource(path);
+    ASSERT_NE(source, nullptr);
+    auto events = readAll(*source);
+    ASSERT_EQ(events.size(), 2u);
+
+    EXPECT_EQ(events[0].timeNs, 0);
+    EXPECT_EQ(events[0].words[0], 0x40903C00u);
+    EXPECT_EQ(events[0].words[1] >> 16, midi7To16(100));
+
+    EXPECT_EQ(events[1].timeNs, 250000000);  // one quarter at 240 BPM
+    EXPECT_EQ(events[1].words[0], 0x40803C00u);
+    std::cout << "[TEST] SMF produced " << events.size() << " events" << std::endl;
+}
+
+TEST_F(MidiFileSourceTest, TestClipFileAcrossGroups) {
+    std::vector<uint8_t> clip = {'S', 'M', 'F', '2', 'C', 'L', 'I', 'P'};
+    appendWord(clip, 0x00300000 | 96);   // 96 ticks per quarter
+    appendWord(clip, 0x00400000);        // delta 0
+    appendWord(clip, 0xF0200000);        // Start of Clip
+    appendWord(clip, 0); appendWord(clip, 0); appendWord(clip, 0);
+    appendWord(clip, 0x00400000);
+    appendWord(clip, 0xD0100000);        // Set Tempo: 1 second per quarter
+    appendWord(clip, 100000000); appendWord(clip, 0); appendWord(clip, 0);
+
+    for (uint32_t group = 0; group < 16; group++) {
+        appendWord(clip, 0x00400000 | (group == 0 ? 0 : 6));
+        appendWord(clip, 0x40903C00 | (group << 24));
+        appendWord(clip, 0xFFFF0000);
+    }
+    appendWord(clip, 0x00400000);
+    appendWord(clip, 0x20903E7F);        // MIDI 1.0 note on in a clip gets up-converted too
+    appendWord(clip, 0x00400000);
+    appendWord(clip, 0xF0210000);        // End of Clip
+    appendWord(clip, 0); appendWord(clip, 0); appendWord(clip, 0);
+    appendWord(clip, 0x40903C00);        // after End of Clip: ignored
+    appendWord(clip, 0xFFFF0000);
+    writeFile(clip);
+
+    auto source = openMidiEventSource(path);
+    ASSERT_NE(source, nullptr);
+    auto events = readAll(*source);
+    ASSERT_EQ(events.size(), 17u);
+
+    for (uint32_t group = 0; group < 16; group++) {
+        EXPECT_EQ((events[group].words[0] >> 24) & 0xF, group);
+        EXPECT_EQ(events[group].timeNs, static_cast<int64_t>(group) * 6 * 1000000000 / 96);
+    }
+    EXPECT_EQ(events[16].words[0], 0x40903E00u);
+    EXPECT_EQ(events[16].words[1], 0xFFFF0000u);
+}
+
+TEST_F(MidiFileSourceTest, TestRejectsUnknownFile) {
+    writeFile({'R', 'I', 'F', 'F', 0, 0, 0, 0});
+    EXPECT_EQ(openMidiEventSource(path), nullptr);
+}
@@ -0,0 +1,17 @@
+#include <gtest/gtest.h>
+#include "midi_value_scaling.h"
+
+class MidiValueScalingTest : public ::testing::Test {
+};
+
+TEST_F(MidiValueScalingTest, TestValueScaling) {
+    EXPECT_EQ(midi7To16(0), 0u);
+    EXPECT_EQ(midi7To16(64), 0x8000u);
+    EXPECT_EQ(midi7To16(127), 0xFFFFu);
+    EXPECT_EQ(midi7To32(127), 0xFFFFFFFFu);
+    EXPECT_EQ(midi14To32(0x2000), 0x80000000u);
+    EXPECT_EQ(midi14To32(0x3FFF), 0xFFFFFFFFu);
+    for (uint32_t value = 0; value < 128; value++) {
+        EXPECT_EQ(midi16To7(midi7To16(static_cast<uint8_t>(value))), value);
+    }
+}
@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include "note_router.h"
+
+class NoteRouterTest : public ::testing::Test {
+protected:
+    NoteRouter router;
+};
+
+TEST_F(NoteRouterTest, TestDefaultRoutesEverythingToGroup0Channel0) {
+    for (int key = 0; key < 128; key++) {
+        NoteRoute route = router.route(key);
+        ASSERT_TRUE(route.valid);
+        EXPECT_EQ(route.group, 0);
+        EXPECT_EQ(route.channel, 0);
+        EXPECT_EQ(route.note, key);
+    }
+    EXPECT_FALSE(router.route(-1).valid);
+    EXPECT_FALSE(router.route(128).valid);
+}
+
+TEST_F(NoteRouterTest, TestSplitWithTransposeAndOverlap) {
+    router.setZones({
+        {0, 59, 1, 2, 0},
+        {60, 127, 0, 0, 12},
+        {48, 52, 15, 15, 0},   // later zone wins inside its range
+    });
+
+    EXPECT_EQ(router.route(40).group, 1);
+    EXPECT_EQ(router.route(40).channel, 2);
+    EXPECT_EQ(router.route(50).group, 15);
+    EXPECT_EQ(router.route(60).note, 72);
+    EXPECT_FALSE(router.route(120).valid);  // transposed past 127
+}
+
+TEST_F(NoteRouterTest, TestNoteOffFollowsOriginalDestination) {
+    router.setZones({{0, 127, 3, 4, 0}});
+    ASSERT_FALSE(router.noteOn(60, router.route(60)).has_value());
+
+    router.setZones({{0, 127, 7, 8, 0}});
+    auto released = router.noteOff(60);
+    ASSERT_TRUE(released.has_value());
+    EXPECT_EQ(released->group, 3);
+    EXPECT_EQ(released->channel, 4);
+    EXPECT_FALSE(router.noteOff(60).has_value());
+}
+
+TEST_F(NoteRouterTest, TestReleaseAllReturnsOnlySoundingNotes) {
+    router.noteOn(10, router.route(10));
+    router.noteOn(20, router.route(20));
+    router.noteOn(10, router.route(10));  // retrigger does not double count
+    EXPECT_EQ(router.activeKeyCount(), 2);
+
+    auto released = router.releaseAll();
+    EXPECT_EQ(released.size(), 2u);
+    EXPECT_EQ(router.activeKeyCount(), 0);
+    EXPECT_TRUE(router.releaseAll().empty());
+}
+
+TEST_F(NoteRouterTest, TestParseZones) {
+    auto zones = NoteRouter::parseZones("0-59:2/1,60-127:16/10:+12");
+    ASSERT_TRUE(zones.has_value());
+    ASSERT_EQ(zones->size(), 2u);
+    EXPECT_EQ((*zones)[0].group, 1);
+    EXPECT_EQ((*zones)[0].channel, 0);
+    EXPECT_EQ((*zones)[1].group, 15);
+    EXPECT_EQ((*zones)[1].channel, 9);
+    EXPECT_EQ((*zones)[1].transpose, 12);
+
+    std::cout << "[TEST] Expecting parse errors below" << std::endl;
+    EXPECT_FALSE(NoteRouter::parseZones("0-59").has_value());
+    EXPECT_FALSE(NoteRouter::parseZones("0-59:17/1").has_value());
+    EXPECT_FALSE(NoteRouter::parseZones("60-50:1/1").has_value());
+}
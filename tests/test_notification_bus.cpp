@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <vector>
+#include "notification_bus.h"
+
+class NotificationBusTest : public ::testing::Test {
+protected:
+    static constexpr int64_t MS = 1'000'000;
+
+    void SetUp() override {
+        bus.setWaker([this](std::chrono::nanoseconds delay) { wakeups.push_back(delay.count()); });
+        bus.setDevicesHandler([this]() { devicesUpdates++; });
+        bus.setConnectionHandler([this](bool connected) { connectionStates.push_back(connected); });
+        bus.setPropertiesHandler([this](uint32_t muid) { refreshed.push_back(muid); });
+        bus.setPropertyRowsHandler([this](uint32_t muid, const PropertyRowUpdate& update) {
+            rowUpdates.push_back({muid, update});
+        });
+    }
+
+    NotificationBus bus{std::chrono::milliseconds(16)};
+    std::vector<int64_t> wakeups;
+    int devicesUpdates = 0;
+    std::vector<bool> connectionStates;
+    std::vector<uint32_t> refreshed;
+    std::vector<std::pair<uint32_t, PropertyRowUpdate>> rowUpdates;
+};
+
+TEST_F(NotificationBusTest, TestBurstIsDeliveredOncePerTopic) {
+    // A discovery answered by 50 devices, plus a connection flapping on the way
+    for (int i = 0; i < 50; i++) {
+        bus.postDevicesChanged();
+    }
+    bus.postConnectionChanged(false);
+    bus.postConnectionChanged(true);
+    EXPECT_EQ(wakeups.size(), 1u);
+
+    bus.deliver();
+    EXPECT_EQ(devicesUpdates, 1);
+    ASSERT_EQ(connectionStates.size(), 1u);
+    EXPECT_TRUE(connectionStates[0]);
+
+    // Nothing pending: nothing delivered
+    bus.deliver();
+    EXPECT_EQ(devicesUpdates, 1);
+
+    // The next post waits out the rest of the frame that started at the last delivery
+    bus.postDevicesChanged();
+    ASSERT_EQ(wakeups.size(), 2u);
+    EXPECT_GT(wakeups[1], 0);
+    EXPECT_LE(wakeups[1], 16 * MS);
+
+    auto stats = bus.stats();
+    EXPECT_EQ(stats.devicesPosted, 51u);
+    EXPECT_EQ(stats.devicesDelivered, 1u);
+    EXPECT_EQ(stats.connectionPosted, 2u);
+    EXPECT_EQ(stats.deliveries, 1u);
+    std::cout << "[TEST] Coalesced " << stats.devicesPosted + stats.connectionPosted << " posts into "
+              << stats.devicesDelivered + stats.connectionDelivered << " UI updates" << std::endl;
+}
+
+TEST_F(NotificationBusTest, TestPropertyRowsAreMergedPerList) {
+    bus.postPropertyRows(0x100, {"AllCtrlList", false, {3, 7}});
+    bus.postPropertyRows(0x100, {"AllCtrlList", false, {1, 7}});
+    bus.postPropertyRows(0x100, {"ProgramList", false, {0}});
+    bus.postPropertyRows(0x200, {"AllCtrlList", false, {2}});
+    bus.postPropertyRows(0x200, {"AllCtrlList", true, {}});
+    bus.postPropertyRows(0x300, {"AllCtrlList", false, {}});  // empty: ignored
+    bus.deliver(0);
+
+    ASSERT_EQ(rowUpdates.size(), 3u);
+    EXPECT_EQ(rowUpdates[0].first, 0x100u);
+    EXPECT_EQ(rowUpdates[0].second.resource, "AllCtrlList");
+    EXPECT_EQ(rowUpdates[0].second.rows, (std::vector<size_t>{1, 3, 7}));
+    EXPECT_EQ(rowUpdates[1].second.resource, "ProgramList");
+    EXPECT_EQ(rowUpdates[2].first, 0x200u);
+    EXPECT_TRUE(rowUpdates[2].second.reset);
+    EXPECT_TRUE(rowUpdates[2].second.rows.empty());
+
+    // A full refresh of a device supersedes its row updates, before and after
+    rowUpdates.clear();
+    bus.postPropertyRows(0x100, {"AllCtrlList", false, {4}});
+    bus.postPropertiesChanged(0x100);
+    bus.postPropertiesChanged(0x100);
+    bus.postPropertyRows(0x100, {"ProgramList", false, {5}});
+    bus.postPropertyRows(0x200, {"ProgramList", false, {5}});
+    bus.deliver(20 * MS);
+    EXPECT_EQ(refreshed, (std::vector<uint32_t>{0x100}));
+    ASSERT_EQ(rowUpdates.size(), 1u);
+    EXPECT_EQ(rowUpdates[0].first, 0x200u);
+}
@@ -0,0 +1,213 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "latency_tracker.h"
+#include "output_pacer.h"
+#include "ump_output_queue.h"
+
+class OutputPacerTest : public ::testing::Test {
+protected:
+    static constexpr int64_t MS = 1'000'000;
+
+    // One SysEx7 message with `bytes` data bytes, as complete packets of up to 6 bytes
+    static std::vector<uint32_t> sysex(size_t bytes) {
+        std::vector<uint32_t> words;
+        size_t packets = (bytes + 5) / 6;
+        for (size_t i = 0; i < packets; i++) {
+            uint32_t status = packets == 1 ? 0x0 : i == 0 ? 0x1 : i == packets - 1 ? 0x3 : 0x2;
+            uint32_t count = static_cast<uint32_t>(std::min<size_t>(6, bytes - i * 6));
+            words.push_back(0x30000000u | (status << 20) | (count << 16));
+            words.push_back(0);
+        }
+        return words;
+    }
+};
+
+TEST_F(OutputPacerTest, TestWireBytes) {
+    uint32_t noteOn1[] = {0x20903C64};
+    uint32_t program1[] = {0x20C10500};
+    uint32_t noteOn2[] = {0x40903C00, 0xFFFF0000};
+    uint32_t rpn2[] = {0x40200000, 0x80000000};
+    uint32_t perNotePitch[] = {0x40603C00, 0x80000000};
+    uint32_t clock[] = {0x10F80000};
+    uint32_t jrTimestamp[] = {0x00200000};
+    EXPECT_EQ(umpMidi1WireBytes(noteOn1), 3u);
+    EXPECT_EQ(umpMidi1WireBytes(program1), 2u);
+    EXPECT_EQ(umpMidi1WireBytes(noteOn2), 3u);
+    EXPECT_EQ(umpMidi1WireBytes(rpn2), 12u);
+    EXPECT_EQ(umpMidi1WireBytes(perNotePitch), 0u);
+    EXPECT_EQ(umpMidi1WireBytes(clock), 1u);
+    EXPECT_EQ(umpMidi1WireBytes(jrTimestamp), 0u);
+
+    // F0 + 14 data bytes + F7 over three packets
+    auto message = sysex(14);
+    size_t total = 0;
+    for (size_t pos = 0; pos < message.size(); pos += 2) {
+        total += umpMidi1WireBytes(&message[pos]);
+    }
+    EXPECT_EQ(total, 16u);
+}
+
+TEST_F(OutputPacerTest, TestTokenBucketAndThroughput) {
+    auto config = OutputPacingConfig::parse("voice=1000/30,bulk=2000");
+    ASSERT_TRUE(config);
+    EXPECT_EQ(config->voice.effectiveBurst(), 30u);
+    EXPECT_EQ(config->bulk.effectiveBurst(), 40u);
+    EXPECT_TRUE(OutputPacingConfig::parse("din")->isEnabled());
+    EXPECT_FALSE(OutputPacingConfig::parse("off")->isEnabled());
+    EXPECT_FALSE(OutputPacingConfig::parse("voice=fast"));
+    EXPECT_FALSE(OutputPacingConfig::parse("voice=100/"));
+    EXPECT_FALSE(OutputPacingConfig::parse("notes=100"));
+
+    OutputPacer pacer;
+    pacer.configure(*config, 0);
+    // A burst of ten 3-byte notes fits, the eleventh waits for 3 ms worth of budget
+    for (int i = 0; i < 10; i++) {
+        ASSERT_EQ(pacer.delayNs(UmpLane::Realtime, 3, 0), 0);
+        pacer.consume(UmpLane::Realtime, 3, 0);
+    }
+    int64_t delay = pacer.delayNs(UmpLane::Realtime, 3, 0);
+    EXPECT_GT(delay, 2 * MS);
+    EXPECT_LE(delay, 3 * MS + 1);
+    EXPECT_EQ(pacer.delayNs(UmpLane::Realtime, 3, delay), 0);
+
+    // The bulk budget is separate: voice exhaustion does not hold SysEx back, and vice versa
+    EXPECT_EQ(pacer.delayNs(UmpLane::Bulk, 8, 0), 0);
+
+    // Sustained bulk traffic settles at the configured rate
+    int64_t now = 0;
+    while (now < 3000 * MS) {
+        now += pacer.delayNs(UmpLane::Bulk, 8, now);
+        pacer.consume(UmpLane::Bulk, 8, now);
+    }
+    EXPECT_NEAR(pacer.throughput(UmpLane::Bulk, now), 2000.0, 50.0);
+    EXPECT_EQ(pacer.throughput(UmpLane::Realtime, 0), 0.0);
+}
+
+TEST_F(OutputPacerTest, TestQueuePacesBulkAndLetsNotesThrough) {
+    std::mutex mutex;
+    std::vector<int64_t> noteTimes;
+    size_t sysexWords = 0;
+    UmpOutputQueue queue([&](const uint32_t* words, size_t wordCount) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t pos = 0; pos < wordCount; pos += (words[pos] >> 28) == 0x3 ? 2 : 1) {
+            if ((words[pos] >> 28) == 0x3) {
+                sysexWords += 2;
+            } else {
+                noteTimes.push_back(LatencyTracker::now());
+            }
+        }
+    });
+    OutputPacingConfig config;
+    config.bulk = {20000, 200};  // a property reply of 1 KB takes about 50 ms
+    queue.setPacing(config);
+    queue.start();
+
+    int64_t start = LatencyTracker::now();
+    for (int i = 0; i < 4; i++) {
+        queue.submit(UmpLane::Bulk, sysex(1000));
+    }
+    auto messageWords = sysex(1000).size();
+    // Keys pressed while the replies are being paced out
+    for (int i = 0; i < 5; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        uint32_t noteOn = 0x20903C64;
+        queue.submit(UmpLane::Realtime, &noteOn, 1);
+    }
+    while (queue.stats().bulkBatches < 4 && LatencyTracker::now() - start < 5000 * MS) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    int64_t elapsed = LatencyTracker::now() - start;
+    queue.stop();
+
+    auto stats = queue.stats();
+    EXPECT_EQ(sysexWords, 4 * messageWords);
+    EXPECT_EQ(noteTimes.size(), 5u);
+    // 4 * 1002 bytes at 20000 B/s, less the initial burst
+    EXPECT_GE(elapsed, 180 * MS);
+    EXPECT_GT(stats.pacedNs, 0u);
+    EXPECT_GT(stats.overtakes, 0u);
+    std::cout << "[TEST] Paced 4 KB of SysEx in " << elapsed / MS << " ms, " << stats.overtakes
+              << " notes sent between messages" << std::endl;
+}
+
+TEST_F(OutputPacerTest, TestNoteWakesWriterWaitingForBulkBudget) {
+    std::mutex mutex;
+    std::vector<int64_t> noteTimes;
+    UmpOutputQueue queue([&](const uint32_t* words, size_t) {
+        if ((words[0] >> 28) != 0x3) {
+            std::lock_guard<std::mutex> lock(mutex);
+            noteTimes.push_back(LatencyTracker::now());
+        }
+    });
+    OutputPacingConfig config;
+    config.bulk = {50, 8};  // one 8-byte SysEx fills the bucket; the next waits 160 ms to start
+    queue.setPacing(config);
+    queue.start();
+    queue.submit(UmpLane::Bulk, sysex(6));
+    queue.submit(UmpLane::Bulk, sysex(6));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    // Notes played while the writer waits for bulk budget
+    std::vector<int64_t> latencies;
+    for (int i = 0; i < 10; i++) {
+        uint32_t noteOn = 0x20903C64;
+        int64_t submitted = LatencyTracker::now();
+        queue.submit(UmpLane::Realtime, &noteOn, 1);
+        while (true) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (noteTimes.size() > latencies.size()) {
+                latencies.push_back(noteTimes.back() - submitted);
+                break;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(7));
+    }
+    EXPECT_EQ(queue.stats().bulkBatches, 1u);
+    queue.stop();
+
+    std::sort(latencies.begin(), latencies.end());
+    std::cout << "[TEST] Note latency during bulk stall: median " << latencies[latencies.size() / 2] / 1000
+              << " us, max " << latencies.back() / 1000 << " us" << std::endl;
+    // Sleeping out the bulk wait in 1 ms steps would put the median near 500 us
+    EXPECT_LT(latencies[latencies.size() / 2], MS / 5);
+}
+
+TEST_F(OutputPacerTest, TestStopDropsOrDrainsWaitingBulk) {
+    OutputPacingConfig config;
+    config.bulk = {10000, 200};  // each 300-byte message waits about 30 ms for budget
+
+    for (auto mode : {UmpOutputQueue::StopMode::DropWaitingBulk, UmpOutputQueue::StopMode::Drain}) {
+        std::mutex mutex;
+        size_t sysexWords = 0;
+        UmpOutputQueue queue([&](const uint32_t*, size_t wordCount) {
+            std::lock_guard<std::mutex> lock(mutex);
+            sysexWords += wordCount;
+        });
+        queue.setPacing(config);
+        queue.start();
+        for (int i = 0; i < 3; i++) {
+            queue.submit(UmpLane::Bulk, sysex(300));
+        }
+        queue.stop(mode);
+
+        auto stats = queue.stats();
+        size_t messageWords = sysex(300).size();
+        if (mode == UmpOutputQueue::StopMode::Drain) {
+            // A final flush (unsubscribes on shutdown) arrives in full
+            EXPECT_EQ(stats.droppedBulkBatches, 0u);
+            EXPECT_EQ(stats.bulkBatches, 3u);
+            EXPECT_EQ(sysexWords, 3 * messageWords);
+        } else {
+            EXPECT_GE(stats.droppedBulkBatches, 1u);
+            EXPECT_EQ(stats.bulkBatches + stats.droppedBulkBatches, 3u);
+            EXPECT_EQ(sysexWords, stats.bulkBatches * messageWords);
+        }
+        std::cout << "[TEST] Stop mode " << static_cast<int>(mode) << ": " << stats.bulkBatches << " sent, "
+                  << stats.droppedBulkBatches << " dropped" << std::endl;
+    }
+}
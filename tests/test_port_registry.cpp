@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include "port_registry.h"
+
+class PortRegistryTest : public ::testing::Test {
+protected:
+    static libremidi::port_information port(const std::string& name, uint64_t handle, const std::string& serial = "") {
+        libremidi::port_information info;
+        info.client = 1;
+        info.port = handle;
+        info.port_name = name;
+        info.display_name = name + " (display)";
+        info.serial = serial;
+        return info;
+    }
+
+    PortRegistry registry;
+};
+
+TEST_F(PortRegistryTest, TestIdsDoNotDependOnListPosition) {
+    auto synth = port("Synth", 10);
+    auto drums = port("Drums", 11);
+    std::string synthId = registry.add(PortDirection::Input, synth)->id;
+    registry.add(PortDirection::Input, drums);
+
+    // A port appearing in front of the selected one must not change what its ID opens
+    auto deltas = registry.sync(PortDirection::Input, {port("Loopback", 3), synth, drums});
+    ASSERT_EQ(deltas.size(), 1u);
+    EXPECT_EQ(deltas[0].kind, PortDelta::Kind::Added);
+    EXPECT_EQ(deltas[0].name, "Loopback");
+    auto found = registry.find(PortDirection::Input, synthId);
+    ASSERT_TRUE(found);
+    EXPECT_EQ(found->port_name, "Synth");
+
+    // Same port unplugged and plugged back, even under a new backend handle, keeps its ID
+    auto removed = registry.remove(PortDirection::Input, synth);
+    ASSERT_TRUE(removed);
+    EXPECT_EQ(removed->id, synthId);
+    EXPECT_FALSE(registry.find(PortDirection::Input, synthId));
+    EXPECT_EQ(registry.add(PortDirection::Input, port("Synth", 42))->id, synthId);
+    EXPECT_EQ(registry.find(PortDirection::Input, synthId)->port, 42u);
+
+    // Identity covers more than the port name
+    EXPECT_NE(PortRegistry::stableId(port("Synth", 10, "A1")), PortRegistry::stableId(port("Synth", 10, "B2")));
+    EXPECT_EQ(PortRegistry::stableId(port("Synth", 10, "A1")), PortRegistry::stableId(port("Synth", 99, "A1")));
+}
+
+TEST_F(PortRegistryTest, TestDuplicatesAndRepeatedEvents) {
+    auto first = port("USB MIDI", 1);
+    auto second = port("USB MIDI", 2);
+    auto firstDelta = registry.add(PortDirection::Output, first);
+    auto secondDelta = registry.add(PortDirection::Output, second);
+    ASSERT_TRUE(firstDelta && secondDelta);
+    EXPECT_EQ(secondDelta->id, firstDelta->id + "-2");
+
+    // Notified twice for the same port: reported once
+    EXPECT_FALSE(registry.add(PortDirection::Output, first));
+    // Inputs and outputs are separate lists
+    EXPECT_TRUE(registry.list(PortDirection::Input).empty());
+
+    // Unplugging the first unit removes exactly that one
+    auto removed = registry.remove(PortDirection::Output, first);
+    ASSERT_TRUE(removed);
+    EXPECT_EQ(removed->id, firstDelta->id);
+    auto ports = registry.list(PortDirection::Output);
+    ASSERT_EQ(ports.size(), 1u);
+    EXPECT_EQ(ports[0].first, secondDelta->id);
+    EXPECT_FALSE(registry.remove(PortDirection::Output, port("Never Seen", 5)));
+
+    // Full listing without the second unit reports its removal
+    auto deltas = registry.sync(PortDirection::Output, {});
+    ASSERT_EQ(deltas.size(), 1u);
+    EXPECT_EQ(deltas[0].kind, PortDelta::Kind::Removed);
+    EXPECT_EQ(deltas[0].id, secondDelta->id);
+    EXPECT_TRUE(registry.list(PortDirection::Output).empty());
+}
+
+TEST_F(PortRegistryTest, TestHotplugWhileEnumerating) {
+    constexpr int cycles = 20000;
+    registry.add(PortDirection::Input, port("Keyboard", 1));
+    std::string keyboardId = registry.list(PortDirection::Input)[0].first;
+
+    std::atomic<bool> stop{false};
+    std::thread hotplug([this, &stop]() {
+        auto device = port("Pad", 7);
+        while (!stop.load()) {
+            registry.add(PortDirection::Input, device);
+            registry.remove(PortDirection::Input, device);
+        }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < cycles; i++) {
+        auto found = registry.find(PortDirection::Input, keyboardId);
+        ASSERT_TRUE(found);
+        ASSERT_EQ(found->port_name, "Keyboard");
+        ASSERT_GE(registry.list(PortDirection::Input).size(), 1u);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stop.store(true);
+    hotplug.join();
+
+    std::cout << "[TEST] " << cycles << " lookups during hotplug in " << ms << " ms" << std::endl;
+}
@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include "preset_store.h"
+
+class PresetStoreTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        directory = (std::filesystem::temp_directory_path() /
+                     ("preset_store_test_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) + "_" +
+                      ::testing::UnitTest::GetInstance()->current_test_info()->name())).string();
+        std::filesystem::remove_all(directory);
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        std::filesystem::remove_all(directory, ec);
+    }
+
+    static ControlSnapshot makeSnapshot(size_t count, uint32_t seed) {
+        ControlSnapshot snapshot;
+        for (size_t i = 0; i < count; i++) {
+            ControlValue control;
+            control.kind = i < 128 ? ControlKind::ControlChange : ControlKind::NRPN;
+            control.channel = static_cast<uint8_t>((i / 128) % 16);
+            control.index = static_cast<uint8_t>(i % 128);
+            control.subIndex = static_cast<uint8_t>(i % 7);
+            control.value = (i % 4 == 0) ? seed : static_cast<uint32_t>(i);
+            snapshot.push_back(control);
+        }
+        return snapshot;
+    }
+
+    std::string directory;
+};
+
+TEST_F(PresetStoreTest, TestSaveAndReload) {
+    auto device = PresetStore::deviceKey("Acme Synths", "Model/1");
+    EXPECT_EQ(device, "Acme_Synths_Model_1");
+
+    {
+        PresetStore store(directory);
+        ASSERT_TRUE(store.selectDevice(device));
+        EXPECT_TRUE(store.presetNames().empty());
+        ASSERT_TRUE(store.save("Init", makeSnapshot(300, 1001)));
+        ASSERT_TRUE(store.save("Pad", makeSnapshot(300, 1002)));
+        ASSERT_TRUE(store.save("Init", makeSnapshot(300, 1003)));  // replaces
+    }
+
+    PresetStore store(directory);
+    ASSERT_TRUE(store.selectDevice(device));
+    auto names = store.presetNames();
+    ASSERT_EQ(names.size(), 2u);
+    EXPECT_EQ(names[0], "Init");
+    EXPECT_EQ(names[1], "Pad");
+
+    auto init = store.presetSnapshot("Init");
+    ASSERT_TRUE(init.has_value());
+    ASSERT_EQ(init->size(), 300u);
+    uint32_t seeded = 0;
+    for (const auto& control : *init) {
+        if (control.value == 1003) seeded++;
+    }
+    EXPECT_EQ(seeded, 75u);
+
+    // Banks are per device
+    ASSERT_TRUE(store.selectDevice(PresetStore::deviceKey("Acme Synths", "Other")));
+    EXPECT_TRUE(store.presetNames().empty());
+}
+
+TEST_F(PresetStoreTest, TestSwitchSendsOnlyChangedControls) {
+    PresetStore store(directory);
+    ASSERT_TRUE(store.selectDevice("device"));
+    ASSERT_TRUE(store.save("A", makeSnapshot(1000, 100)));
+
+    auto current = makeSnapshot(1000, 200);
+    auto changes = store.switchTo("A", current);
+    ASSERT_TRUE(changes.has_value());
+    EXPECT_EQ(changes->size(), 250u);
+    for (const auto& control : *changes) {
+        EXPECT_EQ(control.value, 100u);
+        EXPECT_EQ(control.index % 4, 0);
+    }
+
+    auto same = store.switchTo("A", makeSnapshot(1000, 100));
+    ASSERT_TRUE(same.has_value());
+    EXPECT_TRUE(same->empty());
+    EXPECT_FALSE(store.switchTo("missing", current).has_value());
+}
+
+TEST_F(PresetStoreTest, TestSwitchingBetweenManyPresets) {
+    constexpr int presetCount = 300;
+    constexpr size_t controls = 1000;
+
+    std::vector<Preset> presets;
+    for (int i = 0; i < presetCount; i++) {
+        presets.push_back(Preset::fromSnapshot("Preset " + std::to_string(i), makeSnapshot(controls, i)));
+    }
+    std::filesystem::create_directories(directory);
+    ASSERT_TRUE(writePresetBank(directory + "/device.umppresets", "device", presets));
+
+    PresetStore store(directory);
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_TRUE(store.selectDevice("device"));
+    auto current = makeSnapshot(controls, 0);
+    size_t sent = 0;
+    for (int i = 1; i < presetCount; i++) {
+        auto changes = store.switchTo("Preset " + std::to_string(i), current);
+        ASSERT_TRUE(changes.has_value());
+        sent += changes->size();
+        current = makeSnapshot(controls, i);
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    EXPECT_EQ(sent, static_cast<size_t>(presetCount - 1) * controls / 4);
+    std::cout << "[TEST] " << (presetCount - 1) << " preset switches over " << controls << " controls in " << ms
+              << " ms (" << sent << " controls to send)" << std::endl;
+}
+
+TEST_F(PresetStoreTest, TestRejectsForeignAndTruncatedFiles) {
+    std::filesystem::create_directories(directory);
+    std::string path = directory + "/bank.umppresets";
+    ASSERT_TRUE(writePresetBank(path, "device", {Preset::fromSnapshot("A", makeSnapshot(10, 1))}));
+
+    PresetBankReader reader;
+    ASSERT_TRUE(reader.open(path));
+    EXPECT_EQ(reader.deviceId(), "device");
+    EXPECT_EQ(reader.presetEntries(0).size(), 10u);
+    reader.close();
+
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 20);
+    EXPECT_FALSE(reader.open(path));
+
+    FILE* f = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(f, nullptr);
+    std::fputs("not a preset bank, but long enough to have a header .......................................", f);
+    std::fclose(f);
+    EXPECT_FALSE(reader.open(path));
+}
+
+TEST_F(PresetStoreTest, TestDuplicateControlsKeepLastValue) {
+    ControlSnapshot snapshot = {
+        {ControlKind::ControlChange, 0, 7, 0, 10},
+        {ControlKind::ControlChange, 0, 1, 0, 20},
+        {ControlKind::ControlChange, 0, 7, 0, 30},
+    };
+    auto preset = Preset::fromSnapshot("dup", snapshot);
+    ASSERT_EQ(preset.entries.size(), 2u);
+    EXPECT_EQ(controlValueFromPresetEntry(preset.entries[1]).index, 7);
+    EXPECT_EQ(preset.entries[1].value, 30u);
+}
@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "property_model.h"
+
+using namespace midicci::commonproperties;
+
+class PropertyModelTest : public ::testing::Test {
+protected:
+    static std::vector<uint8_t> controlList(size_t count, size_t changedRow = SIZE_MAX, uint32_t changedDefault = 0) {
+        std::string json = "[";
+        for (size_t i = 0; i < count; i++) {
+            if (i > 0) json += ",";
+            uint32_t value = (i == changedRow) ? changedDefault : static_cast<uint32_t>(i % 128);
+            json += R"({"title": "Control )" + std::to_string(i) + R"(", "ctrlType": "cc", "ctrlIndex": [)" +
+                    std::to_string(i % 128) + R"(], "channel": 1, "default": )" + std::to_string(value) + "}";
+        }
+        json += "]";
+        return std::vector<uint8_t>(json.begin(), json.end());
+    }
+
+    static std::vector<uint8_t> programList(const std::vector<std::string>& titles) {
+        std::string json = "[";
+        for (size_t i = 0; i < titles.size(); i++) {
+            if (i > 0) json += ",";
+            json += R"({"title": ")" + titles[i] + R"(", "bankPC": [0, 0, )" + std::to_string(i) + "]}";
+        }
+        json += "]";
+        return std::vector<uint8_t>(json.begin(), json.end());
+    }
+
+    PropertyModel model;
+};
+
+TEST_F(PropertyModelTest, TestFirstLoadResetsAndIdenticalBodyIsIgnored) {
+    auto update = model.update(StandardPropertyNames::ALL_CTRL_LIST, controlList(10));
+    EXPECT_TRUE(update.reset);
+    ASSERT_TRUE(model.controls(StandardPropertyNames::ALL_CTRL_LIST).has_value());
+    EXPECT_EQ(model.controls(StandardPropertyNames::ALL_CTRL_LIST)->size(), 10u);
+    EXPECT_FALSE(model.programs().has_value());
+
+    update = model.update(StandardPropertyNames::ALL_CTRL_LIST, controlList(10));
+    EXPECT_TRUE(update.empty());
+}
+
+TEST_F(PropertyModelTest, TestOnlyChangedRowsAreReported) {
+    model.update(StandardPropertyNames::ALL_CTRL_LIST, controlList(200));
+
+    auto update = model.update(StandardPropertyNames::ALL_CTRL_LIST, controlList(200, 42, 99));
+    EXPECT_FALSE(update.reset);
+    ASSERT_EQ(update.rows.size(), 1u);
+    EXPECT_EQ(update.rows[0], 42u);
+    EXPECT_EQ((*model.controls(StandardPropertyNames::ALL_CTRL_LIST))[42].defaultValue, 99u);
+
+    // A different row count cannot be matched row by row
+    update = model.update(StandardPropertyNames::ALL_CTRL_LIST, controlList(201));
+    EXPECT_TRUE(update.reset);
+    EXPECT_TRUE(update.rows.empty());
+}
+
+TEST_F(PropertyModelTest, TestProgramListAndUnrelatedResources) {
+    model.update(StandardPropertyNames::PROGRAM_LIST, programList({"Piano", "Strings", "Pad"}));
+    auto update = model.update(StandardPropertyNames::PROGRAM_LIST, programList({"Piano", "Choir", "Pad"}));
+    ASSERT_EQ(update.rows.size(), 1u);
+    EXPECT_EQ(update.rows[0], 1u);
+    EXPECT_EQ((*model.programs())[1].title, "Choir");
+    EXPECT_FALSE(model.controls(StandardPropertyNames::PROGRAM_LIST).has_value());
+
+    // Lists are cached per resource
+    EXPECT_TRUE(model.update(StandardPropertyNames::CH_CTRL_LIST, controlList(3)).reset);
+    EXPECT_FALSE(model.has(StandardPropertyNames::ALL_CTRL_LIST));
+
+    std::string deviceInfo = R"({"manufacturer": "Acme"})";
+    EXPECT_TRUE(model.update("DeviceInfo", std::vector<uint8_t>(deviceInfo.begin(), deviceInfo.end())).empty());
+    EXPECT_FALSE(model.has("DeviceInfo"));
+}
+
+TEST_F(PropertyModelTest, TestSubscriptionUpdatesOnLargeList) {
+    constexpr size_t controls = 2000;
+    constexpr int updates = 100;
+    model.update(StandardPropertyNames::ALL_CTRL_LIST, controlList(controls));
+
+    size_t changedRows = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < updates; i++) {
+        auto update = model.update(StandardPropertyNames::ALL_CTRL_LIST, controlList(controls, i * 17, 1000 + i));
+        ASSERT_FALSE(update.reset);
+        changedRows += update.rows.size();
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    // Each update changes its own row and restores the row the previous one changed
+    EXPECT_EQ(changedRows, static_cast<size_t>(updates * 2 - 1));
+    std::cout << "[TEST] " << updates << " subscription updates of a " << controls << " control list in " << ms
+              << " ms, " << changedRows << " rows signalled" << std::endl;
+}
@@ -0,0 +1,69 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include "qwerty_layout.h"
+
+class QwertyLayoutTest : public ::testing::Test {
+protected:
+    QwertyLayout layout;
+};
+
+TEST_F(QwertyLayoutTest, TestDefaultLayoutIsChromaticFromMiddleC) {
+    EXPECT_EQ(layout.press('A'), 60);
+    EXPECT_EQ(layout.press('W'), 61);
+    EXPECT_EQ(layout.press('K'), 72);
+    EXPECT_EQ(layout.press(';'), 76);
+    EXPECT_EQ(layout.heldCount(), 4);
+
+    // Lower-case characters and Qt key codes (upper-case) are the same key
+    EXPECT_EQ(layout.release('a'), 60);
+    EXPECT_FALSE(layout.press('Q').has_value());
+    EXPECT_FALSE(layout.isMapped(0x01000020));  // Qt::Key_Shift
+}
+
+TEST_F(QwertyLayoutTest, TestHeldKeyDoesNotRetrigger) {
+    EXPECT_EQ(layout.press('S'), 62);
+    EXPECT_FALSE(layout.press('S').has_value());
+    EXPECT_EQ(layout.release('S'), 62);
+    EXPECT_FALSE(layout.release('S').has_value());
+    EXPECT_EQ(layout.heldCount(), 0);
+}
+
+TEST_F(QwertyLayoutTest, TestReleaseAfterOctaveShiftStopsOriginalNote) {
+    EXPECT_EQ(layout.press('A'), 60);
+    layout.shiftOctave(1);
+    EXPECT_EQ(layout.baseNote(), 72);
+    EXPECT_EQ(layout.press('D'), 76);
+    EXPECT_EQ(layout.release('A'), 60);
+
+    auto remaining = layout.releaseAll();
+    ASSERT_EQ(remaining.size(), 1u);
+    EXPECT_EQ(remaining[0], 76);
+    EXPECT_EQ(layout.heldCount(), 0);
+}
+
+TEST_F(QwertyLayoutTest, TestOctaveShiftStaysInRange) {
+    layout.shiftOctave(10);
+    EXPECT_LE(layout.baseNote(), 127);
+    EXPECT_EQ(layout.baseNote() % 12, 0);
+    // Keys above note 127 are silent rather than wrapping
+    EXPECT_FALSE(layout.press('K').has_value());
+
+    layout.shiftOctave(-20);
+    EXPECT_EQ(layout.baseNote(), 0);
+    EXPECT_EQ(layout.press('A'), 0);
+}
+
+TEST_F(QwertyLayoutTest, TestCustomLayout) {
+    ASSERT_TRUE(layout.setLayout("qwertyui"));
+    EXPECT_EQ(layout.press('Q'), 60);
+    EXPECT_EQ(layout.press('I'), 67);
+    EXPECT_FALSE(layout.isMapped('A'));
+
+    // Rejected layouts leave the current one in place
+    EXPECT_FALSE(layout.setLayout("abca"));
+    EXPECT_FALSE(layout.setLayout("azs"));
+    EXPECT_FALSE(layout.setLayout("a s"));
+    EXPECT_EQ(layout.layout(), "qwertyui");
+
+    std::cout << "[TEST] Custom layout maps " << layout.layout().size() << " keys" << std::endl;
+}
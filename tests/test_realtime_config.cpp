@@ -0,0 +1,71 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "realtime_config.h"
+
+class RealtimeConfigTest : public ::testing::Test {
+protected:
+    RealtimeSetup setup;
+};
+
+TEST_F(RealtimeConfigTest, TestParseSpec) {
+    auto config = RealtimeConfig::parse("fifo:80@2,3");
+    ASSERT_TRUE(config);
+    EXPECT_EQ(config->policy, RealtimePolicy::Fifo);
+    EXPECT_EQ(config->priority, 80);
+    EXPECT_EQ(config->cpus, (std::vector<int>{2, 3}));
+
+    config = RealtimeConfig::parse("rr");
+    ASSERT_TRUE(config);
+    EXPECT_EQ(config->policy, RealtimePolicy::RoundRobin);
+    EXPECT_EQ(config->priority, 70);
+    EXPECT_TRUE(config->cpus.empty());
+
+    EXPECT_FALSE(RealtimeConfig::parse("idle"));
+    EXPECT_FALSE(RealtimeConfig::parse("fifo:0"));
+    EXPECT_FALSE(RealtimeConfig::parse("fifo:100"));
+    EXPECT_FALSE(RealtimeConfig::parse("fifo:80x"));
+    EXPECT_FALSE(RealtimeConfig::parse("fifo@1,a"));
+    EXPECT_FALSE(RealtimeConfig::parse("rr@-1"));
+}
+
+TEST_F(RealtimeConfigTest, TestThreadsReportWhatTookEffect) {
+    // Off until applied: I/O threads are left alone
+    EXPECT_FALSE(setup.isEnabled());
+    setup.enterIoThread("ignored");
+    EXPECT_TRUE(setup.status().threads.empty());
+
+    RealtimeConfig config;
+    config.lockMemory = false;  // keep the test process pageable
+    config.heapReserveBytes = 1 << 20;
+    config.cpus = {0};
+    auto status = setup.apply(config);
+    EXPECT_TRUE(status.enabled);
+    EXPECT_FALSE(status.memoryLocked);
+    EXPECT_GE(status.prefaultedBytes, 1u << 20);
+
+    std::vector<uint8_t> ring(256 * 1024);
+    setup.prefault(ring.data(), ring.size());
+
+    // Without privileges the thread keeps normal scheduling and says why
+    std::thread io([this]() {
+        setup.enterIoThread("midi out");
+        setup.enterIoThread("midi out");
+    });
+    io.join();
+
+    status = setup.status();
+    ASSERT_EQ(status.threads.size(), 1u);
+    const auto& thread = status.threads[0];
+    EXPECT_EQ(thread.name, "midi out");
+    EXPECT_TRUE(thread.scheduled || !thread.problem.empty());
+    EXPECT_TRUE(thread.pinned || !thread.problem.empty());
+    EXPECT_GE(status.prefaultedBytes, (1u << 20) + ring.size());
+
+    std::ostringstream out;
+    setup.report(out);
+    EXPECT_NE(out.str().find("midi out"), std::string::npos);
+    std::cout << "[TEST] " << out.str();
+}
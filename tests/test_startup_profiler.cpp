@@ -0,0 +1,51 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include "latency_tracker.h"
+#include "startup_profiler.h"
+
+class StartupProfilerTest : public ::testing::Test {
+protected:
+    static constexpr int64_t MS = 1'000'000;
+
+    StartupProfiler profiler{1000 * MS};
+};
+
+TEST_F(StartupProfilerTest, TestMilestonesAreOrderedAndMarkedOnce) {
+    profiler.expect({"first paint", "devices listed", "MIDI-CI ready"});
+    EXPECT_TRUE(profiler.mark("first paint", 1120 * MS));
+    // Marked from the startup thread, earlier than the paint
+    EXPECT_TRUE(profiler.mark("MIDI-CI ready", 1090 * MS));
+    EXPECT_FALSE(profiler.mark("first paint", 1500 * MS));
+    EXPECT_FALSE(profiler.isComplete());
+    EXPECT_TRUE(profiler.mark("devices listed", 1130 * MS));
+    EXPECT_TRUE(profiler.isComplete());
+
+    auto phases = profiler.phases();
+    ASSERT_EQ(phases.size(), 3u);
+    EXPECT_EQ(phases[0].name, "MIDI-CI ready");
+    EXPECT_EQ(phases[0].sinceStartNs, 90 * MS);
+    EXPECT_EQ(phases[1].name, "first paint");
+    EXPECT_EQ(phases[1].sinceStartNs, 120 * MS);
+    EXPECT_EQ(phases[2].sinceStartNs, 130 * MS);
+
+    std::ostringstream out;
+    profiler.report(out);
+    EXPECT_NE(out.str().find("first paint"), std::string::npos);
+    EXPECT_NE(out.str().find("120.0 ms  (+30.0 ms)"), std::string::npos);
+}
+
+TEST_F(StartupProfilerTest, TestProcessStartPrecedesNow) {
+    int64_t start = StartupProfiler::processStartNs();
+    int64_t now = LatencyTracker::now();
+    EXPECT_GT(start, 0);
+    EXPECT_LE(start, now);
+    // The test binary started moments ago, not before boot
+    EXPECT_LT(now - start, 600'000 * MS);
+    std::cout << "[TEST] Process started " << (now - start) / 1e6 << " ms before this test" << std::endl;
+
+    StartupProfiler fromProcessStart;
+    EXPECT_TRUE(fromProcessStart.mark("test"));
+    EXPECT_GE(fromProcessStart.phases()[0].sinceStartNs, 0);
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <set>
+#include <sstream>
+#include <thread>
+#include "trace_recorder.h"
+
+class TraceRecorderTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        recorder.setEnabled(true);
+    }
+
+    TraceRecorder recorder;
+};
+
+TEST_F(TraceRecorderTest, TestSpansAreRecordedOnlyWhenEnabled) {
+    {
+        TraceSpan span("outer", "ui", recorder);
+        span.setArg("controls", 42);
+        TraceSpan inner("inner", "ui", recorder);
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    recorder.setEnabled(false);
+    {
+        TraceSpan ignored("ignored", "ui", recorder);
+    }
+
+    auto events = recorder.events();
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_STREQ(events[0].name, "outer");
+    EXPECT_STREQ(events[1].name, "inner");
+    EXPECT_GE(events[0].durationNs, events[1].durationNs);
+    EXPECT_GE(events[1].durationNs, 1'000'000);
+    EXPECT_STREQ(events[0].argName, "controls");
+    EXPECT_EQ(events[0].argValue, 42);
+    EXPECT_EQ(events[0].threadId, events[1].threadId);
+}
+
+TEST_F(TraceRecorderTest, TestChromeTraceJson) {
+    recorder.setThreadName("ui \"main\"");
+    {
+        TraceSpan span("setControls", "ui", recorder);
+    }
+    std::ostringstream out;
+    recorder.writeChromeTrace(out);
+    std::string json = out.str();
+
+    EXPECT_EQ(json.rfind("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", 0), 0u);
+    EXPECT_NE(json.find("\"ph\":\"M\""), std::string::npos);
+    EXPECT_NE(json.find("ui \\\"main\\\""), std::string::npos);
+    EXPECT_NE(json.find("\"name\":\"setControls\",\"cat\":\"ui\",\"ph\":\"X\""), std::string::npos);
+    EXPECT_EQ(json.substr(json.size() - 4), "\n]}\n");
+}
+
+TEST_F(TraceRecorderTest, TestRingKeepsNewestEventsAndClear) {
+    TraceRecorder small;
+    small.setEventsPerThread(8);
+    small.setEnabled(true);
+    for (int i = 0; i < 20; i++) {
+        TraceSpan span("tick", "test", small);
+        span.setArg("i", i);
+    }
+    auto events = small.events();
+    // The slot being written could be torn, so export keeps capacity - 1
+    ASSERT_EQ(events.size(), 7u);
+    EXPECT_EQ(events.front().argValue, 13);
+    EXPECT_EQ(events.back().argValue, 19);
+
+    small.clear();
+    EXPECT_TRUE(small.events().empty());
+    {
+        TraceSpan span("after", "test", small);
+    }
+    EXPECT_EQ(small.events().size(), 1u);
+}
+
+TEST_F(TraceRecorderTest, TestThreadsRecordIndependentlyAndRingsAreReused) {
+    constexpr int threads = 4;
+    constexpr int spansPerThread = 10000;
+
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < 3; round++) {
+        std::vector<std::thread> workers;
+        std::atomic<int> finished{0};
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([this, &finished]() {
+                for (int i = 0; i < spansPerThread; i++) {
+                    TraceSpan span("work", "test", recorder);
+                }
+                // Keep every thread of the round alive until all have their ring
+                finished.fetch_add(1);
+                while (finished.load() < threads) {
+                    std::this_thread::yield();
+                }
+            });
+        }
+        for (auto& worker : workers) worker.join();
+    }
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    auto events = recorder.events();
+    std::set<uint32_t> threadIds;
+    for (const auto& event : events) threadIds.insert(event.threadId);
+    // Only 4 threads ran at a time, so each of the 4 rings was reused by one thread per round and
+    // now holds all of round 3 and the newest spans of round 2
+    EXPECT_EQ(events.size(), static_cast<size_t>(threads) * (TraceRecorder::DEFAULT_EVENTS_PER_THREAD - 1));
+    EXPECT_EQ(threadIds.size(), static_cast<size_t>(threads) * 2);
+    std::cout << "[TEST] " << threads * spansPerThread * 3 << " spans recorded from " << threads * 3 << " threads in "
+              << ms << " ms" << std::endl;
+}
+
+TEST_F(TraceRecorderTest, TestExportWhileRecording) {
+    std::atomic<bool> stop{false};
+    std::thread writer([this, &stop]() {
+        int64_t i = 0;
+        while (!stop.load()) {
+            TraceSpan span("busy", "test", recorder);
+            span.setArg("i", i++);
+        }
+    });
+    for (int i = 0; i < 50; i++) {
+        for (const auto& event : recorder.events()) {
+            ASSERT_STREQ(event.name, "busy");
+        }
+    }
+    stop.store(true);
+    writer.join();
+}
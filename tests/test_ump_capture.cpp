@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <set>
+#include <thread>
+#include <vector>
+#include "ump_capture.h"
+
+class UmpCaptureTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path = (std::filesystem::temp_directory_path() /
+                ("ump_capture_test_" + std::to_string(::testing::UnitTest::GetInstance()->random_seed()) + "_" +
+                 ::testing::UnitTest::GetInstance()->current_test_info()->name() + ".umpcap")).string();
+    }
+
+    void TearDown() override {
+        std::error_code ec;
+        std::filesystem::remove(path, ec);
+    }
+
+    std::string path;
+};
+
+TEST_F(UmpCaptureTest, TestRoundTrip) {
+    {
+        UmpCaptureRecorder recorder;
+        ASSERT_TRUE(recorder.open(path, 16, 0x1234567));
+
+        uint32_t noteOn[2] = {0x40903C00, 0xFFFF0000};
+        uint32_t sysex[2] = {0x30167E7F, 0x0D700200};
+        recorder.append(UmpCaptureDirection::Outgoing, noteOn, 2);
+        recorder.append(UmpCaptureDirection::Incoming, sysex, 2);
+        EXPECT_EQ(recorder.recordCount(), 2u);
+    }
+
+    UmpCaptureReader reader;
+    ASSERT_TRUE(reader.open(path));
+    EXPECT_EQ(reader.header().local_muid, 0x1234567u);
+
+    auto entries = reader.readAll();
+    ASSERT_EQ(entries.size(), 2u);
+    EXPECT_EQ(entries[0].direction, UmpCaptureDirection::Outgoing);
+    EXPECT_EQ(entries[0].word_count, 2);
+    EXPECT_EQ(entries[0].words[0], 0x40903C00u);
+    EXPECT_EQ(entries[1].direction, UmpCaptureDirection::Incoming);
+    EXPECT_EQ(entries[1].words[1], 0x0D700200u);
+    EXPECT_LE(entries[0].timestamp_ns, entries[1].timestamp_ns);
+}
+
+TEST_F(UmpCaptureTest, TestRingKeepsNewestRecords) {
+    UmpCaptureRecorder recorder;
+    ASSERT_TRUE(recorder.open(path, 8));
+    for (uint32_t i = 0; i < 20; i++) {
+        uint32_t word = 0x20900000 | i;
+        recorder.append(UmpCaptureDirection::Outgoing, &word, 1);
+    }
+
+    UmpCaptureReader reader;
+    ASSERT_TRUE(reader.open(path));
+    auto entries = reader.readAll();
+    ASSERT_EQ(entries.size(), 8u);
+    EXPECT_EQ(entries.front().index, 12u);
+    EXPECT_EQ(entries.front().words[0] & 0xFF, 12u);
+    EXPECT_EQ(entries.back().words[0] & 0xFF, 19u);
+}
+
+TEST_F(UmpCaptureTest, TestConcurrentAppends) {
+    UmpCaptureRecorder recorder;
+    ASSERT_TRUE(recorder.open(path, 1 << 16));
+
+    constexpr uint32_t perThread = 20000;
+    auto writer = [&recorder](UmpCaptureDirection direction, uint32_t tag) {
+        for (uint32_t i = 0; i < perThread; i++) {
+            uint32_t words[2] = {tag | i, i};
+            recorder.append(direction, words, 2);
+        }
+    };
+    std::thread input(writer, UmpCaptureDirection::Incoming, 0x40000000u);
+    std::thread output(writer, UmpCaptureDirection::Outgoing, 0x48000000u);
+    input.join();
+    output.join();
+
+    UmpCaptureReader reader;
+    ASSERT_TRUE(reader.open(path));
+    auto entries = reader.readAll();
+    ASSERT_EQ(entries.size(), 2 * perThread);
+
+    std::set<uint32_t> seen;
+    for (const auto& entry : entries) {
+        EXPECT_EQ(entry.words[0] & 0xFFFFF, entry.words[1]);  // never torn
+        seen.insert(entry.words[0]);
+    }
+    EXPECT_EQ(seen.size(), 2 * perThread);
+}
+
+TEST_F(UmpCaptureTest, TestRejectsForeignFile) {
+    FILE* f = std::fopen(path.c_str(), "wb");
+    ASSERT_NE(f, nullptr);
+    std::fputs("this is definitely not a capture file, but it is long enough to have a header ...........................................", f);
+    std::fclose(f);
+
+    UmpCaptureReader reader;
+    EXPECT_FALSE(reader.open(path));
+}
@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "ump_endpoint.h"
+
+class UmpEndpointTest : public ::testing::Test {
+protected:
+    static std::vector<uint32_t> stream(uint16_t status, uint32_t word0Low, uint32_t word1 = 0, uint32_t word2 = 0,
+                                        uint32_t word3 = 0, uint8_t format = 0) {
+        return {0xF0000000u | (static_cast<uint32_t>(format) << 26) | (static_cast<uint32_t>(status) << 16) | word0Low,
+                word1, word2, word3};
+    }
+
+    // Text packets as an endpoint sends them: `offset` bytes of header in the message, the rest text
+    static std::vector<std::vector<uint32_t>> text(uint16_t status, uint32_t header, size_t offset, const std::string& value) {
+        size_t perPacket = 16 - offset;
+        size_t packets = std::max<size_t>(1, (value.size() + perPacket - 1) / perPacket);
+        std::vector<std::vector<uint32_t>> result;
+        for (size_t p = 0; p < packets; p++) {
+            uint8_t format = packets == 1 ? 0 : p == 0 ? 1 : p == packets - 1 ? 3 : 2;
+            uint8_t bytes[16] = {};
+            for (size_t i = 0; i < perPacket && p * perPacket + i < value.size(); i++) {
+                bytes[offset + i] = static_cast<uint8_t>(value[p * perPacket + i]);
+            }
+            std::vector<uint32_t> words(4);
+            for (size_t i = 0; i < 16; i++) {
+                words[i / 4] |= static_cast<uint32_t>(bytes[i]) << (24 - 8 * (i % 4));
+            }
+            words[0] |= 0xF0000000u | (static_cast<uint32_t>(format) << 26) | (static_cast<uint32_t>(status) << 16) | header;
+            result.push_back(words);
+        }
+        return result;
+    }
+
+    bool feed(const std::vector<uint32_t>& ump) { return discovery.handle(ump.data(), requests); }
+
+    UmpEndpointDiscovery discovery;
+    std::vector<uint32_t> requests;
+};
+
+TEST_F(UmpEndpointTest, TestDiscoversEndpointAndFunctionBlocks) {
+    discovery.start(requests);
+    ASSERT_EQ(requests.size(), 4u);
+    EXPECT_EQ(requests[0], 0xF0000101u);  // UMP 1.1
+    EXPECT_EQ(requests[1], 0x1Fu);        // everything about the endpoint
+    requests.clear();
+    EXPECT_EQ(discovery.receivingGroups(), UmpEndpointDiscovery::ALL_GROUPS);
+    EXPECT_EQ(discovery.midiCIGroups(), UmpEndpointDiscovery::ALL_GROUPS);
+
+    // Endpoint Info: UMP 1.1, two static blocks, MIDI 1.0 and 2.0, JR both ways
+    EXPECT_TRUE(feed(stream(0x001, 0x0101, 0x82000303)));
+    ASSERT_EQ(requests.size(), 4u);
+    EXPECT_EQ(requests[0], 0xF010FF03u);  // every function block, info and name
+    requests.clear();
+
+    EXPECT_TRUE(feed(stream(0x002, 0, 0x00000041, 0x01000200, 0x01020304)));
+    for (const auto& packet : text(0x003, 0, 2, "Stage Piano MkII")) {
+        feed(packet);
+    }
+    for (const auto& packet : text(0x012, 1 << 8, 3, "Upper manual")) {
+        feed(packet);
+    }
+
+    // The endpoint currently runs MIDI 1.0 with JR Timestamps on: we want MIDI 2.0 and no timestamps
+    EXPECT_TRUE(feed(stream(0x006, 0x0103)));
+    ASSERT_EQ(requests.size(), 4u);
+    EXPECT_EQ(requests[0], 0xF0050200u);
+    requests.clear();
+    EXPECT_TRUE(feed(stream(0x006, 0x0200)));
+    EXPECT_TRUE(requests.empty());  // settled: asked only once
+
+    // Block 0: inactive, groups 1-2; block 1: active, receives, groups 3-4, MIDI-CI 2
+    EXPECT_TRUE(feed(stream(0x011, 0x0001, 0x00020200)));
+    EXPECT_EQ(discovery.receivingGroups(), UmpEndpointDiscovery::ALL_GROUPS);  // block 1 still pending
+    EXPECT_TRUE(feed(stream(0x011, 0x8103, 0x02020200)));
+    EXPECT_TRUE(discovery.functionBlocksKnown());
+    EXPECT_EQ(discovery.receivingGroups(), 0x000Cu);
+    EXPECT_EQ(discovery.midiCIGroups(), 0x000Cu);
+
+    const auto& endpoint = discovery.endpoint();
+    EXPECT_EQ(endpoint.name, "Stage Piano MkII");
+    EXPECT_EQ(endpoint.manufacturer, 0x41u);
+    EXPECT_EQ(endpoint.family, 1u);
+    EXPECT_EQ(endpoint.model, 2u);
+    EXPECT_TRUE(endpoint.staticFunctionBlocks);
+    EXPECT_EQ(endpoint.protocol, UmpProtocol::Midi2);
+    EXPECT_FALSE(endpoint.rxJr);
+    EXPECT_EQ(endpoint.functionBlocks[1].name, "Upper manual");
+    std::cout << "[TEST] " << discovery.describe() << std::endl;
+
+    // Anything that is not a UMP Stream message is none of its business
+    EXPECT_FALSE(feed({0x40903C00, 0xFFFF0000, 0, 0}));
+}
+
+TEST_F(UmpEndpointTest, TestNegotiationFallsBackToWhatTheEndpointSupports) {
+    UmpStreamPreferences preferences;
+    preferences.receiveJrTimestamps = true;
+    discovery.setPreferences(preferences);
+    discovery.start(requests);
+    requests.clear();
+
+    // MIDI 1.0 only, can send JR Timestamps, no function blocks
+    feed(stream(0x001, 0x0101, 0x00000101));
+    EXPECT_TRUE(requests.empty());
+    feed(stream(0x006, 0x0100));
+    ASSERT_EQ(requests.size(), 4u);
+    EXPECT_EQ(requests[0], 0xF0050101u);  // stays MIDI 1.0, asks for TxJR
+    EXPECT_EQ(discovery.receivingGroups(), UmpEndpointDiscovery::ALL_GROUPS);
+
+    // A later discovery starts from the cache: the groups apply before the endpoint answers
+    UmpEndpointInfo cached;
+    cached.functionBlocks.resize(1);
+    cached.functionBlocks[0] = {0, true, true, UmpFunctionBlock::DIRECTION_INPUT | UmpFunctionBlock::DIRECTION_OUTPUT, 4, 1,
+                                0, 0, 0, 0, ""};
+    requests.clear();
+    discovery.start(cached, requests);
+    EXPECT_EQ(requests.size(), 4u);
+    EXPECT_EQ(discovery.receivingGroups(), 0x0010u);
+    EXPECT_EQ(discovery.midiCIGroups(), 0u);  // no MIDI-CI behind that block
+}
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "latency_tracker.h"
+#include "ump_output_queue.h"
+
+class UmpOutputQueueTest : public ::testing::Test {
+protected:
+    // A SysEx7 message of `packets` packets whose first data word carries `tag`
+    static std::vector<uint32_t> sysex(uint32_t tag, int packets) {
+        std::vector<uint32_t> words;
+        for (int i = 0; i < packets; i++) {
+            uint32_t status = packets == 1 ? 0x0 : i == 0 ? 0x1 : i == packets - 1 ? 0x3 : 0x2;
+            words.push_back(0x30000000u | (status << 20) | 0x00060000u | (tag & 0xFFFF));
+            words.push_back(static_cast<uint32_t>(i));
+        }
+        return words;
+    }
+
+    static std::vector<uint32_t> noteOn(uint8_t note) {
+        return {0x40900000u | (static_cast<uint32_t>(note) << 8), 0xFFFF0000u};
+    }
+
+    std::mutex mutex;
+    std::vector<std::vector<uint32_t>> written;
+};
+
+TEST_F(UmpOutputQueueTest, TestNotesOvertakeWaitingSysExBetweenMessages) {
+    UmpOutputQueue* self = nullptr;
+    UmpOutputQueue queue([&](const uint32_t* words, size_t wordCount) {
+        std::lock_guard<std::mutex> lock(mutex);
+        written.emplace_back(words, words + wordCount);
+        // A key is pressed while the first property reply is on the wire
+        if (written.size() == 1) {
+            self->submit(UmpLane::Realtime, noteOn(60));
+        }
+    });
+    self = &queue;
+
+    queue.submit(UmpLane::Bulk, sysex(1, 20));
+    queue.submit(UmpLane::Bulk, sysex(2, 20));
+    queue.submit(UmpLane::Bulk, sysex(3, 20));
+    queue.start();
+    for (int i = 0; i < 1000 && queue.stats().words < 3u * 40 + 2; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    queue.stop();
+
+    // The note waits for the message in flight, not for the ones behind it
+    ASSERT_EQ(written.size(), 4u);
+    EXPECT_EQ(written[0], sysex(1, 20));
+    EXPECT_EQ(written[1], noteOn(60));
+    EXPECT_EQ(written[2], sysex(2, 20));
+    EXPECT_EQ(written[3], sysex(3, 20));
+
+    auto stats = queue.stats();
+    EXPECT_EQ(stats.realtimeBatches, 1u);
+    EXPECT_EQ(stats.bulkBatches, 3u);
+    EXPECT_EQ(stats.overtakes, 1u);
+    EXPECT_EQ(stats.words, 3u * 40 + 2);
+
+    // Stopped: nothing more is accepted
+    EXPECT_FALSE(queue.submit(UmpLane::Realtime, noteOn(61)));
+}
+
+TEST_F(UmpOutputQueueTest, TestConcurrentProducersKeepMessagesWhole) {
+    constexpr int PRODUCERS = 4;
+    constexpr int MESSAGES = 2000;
+    UmpOutputQueue queue([&](const uint32_t* words, size_t wordCount) {
+        std::lock_guard<std::mutex> lock(mutex);
+        written.emplace_back(words, words + wordCount);
+    });
+    queue.start();
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < PRODUCERS; p++) {
+        producers.emplace_back([&queue, p]() {
+            for (int i = 0; i < MESSAGES; i++) {
+                uint32_t tag = static_cast<uint32_t>(p << 12 | i);
+                if (p % 2 == 0) {
+                    queue.submit(UmpLane::Bulk, sysex(tag, 1 + i % 7));
+                } else {
+                    queue.submit(UmpLane::Realtime, noteOn(static_cast<uint8_t>(i & 0x7F)));
+                }
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    queue.stop();
+
+    ASSERT_EQ(written.size(), static_cast<size_t>(PRODUCERS * MESSAGES));
+    // Each SysEx arrives as the exact message submitted, and each producer's messages in order
+    std::vector<int> nextMessage(PRODUCERS, 0);
+    for (const auto& batch : written) {
+        if ((batch[0] >> 28) != 0x3) {
+            continue;
+        }
+        int producer = static_cast<int>((batch[0] >> 12) & 0xF);
+        int message = nextMessage[producer];
+        EXPECT_EQ(batch, sysex(static_cast<uint32_t>(producer << 12 | message), 1 + message % 7));
+        nextMessage[producer]++;
+    }
+    EXPECT_EQ(nextMessage[0], MESSAGES);
+    EXPECT_EQ(nextMessage[2], MESSAGES);
+    std::cout << "[TEST] " << queue.stats().overtakes << " of " << PRODUCERS / 2 * MESSAGES
+              << " notes overtook waiting SysEx" << std::endl;
+}
+
+TEST_F(UmpOutputQueueTest, TestRecordsQueueToWireForRealtimeBatches) {
+    auto& tracker = LatencyTracker::instance();
+    tracker.setEnabled(true);
+    tracker.reset();
+
+    UmpOutputQueue queue([this](const uint32_t* words, size_t wordCount) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));  // a slow port
+        std::lock_guard<std::mutex> lock(mutex);
+        written.emplace_back(words, words + wordCount);
+    });
+    queue.start();
+    for (uint8_t note = 60; note < 63; note++) {
+        auto words = noteOn(note);
+        queue.submit(UmpLane::Realtime, words.data(), words.size());
+    }
+    queue.submit(UmpLane::Bulk, sysex(1, 2));
+    queue.stop();
+
+    // One interval per realtime batch, measured until the sink returned
+    const auto& histogram = tracker.histogram(LatencyInterval::QueueToWire);
+    EXPECT_EQ(histogram.count(), 3u);
+    EXPECT_GE(histogram.max(), 200'000u);
+    std::cout << "[TEST] queue->wire max " << histogram.max() / 1000 << " us" << std::endl;
+}
@@ -0,0 +1,279 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "keyboard_controller.h"
+#include "ump_capture.h"
+#include "ump_replay.h"
+
+namespace {
+
+constexpr uint32_t LOCAL_MUID = 0x0ABCDEF;
+constexpr uint32_t REMOTE_MUID = 0x1234567;
+
+void appendMuid(std::vector<uint8_t>& out, uint32_t muid) {
+    for (int shift = 0; shift < 28; shift += 7) {
+        out.push_back(static_cast<uint8_t>((muid >> shift) & 0x7F));
+    }
+}
+
+void append14(std::vector<uint8_t>& out, size_t value) {
+    out.push_back(static_cast<uint8_t>(value & 0x7F));
+    out.push_back(static_cast<uint8_t>((value >> 7) & 0x7F));
+}
+
+// A MIDI-CI 1.2 message from the remote device to us, without F0/F7
+std::vector<uint8_t> ciMessage(uint8_t subId2, const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> message = {0x7E, 0x7F, 0x0D, subId2, 0x02};
+    appendMuid(message, REMOTE_MUID);
+    appendMuid(message, LOCAL_MUID);
+    message.insert(message.end(), payload.begin(), payload.end());
+    return message;
+}
+
+std::vector<uint8_t> propertyReply(uint8_t requestId, const std::string& header, const std::string& body) {
+    std::vector<uint8_t> payload = {requestId};
+    append14(payload, header.size());
+    payload.insert(payload.end(), header.begin(), header.end());
+    append14(payload, 1);  // one chunk
+    append14(payload, 1);  // chunk 1
+    append14(payload, body.size());
+    payload.insert(payload.end(), body.begin(), body.end());
+    return ciMessage(0x35, payload);
+}
+
+}  // namespace
+
+class UmpReplayTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto base = std::filesystem::temp_directory_path() /
+                    ("ump_replay_test_" + std::string(::testing::UnitTest::GetInstance()->current_test_info()->name()));
+        capturePath = base.string() + ".umpcap";
+        expectationPath = base.string() + ".expect";
+        controller = std::make_unique<KeyboardController>();
+    }
+
+    void TearDown() override {
+        controller.reset();
+        std::error_code ec;
+        std::filesystem::remove(capturePath, ec);
+        std::filesystem::remove(expectationPath, ec);
+    }
+
+    void writeCapture() {
+        UmpCaptureRecorder recorder;
+        ASSERT_TRUE(recorder.open(capturePath, 64, LOCAL_MUID));
+
+        uint32_t noteOn[2] = {0x40903C00, 0xFFFF0000};
+        recorder.append(UmpCaptureDirection::Outgoing, noteOn, 2);
+
+        // Discovery Inquiry from another MUID, split into start/end SysEx7 packets
+        uint32_t start[2] = {0x30167E7F, 0x0D700201};
+        uint32_t end[2] = {0x30320203, 0x04000000};
+        recorder.append(UmpCaptureDirection::Incoming, start, 2);
+        recorder.append(UmpCaptureDirection::Incoming, end, 2);
+    }
+
+    // Splits one SysEx into SysEx7 packets on group 0
+    static void appendSysEx(UmpCaptureRecorder& recorder, const std::vector<uint8_t>& data) {
+        size_t packets = std::max<size_t>(1, (data.size() + 5) / 6);
+        for (size_t p = 0; p < packets; p++) {
+            size_t count = std::min<size_t>(6, data.size() - p * 6);
+            uint32_t status = packets == 1 ? 0 : p == 0 ? 1 : p == packets - 1 ? 3 : 2;
+            uint8_t bytes[6] = {};
+            std::copy_n(data.begin() + p * 6, count, bytes);
+            uint32_t words[2] = {
+                0x30000000u | (status << 20) | (static_cast<uint32_t>(count) << 16) | (bytes[0] << 8) | bytes[1],
+                (static_cast<uint32_t>(bytes[2]) << 24) | (bytes[3] << 16) | (bytes[4] << 8) | bytes[5]};
+            recorder.append(UmpCaptureDirection::Incoming, words, 2);
+        }
+    }
+
+    // What a device with Property Exchange answers to our discovery: Discovery Reply, Endpoint
+    // Reply, PE Capabilities Reply and a resource list for our Get Property Data request. The
+    // request ID depends on what the stack sent before, so the reply is there for each of them.
+    void writeSessionCapture() {
+        UmpCaptureRecorder recorder;
+        ASSERT_TRUE(recorder.open(capturePath, 1024, LOCAL_MUID));
+
+        std::vector<uint8_t> details = {0x7D, 0x00, 0x00,  // manufacturer
+                                        0x01, 0x00,        // family
+                                        0x02, 0x00,        // model
+                                        0x01, 0x00, 0x00, 0x00,  // version
+                                        0x08,                    // Property Exchange
+                                        0x00, 0x20, 0x00, 0x00,  // 4096 byte SysEx
+                                        0x00, 0x7F};             // output path, no function block
+        appendSysEx(recorder, ciMessage(0x71, details));
+
+        std::string productInstanceId = "replay-1";
+        std::vector<uint8_t> endpoint = {0x00};
+        append14(endpoint, productInstanceId.size());
+        endpoint.insert(endpoint.end(), productInstanceId.begin(), productInstanceId.end());
+        appendSysEx(recorder, ciMessage(0x73, endpoint));
+
+        appendSysEx(recorder, ciMessage(0x31, {0x04, 0x00, 0x00}));
+
+        for (uint8_t requestId = 0; requestId < 32; requestId++) {
+            appendSysEx(recorder, propertyReply(requestId, R"({"status":200})", R"([{"resource":"DeviceInfo"}])"));
+        }
+    }
+
+    static size_t countWithPrefix(const std::vector<std::string>& lines, const std::string& prefix) {
+        return std::count_if(lines.begin(), lines.end(),
+                             [&](const std::string& line) { return line.rfind(prefix, 0) == 0; });
+    }
+
+    std::string capturePath;
+    std::string expectationPath;
+    std::unique_ptr<KeyboardController> controller;
+};
+
+TEST_F(UmpReplayTest, TestReplaysOnlyIncomingPackets) {
+    writeCapture();
+
+    UmpReplayer replayer(*controller);
+    auto report = replayer.replay(capturePath, UmpReplayOptions{});
+    ASSERT_TRUE(report.has_value());
+
+    std::cout << "[TEST] Replayed " << report->packets << " packets, " << report->sysexBytes << " SysEx bytes" << std::endl;
+    EXPECT_EQ(report->packets, 2u);
+    EXPECT_EQ(report->sysexPackets, 2u);
+    EXPECT_EQ(report->sysexBytes, 8u);
+    EXPECT_TRUE(controller->isMidiCIInitialized());
+    EXPECT_EQ(controller->getMidiCIMuid(), LOCAL_MUID);
+}
+
+TEST_F(UmpReplayTest, TestRestoresDevicesAndPropertiesFromCapture) {
+    writeSessionCapture();
+
+    UmpReplayer replayer(*controller);
+    ASSERT_TRUE(replayer.replay(capturePath, UmpReplayOptions{}).has_value());
+    auto state = replayer.describeState();
+    for (const auto& line : state) {
+        std::cout << "[TEST] " << line << std::endl;
+    }
+
+    EXPECT_EQ(countWithPrefix(state, "device "), 1u);
+    EXPECT_EQ(countWithPrefix(state, "device 01234567 endpoint_ready=1"), 1u);
+    EXPECT_GE(countWithPrefix(state, "property 01234567 "), 1u);
+    EXPECT_EQ(countWithPrefix(state, "property 01234567 ResourceList "), 1u);
+    ASSERT_TRUE(replayer.writeExpectation(expectationPath));
+
+    // A second replay from a fresh MIDI-CI instance must land in the same state
+    ASSERT_TRUE(replayer.replay(capturePath, UmpReplayOptions{}).has_value());
+    EXPECT_EQ(replayer.describeState(), state);
+    EXPECT_TRUE(replayer.verifyExpectation(expectationPath));
+}
+
+TEST_F(UmpReplayTest, TestMutedReplayKeepsMidiCIResetOffOutput) {
+    writeSessionCapture();
+    // Whatever startup sent has been written by now
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto before = controller->getOutputStats();
+
+    // The reset to the captured MUID sends InvalidateMUID and a discovery; both must be muted
+    UmpReplayer replayer(*controller);
+    ASSERT_TRUE(replayer.replay(capturePath, UmpReplayOptions{}).has_value());
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto after = controller->getOutputStats();
+
+    std::cout << "[TEST] Output batches during muted replay: " << after.bulkBatches - before.bulkBatches << " bulk, "
+              << after.realtimeBatches - before.realtimeBatches << " realtime" << std::endl;
+    EXPECT_EQ(after.bulkBatches, before.bulkBatches);
+    EXPECT_EQ(after.realtimeBatches, before.realtimeBatches);
+}
+
+TEST_F(UmpReplayTest, TestReportsTamperedExpectation) {
+    writeSessionCapture();
+
+    UmpReplayer replayer(*controller);
+    ASSERT_TRUE(replayer.replay(capturePath, UmpReplayOptions{}).has_value());
+    auto state = replayer.describeState();
+    ASSERT_FALSE(state.empty());
+
+    // A property body that hashes differently
+    {
+        std::ofstream out(expectationPath);
+        for (const auto& line : state) {
+            std::string tampered = line;
+            if (tampered.rfind("property ", 0) == 0) {
+                tampered.replace(tampered.size() - 1, 1, tampered.back() == '0' ? "1" : "0");
+            }
+            out << tampered << '\n';
+        }
+    }
+    EXPECT_FALSE(replayer.verifyExpectation(expectationPath));
+
+    // A device the replay never saw
+    {
+        std::ofstream out(expectationPath);
+        for (const auto& line : state) {
+            out << line << '\n';
+        }
+        out << "device 07654321 endpoint_ready=0\n";
+    }
+    EXPECT_FALSE(replayer.verifyExpectation(expectationPath));
+
+    // The untouched expectation still matches
+    {
+        std::ofstream out(expectationPath);
+        for (const auto& line : state) {
+            out << line << '\n';
+        }
+    }
+    EXPECT_TRUE(replayer.verifyExpectation(expectationPath));
+}
+
+TEST_F(UmpReplayTest, TestScaledTimingDividesCapturedGaps) {
+    {
+        UmpCaptureRecorder recorder;
+        ASSERT_TRUE(recorder.open(capturePath, 16, LOCAL_MUID));
+        uint32_t clock[1] = {0x10F80000};
+        recorder.append(UmpCaptureDirection::Incoming, clock, 1);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        recorder.append(UmpCaptureDirection::Incoming, clock, 1);
+    }
+
+    UmpCaptureReader reader;
+    ASSERT_TRUE(reader.open(capturePath));
+    auto entries = reader.readAll();
+    ASSERT_EQ(entries.size(), 2u);
+    double gap = static_cast<double>(entries[1].timestamp_ns - entries[0].timestamp_ns) / 1e9;
+    reader.close();
+
+    struct Case {
+        ReplayTiming timing;
+        double speed;
+    };
+    UmpReplayer replayer(*controller);
+    for (const auto& c : {Case{ReplayTiming::Original, 1.0}, Case{ReplayTiming::Scaled, 2.0},
+                          Case{ReplayTiming::Scaled, 0.5}}) {
+        UmpReplayOptions options;
+        options.timing = c.timing;
+        options.speed = c.speed;
+        auto report = replayer.replay(capturePath, options);
+        ASSERT_TRUE(report.has_value());
+
+        double expected = gap / c.speed;
+        std::cout << "[TEST] Speed " << c.speed << ": " << report->seconds << "s for a " << gap << "s gap" << std::endl;
+        EXPECT_EQ(report->packets, 2u);
+        EXPECT_GE(report->seconds, expected - 0.001);
+        EXPECT_LT(report->seconds, expected + 0.05);
+    }
+
+    auto fast = replayer.replay(capturePath, UmpReplayOptions{});
+    ASSERT_TRUE(fast.has_value());
+    EXPECT_LT(fast->seconds, gap / 4);
+}
+
+TEST_F(UmpReplayTest, TestRejectsMissingCapture) {
+    UmpReplayer replayer(*controller);
+    EXPECT_FALSE(replayer.replay(capturePath, UmpReplayOptions{}).has_value());
+}